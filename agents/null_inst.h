@@ -14,6 +14,10 @@ class NullInst : public cyclus::Institution {
 
   virtual std::string version() { return cyclus::version::describe(); }
 
+  /// A null institution only decommissions its children at the end of their
+  /// lifetimes and so is woken at their exit times.
+  virtual int NextWakeup() { return NextChildExit(); }
+
   #pragma cyclus
 
   #pragma cyclus note {"doc": "An instition that owns facilities in the " \
@@ -52,6 +52,12 @@ TEST_F(NullInstTest, Tock) {
   // Test NullInst specific behaviors of the handleTock function here
 }
 
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST_F(NullInstTest, NextWakeup) {
+  // without children there are no lifetimes to check
+  EXPECT_EQ(kNeverWake, src_inst_->NextWakeup());
+}
+
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 cyclus::Agent* NullInstConstructor(cyclus::Context* ctx) {
   return new NullInst(ctx);
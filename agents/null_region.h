@@ -14,6 +14,9 @@ class NullRegion : public cyclus::Region {
 
   virtual std::string version() { return cyclus::version::describe(); }
 
+  /// A null region does nothing in Tick and Tock and so is never woken.
+  virtual int NextWakeup() { return kNeverWake; }
+
   #pragma cyclus
 
   #pragma cyclus note {"doc": "A region that owns the simulation's " \
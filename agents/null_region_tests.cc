@@ -56,6 +56,11 @@ TEST_F(NullRegionTest, Tock) {
   // Test NullRegion specific behaviors of the handleTock function here
 }
 
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST_F(NullRegionTest, NextWakeup) {
+  EXPECT_EQ(kNeverWake, src_region_->NextWakeup());
+}
+
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 cyclus::Agent* NullRegionConstructor(cyclus::Context* ctx) {
   return new NullRegion(ctx);
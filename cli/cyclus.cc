@@ -10,7 +10,9 @@
 #include <boost/uuid/uuid_io.hpp>
 #include <boost/uuid/string_generator.hpp>
 
+#include "column_back.h"
 #include "cyclus.h"
+#include "ensemble.h"
 #include "hdf5_back.h"
 #include "pyne.h"
 #include "query_backend.h"
@@ -31,6 +33,17 @@ struct ArgInfo {
   std::string schema_path;
   std::string output_path;
   std::string restart;
+  int nthreads;
+  int record_buffers;
+  double intern_tol;
+  bool batch_decay;
+  bool skip_idle;
+  int timings;
+  int snapshot_interval;
+  int delta_snapshots;
+  bool sqlite_binary;
+  std::vector<std::string> ensemble;
+  int ensemble_threads;
 };
 
 // Describes and parses cli arguments. Returns the error code that main should
@@ -44,6 +57,10 @@ int EarlyExitArgs(const ArgInfo& ai);
 // Using cli flags, retrieves and sets global params for the simulation.
 void GetSimInfo(ArgInfo* ai);
 
+// Runs the input files of an --ensemble concurrently. Returns the error code
+// that main should return.
+int RunEnsemble(const ArgInfo& ai);
+
 static std::string usage = "Usage:   cyclus [opts] [input-file]";
 
 //-----------------------------------------------------------------------
@@ -70,6 +87,9 @@ int main(int argc, char* argv[]) {
   if (ret > -1) {
     return ret;
   }
+  if (!ai.ensemble.empty()) {
+    return RunEnsemble(ai);
+  }
 
   // Process positional args
   std::string infile;
@@ -120,8 +140,14 @@ int main(int argc, char* argv[]) {
   std::string stem = fs::path(ai.output_path).stem().string();
   if (ext == ".h5") {
     fback = new Hdf5Back(ai.output_path.c_str());
+  } else if (ext == ".col") {
+    fback = new ColumnBack(ai.output_path);
   } else {
-    fback = new SqliteBack(ai.output_path);
+    SqliteBack::Encoding enc = SqliteBack::XML_ENCODING;
+    if (ai.sqlite_binary) {
+      enc = SqliteBack::BINARY_ENCODING;
+    }
+    fback = new SqliteBack(ai.output_path, enc);
   }
   rec.RegisterBackend(fback);
   bdel.Add(fback);
@@ -186,6 +212,8 @@ int main(int argc, char* argv[]) {
     std::string ext = dbfile.extension().string();
     if (ext == ".h5") {
       rback = new Hdf5Back(dbfile.c_str());
+    } else if (ext == ".col") {
+      rback = new ColumnBack(dbfile.string());
     } else {
       rback = new SqliteBack(dbfile.c_str());
     }
@@ -195,6 +223,31 @@ int main(int argc, char* argv[]) {
     si.recorder()->RegisterBackend(fback);
   }
 
+  if (ai.nthreads > 0) {
+    si.context()->nthreads(ai.nthreads);
+  }
+  if (ai.record_buffers > 0) {
+    si.context()->record_buffers(ai.record_buffers);
+  }
+  if (ai.intern_tol >= 0) {
+    si.context()->intern_tol(ai.intern_tol);
+  }
+  if (ai.batch_decay) {
+    si.context()->batch_decay(true);
+  }
+  if (ai.skip_idle) {
+    si.context()->skip_idle(true);
+  }
+  if (ai.timings >= 0) {
+    si.context()->timings(ai.timings);
+  }
+  if (ai.snapshot_interval >= 0) {
+    si.context()->snapshot_interval(ai.snapshot_interval);
+  }
+  if (ai.delta_snapshots >= 0) {
+    si.context()->delta_snapshots(ai.delta_snapshots);
+  }
+
   try {
     si.timer()->RunSim();
   } catch (cyclus::Error err) {
@@ -209,6 +262,11 @@ int main(int argc, char* argv[]) {
   std::cout << "Output location: " << ai.output_path << std::endl;
   std::cout << "Simulation ID: " << boost::lexical_cast<std::string>
                (si.context()->sim_id()) << std::endl;
+  IdCounters::Scope scope(si.context()->ids());
+  if (Composition::intern_tol() > 0) {
+    std::cout << "Duplicate compositions removed: "
+              << Composition::n_interned_dups() << std::endl;
+  }
 
   return 0;
 }
@@ -239,6 +297,40 @@ int ParseCliArgs(ArgInfo* ai, int argc, char* argv[]) {
       ("verb,v", po::value<std::string>(),
        "log verbosity. integer from 0 (quiet) to 11 (verbose).")
       ("output-path,o", po::value<std::string>(), "output path")
+      ("sqlite-binary", "store container values in sqlite output in a "
+       "compact binary encoding instead of XML, which older versions of "
+       "cyclus cannot read")
+      ("threads,j", po::value<int>(),
+       "number of threads for parallel simulation phases, overrides the "
+       "input file's control parameters")
+      ("record-buffers", po::value<int>(),
+       "number of output buffers, 2 or more writes output on a separate "
+       "thread; overrides the input file's control parameters")
+      ("intern-tol", po::value<double>(),
+       "relative tolerance for sharing equal material compositions, 0 "
+       "disables; overrides the input file's control parameters")
+      ("batch-decay", "decay all materials together at the start of each "
+       "time step; overrides the input file's control parameters")
+      ("skip-idle", "skip time steps at which no agent is scheduled to act; "
+       "overrides the input file's control parameters")
+      ("timings", po::value<int>(),
+       "record phase timings in the PhaseTimings table (1), and also "
+       "per-agent timings in the AgentTimings table (2), 0 disables; "
+       "overrides the input file's control parameters")
+      ("snapshot-interval", po::value<int>(),
+       "snapshot the simulation state every N time steps, 0 disables; "
+       "overrides the input file's control parameters")
+      ("delta-snapshots", po::value<int>(),
+       "number of incremental snapshots, recording only changed agent "
+       "state and inventory differences, taken after each full snapshot; "
+       "overrides the input file's control parameters")
+      ("ensemble", po::value<std::vector<std::string> >()->multitoken(),
+       "run several input files concurrently in one process; each writes "
+       "to its input file's stem with the output path's directory and "
+       "extension")
+      ("ensemble-threads", po::value<int>(),
+       "number of ensemble simulations run at the same time, defaults to "
+       "the number of hardware threads")
       ("input-file", po::value<std::string>(), "input file")
       ("warn-limit", po::value<unsigned int>(),
        "number of warnings to issue per kind, defaults to 42")
@@ -456,9 +548,70 @@ void GetSimInfo(ArgInfo* ai) {
   if (ai->vm.count("warn-as-error"))
     cyclus::warn_as_error = true;
 
-  // Output path
+  // Threading params
+  ai->nthreads = 0;
+  if (ai->vm.count("threads")) {
+    ai->nthreads = ai->vm["threads"].as<int>();
+  }
+  ai->record_buffers = 0;
+  if (ai->vm.count("record-buffers")) {
+    ai->record_buffers = ai->vm["record-buffers"].as<int>();
+  }
+  ai->intern_tol = -1;
+  if (ai->vm.count("intern-tol")) {
+    ai->intern_tol = ai->vm["intern-tol"].as<double>();
+  }
+  ai->batch_decay = ai->vm.count("batch-decay") > 0;
+  ai->skip_idle = ai->vm.count("skip-idle") > 0;
+  ai->timings = -1;
+  if (ai->vm.count("timings")) {
+    ai->timings = ai->vm["timings"].as<int>();
+  }
+  ai->snapshot_interval = -1;
+  if (ai->vm.count("snapshot-interval")) {
+    ai->snapshot_interval = ai->vm["snapshot-interval"].as<int>();
+  }
+  ai->delta_snapshots = -1;
+  if (ai->vm.count("delta-snapshots")) {
+    ai->delta_snapshots = ai->vm["delta-snapshots"].as<int>();
+  }
+
+  // Output params
+  ai->sqlite_binary = ai->vm.count("sqlite-binary") > 0;
   ai->output_path = "cyclus.sqlite";
   if (ai->vm.count("output-path")) {
     ai->output_path = ai->vm["output-path"].as<std::string>();
   }
+
+  // Ensemble params
+  if (ai->vm.count("ensemble")) {
+    ai->ensemble = ai->vm["ensemble"].as<std::vector<std::string> >();
+  }
+  ai->ensemble_threads = 0;
+  if (ai->vm.count("ensemble-threads")) {
+    ai->ensemble_threads = ai->vm["ensemble-threads"].as<int>();
+  }
+}
+
+int RunEnsemble(const ArgInfo& ai) {
+  fs::path out(ai.output_path);
+  Ensemble e(ai.ensemble_threads);
+  for (int i = 0; i < ai.ensemble.size(); ++i) {
+    std::string stem = fs::path(ai.ensemble[i]).stem().string();
+    fs::path outfile = out.parent_path() / (stem + out.extension().string());
+    e.Add(ai.ensemble[i], outfile.string());
+  }
+
+  int nfailed = e.Run();
+  const std::vector<EnsembleCase>& cases = e.cases();
+  for (int i = 0; i < cases.size(); ++i) {
+    if (cases[i].error.empty()) {
+      std::cout << cases[i].infile << ": " << cases[i].outfile << "\n";
+    } else {
+      std::cerr << cases[i].infile << ": " << cases[i].error << "\n";
+    }
+  }
+  std::cout << "Status: " << cases.size() - nfailed << " of " << cases.size()
+            << " ensemble simulations successful" << std::endl;
+  return nfailed > 0 ? 1 : 0;
 }
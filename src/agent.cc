@@ -14,7 +14,6 @@
 namespace cyclus {
 
 // static members
-int Agent::next_id_ = 0;
 
 void Agent::InitFrom(Agent* m) {
   prototype_ = m->prototype_;
@@ -58,7 +57,7 @@ void Agent::Snapshot(DbInit di) {
 
 Agent::Agent(Context* ctx)
     : ctx_(ctx),
-      id_(next_id_++),
+      id_(ctx->ids()->agent++),
       kind_("Agent"),
       parent_id_(-1),
       enter_time_(-1),
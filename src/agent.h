@@ -453,9 +453,6 @@ class Agent : public StateWrangler, virtual public Ider {
   /// connects an agent to its parent.
   void Connect(Agent* parent);
 
-  /// Stores the next available facility ID
-  static int next_id_;
-
   /// children of this agent
   std::set<Agent*> children_;
 
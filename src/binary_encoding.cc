@@ -0,0 +1,187 @@
+#include "binary_encoding.h"
+
+#include <typeinfo>
+
+#include <boost/uuid/uuid.hpp>
+
+#include "blob.h"
+
+namespace cyclus {
+
+namespace {
+
+struct TypeInfoLess {
+  bool operator()(const std::type_info* a, const std::type_info* b) const {
+    return a->before(*b);
+  }
+};
+
+typedef std::map<const std::type_info*, DbTypes, TypeInfoLess> TypeMap;
+
+TypeMap BuildTypeMap() {
+  TypeMap type_map;
+  type_map[&typeid(int)] = INT;
+  type_map[&typeid(double)] = DOUBLE;
+  type_map[&typeid(float)] = FLOAT;
+  type_map[&typeid(bool)] = BOOL;
+  type_map[&typeid(Blob)] = BLOB;
+  type_map[&typeid(boost::uuids::uuid)] = UUID;
+  type_map[&typeid(std::string)] = STRING;
+  type_map[&typeid(std::set<int>)] = SET_INT;
+  type_map[&typeid(std::set<std::string>)] = SET_STRING;
+  type_map[&typeid(std::vector<int>)] = VECTOR_INT;
+  type_map[&typeid(std::vector<double>)] = VECTOR_DOUBLE;
+  type_map[&typeid(std::vector<std::string>)] = VECTOR_STRING;
+  type_map[&typeid(std::list<int>)] = LIST_INT;
+  type_map[&typeid(std::list<std::string>)] = LIST_STRING;
+  type_map[&typeid(std::map<int, int>)] = MAP_INT_INT;
+  type_map[&typeid(std::map<int, double>)] = MAP_INT_DOUBLE;
+  type_map[&typeid(std::map<int, std::string>)] = MAP_INT_STRING;
+  type_map[&typeid(std::map<std::string, int>)] = MAP_STRING_INT;
+  type_map[&typeid(std::map<std::string, double>)] = MAP_STRING_DOUBLE;
+  type_map[&typeid(std::map<std::string, std::string>)] = MAP_STRING_STRING;
+  type_map[&typeid(std::map<std::string, std::vector<double> >)] =
+      MAP_STRING_VECTOR_DOUBLE;
+  type_map[&typeid(std::map<std::string, std::map<int, double> >)] =
+      MAP_STRING_MAP_INT_DOUBLE;
+  type_map[&typeid(std::map<std::string,
+                            std::pair<double, std::map<int, double> > >)] =
+      MAP_STRING_PAIR_DOUBLE_MAP_INT_DOUBLE;
+  type_map[&typeid(std::map<int, std::map<std::string, double> >)] =
+      MAP_INT_MAP_STRING_DOUBLE;
+  type_map[&typeid(
+      std::map<std::string,
+               std::vector<std::pair<int, std::pair<std::string,
+                                                    std::string> > > >)] =
+      MAP_STRING_VECTOR_PAIR_INT_PAIR_STRING_STRING;
+  type_map[&typeid(std::list<std::pair<int, int> >)] = LIST_PAIR_INT_INT;
+  return type_map;
+}
+
+}  // namespace
+
+DbTypes BinType(const boost::spirit::hold_any& v) {
+  static const TypeMap type_map = BuildTypeMap();
+  const std::type_info* ti = &v.type();
+  TypeMap::const_iterator it = type_map.find(ti);
+  if (it == type_map.end()) {
+    throw ValueError(std::string("unsupported backend type ") + ti->name());
+  }
+  return it->second;
+}
+
+void BinEncodeAny(const boost::spirit::hold_any& v, DbTypes type,
+                  std::string* out) {
+
+// encodes the value v of type T and DbType D (inside a case statement)
+#define CYCLUS_COMMA ,
+#define CYCLUS_ENCODEVAL(D, T) \
+    case D: { \
+    BinEncode(v.cast<T>(), out); \
+    break; \
+    }
+
+  switch (type) {
+  CYCLUS_ENCODEVAL(SET_INT, std::set<int>);
+  CYCLUS_ENCODEVAL(SET_STRING, std::set<std::string>);
+  CYCLUS_ENCODEVAL(LIST_INT, std::list<int>);
+  CYCLUS_ENCODEVAL(LIST_STRING, std::list<std::string>);
+  CYCLUS_ENCODEVAL(VECTOR_INT, std::vector<int>);
+  CYCLUS_ENCODEVAL(VECTOR_DOUBLE, std::vector<double>);
+  CYCLUS_ENCODEVAL(VECTOR_STRING, std::vector<std::string>);
+  CYCLUS_ENCODEVAL(MAP_INT_DOUBLE, std::map<int CYCLUS_COMMA double>);
+  CYCLUS_ENCODEVAL(MAP_INT_INT, std::map<int CYCLUS_COMMA int>);
+  CYCLUS_ENCODEVAL(MAP_INT_STRING, std::map<int CYCLUS_COMMA std::string>);
+  CYCLUS_ENCODEVAL(MAP_STRING_INT, std::map<std::string CYCLUS_COMMA int>);
+  CYCLUS_ENCODEVAL(MAP_STRING_DOUBLE,
+                   std::map<std::string CYCLUS_COMMA double>);
+  CYCLUS_ENCODEVAL(MAP_STRING_STRING,
+                   std::map<std::string CYCLUS_COMMA std::string>);
+  CYCLUS_ENCODEVAL(MAP_STRING_VECTOR_DOUBLE,
+                   std::map<std::string CYCLUS_COMMA std::vector<double> >);
+  CYCLUS_ENCODEVAL(
+      MAP_STRING_MAP_INT_DOUBLE,
+      std::map<std::string CYCLUS_COMMA std::map<int CYCLUS_COMMA double> >);
+  CYCLUS_ENCODEVAL(MAP_STRING_PAIR_DOUBLE_MAP_INT_DOUBLE,
+                   std::map<std::string CYCLUS_COMMA std::pair<
+                       double CYCLUS_COMMA
+                       std::map<int CYCLUS_COMMA double> > >);
+  CYCLUS_ENCODEVAL(MAP_INT_MAP_STRING_DOUBLE,
+                   std::map<int CYCLUS_COMMA
+                            std::map<std::string CYCLUS_COMMA double> >);
+  CYCLUS_ENCODEVAL(
+      MAP_STRING_VECTOR_PAIR_INT_PAIR_STRING_STRING,
+      std::map<std::string CYCLUS_COMMA
+      std::vector<std::pair<int CYCLUS_COMMA
+      std::pair<std::string CYCLUS_COMMA std::string> > > >);
+  CYCLUS_ENCODEVAL(LIST_PAIR_INT_INT,
+                   std::list<std::pair<int CYCLUS_COMMA int> >);
+  default: {
+    throw ValueError("attempted to encode unsupported container type");
+  }
+  }
+#undef CYCLUS_ENCODEVAL
+#undef CYCLUS_COMMA
+}
+
+boost::spirit::hold_any BinDecodeAny(const char* data, size_t n,
+                                     DbTypes type) {
+  boost::spirit::hold_any v;
+  const char* p = data;
+
+// decodes a value of type T and DbType D into v (inside a case statement)
+#define CYCLUS_COMMA ,
+#define CYCLUS_DECODEVAL(D, T) \
+    case D: { \
+    T x; \
+    BinDecode(&p, data + n, &x); \
+    v = x; \
+    break; \
+    }
+
+  switch (type) {
+  CYCLUS_DECODEVAL(SET_INT, std::set<int>);
+  CYCLUS_DECODEVAL(SET_STRING, std::set<std::string>);
+  CYCLUS_DECODEVAL(LIST_INT, std::list<int>);
+  CYCLUS_DECODEVAL(LIST_STRING, std::list<std::string>);
+  CYCLUS_DECODEVAL(VECTOR_INT, std::vector<int>);
+  CYCLUS_DECODEVAL(VECTOR_DOUBLE, std::vector<double>);
+  CYCLUS_DECODEVAL(VECTOR_STRING, std::vector<std::string>);
+  CYCLUS_DECODEVAL(MAP_INT_DOUBLE, std::map<int CYCLUS_COMMA double>);
+  CYCLUS_DECODEVAL(MAP_INT_INT, std::map<int CYCLUS_COMMA int>);
+  CYCLUS_DECODEVAL(MAP_INT_STRING, std::map<int CYCLUS_COMMA std::string>);
+  CYCLUS_DECODEVAL(MAP_STRING_INT, std::map<std::string CYCLUS_COMMA int>);
+  CYCLUS_DECODEVAL(MAP_STRING_DOUBLE,
+                   std::map<std::string CYCLUS_COMMA double>);
+  CYCLUS_DECODEVAL(MAP_STRING_STRING,
+                   std::map<std::string CYCLUS_COMMA std::string>);
+  CYCLUS_DECODEVAL(MAP_STRING_VECTOR_DOUBLE,
+                   std::map<std::string CYCLUS_COMMA std::vector<double> >);
+  CYCLUS_DECODEVAL(
+      MAP_STRING_MAP_INT_DOUBLE,
+      std::map<std::string CYCLUS_COMMA std::map<int CYCLUS_COMMA double> >);
+  CYCLUS_DECODEVAL(MAP_STRING_PAIR_DOUBLE_MAP_INT_DOUBLE,
+                   std::map<std::string CYCLUS_COMMA std::pair<
+                       double CYCLUS_COMMA
+                       std::map<int CYCLUS_COMMA double> > >);
+  CYCLUS_DECODEVAL(MAP_INT_MAP_STRING_DOUBLE,
+                   std::map<int CYCLUS_COMMA
+                            std::map<std::string CYCLUS_COMMA double> >);
+  CYCLUS_DECODEVAL(
+      MAP_STRING_VECTOR_PAIR_INT_PAIR_STRING_STRING,
+      std::map<std::string CYCLUS_COMMA
+      std::vector<std::pair<int CYCLUS_COMMA
+      std::pair<std::string CYCLUS_COMMA std::string> > > >);
+  CYCLUS_DECODEVAL(LIST_PAIR_INT_INT,
+                   std::list<std::pair<int CYCLUS_COMMA int> >);
+  default: {
+    throw ValueError("attempted to decode unsupported container type");
+  }
+  }
+#undef CYCLUS_DECODEVAL
+#undef CYCLUS_COMMA
+
+  return v;
+}
+
+}  // namespace cyclus
@@ -0,0 +1,226 @@
+#ifndef CYCLUS_SRC_BINARY_ENCODING_H_
+#define CYCLUS_SRC_BINARY_ENCODING_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#include <list>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "any.hpp"
+#include "error.h"
+#include "query_backend.h"
+
+namespace cyclus {
+
+/// @name Binary encoding
+///
+/// The compact binary encoding of container values, as stored by SqliteBack
+/// (see SqliteBack::BINARY_ENCODING) and ColumnBack: native-endian 32-bit
+/// ints and 64-bit doubles, strings and containers prefixed by their 32-bit
+/// length, and pairs as their two members in order. BinDecode advances *p
+/// past the decoded value and throws a ValueError if that would pass end,
+/// including before allocating for a container length that the remaining
+/// bytes cannot hold.
+/// @{
+
+// All overloads are declared before any are defined so that nested
+// containers resolve to them.
+inline void BinEncode(const int& x, std::string* out);
+inline void BinEncode(const double& x, std::string* out);
+inline void BinEncode(const std::string& x, std::string* out);
+template <class T1, class T2>
+void BinEncode(const std::pair<T1, T2>& x, std::string* out);
+template <class T>
+void BinEncode(const std::vector<T>& x, std::string* out);
+template <class T>
+void BinEncode(const std::list<T>& x, std::string* out);
+template <class T>
+void BinEncode(const std::set<T>& x, std::string* out);
+template <class K, class V>
+void BinEncode(const std::map<K, V>& x, std::string* out);
+
+inline void BinDecode(const char** p, const char* end, int* x);
+inline void BinDecode(const char** p, const char* end, double* x);
+inline void BinDecode(const char** p, const char* end, std::string* x);
+template <class T1, class T2>
+void BinDecode(const char** p, const char* end, std::pair<T1, T2>* x);
+template <class T>
+void BinDecode(const char** p, const char* end, std::vector<T>* x);
+template <class T>
+void BinDecode(const char** p, const char* end, std::list<T>* x);
+template <class T>
+void BinDecode(const char** p, const char* end, std::set<T>* x);
+template <class K, class V>
+void BinDecode(const char** p, const char* end, std::map<K, V>* x);
+
+inline void BinEncodeLen(size_t n, std::string* out) {
+  uint32_t len = n;
+  out->append(reinterpret_cast<const char*>(&len), sizeof(len));
+}
+
+template <class It>
+void BinEncodeRange(It first, It last, size_t n, std::string* out) {
+  BinEncodeLen(n, out);
+  for (; first != last; ++first) {
+    BinEncode(*first, out);
+  }
+}
+
+inline void BinEncode(const int& x, std::string* out) {
+  int32_t v = x;
+  out->append(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+
+inline void BinEncode(const double& x, std::string* out) {
+  out->append(reinterpret_cast<const char*>(&x), sizeof(x));
+}
+
+inline void BinEncode(const std::string& x, std::string* out) {
+  BinEncodeLen(x.size(), out);
+  out->append(x);
+}
+
+template <class T1, class T2>
+void BinEncode(const std::pair<T1, T2>& x, std::string* out) {
+  BinEncode(x.first, out);
+  BinEncode(x.second, out);
+}
+
+template <class T>
+void BinEncode(const std::vector<T>& x, std::string* out) {
+  BinEncodeRange(x.begin(), x.end(), x.size(), out);
+}
+
+template <class T>
+void BinEncode(const std::list<T>& x, std::string* out) {
+  BinEncodeRange(x.begin(), x.end(), x.size(), out);
+}
+
+template <class T>
+void BinEncode(const std::set<T>& x, std::string* out) {
+  BinEncodeRange(x.begin(), x.end(), x.size(), out);
+}
+
+template <class K, class V>
+void BinEncode(const std::map<K, V>& x, std::string* out) {
+  BinEncodeRange(x.begin(), x.end(), x.size(), out);
+}
+
+/// Returns the number of bytes left between *p and end.
+inline size_t BinLeft(const char* const* p, const char* end) {
+  if (end < *p) {
+    throw ValueError("truncated binary container value");
+  }
+  return static_cast<size_t>(end - *p);
+}
+
+inline void BinRead(const char** p, const char* end, void* x, size_t n) {
+  if (BinLeft(p, end) < n) {
+    throw ValueError("truncated binary container value");
+  }
+  memcpy(x, *p, n);
+  *p += n;
+}
+
+inline size_t BinDecodeLen(const char** p, const char* end) {
+  uint32_t len;
+  BinRead(p, end, &len, sizeof(len));
+  return len;
+}
+
+/// Reads the length of a container, each of whose elements takes at least
+/// 4 bytes, and checks that the remaining bytes can hold that many.
+inline size_t BinDecodeCount(const char** p, const char* end) {
+  size_t n = BinDecodeLen(p, end);
+  if (n > BinLeft(p, end) / 4) {
+    throw ValueError("truncated binary container value");
+  }
+  return n;
+}
+
+inline void BinDecode(const char** p, const char* end, int* x) {
+  int32_t v;
+  BinRead(p, end, &v, sizeof(v));
+  *x = v;
+}
+
+inline void BinDecode(const char** p, const char* end, double* x) {
+  BinRead(p, end, x, sizeof(*x));
+}
+
+inline void BinDecode(const char** p, const char* end, std::string* x) {
+  size_t n = BinDecodeLen(p, end);
+  if (BinLeft(p, end) < n) {
+    throw ValueError("truncated binary container value");
+  }
+  x->assign(*p, n);
+  *p += n;
+}
+
+template <class T1, class T2>
+void BinDecode(const char** p, const char* end, std::pair<T1, T2>* x) {
+  BinDecode(p, end, &x->first);
+  BinDecode(p, end, &x->second);
+}
+
+template <class T>
+void BinDecode(const char** p, const char* end, std::vector<T>* x) {
+  size_t n = BinDecodeCount(p, end);
+  x->resize(n);
+  for (size_t i = 0; i < n; ++i) {
+    BinDecode(p, end, &(*x)[i]);
+  }
+}
+
+template <class T>
+void BinDecode(const char** p, const char* end, std::list<T>* x) {
+  size_t n = BinDecodeCount(p, end);
+  for (size_t i = 0; i < n; ++i) {
+    T v;
+    BinDecode(p, end, &v);
+    x->push_back(v);
+  }
+}
+
+template <class T>
+void BinDecode(const char** p, const char* end, std::set<T>* x) {
+  size_t n = BinDecodeCount(p, end);
+  for (size_t i = 0; i < n; ++i) {
+    T v;
+    BinDecode(p, end, &v);
+    x->insert(x->end(), v);
+  }
+}
+
+template <class K, class V>
+void BinDecode(const char** p, const char* end, std::map<K, V>* x) {
+  size_t n = BinDecodeCount(p, end);
+  for (size_t i = 0; i < n; ++i) {
+    std::pair<K, V> v;
+    BinDecode(p, end, &v);
+    x->insert(x->end(), v);
+  }
+}
+
+/// Returns the backend type of v, which must hold a scalar (bool, int, float,
+/// double, std::string, Blob or uuid) or a container type with a binary
+/// encoding. Throws a ValueError for any other type.
+DbTypes BinType(const boost::spirit::hold_any& v);
+
+/// Appends the binary encoding of the container value v of type type to out.
+void BinEncodeAny(const boost::spirit::hold_any& v, DbTypes type,
+                  std::string* out);
+
+/// Decodes a container value of type type from the n bytes at data.
+boost::spirit::hold_any BinDecodeAny(const char* data, size_t n, DbTypes type);
+
+/// @}
+
+}  // namespace cyclus
+
+#endif  // CYCLUS_SRC_BINARY_ENCODING_H_
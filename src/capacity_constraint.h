@@ -1,6 +1,8 @@
 #ifndef CYCLUS_SRC_CAPACITY_CONSTRAINT_H_
 #define CYCLUS_SRC_CAPACITY_CONSTRAINT_H_
 
+#include <atomic>
+
 #include <boost/shared_ptr.hpp>
 
 #include "error.h"
@@ -114,10 +116,10 @@ class CapacityConstraint {
   double capacity_;
   typename Converter<T>::Ptr converter_;
   int id_;
-  static int next_id_;
+  static std::atomic<int> next_id_;
 };
 
-template<class T> int CapacityConstraint<T>::next_id_ = 0;
+template<class T> std::atomic<int> CapacityConstraint<T>::next_id_(0);
 
 /// @brief CapacityConstraint-CapacityConstraint equality operator
 template<class T>
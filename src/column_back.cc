@@ -0,0 +1,790 @@
+#include "column_back.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <typeinfo>
+
+#include <boost/filesystem.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/uuid/uuid.hpp>
+
+#include "binary_encoding.h"
+#include "blob.h"
+#include "datum.h"
+#include "error.h"
+#include "logger.h"
+
+namespace fs = boost::filesystem;
+
+namespace cyclus {
+
+namespace {
+
+/// the size of the memory mapped segments column files are written through,
+/// a multiple of the page size
+const uint64_t kSegment = 1 << 20;
+
+/// the first line of every table's schema file
+const char* kSchemaMagic = "cyclus-columns 1";
+
+IOError SysError(const std::string& what, const std::string& path) {
+  return IOError(what + " " + path + ": " + strerror(errno));
+}
+
+/// How the values of a column are stored.
+enum Layout {
+  FIXED,  ///< an array of fixed width values in the .col file
+  DICT,  ///< 32-bit codes in the .col file, strings in the .dict file
+  OFFSETS,  ///< values in the .dat file, end offsets in the .off file
+};
+
+Layout LayoutOf(DbTypes type) {
+  switch (type) {
+    case BOOL:
+    case INT:
+    case FLOAT:
+    case DOUBLE:
+    case UUID:
+      return FIXED;
+    case STRING:
+    case VL_STRING:
+      return DICT;
+    default:
+      return OFFSETS;
+  }
+}
+
+/// Returns the number of bytes per row in the .col (FIXED and DICT) or .off
+/// (OFFSETS) file of a column of type type.
+size_t RowWidth(DbTypes type) {
+  switch (type) {
+    case BOOL:
+      return 1;
+    case INT:
+    case FLOAT:
+      return 4;
+    case UUID:
+      return 16;
+    case DOUBLE:
+      return 8;
+    default:
+      return LayoutOf(type) == DICT ? 4 : 8;
+  }
+}
+
+/// Returns the backend type of the i-th field of d.
+DbTypes FieldType(Datum* d, int i) {
+  switch (d->field(i).type) {
+    case Datum::BOOL_FIELD:
+      return BOOL;
+    case Datum::INT_FIELD:
+      return INT;
+    case Datum::FLOAT_FIELD:
+      return FLOAT;
+    case Datum::DOUBLE_FIELD:
+      return DOUBLE;
+    case Datum::STRING_FIELD:
+      return STRING;
+    case Datum::BLOB_FIELD:
+      return BLOB;
+    case Datum::UUID_FIELD:
+      return UUID;
+    default:
+      return BinType(d->box(i));
+  }
+}
+
+/// Appends to a file through a writable memory map of the kSegment sized,
+/// aligned segment of the file its end falls into. The file is extended a
+/// segment at a time while mapped and truncated to its contents by Flush.
+/// No file descriptor is held between segments.
+class Appender {
+ public:
+  /// Appends to the file at path, whose contents are its first size bytes.
+  /// Anything after them, e.g. the unused part of the last segment after an
+  /// unclean shutdown, is truncated. A negative size takes the whole file.
+  Appender(const std::string& path, int64_t size)
+      : path_(path),
+        map_(NULL),
+        map_off_(0) {
+    struct stat st;
+    uint64_t file_size = stat(path.c_str(), &st) == 0 ? st.st_size : 0;
+    if (size < 0) {
+      size_ = file_size;
+      return;
+    }
+    size_ = size;
+    if (file_size < size_) {
+      throw IOError("column file " + path + " is shorter than recorded");
+    } else if (file_size > size_ && truncate(path.c_str(), size_) != 0) {
+      throw SysError("cannot truncate column file", path);
+    }
+  }
+
+  ~Appender() {
+    try {
+      Flush();
+    } catch (Error err) {
+      CLOG(LEV_ERROR) << "Error in ColumnBack: " << err.what();
+    }
+  }
+
+  void Append(const void* p, size_t n) {
+    const char* src = static_cast<const char*>(p);
+    while (n > 0) {
+      if (map_ == NULL || size_ == map_off_ + kSegment) {
+        Map();
+      }
+      size_t k = std::min<uint64_t>(n, map_off_ + kSegment - size_);
+      memcpy(map_ + (size_ - map_off_), src, k);
+      size_ += k;
+      src += k;
+      n -= k;
+    }
+  }
+
+  /// Unmaps the current segment and truncates the file to its contents.
+  void Flush() {
+    if (map_ == NULL) {
+      return;
+    }
+    munmap(map_, kSegment);
+    map_ = NULL;
+    if (truncate(path_.c_str(), size_) != 0) {
+      throw SysError("cannot truncate column file", path_);
+    }
+  }
+
+  inline uint64_t size() const { return size_; }
+
+ private:
+  /// maps the segment the end of the file falls into
+  void Map() {
+    if (map_ != NULL) {
+      munmap(map_, kSegment);
+      map_ = NULL;
+    }
+    map_off_ = size_ - size_ % kSegment;
+    int fd = open(path_.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+      throw SysError("cannot open column file", path_);
+    }
+    if (ftruncate(fd, map_off_ + kSegment) != 0) {
+      close(fd);
+      throw SysError("cannot extend column file", path_);
+    }
+    void* m = mmap(NULL, kSegment, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+                   map_off_);
+    close(fd);
+    if (m == MAP_FAILED) {
+      throw SysError("cannot map column file", path_);
+    }
+    map_ = static_cast<char*>(m);
+  }
+
+  std::string path_;
+  uint64_t size_;
+  char* map_;
+  uint64_t map_off_;
+};
+
+/// A read-only memory map of a whole file. A missing file is empty.
+class MappedFile {
+ public:
+  explicit MappedFile(const std::string& path) : data_(NULL), size_(0) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+      void* m = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (m == MAP_FAILED) {
+        close(fd);
+        throw SysError("cannot map column file", path);
+      }
+      data_ = static_cast<const char*>(m);
+      size_ = st.st_size;
+    }
+    close(fd);
+  }
+
+  ~MappedFile() {
+    if (data_ != NULL) {
+      munmap(const_cast<char*>(data_), size_);
+    }
+  }
+
+  inline const char* data() const { return data_; }
+  inline size_t size() const { return size_; }
+
+ private:
+  const char* data_;
+  size_t size_;
+};
+
+typedef boost::shared_ptr<MappedFile> MappedPtr;
+
+/// Returns the strings of a dictionary file in code order.
+std::vector<std::string> ReadDict(const MappedFile& f) {
+  std::vector<std::string> dict;
+  const char* p = f.data();
+  const char* end = p + f.size();
+  while (p < end) {
+    std::string s;
+    BinDecode(&p, end, &s);
+    dict.push_back(s);
+  }
+  return dict;
+}
+
+template <class T>
+inline bool Cmp(const T& a, CmpOpCode op, const T& b) {
+  switch (op) {
+    case LT:
+      return a < b;
+    case GT:
+      return a > b;
+    case LE:
+      return a <= b;
+    case GE:
+      return a >= b;
+    case EQ:
+      return a == b;
+    default:
+      return a != b;
+  }
+}
+
+/// Clears the mask of every row of the n values at x that fail "x op v".
+/// Each case is a branch-free loop over the raw column that the compiler
+/// vectorizes.
+template <class T>
+void FilterNum(const T* x, size_t n, CmpOpCode op, double v,
+               unsigned char* mask) {
+  switch (op) {
+    case LT:
+      for (size_t i = 0; i < n; ++i) mask[i] &= x[i] < v;
+      break;
+    case GT:
+      for (size_t i = 0; i < n; ++i) mask[i] &= x[i] > v;
+      break;
+    case LE:
+      for (size_t i = 0; i < n; ++i) mask[i] &= x[i] <= v;
+      break;
+    case GE:
+      for (size_t i = 0; i < n; ++i) mask[i] &= x[i] >= v;
+      break;
+    case EQ:
+      for (size_t i = 0; i < n; ++i) mask[i] &= x[i] == v;
+      break;
+    case NE:
+      for (size_t i = 0; i < n; ++i) mask[i] &= x[i] != v;
+      break;
+  }
+}
+
+/// Returns the value of a condition on a numeric column.
+double NumVal(const Cond& c) {
+  const std::type_info& t = c.val.type();
+  if (t == typeid(int)) {
+    return c.val.cast<int>();
+  } else if (t == typeid(double)) {
+    return c.val.cast<double>();
+  } else if (t == typeid(float)) {
+    return c.val.cast<float>();
+  } else if (t == typeid(bool)) {
+    return c.val.cast<bool>();
+  }
+  throw ValueError("condition on numeric field '" + c.field +
+                   "' has a non-numeric value");
+}
+
+}  // namespace
+
+struct ColumnBack::Table {
+  struct Column {
+    std::string name;
+    DbTypes type;
+    /// the .col (FIXED, DICT) or .off (OFFSETS) file
+    Appender* rows;
+    /// the .dict (DICT) or .dat (OFFSETS) file, NULL for FIXED
+    Appender* vals;
+    /// the code of every string in the dictionary (DICT)
+    boost::unordered_map<std::string, int32_t> codes;
+  };
+
+  Table() : dirty(false) {}
+
+  ~Table() {
+    for (int i = 0; i < cols.size(); ++i) {
+      delete cols[i].rows;
+      delete cols[i].vals;
+    }
+  }
+
+  /// returns the path of a file of column c with the extension ext
+  std::string File(const Column& c, const char* ext) const {
+    return (dir / (c.name + ext)).string();
+  }
+
+  /// Replaces the sizes file with the current sizes of the column files.
+  /// It is written to a temporary file first, so that it always holds the
+  /// sizes of a complete flush.
+  void WriteSizes() const {
+    fs::path tmp = dir / "sizes.tmp";
+    {
+      std::ofstream f(tmp.string().c_str());
+      for (int i = 0; i < cols.size(); ++i) {
+        f << cols[i].rows->size() << " "
+          << (cols[i].vals != NULL ? cols[i].vals->size() : 0) << "\n";
+      }
+      if (!f) {
+        throw IOError("cannot write column sizes " + tmp.string());
+      }
+    }
+    fs::rename(tmp, dir / "sizes");
+  }
+
+  fs::path dir;
+  std::vector<Column> cols;
+  /// whether rows were appended since the last flush
+  bool dirty;
+};
+
+ColumnBack::ColumnBack(std::string path) : path_(path) {
+  fs::create_directories(path_);
+}
+
+ColumnBack::~ColumnBack() {
+  try {
+    Close();
+  } catch (Error err) {
+    CLOG(LEV_ERROR) << "Error in ColumnBack destructor: " << err.what();
+  }
+}
+
+void ColumnBack::Notify(DatumList data) {
+  for (DatumList::iterator it = data.begin(); it != data.end(); ++it) {
+    Datum* d = *it;
+    Table* t = GetTable(d->title(), d);
+    if (d->nfields() != t->cols.size()) {
+      throw ValueError("datum for table " + d->title() + " has " +
+                       std::to_string(d->nfields()) + " fields instead of " +
+                       std::to_string(t->cols.size()));
+    }
+    // check every field before appending any, so that the columns stay
+    // aligned if one doesn't match
+    for (int i = 0; i < d->nfields(); ++i) {
+      if (FieldType(d, i) != t->cols[i].type) {
+        throw ValueError("field " + t->cols[i].name + " of table " +
+                         d->title() + " changed type");
+      }
+    }
+    for (int i = 0; i < d->nfields(); ++i) {
+      Append(t, d, i);
+    }
+    t->dirty = true;
+  }
+}
+
+std::string ColumnBack::Name() {
+  return path_;
+}
+
+void ColumnBack::Flush() {
+  std::map<std::string, Table*>::iterator it;
+  for (it = tables_.begin(); it != tables_.end(); ++it) {
+    Table* t = it->second;
+    if (!t->dirty) {
+      continue;
+    }
+    for (int i = 0; i < t->cols.size(); ++i) {
+      t->cols[i].rows->Flush();
+      if (t->cols[i].vals != NULL) {
+        t->cols[i].vals->Flush();
+      }
+    }
+    t->WriteSizes();
+    t->dirty = false;
+  }
+}
+
+void ColumnBack::Close() {
+  Flush();
+  std::map<std::string, Table*>::iterator it;
+  for (it = tables_.begin(); it != tables_.end(); ++it) {
+    delete it->second;
+  }
+  tables_.clear();
+  closed_ = true;
+}
+
+ColumnBack::Table* ColumnBack::GetTable(const std::string& name, Datum* d) {
+  std::map<std::string, Table*>::iterator it = tables_.find(name);
+  if (it != tables_.end()) {
+    return it->second;
+  }
+
+  fs::path dir = fs::path(path_) / name;
+  fs::path schema = dir / "schema";
+  Table* t = new Table();
+  t->dir = dir;
+  // the recorded size of each column's rows and values file. Tables written
+  // before sizes were recorded have none; their files are taken as they are.
+  std::vector<std::pair<int64_t, int64_t> > sizes;
+  bool created = false;
+  if (fs::exists(schema)) {
+    std::ifstream f(schema.string().c_str());
+    std::string magic;
+    std::getline(f, magic);
+    if (magic != kSchemaMagic) {
+      delete t;
+      throw IOError("invalid column schema " + schema.string());
+    }
+    Table::Column c;
+    int type;
+    while (f >> c.name >> type) {
+      c.type = static_cast<DbTypes>(type);
+      t->cols.push_back(c);
+    }
+    fs::path sizes_path = dir / "sizes";
+    if (fs::exists(sizes_path)) {
+      std::ifstream sf(sizes_path.string().c_str());
+      std::pair<int64_t, int64_t> sz;
+      while (sf >> sz.first >> sz.second) {
+        sizes.push_back(sz);
+      }
+      if (sizes.size() != t->cols.size()) {
+        delete t;
+        throw IOError("invalid column sizes " + sizes_path.string());
+      }
+    }
+  } else if (d == NULL) {
+    delete t;
+    return NULL;
+  } else {
+    fs::create_directories(dir);
+    std::ofstream f(schema.string().c_str());
+    f << kSchemaMagic << "\n";
+    for (int i = 0; i < d->nfields(); ++i) {
+      Table::Column c;
+      c.name = d->field(i).name;
+      c.type = FieldType(d, i);
+      t->cols.push_back(c);
+      f << c.name << " " << c.type << "\n";
+    }
+    if (!f) {
+      delete t;
+      throw IOError("cannot write column schema " + schema.string());
+    }
+    sizes.resize(t->cols.size(), std::make_pair(0, 0));
+    created = true;
+  }
+
+  for (int i = 0; i < t->cols.size(); ++i) {
+    Table::Column& c = t->cols[i];
+    c.rows = NULL;
+    c.vals = NULL;
+  }
+  try {
+    for (int i = 0; i < t->cols.size(); ++i) {
+      Table::Column& c = t->cols[i];
+      int64_t nrows = sizes.empty() ? -1 : sizes[i].first;
+      int64_t nvals = sizes.empty() ? -1 : sizes[i].second;
+      switch (LayoutOf(c.type)) {
+        case FIXED:
+          c.rows = new Appender(t->File(c, ".col"), nrows);
+          break;
+        case DICT: {
+          c.rows = new Appender(t->File(c, ".col"), nrows);
+          c.vals = new Appender(t->File(c, ".dict"), nvals);
+          std::vector<std::string> dict =
+              ReadDict(MappedFile(t->File(c, ".dict")));
+          for (int j = 0; j < dict.size(); ++j) {
+            c.codes[dict[j]] = j;
+          }
+          break;
+        }
+        case OFFSETS:
+          c.rows = new Appender(t->File(c, ".off"), nrows);
+          c.vals = new Appender(t->File(c, ".dat"), nvals);
+          break;
+      }
+    }
+    if (created) {
+      t->WriteSizes();
+    }
+  } catch (...) {
+    delete t;
+    throw;
+  }
+  tables_[name] = t;
+  return t;
+}
+
+void ColumnBack::Append(Table* t, Datum* d, int i) {
+  Table::Column& c = t->cols[i];
+  const Datum::Field& f = d->field(i);
+  DbTypes type = c.type;
+  switch (type) {
+    case BOOL: {
+      int8_t x = f.type == Datum::ANY_FIELD ? d->box(i).cast<bool>()
+                                            : d->AsBool(i);
+      c.rows->Append(&x, sizeof(x));
+      break;
+    }
+    case INT: {
+      int32_t x = f.type == Datum::ANY_FIELD ? d->box(i).cast<int>()
+                                             : d->AsInt(i);
+      c.rows->Append(&x, sizeof(x));
+      break;
+    }
+    case FLOAT: {
+      float x = f.type == Datum::ANY_FIELD ? d->box(i).cast<float>()
+                                           : d->AsFloat(i);
+      c.rows->Append(&x, sizeof(x));
+      break;
+    }
+    case DOUBLE: {
+      double x = f.type == Datum::ANY_FIELD ? d->box(i).cast<double>()
+                                            : d->AsDouble(i);
+      c.rows->Append(&x, sizeof(x));
+      break;
+    }
+    case UUID: {
+      boost::uuids::uuid x = f.type == Datum::ANY_FIELD
+                                 ? d->box(i).cast<boost::uuids::uuid>()
+                                 : d->AsUuid(i);
+      c.rows->Append(x.data, 16);
+      break;
+    }
+    case STRING: {
+      std::string x = f.type == Datum::ANY_FIELD
+                          ? d->box(i).cast<std::string>()
+                          : std::string(d->data(i), f.size);
+      boost::unordered_map<std::string, int32_t>::iterator it =
+          c.codes.find(x);
+      int32_t code;
+      if (it != c.codes.end()) {
+        code = it->second;
+      } else {
+        code = c.codes.size();
+        c.codes[x] = code;
+        std::string entry;
+        BinEncode(x, &entry);
+        c.vals->Append(entry.data(), entry.size());
+      }
+      c.rows->Append(&code, sizeof(code));
+      break;
+    }
+    default: {
+      if (type == BLOB && f.type != Datum::ANY_FIELD) {
+        c.vals->Append(d->data(i), f.size);
+      } else {
+        std::string x;
+        if (type == BLOB) {
+          x = d->box(i).cast<Blob>().str();
+        } else {
+          BinEncodeAny(d->box(i), type, &x);
+        }
+        c.vals->Append(x.data(), x.size());
+      }
+      uint64_t end = c.vals->size();
+      c.rows->Append(&end, sizeof(end));
+      break;
+    }
+  }
+}
+
+QueryResult ColumnBack::Query(std::string table, std::vector<Cond>* conds) {
+  Flush();
+  Table* t = GetTable(table, NULL);
+  if (t == NULL) {
+    throw ValueError("Invalid table name " + table);
+  }
+
+  int ncols = t->cols.size();
+  std::vector<MappedPtr> rows(ncols);
+  std::vector<MappedPtr> vals(ncols);
+  std::vector<std::vector<std::string> > dicts(ncols);
+  size_t n = ncols > 0 ? SIZE_MAX : 0;
+  for (int j = 0; j < ncols; ++j) {
+    const Table::Column& c = t->cols[j];
+    Layout layout = LayoutOf(c.type);
+    rows[j] = MappedPtr(new MappedFile(
+        t->File(c, layout == OFFSETS ? ".off" : ".col")));
+    if (layout == DICT) {
+      dicts[j] = ReadDict(MappedFile(t->File(c, ".dict")));
+    } else if (layout == OFFSETS) {
+      vals[j] = MappedPtr(new MappedFile(t->File(c, ".dat")));
+    }
+    n = std::min(n, rows[j]->size() / RowWidth(c.type));
+  }
+
+  // evaluate the conditions a column at a time
+  std::vector<unsigned char> mask(n, 1);
+  for (int k = 0; conds != NULL && k < conds->size(); ++k) {
+    const Cond& cond = (*conds)[k];
+    int j = 0;
+    while (j < ncols && t->cols[j].name != cond.field) {
+      ++j;
+    }
+    if (j == ncols) {
+      throw ValueError("no field " + cond.field + " in table " + table);
+    }
+
+    DbTypes type = t->cols[j].type;
+    const char* x = rows[j]->data();
+    switch (type) {
+      case BOOL:
+        FilterNum(reinterpret_cast<const int8_t*>(x), n, cond.opcode,
+                  NumVal(cond), mask.data());
+        break;
+      case INT:
+        FilterNum(reinterpret_cast<const int32_t*>(x), n, cond.opcode,
+                  NumVal(cond), mask.data());
+        break;
+      case FLOAT:
+        FilterNum(reinterpret_cast<const float*>(x), n, cond.opcode,
+                  NumVal(cond), mask.data());
+        break;
+      case DOUBLE:
+        FilterNum(reinterpret_cast<const double*>(x), n, cond.opcode,
+                  NumVal(cond), mask.data());
+        break;
+      case UUID: {
+        const boost::uuids::uuid& v = cond.val.cast<boost::uuids::uuid>();
+        for (size_t i = 0; i < n; ++i) {
+          mask[i] &= Cmp(memcmp(x + 16 * i, v.data, 16), cond.opcode, 0);
+        }
+        break;
+      }
+      case STRING:
+      case VL_STRING: {
+        // compare each distinct string once, then look rows up by code
+        const std::string& v = cond.val.cast<std::string>();
+        const std::vector<std::string>& dict = dicts[j];
+        std::vector<unsigned char> match(dict.size());
+        for (int i = 0; i < dict.size(); ++i) {
+          match[i] = Cmp(dict[i], cond.opcode, v);
+        }
+        const int32_t* codes = reinterpret_cast<const int32_t*>(x);
+        for (size_t i = 0; i < n; ++i) {
+          mask[i] &= match[codes[i]];
+        }
+        break;
+      }
+      default: {
+        if (cond.opcode != EQ && cond.opcode != NE) {
+          throw ValueError("only == and != conditions are supported on "
+                           "field " + cond.field);
+        }
+        std::string v;
+        if (type == BLOB) {
+          v = cond.val.cast<Blob>().str();
+        } else {
+          BinEncodeAny(cond.val, type, &v);
+        }
+        const uint64_t* ends = reinterpret_cast<const uint64_t*>(x);
+        const char* dat = vals[j]->data();
+        for (size_t i = 0; i < n; ++i) {
+          uint64_t start = i == 0 ? 0 : ends[i - 1];
+          bool eq = ends[i] - start == v.size() &&
+                    memcmp(dat + start, v.data(), v.size()) == 0;
+          mask[i] &= eq == (cond.opcode == EQ);
+        }
+        break;
+      }
+    }
+  }
+
+  QueryResult qr;
+  for (int j = 0; j < ncols; ++j) {
+    qr.fields.push_back(t->cols[j].name);
+    qr.types.push_back(t->cols[j].type);
+  }
+
+  // decode the matching rows
+  for (size_t i = 0; i < n; ++i) {
+    if (!mask[i]) {
+      continue;
+    }
+    QueryRow r(ncols);
+    for (int j = 0; j < ncols; ++j) {
+      DbTypes type = t->cols[j].type;
+      const char* x = rows[j]->data();
+      switch (type) {
+        case BOOL:
+          r[j] = static_cast<bool>(x[i]);
+          break;
+        case INT:
+          r[j] = static_cast<int>(reinterpret_cast<const int32_t*>(x)[i]);
+          break;
+        case FLOAT:
+          r[j] = reinterpret_cast<const float*>(x)[i];
+          break;
+        case DOUBLE:
+          r[j] = reinterpret_cast<const double*>(x)[i];
+          break;
+        case UUID: {
+          boost::uuids::uuid u;
+          memcpy(u.data, x + 16 * i, 16);
+          r[j] = u;
+          break;
+        }
+        case STRING:
+        case VL_STRING:
+          r[j] = dicts[j][reinterpret_cast<const int32_t*>(x)[i]];
+          break;
+        default: {
+          const uint64_t* ends = reinterpret_cast<const uint64_t*>(x);
+          uint64_t start = i == 0 ? 0 : ends[i - 1];
+          const char* dat = vals[j]->data() + start;
+          if (type == BLOB) {
+            r[j] = Blob(std::string(dat, ends[i] - start));
+          } else {
+            r[j] = BinDecodeAny(dat, ends[i] - start, type);
+          }
+          break;
+        }
+      }
+    }
+    qr.rows.push_back(r);
+  }
+  return qr;
+}
+
+std::map<std::string, DbTypes> ColumnBack::ColumnTypes(std::string table) {
+  Table* t = GetTable(table, NULL);
+  if (t == NULL) {
+    throw ValueError("Invalid table name " + table);
+  }
+  std::map<std::string, DbTypes> rtn;
+  for (int i = 0; i < t->cols.size(); ++i) {
+    rtn[t->cols[i].name] = t->cols[i].type;
+  }
+  return rtn;
+}
+
+std::set<std::string> ColumnBack::Tables() {
+  std::set<std::string> rtn;
+  fs::directory_iterator end;
+  for (fs::directory_iterator it(path_); it != end; ++it) {
+    if (fs::exists(it->path() / "schema")) {
+      rtn.insert(it->path().filename().string());
+    }
+  }
+  return rtn;
+}
+
+}  // namespace cyclus
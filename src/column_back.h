@@ -0,0 +1,89 @@
+#ifndef CYCLUS_SRC_COLUMN_BACK_H_
+#define CYCLUS_SRC_COLUMN_BACK_H_
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "query_backend.h"
+
+namespace cyclus {
+
+/// A backend that writes each table as a set of append-only column files,
+/// selected by the ".col" output extension. It avoids the per-row overhead
+/// of SqliteBack (statement binding) and Hdf5Back (digesting of variable
+/// length values): a row is recorded by appending each of its values to the
+/// end of its column.
+///
+/// The database is a directory holding one subdirectory per table. A
+/// table's "schema" file lists its fields and their DbTypes in order, and
+/// each field is stored in files named after it according to its type:
+///
+///  - bool, int, float, double and uuid values are stored in [field].col as
+///    an array of fixed width (1, 4, 4, 8 and 16 byte) native values.
+///  - strings are dictionary encoded: [field].col holds a 32-bit code per
+///    row and [field].dict the distinct strings in order of first use, each
+///    prefixed by its 32-bit length.
+///  - blobs and container values (in the binary encoding, see
+///    binary_encoding.h) use an offset-array layout: [field].dat holds all
+///    values back to back and [field].off the 64-bit end offset of each
+///    row's value.
+///
+/// Column files are written through writable memory maps of fixed size
+/// segments at their ends, which are kept mapped across Notify calls, and
+/// are truncated to their contents only on Flush and Close. Each Flush then
+/// records the size of every file of a table in its "sizes" file. When a
+/// table is opened, its files are truncated to the recorded sizes, which
+/// drops the zero padding of the last segments and any rows appended after
+/// the last Flush if the database was not closed cleanly.
+///
+/// Queries map the columns read-only and evaluate conditions a whole column
+/// at a time into a row mask, using tight loops over the raw arrays (over
+/// dictionary codes for strings) that the compiler vectorizes. Only the
+/// matching rows are decoded.
+class ColumnBack : public FullBackend {
+ public:
+  /// Opens the database in the directory path, creating it if it doesn't
+  /// exist. Records are appended to the tables that already exist in it.
+  explicit ColumnBack(std::string path);
+
+  virtual ~ColumnBack();
+
+  /// Appends the Datum objects to their tables' columns.
+  virtual void Notify(DatumList data);
+
+  /// Returns the database directory.
+  virtual std::string Name();
+
+  /// Unmaps all column segments being written and truncates the column
+  /// files to their contents.
+  virtual void Flush();
+
+  /// Flushes and releases all column files.
+  virtual void Close();
+
+  virtual QueryResult Query(std::string table, std::vector<Cond>* conds);
+
+  virtual std::map<std::string, DbTypes> ColumnTypes(std::string table);
+
+  virtual std::set<std::string> Tables();
+
+ private:
+  struct Table;
+
+  /// Returns the table named name, loading it from disk or creating it from
+  /// the fields of d as needed. d may be NULL when only reading.
+  Table* GetTable(const std::string& name, Datum* d);
+
+  /// Appends the i-th field of d, whose type must match, to the i-th column
+  /// of t.
+  void Append(Table* t, Datum* d, int i);
+
+  std::string path_;
+  std::map<std::string, Table*> tables_;
+};
+
+}  // namespace cyclus
+
+#endif  // CYCLUS_SRC_COLUMN_BACK_H_
@@ -128,5 +128,144 @@ bool AlmostEq(const CompMap& v1, const CompMap& v2, double threshold) {
   return true;
 }
 
+namespace {
+
+void CheckThreshold(double threshold) {
+  if (threshold < 0) {
+    std::stringstream ss;
+    ss << "The threshold cannot be negative. The value provided was '"
+       << threshold << "'.";
+    throw ValueError(ss.str());
+  }
+}
+
+/// Merges v1 and v2, combining the quantities of nuclides present in both
+/// with sign = 1 (addition) or sign = -1 (subtraction).
+CompVec Merge(const CompVec& v1, const CompVec& v2, double sign) {
+  const std::vector<Nuc>& n1 = v1.nucs();
+  const std::vector<Nuc>& n2 = v2.nucs();
+  const std::vector<double>& q1 = v1.vals();
+  const std::vector<double>& q2 = v2.vals();
+
+  CompVec out;
+  out.reserve(n1.size() + n2.size());
+  int i = 0;
+  int j = 0;
+  while (i < n1.size() && j < n2.size()) {
+    if (n1[i] < n2[j]) {
+      out.Append(n1[i], q1[i]);
+      ++i;
+    } else if (n2[j] < n1[i]) {
+      out.Append(n2[j], sign * q2[j]);
+      ++j;
+    } else {
+      out.Append(n1[i], q1[i] + sign * q2[j]);
+      ++i;
+      ++j;
+    }
+  }
+  for (; i < n1.size(); ++i) {
+    out.Append(n1[i], q1[i]);
+  }
+  for (; j < n2.size(); ++j) {
+    out.Append(n2[j], sign * q2[j]);
+  }
+  return out;
+}
+
+}  // namespace
+
+CompVec Add(const CompVec& v1, const CompVec& v2) {
+  return Merge(v1, v2, 1);
+}
+
+CompVec Sub(const CompVec& v1, const CompVec& v2) {
+  return Merge(v1, v2, -1);
+}
+
+double Sum(const CompVec& v) {
+  return CycArithmetic::KahanSum(v.vals());
+}
+
+void ApplyThreshold(CompVec* v, double threshold) {
+  CheckThreshold(threshold);
+
+  // count first in a branch-free loop: in the common case nothing is dropped
+  // and the vector doesn't need to be touched.
+  const double* q = v->vals().data();
+  int n = v->size();
+  int ndrop = 0;
+  for (int i = 0; i < n; ++i) {
+    ndrop += std::abs(q[i]) <= threshold;
+  }
+  if (ndrop == 0) {
+    return;
+  }
+
+  std::vector<bool> drop(n);
+  for (int i = 0; i < n; ++i) {
+    drop[i] = std::abs(q[i]) <= threshold;
+  }
+  v->Erase(drop);
+}
+
+void Normalize(CompVec* v, double val) {
+  double sum = Sum(*v);
+  if (sum != val && sum != 0) {
+    double mult = val / sum;
+    double* q = v->vals().data();
+    int n = v->size();
+    for (int i = 0; i < n; ++i) {
+      q[i] *= mult;
+    }
+  }
+}
+
+bool ValidNucs(const CompVec& v) {
+  const std::vector<Nuc>& nucs = v.nucs();
+  for (int i = 0; i < nucs.size(); ++i) {
+    if (!pyne::nucname::isnuclide(nucs[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool AllPositive(const CompVec& v) {
+  const double* q = v.vals().data();
+  int n = v.size();
+  int nneg = 0;
+  for (int i = 0; i < n; ++i) {
+    nneg += q[i] < 0;
+  }
+  return nneg == 0;
+}
+
+bool AlmostEq(const CompVec& v1, const CompVec& v2, double threshold) {
+  // see the CompMap version for the reasoning behind this comparison
+  CheckThreshold(threshold);
+
+  if (v1.nucs() != v2.nucs()) {
+    return false;
+  }
+
+  const std::vector<double>& q1 = v1.vals();
+  const std::vector<double>& q2 = v2.vals();
+  for (int i = 0; i < q1.size(); ++i) {
+    double minuend = q2[i];
+    double subtrahend = q1[i];
+    double diff = minuend - subtrahend;
+    if (std::abs(minuend) == 0 || std::abs(subtrahend) == 0) {
+      if (std::abs(diff) > std::abs(diff)*threshold) {
+        return false;
+      }
+    } else if (std::abs(diff) > std::abs(minuend)*threshold ||
+               std::abs(diff) > std::abs(subtrahend)*threshold) {
+      return false;
+    }
+  }
+  return true;
+}
+
 }  // namespace compmath
 }  // namespace cyclus
@@ -1,6 +1,7 @@
 #ifndef CYCLUS_SRC_COMP_MATH_H_
 #define CYCLUS_SRC_COMP_MATH_H_
 
+#include "comp_vec.h"
 #include "composition.h"
 
 namespace cyclus {
@@ -49,6 +50,21 @@ bool AllPositive(const CompMap& v);
 /// normalization is performed.
 bool AlmostEq(const CompMap& v1, const CompMap& v2, double threshold);
 
+/// @name CompVec kernels
+/// These behave exactly like their CompMap counterparts above but work on
+/// sorted flat arrays: Add and Sub are a single merge pass and the per-nuclide
+/// loops of the remaining functions run over contiguous memory.
+/// @{
+CompVec Add(const CompVec& v1, const CompVec& v2);
+CompVec Sub(const CompVec& v1, const CompVec& v2);
+double Sum(const CompVec& v);
+void ApplyThreshold(CompVec* v, double threshold);
+void Normalize(CompVec* v, double val = 1.0);
+bool ValidNucs(const CompVec& v);
+bool AllPositive(const CompVec& v);
+bool AlmostEq(const CompVec& v1, const CompVec& v2, double threshold);
+/// @}
+
 }  // namespace compmath
 }  // namespace cyclus
 
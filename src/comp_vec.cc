@@ -0,0 +1,67 @@
+#include "comp_vec.h"
+
+#include <algorithm>
+
+#include "error.h"
+
+namespace cyclus {
+
+CompVec::CompVec(const CompMap& m) {
+  nucs_.reserve(m.size());
+  vals_.reserve(m.size());
+  CompMap::const_iterator it;
+  for (it = m.begin(); it != m.end(); ++it) {
+    nucs_.push_back(it->first);
+    vals_.push_back(it->second);
+  }
+}
+
+CompMap CompVec::ToMap() const {
+  CompMap m;
+  for (int i = 0; i < nucs_.size(); ++i) {
+    m.insert(m.end(), std::make_pair(nucs_[i], vals_[i]));
+  }
+  return m;
+}
+
+void CompVec::reserve(size_t n) {
+  nucs_.reserve(n);
+  vals_.reserve(n);
+}
+
+void CompVec::clear() {
+  nucs_.clear();
+  vals_.clear();
+}
+
+void CompVec::Append(Nuc nuc, double val) {
+  if (!nucs_.empty() && nuc <= nucs_.back()) {
+    throw ValueError("CompVec nuclides must be appended in ascending order");
+  }
+  nucs_.push_back(nuc);
+  vals_.push_back(val);
+}
+
+void CompVec::Erase(const std::vector<bool>& drop) {
+  int n = 0;
+  for (int i = 0; i < nucs_.size(); ++i) {
+    if (!drop[i]) {
+      nucs_[n] = nucs_[i];
+      vals_[n] = vals_[i];
+      ++n;
+    }
+  }
+  nucs_.resize(n);
+  vals_.resize(n);
+}
+
+int CompVec::Find(Nuc nuc) const {
+  std::vector<Nuc>::const_iterator it =
+      std::lower_bound(nucs_.begin(), nucs_.end(), nuc);
+  if (it == nucs_.end() || *it != nuc) {
+    return -1;
+  }
+  return it - nucs_.begin();
+}
+
+}  // namespace cyclus
@@ -0,0 +1,82 @@
+#ifndef CYCLUS_SRC_COMP_VEC_H_
+#define CYCLUS_SRC_COMP_VEC_H_
+
+#include <stddef.h>
+#include <map>
+#include <vector>
+
+namespace cyclus {
+
+typedef int Nuc;
+
+/// a raw definition of nuclides and corresponding (dimensionless quantities).
+typedef std::map<Nuc, double> CompMap;
+
+/// A flat, cache-friendly alternative to CompMap. Nuclides and their
+/// quantities are held in two parallel arrays sorted by nuclide, so that the
+/// compmath kernels can merge two compositions in a single linear pass and
+/// scale or threshold quantities over contiguous memory without allocating a
+/// node per nuclide.
+///
+/// CompVec is used internally by Composition and Material; CompMap remains the
+/// type used at API boundaries. Converting between the two is linear in the
+/// number of nuclides:
+///
+/// @code
+/// CompMap m;
+/// m[922350000] = 0.05;
+/// m[922380000] = 0.95;
+/// CompVec v(m);
+/// CompMap back = v.ToMap();
+/// @endcode
+class CompVec {
+ public:
+  CompVec() {}
+
+  /// Creates a CompVec holding the same nuclides and quantities as m.
+  explicit CompVec(const CompMap& m);
+
+  /// Returns a CompMap holding the same nuclides and quantities.
+  CompMap ToMap() const;
+
+  /// Returns the number of nuclides.
+  inline size_t size() const { return nucs_.size(); }
+
+  inline bool empty() const { return nucs_.empty(); }
+
+  /// Returns the nuclides in ascending order.
+  inline const std::vector<Nuc>& nucs() const { return nucs_; }
+
+  /// Returns the quantities, where vals()[i] belongs to nucs()[i].
+  inline const std::vector<double>& vals() const { return vals_; }
+
+  /// Returns the quantities for in-place modification. Nuclides and their
+  /// order can only be changed with Append, Erase and clear.
+  inline std::vector<double>& vals() { return vals_; }
+
+  /// Reserves space for n nuclides.
+  void reserve(size_t n);
+
+  /// Removes all nuclides.
+  void clear();
+
+  /// Adds nuc with quantity val to the end of the vector.
+  ///
+  /// @throws ValueError if nuc is not greater than every nuclide already held
+  void Append(Nuc nuc, double val);
+
+  /// Removes every nuclide i for which drop[i] is true, preserving the order of
+  /// the remaining ones.
+  void Erase(const std::vector<bool>& drop);
+
+  /// Returns the index of nuc or -1 if it is not present.
+  int Find(Nuc nuc) const;
+
+ private:
+  std::vector<Nuc> nucs_;
+  std::vector<double> vals_;
+};
+
+}  // namespace cyclus
+
+#endif  // CYCLUS_SRC_COMP_VEC_H_
@@ -1,38 +1,133 @@
 #include "composition.h"
 
+#include <cmath>
+#include <mutex>
+#include <utility>
+#include <vector>
+
 #include "comp_math.h"
 #include "context.h"
+#include "decay_engine.h"
 #include "decayer.h"
 #include "error.h"
+#include "id_counters.h"
+#include "nuc_registry.h"
 #include "recorder.h"
-#include "pyne_decay.h"
 
 namespace cyclus {
 
-int Composition::next_id_ = 1;
+
+void Composition::intern_tol(double tol) {
+  IdCounters::current()->InternTol(tol);
+}
+
+double Composition::intern_tol() {
+  IdCounters* ids = IdCounters::current();
+  std::lock_guard<std::mutex> lk(ids->intern_mu);
+  return ids->intern_tol;
+}
+
+int Composition::n_interned_dups() {
+  IdCounters* ids = IdCounters::current();
+  std::lock_guard<std::mutex> lk(ids->intern_mu);
+  return ids->intern_dups;
+}
+
+void Composition::ClearInterned() {
+  IdCounters* ids = IdCounters::current();
+  std::lock_guard<std::mutex> lk(ids->intern_mu);
+  ids->interned.clear();
+  ids->intern_dups = 0;
+}
+
+Composition::Ptr Composition::Intern(const CompVec& v, bool atom_basis) {
+  double total = 0;
+  const std::vector<double>& q = v.vals();
+  for (int i = 0; i < q.size(); ++i) {
+    total += q[i];
+  }
+
+  IdCounters* ids = IdCounters::current();
+  std::unique_lock<std::mutex> lk(ids->intern_mu);
+  if (ids->intern_tol <= 0 || total <= 0) {
+    lk.unlock();
+    return New(v, atom_basis);
+  }
+
+  // each quantity is rounded to its bucket, a multiple of the tolerance
+  InternKey key;
+  key.reserve(v.size() + 1);
+  for (int i = 0; i < q.size(); ++i) {
+    long long n = std::llround(q[i] / total / ids->intern_tol);
+    if (n != 0) {
+      key.push_back(std::make_pair(v.nucs()[i], n));
+    }
+  }
+  key.push_back(std::make_pair(0, atom_basis ? 1LL : 0LL));
+
+  boost::weak_ptr<Composition>& entry = ids->interned[key];
+  Ptr c = entry.lock();
+  if (c) {
+    ++ids->intern_dups;
+    return c;
+  }
+  c = New(v, atom_basis);
+  entry = c;
+
+  // erase the entries of destroyed compositions once the table has doubled
+  if (ids->interned.size() >= static_cast<size_t>(ids->intern_sweep)) {
+    boost::unordered_map<InternKey, boost::weak_ptr<Composition>,
+                         boost::hash<InternKey> >::iterator it;
+    for (it = ids->interned.begin(); it != ids->interned.end();) {
+      if (it->second.expired()) {
+        it = ids->interned.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    int n = 2 * ids->interned.size();
+    ids->intern_sweep = n > IdCounters::kInternSweepMin ?
+                        n : IdCounters::kInternSweepMin;
+  }
+  return c;
+}
+
+Composition::Ptr Composition::New(const CompVec& v, bool atom_basis) {
+  Composition::Ptr c(new Composition());
+  if (atom_basis) {
+    c->atom_vec_ = v;
+  } else {
+    c->mass_vec_ = v;
+  }
+  return c;
+}
 
 Composition::Ptr Composition::CreateFromAtom(CompMap v) {
+  return CreateFromAtom(CompVec(v));
+}
+
+Composition::Ptr Composition::CreateFromMass(CompMap v) {
+  return CreateFromMass(CompVec(v));
+}
+
+Composition::Ptr Composition::CreateFromAtom(const CompVec& v) {
   if (!compmath::ValidNucs(v))
     throw ValueError("invalid nuclide in CompMap");
 
   if (!compmath::AllPositive(v))
     throw ValueError("negative quantity in CompMap");
 
-  Composition::Ptr c(new Composition());
-  c->atom_ = v;
-  return c;
+  return Intern(v, true);
 }
 
-Composition::Ptr Composition::CreateFromMass(CompMap v) {
+Composition::Ptr Composition::CreateFromMass(const CompVec& v) {
   if (!compmath::ValidNucs(v))
     throw ValueError("invalid nuclide in CompMap");
 
   if (!compmath::AllPositive(v))
     throw ValueError("negative quantity in CompMap");
 
-  Composition::Ptr c(new Composition());
-  c->mass_ = v;
-  return c;
+  return Intern(v, false);
 }
 
 int Composition::id() {
@@ -40,41 +135,67 @@ int Composition::id() {
 }
 
 const CompMap& Composition::atom() {
-  if (atom_.size() == 0) {
-    CompMap::iterator it;
-    for (it = mass_.begin(); it != mass_.end(); ++it) {
-      Nuc nuc = it->first;
-      atom_[nuc] = it->second / pyne::atomic_mass(nuc);
-    }
-  }
+  std::call_once(atom_once_, [this] { atom_ = atom_vec().ToMap(); });
   return atom_;
 }
 
 const CompMap& Composition::mass() {
-  if (mass_.size() == 0) {
-    CompMap::iterator it;
-    for (it = atom_.begin(); it != atom_.end(); ++it) {
-      Nuc nuc = it->first;
-      mass_[nuc] = it->second * pyne::atomic_mass(nuc);
-    }
-  }
+  std::call_once(mass_once_, [this] { mass_ = mass_vec().ToMap(); });
   return mass_;
 }
 
+const CompVec& Composition::atom_vec() {
+  std::call_once(atom_vec_once_, [this] {
+    if (!atom_vec_.empty()) {
+      return;
+    }
+    const NucRegistry& reg = NucRegistry::Instance();
+    const std::vector<Nuc>& nucs = mass_vec_.nucs();
+    const std::vector<double>& q = mass_vec_.vals();
+    atom_vec_.reserve(nucs.size());
+    for (int i = 0; i < nucs.size(); ++i) {
+      atom_vec_.Append(nucs[i], q[i] / reg.AtomicMass(nucs[i]));
+    }
+  });
+  return atom_vec_;
+}
+
+const CompVec& Composition::mass_vec() {
+  std::call_once(mass_vec_once_, [this] {
+    if (!mass_vec_.empty()) {
+      return;
+    }
+    const NucRegistry& reg = NucRegistry::Instance();
+    const std::vector<Nuc>& nucs = atom_vec_.nucs();
+    const std::vector<double>& q = atom_vec_.vals();
+    mass_vec_.reserve(nucs.size());
+    for (int i = 0; i < nucs.size(); ++i) {
+      mass_vec_.Append(nucs[i], q[i] * reg.AtomicMass(nucs[i]));
+    }
+  });
+  return mass_vec_;
+}
+
 Composition::Ptr Composition::Decay(int delta, uint64_t secs_per_timestep) {
   int tot_decay = prev_decay_ + delta;
-  if (decay_line_->count(tot_decay) == 1) {
-    // decay_line_ has cached, pre-computed result of this decay
-    return (*decay_line_)[tot_decay];
+  {
+    std::lock_guard<std::mutex> lk(decay_line_->mu);
+    Chain::iterator it = decay_line_->chain.find(tot_decay);
+    if (it != decay_line_->chain.end()) {
+      // decay_line_ has cached, pre-computed result of this decay
+      return it->second;
+    }
   }
 
-  // Calculate a new decayed composition and insert it into the decay chain.
-  // It will automagically appear in the decay chain for all other compositions
-  // that are a part of this decay chain because decay_line_ is a pointer that
-  // all compositions in the chain share.
+  // Calculate a new decayed composition outside the lock and insert it into
+  // the decay chain. It will automagically appear in the decay chain for all
+  // other compositions that are a part of this decay chain because
+  // decay_line_ is a pointer that all compositions in the chain share. A
+  // result that a concurrent decay inserted first is kept.
   Composition::Ptr decayed = NewDecay(delta, secs_per_timestep);
-  (*decay_line_)[tot_decay] = decayed;
-  return decayed;
+  std::lock_guard<std::mutex> lk(decay_line_->mu);
+  return decay_line_->chain.insert(std::make_pair(tot_decay, decayed))
+      .first->second;
 }
 
 Composition::Ptr Composition::Decay(int delta) {
@@ -82,50 +203,51 @@ Composition::Ptr Composition::Decay(int delta) {
 }
 
 void Composition::Record(Context* ctx) {
-  if (recorded_) {
+  if (recorded_.exchange(true)) {
     return;
   }
-  recorded_ = true;
-
-  CompMap::const_iterator it;
-  CompMap cm = mass();  // force lazy evaluation now
+  CompVec cm = mass_vec();  // force lazy evaluation now
   compmath::Normalize(&cm, 1);
-  for (it = cm.begin(); it != cm.end(); ++it) {
+  for (int i = 0; i < cm.size(); ++i) {
     ctx->NewDatum("Compositions")
         ->AddVal("QualId", id())
-        ->AddVal("NucId", it->first)
-        ->AddVal("MassFrac", it->second)
+        ->AddVal("NucId", cm.nucs()[i])
+        ->AddVal("MassFrac", cm.vals()[i])
         ->Record();
   }
 }
 
 Composition::Composition() : prev_decay_(0), recorded_(false) {
-  id_ = next_id_;
-  next_id_++;
-  decay_line_ = ChainPtr(new Chain());
+  IdCounters* ids = IdCounters::current();
+  ids->CheckUnfrozen();
+  id_ = ids->comp++;
+  decay_line_ = ChainPtr(new DecayLine());
 }
 
 Composition::Composition(int prev_decay, ChainPtr decay_line)
     : recorded_(false),
       prev_decay_(prev_decay),
       decay_line_(decay_line) {
-  id_ = next_id_;
-  next_id_++;
+  IdCounters* ids = IdCounters::current();
+  ids->CheckUnfrozen();
+  id_ = ids->comp++;
 }
 
 Composition::Ptr Composition::NewDecay(int delta, uint64_t secs_per_timestep) {
   int tot_decay = prev_decay_ + delta;
-  atom();  // force evaluation of atom-composition if not calculated already
+  // force evaluation of atom-composition if not calculated already
+  const CompVec& atoms = atom_vec();
 
   // the new composition is a part of this decay chain and so is created with a
   // pointer to the exact same decay_line_.
   Composition::Ptr decayed(new Composition(tot_decay, decay_line_));
 
   // FIXME this is only here for testing, see issue #761
-  if (atom_.size() == 0)
+  if (atoms.size() == 0)
     return decayed;
 
-  decayed->atom_ = pyne::decayers::decay(atom_, static_cast<double>(secs_per_timestep) * delta);
+  decayed->atom_vec_ = DecayEngine::Instance().DecayVector(
+      atoms, static_cast<double>(secs_per_timestep) * delta);
   return decayed;
 }
 
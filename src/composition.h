@@ -1,21 +1,20 @@
 #ifndef CYCLUS_SRC_COMPOSITION_H_
 #define CYCLUS_SRC_COMPOSITION_H_
 
+#include <atomic>
 #include <map>
+#include <mutex>
 #include <stdint.h>
 #include <boost/shared_ptr.hpp>
 
+#include "comp_vec.h"
+
 class SimInitTest;
 
 namespace cyclus {
 
 class Context;
 
-typedef int Nuc;
-
-/// a raw definition of nuclides and corresponding (dimensionless quantities).
-typedef std::map<Nuc, double> CompMap;
-
 /// An immutable object responsible for holding a nuclide composition. It tracks
 /// decay lineages to prevent duplicate calculations and output recording and is
 /// able to record its composition data to output when told.  Each composition
@@ -35,8 +34,13 @@ typedef std::map<Nuc, double> CompMap;
 /// Composition c = Composition::CreateFromAtom(v);
 /// @endcode
 ///
+/// Compositions can optionally be interned (see intern_tol): while interning
+/// is enabled, creating a composition that is equal within the tolerance to a
+/// previously created one returns the earlier composition object instead. The
+/// two then share the same id, output record and decay lineage.
 class Composition {
   friend class SimInit;
+  friend class DecayBatch;
   friend class ::SimInitTest;
 
  public:
@@ -52,6 +56,40 @@ class Composition {
   /// value.
   static Ptr CreateFromMass(CompMap v);
 
+  /// Same as CreateFromAtom(CompMap) but takes a flat composition vector.
+  static Ptr CreateFromAtom(const CompVec& v);
+
+  /// Same as CreateFromMass(CompMap) but takes a flat composition vector.
+  static Ptr CreateFromMass(const CompVec& v);
+
+  /// Sets the relative tolerance used to intern compositions created by
+  /// CreateFromAtom and CreateFromMass. Each normalized quantity is rounded
+  /// to the nearest multiple of tol, its bucket, and two compositions are
+  /// interned together exactly when all their quantities fall into the same
+  /// buckets. Compositions closer than tol whose quantities straddle a
+  /// bucket boundary are therefore not interned together. A tol of zero or
+  /// less disables interning, which is the default. Positive tolerances
+  /// below IdCounters::kMinInternTol are rejected with a ValueError.
+  /// Changing the tolerance clears the interned compositions. Interning does
+  /// not keep compositions alive: once every pointer to an interned
+  /// composition is gone, an equal composition created later is new.
+  ///
+  /// Interning is per simulation: the tolerance, the interned compositions
+  /// and the duplicate count belong to the counters current on the calling
+  /// thread (see IdCounters), like composition ids.
+  static void intern_tol(double tol);
+
+  /// Returns the relative tolerance used to intern compositions.
+  static double intern_tol();
+
+  /// Returns the number of created compositions that were replaced by an
+  /// already interned, equal composition.
+  static int n_interned_dups();
+
+  /// Removes all compositions from the interning table and resets the
+  /// duplicate count.
+  static void ClearInterned();
+
   /// Returns a unique id associated with this composition.  Note that multiple
   /// material objects can share the same composition. Also Note that the id is
   /// not the same for two compositions that were separately created from the
@@ -64,6 +102,12 @@ class Composition {
   /// Returns the unnormalized mass composition.
   const CompMap& mass();
 
+  /// Returns the unnormalized atom composition as a flat vector.
+  const CompVec& atom_vec();
+
+  /// Returns the unnormalized mass composition as a flat vector.
+  const CompVec& mass_vec();
+
   /// Returns a decayed version of this composition (decayed delta timesteps)
   /// assuming a time step is 1/12 of one year in duration. This composition
   /// remains unchanged.
@@ -83,7 +127,14 @@ class Composition {
   /// has been decayed from its root parent.
   typedef std::map<int, Composition::Ptr> Chain;
 
-  typedef boost::shared_ptr<Chain> ChainPtr;
+  /// a decay chain together with the lock that guards it, so that
+  /// compositions of different chains decay concurrently
+  struct DecayLine {
+    std::mutex mu;
+    Chain chain;
+  };
+
+  typedef boost::shared_ptr<DecayLine> ChainPtr;
 
   Composition();
 
@@ -94,14 +145,32 @@ class Composition {
   /// compositions while avoiding extra memory allocations.
   Composition(int prev_decay, ChainPtr decay_line);
 
+  /// Returns the interned composition equal to v if there is one. Otherwise
+  /// creates a new composition from v and, if interning is enabled, interns
+  /// it. atom_basis tells whether v holds atom or mass quantities.
+  static Ptr Intern(const CompVec& v, bool atom_basis);
+
+  /// Creates a new, never interned composition from v.
+  static Ptr New(const CompVec& v, bool atom_basis);
+
   /// Performs a decay calculation and creates a new decayed composition.
   Ptr NewDecay(int delta, uint64_t secs_per_timestep);
 
-  static int next_id_;
   int id_;
-  bool recorded_;
+  std::atomic<bool> recorded_;
+
+  // The flat vectors hold the composition; the maps are built from them on
+  // demand for callers of atom() and mass(). Agents ticked in parallel may
+  // share a composition (see TimeListener::ThreadSafeTick), so each is built
+  // exactly once under its flag.
+  CompVec atom_vec_;
+  CompVec mass_vec_;
   CompMap atom_;
   CompMap mass_;
+  std::once_flag atom_vec_once_;
+  std::once_flag mass_vec_once_;
+  std::once_flag atom_once_;
+  std::once_flag mass_once_;
 
   /// the total time delta this composition has been decayed from its root ancestor.
   int prev_decay_;
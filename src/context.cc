@@ -3,10 +3,13 @@
 #include <vector>
 #include <boost/uuid/uuid_generators.hpp>
 
+#include "decay_batch.h"
 #include "error.h"
 #include "exchange_solver.h"
 #include "logger.h"
+#include "material.h"
 #include "sim_init.h"
+#include "thread_pool.h"
 #include "timer.h"
 #include "version.h"
 
@@ -17,6 +20,14 @@ SimInfo::SimInfo()
       y0(0),
       m0(0),
       dt(kDefaultTimeStepDur),
+      nthreads(1),
+      record_buffers(kDefaultNumBuffers),
+      intern_tol(0),
+      batch_decay(false),
+      skip_idle(false),
+      timings(0),
+      snapshot_interval(0),
+      delta_snapshots(0),
       decay("manual"),
       branch_time(-1),
       parent_sim(boost::uuids::nil_uuid()),
@@ -27,6 +38,14 @@ SimInfo::SimInfo(int dur, int y0, int m0, std::string handle)
       y0(y0),
       m0(m0),
       dt(kDefaultTimeStepDur),
+      nthreads(1),
+      record_buffers(kDefaultNumBuffers),
+      intern_tol(0),
+      batch_decay(false),
+      skip_idle(false),
+      timings(0),
+      snapshot_interval(0),
+      delta_snapshots(0),
       decay("manual"),
       branch_time(-1),
       handle(handle),
@@ -38,6 +57,14 @@ SimInfo::SimInfo(int dur, int y0, int m0, std::string handle, std::string d)
       y0(y0),
       m0(m0),
       dt(kDefaultTimeStepDur),
+      nthreads(1),
+      record_buffers(kDefaultNumBuffers),
+      intern_tol(0),
+      batch_decay(false),
+      skip_idle(false),
+      timings(0),
+      snapshot_interval(0),
+      delta_snapshots(0),
       decay(d),
       branch_time(-1),
       handle(handle),
@@ -51,6 +78,14 @@ SimInfo::SimInfo(int dur, boost::uuids::uuid parent_sim,
       y0(-1),
       m0(-1),
       dt(kDefaultTimeStepDur),
+      nthreads(1),
+      record_buffers(kDefaultNumBuffers),
+      intern_tol(0),
+      batch_decay(false),
+      skip_idle(false),
+      timings(0),
+      snapshot_interval(0),
+      delta_snapshots(0),
       decay("manual"),
       parent_sim(parent_sim),
       parent_type(parent_type),
@@ -61,13 +96,19 @@ Context::Context(Timer* ti, Recorder* rec)
     : ti_(ti),
       rec_(rec),
       solver_(NULL),
+      pool_(NULL),
       trans_id_(0),
-      si_(0) {}
+      n_delta_snaps_(-1),
+      si_(0),
+      prev_batch_time_(-1) {}
 
 Context::~Context() {
   if (solver_ != NULL) {
     delete solver_;
   }
+  if (pool_ != NULL) {
+    delete pool_;
+  }
 
   // initiate deletion of agents that don't have parents.
   // dealloc will propagate through hierarchy as agents delete their children
@@ -198,9 +239,142 @@ void Context::InitSim(SimInfo si) {
       ->Record();
 
   si_ = si;
+  nthreads(si.nthreads);
+  record_buffers(si.record_buffers);
+  intern_tol(si.intern_tol);
+  batch_decay(si.batch_decay);
+  timings(si.timings);
+  snapshot_interval(si.snapshot_interval);
+  delta_snapshots(si.delta_snapshots);
   ti_->Initialize(this, si);
 }
 
+ThreadPool* Context::thread_pool() {
+  if (pool_ == NULL && si_.nthreads > 1) {
+    // tasks create compositions and untracked resources with this
+    // simulation's ids
+    IdCounters* ids = &ids_;
+    pool_ = new ThreadPool(si_.nthreads,
+                           [ids]() { IdCounters::current(ids); });
+  }
+  return pool_;
+}
+
+void Context::ParallelPhase(int n, const std::function<void(int)>& f) {
+  ThreadPool* pool = thread_pool();
+  if (pool == NULL) {
+    for (int i = 0; i < n; ++i) {
+      f(i);
+    }
+    return;
+  }
+
+  rec_->OpenStages(n);
+  std::function<void(int)> staged = [&](int i) {
+    rec_->SelectStage(i);
+    try {
+      f(i);
+    } catch (...) {
+      rec_->SelectStage(-1);
+      throw;
+    }
+    rec_->SelectStage(-1);
+  };
+  try {
+    pool->ParallelFor(n, staged);
+  } catch (...) {
+    rec_->MergeStages();
+    throw;
+  }
+  rec_->MergeStages();
+}
+
+void Context::nthreads(int n) {
+  si_.nthreads = n;
+  if (pool_ != NULL) {
+    delete pool_;
+    pool_ = NULL;
+  }
+}
+
+void Context::record_buffers(int n) {
+  si_.record_buffers = n;
+  rec_->set_nbuffers(n);
+}
+
+void Context::intern_tol(double tol) {
+  ids_.InternTol(tol);
+  si_.intern_tol = tol;
+}
+
+void Context::batch_decay(bool on) {
+  si_.batch_decay = on;
+  if (!on) {
+    std::lock_guard<std::mutex> lk(materials_mu_);
+    materials_.clear();
+  }
+}
+
+void Context::skip_idle(bool on) {
+  si_.skip_idle = on;
+  ti_->skip_idle(on);
+}
+
+void Context::timings(int level) {
+  si_.timings = level;
+  timings_.level(level);
+}
+
+void Context::snapshot_interval(int n) {
+  si_.snapshot_interval = n;
+  ti_->snapshot_interval(n);
+}
+
+void Context::delta_snapshots(int n) {
+  si_.delta_snapshots = n;
+}
+
+void Context::RegisterMaterial(boost::shared_ptr<Material> m) {
+  if (si_.batch_decay) {
+    std::lock_guard<std::mutex> lk(materials_mu_);
+    materials_.push_back(m);
+  }
+}
+
+int Context::BatchDecay() {
+  if (!si_.batch_decay || si_.decay == "never") {
+    return 0;
+  }
+
+  // drop the materials that no longer exist while queueing the others. Only
+  // materials decayed since the previous batch are queued: the decay of the
+  // others was not used, and computing it anyway would grow their decay
+  // lineages by a composition every time step.
+  DecayBatch batch;
+  std::lock_guard<std::mutex> lk(materials_mu_);
+  int n = 0;
+  int nqueued = 0;
+  for (int i = 0; i < materials_.size(); ++i) {
+    Material::Ptr m = materials_[i].lock();
+    if (!m || m->ctx_ != this) {
+      continue;
+    }
+    if (m->prev_decay_time_ >= prev_batch_time_) {
+      m->QueueDecay(&batch, time());
+      nqueued++;
+    }
+    materials_[n++] = materials_[i];
+  }
+  materials_.resize(n);
+  prev_batch_time_ = time();
+
+  int ndecayed = batch.Run(thread_pool());
+  CLOG(LEV_INFO3) << "Batched decay computed " << ndecayed
+                  << " compositions for " << nqueued << " of " << n
+                  << " materials";
+  return ndecayed;
+}
+
 int Context::time() {
   return ti_->time();
 }
@@ -1,9 +1,13 @@
 #ifndef CYCLUS_SRC_CONTEXT_H_
 #define CYCLUS_SRC_CONTEXT_H_
 
+#include <functional>
+#include <limits>
 #include <map>
+#include <mutex>
 #include <set>
 #include <string>
+#include <vector>
 #include <stdint.h>
 
 #ifndef CYCPP
@@ -12,25 +16,34 @@
 // closed braces '}'
 #include <boost/uuid/uuid_generators.hpp>
 #endif
+#include <boost/weak_ptr.hpp>
 
 #include "composition.h"
 #include "agent.h"
 #include "greedy_solver.h"
+#include "id_counters.h"
 #include "recorder.h"
+#include "timings.h"
 
 const uint64_t kDefaultTimeStepDur = 2629846;
 
+/// Wake-up time returned by TimeListener::NextWakeup and Trader::NextTrade
+/// when an agent need not be woken again.
+const int kNeverWake = std::numeric_limits<int>::max();
+
 class SimInitTest;
 
 namespace cyclus {
 
 class Datum;
 class ExchangeSolver;
+class Material;
 class Recorder;
 class Trader;
 class Timer;
 class TimeListener;
 class SimInit;
+class ThreadPool;
 
 /// Container for a static simulation-global parameters that both describe
 /// the simulation and affect its behavior.
@@ -97,6 +110,41 @@ class SimInfo {
 
   /// Duration in seconds of a single time step in the simulation.
   uint64_t dt;
+
+  /// Number of threads used by the parallel phases of the simulation,
+  /// including the main thread. The default, 1, runs every phase serially.
+  int nthreads;
+
+  /// Number of Datum buffers used by the recorder. With two or more, output
+  /// is written to the backends by a separate thread (see Recorder).
+  int record_buffers;
+
+  /// Relative tolerance within which equal compositions are interned to a
+  /// single Composition object (see Composition::intern_tol). The default, 0,
+  /// disables interning.
+  double intern_tol;
+
+  /// If true, the compositions of all materials are decayed together in one
+  /// batched pass at the start of every time step (see Context::BatchDecay).
+  bool batch_decay;
+
+  /// If true, the timer skips time steps at which no builds, decommissionings,
+  /// time listener wake-ups or trades are scheduled (see Timer::RunSim).
+  bool skip_idle;
+
+  /// Level of timing instrumentation written to the PhaseTimings and
+  /// AgentTimings tables (see Timings::Level). The default, 0, disables it.
+  int timings;
+
+  /// Number of time steps between automatic snapshots of the simulation
+  /// state (see SimInit::Snapshot). The default, 0, only takes the snapshots
+  /// that are requested and the one at the end of the simulation.
+  int snapshot_interval;
+
+  /// Number of incremental snapshots taken after each full snapshot, which
+  /// only record what changed since the previous snapshot (see
+  /// SimInit::Snapshot). The default, 0, takes full snapshots only.
+  int delta_snapshots;
 };
 
 /// A simulation context provides access to necessary simulation-global
@@ -115,6 +163,9 @@ class Context {
   friend class ::SimInitTest;
   friend class SimInit;
   friend class Agent;
+  friend class Material;
+  friend class Timer;
+  friend class Timings;
 
   /// Creates a new context working with the specified timer and datum manager.
   /// The timer does not have to be initialized (yet).
@@ -154,6 +205,11 @@ class Context {
     return traders_;
   }
 
+  /// @return all agents currently in the simulation.
+  inline const std::set<Agent*>& agents() const {
+    return agent_list_;
+  }
+
   /// Create a new agent by cloning the named prototype. The returned agent is
   /// not initialized as a simulation participant.
   ///
@@ -252,6 +308,71 @@ class Context {
     solver_->sim_ctx(this);
   }
 
+  /// Returns the worker pool used by the parallel phases of the simulation,
+  /// or NULL if the simulation is run serially (i.e., SimInfo::nthreads is 1
+  /// or less).
+  ThreadPool* thread_pool();
+
+  /// Runs f(i) for every i in [0, n) on the simulation's thread pool. Datum
+  /// objects recorded by each call are staged separately and passed on to the
+  /// recorder in index order once all calls have finished (see
+  /// Recorder::OpenStages), so the output does not depend on how the calls
+  /// were scheduled. Runs the calls serially, in order, if there is no pool.
+  void ParallelPhase(int n, const std::function<void(int)>& f);
+
+  /// Sets the number of threads used by the parallel phases of the
+  /// simulation, overriding the value given in the simulation's SimInfo.
+  void nthreads(int n);
+
+  /// Sets the number of Datum buffers used by the simulation's recorder,
+  /// overriding the value given in the simulation's SimInfo.
+  void record_buffers(int n);
+
+  /// Sets the composition interning tolerance of this simulation's
+  /// compositions, overriding the value given in the simulation's SimInfo.
+  void intern_tol(double tol);
+
+  /// Enables or disables batched decay, overriding the value given in the
+  /// simulation's SimInfo. Only materials created while batched decay is
+  /// enabled take part in the batched pass.
+  void batch_decay(bool on);
+
+  /// Enables or disables skipping idle time steps, overriding the value given
+  /// in the simulation's SimInfo.
+  void skip_idle(bool on);
+
+  /// Sets the timing instrumentation level, overriding the value given in the
+  /// simulation's SimInfo.
+  void timings(int level);
+
+  /// Returns the timings collected for the current time step.
+  inline Timings* timings() { return &timings_; }
+
+  /// Returns the counters from which the simulation's ids are assigned.
+  inline IdCounters* ids() { return &ids_; }
+
+  /// Sets the number of time steps between automatic snapshots, overriding
+  /// the value given in the simulation's SimInfo.
+  void snapshot_interval(int n);
+
+  /// Sets the number of incremental snapshots taken after each full snapshot,
+  /// overriding the value given in the simulation's SimInfo.
+  void delta_snapshots(int n);
+
+  /// Computes the decay up to the current time step of the materials created
+  /// in this context whose decay is in use, as a single DecayBatch using the
+  /// context's thread pool. The results are cached in the decay lineages of
+  /// the materials' compositions, so that the materials' own (e.g. lazy)
+  /// Decay calls during the time step are simple lookups. Neither the
+  /// "manual" nor the "lazy" decay mode guarantees that a material's decay is
+  /// read, so only materials that were decayed (or created) since the
+  /// previous batch are included. Materials that are left untouched thus add
+  /// at most one unused composition to their decay lineages. Does nothing
+  /// unless batched decay is enabled and the decay mode is not "never".
+  ///
+  /// @return the number of compositions computed
+  int BatchDecay();
+
   /// @return the number of agents of a given prototype currently in the
   /// simulation
   inline int n_prototypes(std::string type) {
@@ -277,6 +398,20 @@ class Context {
     n_specs_[a->spec()]--;
   }
 
+  /// Registers a material for batched decay if that is enabled.
+  void RegisterMaterial(boost::shared_ptr<Material> m);
+
+  /// What the last snapshot recorded for an agent, which incremental
+  /// snapshots compare against (see SimInit::Snapshot).
+  struct AgentSnap {
+    /// the agent's recorded state values, if comparable is true
+    std::string state;
+    /// false if the state contains values that can't be compared
+    bool comparable;
+    /// the resource state ids of each of the agent's inventories
+    std::map<std::string, std::vector<int> > invs;
+  };
+
   /// contains archetype specs of all agents for which version have already
   /// been recorded in the db
   std::set<std::string> rec_ver_;
@@ -292,7 +427,26 @@ class Context {
   Timer* ti_;
   ExchangeSolver* solver_;
   Recorder* rec_;
+  ThreadPool* pool_;
+  Timings timings_;
+  IdCounters ids_;
   int trans_id_;
+
+  /// number of incremental snapshots since the last full one, -1 before the
+  /// first snapshot
+  int n_delta_snaps_;
+
+  /// std::map<AgentId, AgentSnap> of every agent in the last snapshot, kept
+  /// only if incremental snapshots are enabled
+  std::map<int, AgentSnap> snaps_;
+
+  /// materials taking part in batched decay. Materials can be created from
+  /// parallel phases, so additions go through materials_mu_.
+  std::vector<boost::weak_ptr<Material> > materials_;
+  std::mutex materials_mu_;
+
+  /// the time step of the previous BatchDecay, -1 before the first
+  int prev_batch_time_;
 };
 
 }  // namespace cyclus
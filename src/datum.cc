@@ -1,7 +1,10 @@
 #include "datum.h"
 
+#include <string.h>
+
 #include <boost/pool/singleton_pool.hpp>
 
+#include "error.h"
 #include "timer.h"
 
 namespace cyclus {
@@ -11,27 +14,144 @@ typedef boost::singleton_pool<Datum, sizeof(Datum)> DatumPool;
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 Datum* Datum::AddVal(const char* field, boost::spirit::hold_any val,
                      std::vector<int>* shape) {
-  vals_.push_back(std::pair<const char*, boost::spirit::hold_any>(field, val));
-  std::vector<int> s;
-  if (shape == NULL)
-    shapes_.push_back(s);
-  else
-    shapes_.push_back(*shape);
+  // values of the typed kinds are unboxed so that backends never have to
+  // distinguish how they were added
+  const std::type_info& t = val.type();
+  if (t == typeid(bool)) {
+    return AddVal(field, val.cast<bool>(), shape);
+  } else if (t == typeid(int)) {
+    return AddVal(field, val.cast<int>(), shape);
+  } else if (t == typeid(float)) {
+    return AddVal(field, val.cast<float>(), shape);
+  } else if (t == typeid(double)) {
+    return AddVal(field, val.cast<double>(), shape);
+  } else if (t == typeid(std::string)) {
+    return AddVal(field, val.cast<std::string>(), shape);
+  } else if (t == typeid(const char*)) {
+    return AddVal(field, val.cast<const char*>(), shape);
+  } else if (t == typeid(char*)) {
+    return AddVal(field, val.cast<char*>(), shape);
+  } else if (t == typeid(Blob)) {
+    return AddVal(field, val.cast<Blob>(), shape);
+  } else if (t == typeid(boost::uuids::uuid)) {
+    return AddVal(field, val.cast<boost::uuids::uuid>(), shape);
+  }
+
+  Field f = {field, ANY_FIELD, boxes_.size(), 0};
+  fields_.push_back(f);
+  boxes_.push_back(val);
+  AddShape(shape);
   return this;
 }
 
+Datum* Datum::AddVal(const char* field, bool val, std::vector<int>* shape) {
+  return AddInline(field, BOOL_FIELD, &val, sizeof(val), shape);
+}
+
+Datum* Datum::AddVal(const char* field, int val, std::vector<int>* shape) {
+  return AddInline(field, INT_FIELD, &val, sizeof(val), shape);
+}
+
+Datum* Datum::AddVal(const char* field, float val, std::vector<int>* shape) {
+  return AddInline(field, FLOAT_FIELD, &val, sizeof(val), shape);
+}
+
+Datum* Datum::AddVal(const char* field, double val, std::vector<int>* shape) {
+  return AddInline(field, DOUBLE_FIELD, &val, sizeof(val), shape);
+}
+
+Datum* Datum::AddVal(const char* field, const char* val,
+                     std::vector<int>* shape) {
+  return AddBytes(field, STRING_FIELD, val, strlen(val), shape);
+}
+
+Datum* Datum::AddVal(const char* field, const std::string& val,
+                     std::vector<int>* shape) {
+  return AddBytes(field, STRING_FIELD, val.c_str(), val.size(), shape);
+}
+
+Datum* Datum::AddVal(const char* field, const Blob& val,
+                     std::vector<int>* shape) {
+  const std::string& s = val.str();
+  return AddBytes(field, BLOB_FIELD, s.c_str(), s.size(), shape);
+}
+
+Datum* Datum::AddVal(const char* field, const boost::uuids::uuid& val,
+                     std::vector<int>* shape) {
+  return AddInline(field, UUID_FIELD, val.data, val.size(), shape);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+Datum* Datum::AddInline(const char* field, FieldType type, const void* val,
+                        size_t size, std::vector<int>* shape) {
+  Field f = {field, type, row_.size(), size};
+  fields_.push_back(f);
+  row_.resize(f.offset + size);
+  memcpy(&row_[f.offset], val, size);
+  AddShape(shape);
+  return this;
+}
+
+Datum* Datum::AddBytes(const char* field, FieldType type, const char* val,
+                       size_t size, std::vector<int>* shape) {
+  Field f = {field, type, arena_.size(), size};
+  fields_.push_back(f);
+  arena_.resize(f.offset + size + 1);
+  memcpy(&arena_[f.offset], val, size);
+  arena_[f.offset + size] = '\0';
+  AddShape(shape);
+  return this;
+}
+
+void Datum::AddShape(std::vector<int>* shape) {
+  shapes_.push_back(Shape());
+  if (shape != NULL)
+    shapes_.back() = *shape;
+  vals_valid_ = false;
+}
+
+void Datum::Truncate(int n) {
+  size_t row_end = 0;
+  size_t arena_end = 0;
+  size_t nboxes = 0;
+  for (int i = 0; i < n; ++i) {
+    const Field& f = fields_[i];
+    switch (f.type) {
+      case ANY_FIELD:
+        nboxes = f.offset + 1;
+        break;
+      case STRING_FIELD:
+      case BLOB_FIELD:
+        arena_end = f.offset + f.size + 1;
+        break;
+      default:
+        row_end = f.offset + f.size;
+    }
+  }
+  fields_.resize(n);
+  row_.resize(row_end);
+  arena_.resize(arena_end);
+  boxes_.resize(nboxes);
+  shapes_.resize(n);
+  vals_valid_ = false;
+}
+
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 void Datum::Record() {
   manager_->AddDatum(this);
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-Datum::Datum(Recorder* m, std::string title) : title_(title), manager_(m) {
+Datum::Datum(Recorder* m, std::string title)
+    : title_(title),
+      manager_(m),
+      vals_valid_(false) {
   // The (vect) size to reserve is chosen to be just bigger than most/all cyclus
   // core tables.  This prevents extra reallocations in the underlying
   // vector as vals are added to the datum.
-  vals_.reserve(10);
+  fields_.reserve(10);
   shapes_.reserve(10);
+  row_.reserve(10 * sizeof(double));
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
@@ -42,9 +162,107 @@ std::string Datum::title() {
 }
 
 const Datum::Vals& Datum::vals() {
+  if (vals_valid_)
+    return vals_;
+
+  vals_.clear();
+  vals_.reserve(fields_.size());
+  for (int i = 0; i < fields_.size(); ++i) {
+    const Field& f = fields_[i];
+    boost::spirit::hold_any v;
+    switch (f.type) {
+      case ANY_FIELD:
+        v = boxes_[f.offset];
+        break;
+      case BOOL_FIELD:
+        v = AsBool(i);
+        break;
+      case INT_FIELD:
+        v = AsInt(i);
+        break;
+      case FLOAT_FIELD:
+        v = AsFloat(i);
+        break;
+      case DOUBLE_FIELD:
+        v = AsDouble(i);
+        break;
+      case STRING_FIELD:
+        v = std::string(data(i), f.size);
+        break;
+      case BLOB_FIELD:
+        v = Blob(std::string(data(i), f.size));
+        break;
+      case UUID_FIELD:
+        v = AsUuid(i);
+        break;
+    }
+    vals_.push_back(Entry(f.name, v));
+  }
+  vals_valid_ = true;
   return vals_;
 }
 
+const char* Datum::data(int i) const {
+  const Field& f = fields_[i];
+  switch (f.type) {
+    case ANY_FIELD:
+      throw ValueError(std::string("datum field '") + f.name
+                       + "' is boxed and has no raw data");
+    case STRING_FIELD:
+    case BLOB_FIELD:
+      return &arena_[f.offset];
+    default:
+      return &row_[f.offset];
+  }
+}
+
+const boost::spirit::hold_any& Datum::box(int i) const {
+  CheckType(i, ANY_FIELD);
+  return boxes_[fields_[i].offset];
+}
+
+bool Datum::AsBool(int i) const {
+  CheckType(i, BOOL_FIELD);
+  bool v;
+  memcpy(&v, data(i), sizeof(v));
+  return v;
+}
+
+int Datum::AsInt(int i) const {
+  CheckType(i, INT_FIELD);
+  int v;
+  memcpy(&v, data(i), sizeof(v));
+  return v;
+}
+
+float Datum::AsFloat(int i) const {
+  CheckType(i, FLOAT_FIELD);
+  float v;
+  memcpy(&v, data(i), sizeof(v));
+  return v;
+}
+
+double Datum::AsDouble(int i) const {
+  CheckType(i, DOUBLE_FIELD);
+  double v;
+  memcpy(&v, data(i), sizeof(v));
+  return v;
+}
+
+boost::uuids::uuid Datum::AsUuid(int i) const {
+  CheckType(i, UUID_FIELD);
+  boost::uuids::uuid v;
+  memcpy(v.data, data(i), v.size());
+  return v;
+}
+
+void Datum::CheckType(int i, FieldType type) const {
+  if (fields_[i].type != type) {
+    throw ValueError(std::string("datum field '") + fields_[i].name
+                     + "' has a different type than requested");
+  }
+}
+
 const Datum::Shapes& Datum::shapes() {
   return shapes_;
 }
@@ -5,13 +5,24 @@
 #include <string>
 #include <vector>
 
+#include <boost/uuid/uuid.hpp>
+
 #include "any.hpp"
+#include "blob.h"
 #include "recorder.h"
 
 namespace cyclus {
 
 /// Used to specify and send a collection of key-value pairs to the
 /// Recorder for recording.
+///
+/// Values of the scalar types (bool, int, float, double, uuid) are stored
+/// inline in a packed row buffer and strings and blobs are copied into a byte
+/// arena, so that adding them never allocates once a recycled datum's buffers
+/// have grown to fit its table. Values of all other types (e.g. containers)
+/// are boxed in a boost::spirit::hold_any. Backends read typed fields directly
+/// via field(), data(), and the As* accessors; vals() remains available for
+/// consumers that expect every value boxed.
 class Datum {
   friend class Recorder;
 
@@ -21,6 +32,29 @@ class Datum {
   typedef std::vector<int> Shape;
   typedef std::vector<Shape> Shapes;
 
+  /// How a field's value is stored in the datum.
+  enum FieldType {
+    ANY_FIELD,  ///< boxed in a hold_any, see box()
+    BOOL_FIELD,
+    INT_FIELD,
+    FLOAT_FIELD,
+    DOUBLE_FIELD,
+    STRING_FIELD,  ///< bytes in the arena, NUL-terminated
+    BLOB_FIELD,  ///< bytes in the arena
+    UUID_FIELD,
+  };
+
+  /// The location of a single field's value.
+  struct Field {
+    const char* name;
+    FieldType type;
+    /// offset into the row buffer (inline types), the arena (strings and
+    /// blobs) or the box list (ANY_FIELD)
+    size_t offset;
+    /// number of bytes of the value, excluding a string's NUL terminator
+    size_t size;
+  };
+
   virtual ~Datum();
 
   /// Add an arbitrary field-value pair to the datum.
@@ -48,6 +82,29 @@ class Datum {
   Datum* AddVal(const char* field, boost::spirit::hold_any val,
                 std::vector<int>* shape = NULL);
 
+  /// Typed overloads of AddVal that store the value without boxing it.
+  /// \{
+  Datum* AddVal(const char* field, bool val, std::vector<int>* shape = NULL);
+  Datum* AddVal(const char* field, int val, std::vector<int>* shape = NULL);
+  Datum* AddVal(const char* field, float val, std::vector<int>* shape = NULL);
+  Datum* AddVal(const char* field, double val, std::vector<int>* shape = NULL);
+  Datum* AddVal(const char* field, const char* val,
+                std::vector<int>* shape = NULL);
+  Datum* AddVal(const char* field, const std::string& val,
+                std::vector<int>* shape = NULL);
+  Datum* AddVal(const char* field, const Blob& val,
+                std::vector<int>* shape = NULL);
+  Datum* AddVal(const char* field, const boost::uuids::uuid& val,
+                std::vector<int>* shape = NULL);
+  /// \}
+
+  /// Adds a value of any other type by boxing it.
+  template <class T>
+  Datum* AddVal(const char* field, const T& val,
+                std::vector<int>* shape = NULL) {
+    return AddVal(field, boost::spirit::hold_any(val), shape);
+  }
+
   /// Record this datum to its Recorder. Recorded Datum objects of the same
   /// title (e.g. same table) must not contain any fields that were not
   /// present in the first datum recorded of that title.
@@ -56,9 +113,35 @@ class Datum {
   /// Returns the datum's title as specified during the datum's creation.
   std::string title();
 
-  /// Returns a vector of all field-value pairs that have been added to this datum.
+  /// Returns a vector of all field-value pairs that have been added to this
+  /// datum. Typed fields are boxed on the first call after a change, so
+  /// backends should prefer the typed accessors below.
   const Vals& vals();
 
+  /// Returns the number of fields that have been added to this datum.
+  inline int nfields() const { return fields_.size(); }
+
+  /// Returns the i-th field added to this datum.
+  inline const Field& field(int i) const { return fields_[i]; }
+
+  /// Returns a pointer to the bytes of the i-th field's value, which is
+  /// field(i).size bytes long. Throws a ValueError for ANY_FIELD fields.
+  const char* data(int i) const;
+
+  /// Returns the boxed value of the i-th field. Throws a ValueError for typed
+  /// fields.
+  const boost::spirit::hold_any& box(int i) const;
+
+  /// Typed accessors for the i-th field. Each throws a ValueError if the
+  /// field was not added with the matching type.
+  /// \{
+  bool AsBool(int i) const;
+  int AsInt(int i) const;
+  float AsFloat(int i) const;
+  double AsDouble(int i) const;
+  boost::uuids::uuid AsUuid(int i) const;
+  /// \}
+
   /// Returns a vector of all shapes (pointers to vectors of ints) that have been
   /// added to this datum. The length of shapes must match the length of vals.
   const Shapes& shapes();
@@ -71,10 +154,35 @@ class Datum {
   /// use the recorder interface).
   Datum(Recorder* m, std::string title);
 
+  /// Appends a field whose value is copied inline into the row buffer.
+  Datum* AddInline(const char* field, FieldType type, const void* val,
+                   size_t size, std::vector<int>* shape);
+
+  /// Appends a field whose value is copied into the arena.
+  Datum* AddBytes(const char* field, FieldType type, const char* val,
+                  size_t size, std::vector<int>* shape);
+
+  /// Appends the field's shape and invalidates the boxed vals.
+  void AddShape(std::vector<int>* shape);
+
+  /// Throws a ValueError unless the i-th field has the given type.
+  void CheckType(int i, FieldType type) const;
+
+  /// Removes all but the first n fields, keeping the capacity of all buffers
+  /// so that the datum can be refilled without allocating.
+  void Truncate(int n);
+
   Recorder* manager_;
   std::string title_;
-  Vals vals_;
+  std::vector<Field> fields_;
+  std::vector<char> row_;
+  std::vector<char> arena_;
+  std::vector<boost::spirit::hold_any> boxes_;
   Shapes shapes_;
+
+  /// lazily boxed copy of all fields, valid while vals_valid_ is true
+  Vals vals_;
+  bool vals_valid_;
 };
 
 }  // namespace cyclus
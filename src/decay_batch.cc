@@ -0,0 +1,165 @@
+#include "decay_batch.h"
+
+#include <algorithm>
+#include <functional>
+#include <mutex>
+
+#include "decay_engine.h"
+#include "thread_pool.h"
+
+namespace cyclus {
+
+namespace {
+
+/// the maximum number of compositions multiplied by one dense product
+const int kBlockSize = 256;
+
+}  // namespace
+
+void DecayBatch::Add(Composition::Ptr c, int delta, uint64_t secs_per_timestep) {
+  int tot_decay = c->prev_decay_ + delta;
+  {
+    std::lock_guard<std::mutex> lk(c->decay_line_->mu);
+    if (delta == 0 || c->decay_line_->chain.count(tot_decay) > 0) {
+      return;
+    }
+  }
+
+  std::pair<Composition::DecayLine*, int> key(c->decay_line_.get(), tot_decay);
+  if (index_.count(key) > 0) {
+    return;
+  }
+  index_[key] = jobs_.size();
+
+  Job j;
+  j.comp = c;
+  j.delta = delta;
+  j.secs = static_cast<double>(secs_per_timestep) * delta;
+  jobs_.push_back(j);
+}
+
+int DecayBatch::Run(ThreadPool* pool) {
+  std::map<double, std::vector<Job*> > groups;
+  for (int i = 0; i < jobs_.size(); ++i) {
+    groups[jobs_[i].secs].push_back(&jobs_[i]);
+  }
+
+  std::map<double, std::vector<Job*> >::iterator it;
+  for (it = groups.begin(); it != groups.end(); ++it) {
+    const std::vector<Job*>& group = it->second;
+    for (int k0 = 0; k0 < group.size(); k0 += kBlockSize) {
+      int k1 = std::min<int>(k0 + kBlockSize, group.size());
+      RunBlock(std::vector<Job*>(group.begin() + k0, group.begin() + k1),
+               it->first, pool);
+    }
+  }
+
+  int n = jobs_.size();
+  jobs_.clear();
+  index_.clear();
+  return n;
+}
+
+void DecayBatch::RunBlock(const std::vector<Job*>& block, double secs,
+                          ThreadPool* pool) {
+  int nk = block.size();
+
+  // rows of X: the union of all parent nuclides in the block
+  std::vector<const CompVec*> inputs(nk);
+  std::map<Nuc, int> parents;
+  for (int k = 0; k < nk; ++k) {
+    inputs[k] = &block[k]->comp->atom_vec();
+    const std::vector<Nuc>& nucs = inputs[k]->nucs();
+    for (int i = 0; i < nucs.size(); ++i) {
+      parents[nucs[i]] = 0;
+    }
+  }
+  int nm = 0;
+  std::vector<CompVec> cols;
+  DecayEngine& eng = DecayEngine::Instance();
+  std::map<Nuc, int>::iterator pit;
+  for (pit = parents.begin(); pit != parents.end(); ++pit) {
+    pit->second = nm++;
+    cols.push_back(eng.Column(pit->first, secs));
+  }
+
+  // rows of Y: the union of all nuclides produced by those parents
+  std::map<Nuc, int> daughters;
+  for (int m = 0; m < nm; ++m) {
+    const std::vector<Nuc>& nucs = cols[m].nucs();
+    for (int i = 0; i < nucs.size(); ++i) {
+      daughters[nucs[i]] = 0;
+    }
+  }
+  int nr = 0;
+  std::vector<Nuc> rownucs;
+  rownucs.reserve(daughters.size());
+  std::map<Nuc, int>::iterator it;
+  for (it = daughters.begin(); it != daughters.end(); ++it) {
+    it->second = nr++;
+    rownucs.push_back(it->first);
+  }
+
+  // dense, column-major decay operator A (nr x nm) and input X (nm x nk)
+  std::vector<double> a(static_cast<size_t>(nr) * nm, 0);
+  for (int m = 0; m < nm; ++m) {
+    const std::vector<Nuc>& nucs = cols[m].nucs();
+    const std::vector<double>& q = cols[m].vals();
+    for (int i = 0; i < nucs.size(); ++i) {
+      a[static_cast<size_t>(m) * nr + daughters[nucs[i]]] = q[i];
+    }
+  }
+  std::vector<double> x(static_cast<size_t>(nm) * nk, 0);
+  for (int k = 0; k < nk; ++k) {
+    const std::vector<Nuc>& nucs = inputs[k]->nucs();
+    const std::vector<double>& q = inputs[k]->vals();
+    for (int i = 0; i < nucs.size(); ++i) {
+      x[static_cast<size_t>(k) * nm + parents[nucs[i]]] = q[i];
+    }
+  }
+
+  // Y = A X, one output column per task. The inner loop runs down contiguous
+  // columns of A and Y and is left to the compiler to vectorize.
+  std::vector<double> y(static_cast<size_t>(nr) * nk, 0);
+  std::vector<CompVec> outs(nk);
+  std::function<void(int)> mult = [&](int k) {
+    double* yk = &y[static_cast<size_t>(k) * nr];
+    const double* xk = &x[static_cast<size_t>(k) * nm];
+    for (int m = 0; m < nm; ++m) {
+      double xm = xk[m];
+      if (xm == 0) {
+        continue;
+      }
+      const double* am = &a[static_cast<size_t>(m) * nr];
+      for (int r = 0; r < nr; ++r) {
+        yk[r] += am[r] * xm;
+      }
+    }
+    for (int r = 0; r < nr; ++r) {
+      if (yk[r] > 0) {
+        outs[k].Append(rownucs[r], yk[r]);
+      }
+    }
+  };
+  if (pool != NULL) {
+    pool->ParallelFor(nk, mult);
+  } else {
+    for (int k = 0; k < nk; ++k) {
+      mult(k);
+    }
+  }
+
+  // create the decayed compositions in queue order so their ids are
+  // deterministic
+  for (int k = 0; k < nk; ++k) {
+    Composition::Ptr c = block[k]->comp;
+    int tot_decay = c->prev_decay_ + block[k]->delta;
+    Composition::Ptr decayed(new Composition(tot_decay, c->decay_line_));
+    decayed->atom_vec_ = outs[k];
+    // keep a result that a concurrent Composition::Decay got in first
+    std::lock_guard<std::mutex> lk(c->decay_line_->mu);
+    c->decay_line_->chain.insert(std::make_pair(tot_decay, decayed));
+  }
+}
+
+}  // namespace cyclus
@@ -0,0 +1,75 @@
+#ifndef CYCLUS_SRC_DECAY_BATCH_H_
+#define CYCLUS_SRC_DECAY_BATCH_H_
+
+#include <map>
+#include <utility>
+#include <vector>
+#include <stdint.h>
+
+#include "composition.h"
+
+namespace cyclus {
+
+class ThreadPool;
+
+/// DecayBatch decays many compositions together. Compositions are queued with
+/// Add and decayed by a single call to Run, which stores every result in the
+/// decay lineage (i.e. decay_line_) of the queued composition. A later
+/// Composition::Decay call for the same time delta then returns the cached
+/// result without further computation.
+///
+/// Queued decays are deduplicated: compositions that share a decay lineage
+/// and would be decayed to the same total time are computed once. The
+/// remaining decays are grouped by their duration in seconds. Because decay is
+/// linear in the initial nuclide quantities, each group is evaluated as one
+/// matrix-matrix product Y = A X, where X is a dense nuclide by composition
+/// matrix of the queued atom quantities and each column of the decay operator
+/// A is the decay of one unit of a single parent nuclide. Operator columns are
+/// taken from the DecayEngine, which computes them once per (duration,
+/// nuclide). The product is split by composition across a thread pool.
+///
+/// @code
+/// DecayBatch batch;
+/// batch.Add(c1, 3, kDefaultTimeStepDur);
+/// batch.Add(c2, 1, kDefaultTimeStepDur);
+/// batch.Run(ctx->thread_pool());
+/// Composition::Ptr decayed = c1->Decay(3);  // cached by Run
+/// @endcode
+class DecayBatch {
+ public:
+  DecayBatch() {}
+
+  /// Queues c to be decayed by delta time steps of secs_per_timestep seconds.
+  /// Decays that are already cached in c's decay lineage are ignored.
+  void Add(Composition::Ptr c, int delta, uint64_t secs_per_timestep);
+
+  /// Returns the number of distinct decays queued.
+  inline int size() const { return jobs_.size(); }
+
+  /// Computes all queued decays, storing them in the decay lineages of the
+  /// queued compositions, and empties the queue. The matrix products are
+  /// split across pool's threads if pool is not NULL.
+  ///
+  /// @return the number of decayed compositions that were computed
+  int Run(ThreadPool* pool = NULL);
+
+ private:
+  struct Job {
+    Composition::Ptr comp;
+    int delta;
+    double secs;
+  };
+
+  /// Computes a block of jobs that all decay for secs seconds.
+  void RunBlock(const std::vector<Job*>& block, double secs, ThreadPool* pool);
+
+  /// queued jobs in the order they were added
+  std::vector<Job> jobs_;
+
+  /// index into jobs_ keyed by decay lineage and total decay time
+  std::map<std::pair<Composition::DecayLine*, int>, int> index_;
+};
+
+}  // namespace cyclus
+
+#endif  // CYCLUS_SRC_DECAY_BATCH_H_
@@ -0,0 +1,406 @@
+#include "decay_engine.h"
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <utility>
+
+#include "nuc_registry.h"
+
+namespace cyclus {
+
+namespace {
+
+typedef std::complex<double> Complex;
+
+/// the number of conjugate pole pairs of the order 16 approximation
+const int kNumPoles = 8;
+
+/// CRAM-16 poles and residues in incomplete partial fraction form, see
+/// M. Pusa, "Higher-Order Chebyshev Rational Approximation Method and
+/// Application to Burnup Equations", Nucl. Sci. Eng. 182 (2016).
+const Complex kTheta[kNumPoles] = {
+  Complex(3.509103608414918, 8.436198985884374),
+  Complex(5.948152268951177, 3.587457362018322),
+  Complex(-5.264971343442647, 16.22022147316793),
+  Complex(1.419375897185666, 10.92536348449672),
+  Complex(6.416177699099435, 1.194122393370139),
+  Complex(4.993174737717997, 5.996881713603942),
+  Complex(-1.413928462488886, 13.49772569889275),
+  Complex(-10.84391707869699, 19.27744616718165),
+};
+
+const Complex kAlpha[kNumPoles] = {
+  Complex(5.464930576870210e+3, -3.797983575308356e+4),
+  Complex(9.045112476907548e+1, -1.115537522430261e+3),
+  Complex(2.344818070467641e+2, -4.228020157070496e+2),
+  Complex(9.453304067358312e+1, -2.951294291446048e+2),
+  Complex(7.283792954673409e+2, -1.205646080220011e+5),
+  Complex(3.648229059594851e+1, -1.155509621409682e+2),
+  Complex(2.547321630156819e+1, -2.639500283021502e+1),
+  Complex(2.394538338734709e+1, -5.650522971778156e+0),
+};
+
+const double kAlpha0 = 2.124853710495224e-16;
+
+/// Solves the dense n x n row-major system m x = b in place by Gaussian
+/// elimination with partial pivoting, leaving x in b.
+void SolveDense(std::vector<Complex>* m, std::vector<Complex>* b, int n) {
+  std::vector<Complex>& a = *m;
+  std::vector<Complex>& x = *b;
+  for (int c = 0; c < n; ++c) {
+    int piv = c;
+    for (int r = c + 1; r < n; ++r) {
+      if (std::abs(a[r * n + c]) > std::abs(a[piv * n + c])) {
+        piv = r;
+      }
+    }
+    if (piv != c) {
+      for (int k = 0; k < n; ++k) {
+        std::swap(a[c * n + k], a[piv * n + k]);
+      }
+      std::swap(x[c], x[piv]);
+    }
+    for (int r = c + 1; r < n; ++r) {
+      Complex f = a[r * n + c] / a[c * n + c];
+      for (int k = c; k < n; ++k) {
+        a[r * n + k] -= f * a[c * n + k];
+      }
+      x[r] -= f * x[c];
+    }
+  }
+  for (int c = n - 1; c >= 0; --c) {
+    for (int k = c + 1; k < n; ++k) {
+      x[c] -= a[c * n + k] * x[k];
+    }
+    x[c] /= a[c * n + c];
+  }
+}
+
+}  // namespace
+
+DecayEngine& DecayEngine::Instance() {
+  static DecayEngine eng;
+  return eng;
+}
+
+DecayEngine::DecayEngine() : reg_(NucRegistry::Instance()), nused_(0) {
+  Build();
+}
+
+void DecayEngine::Build() {
+  int n = reg_.size();
+
+  // sparse parent lists, i.e. the off-diagonal entries of the decay matrix
+  // stored by row
+  pstart_.assign(n + 1, 0);
+  for (int i = 0; i < n; ++i) {
+    for (int j = 0; j < reg_.n_daughters(i); ++j) {
+      int d = reg_.daughter(i, j);
+      if (d != i) {
+        ++pstart_[d + 1];
+      }
+    }
+  }
+  for (int i = 0; i < n; ++i) {
+    pstart_[i + 1] += pstart_[i];
+  }
+  parents_.resize(pstart_[n]);
+  coeffs_.resize(pstart_[n]);
+  std::vector<int> fill(pstart_.begin(), pstart_.end() - 1);
+  for (int i = 0; i < n; ++i) {
+    for (int j = 0; j < reg_.n_daughters(i); ++j) {
+      int d = reg_.daughter(i, j);
+      if (d != i) {
+        parents_[fill[d]] = i;
+        coeffs_[fill[d]] = reg_.branch_ratio(i, j) * reg_.decay_const(i);
+        ++fill[d];
+      }
+    }
+  }
+
+  // Tarjan's strongly connected components, without recursion because decay
+  // chains can be long. Components are found daughters first.
+  std::vector<int> index(n, -1);
+  std::vector<int> low(n, 0);
+  std::vector<bool> onstack(n, false);
+  std::vector<int> stack;
+  std::vector<std::pair<int, int> > calls;
+  std::vector<std::vector<int> > comps;
+  int next = 0;
+  for (int s = 0; s < n; ++s) {
+    if (index[s] >= 0) {
+      continue;
+    }
+    index[s] = low[s] = next++;
+    stack.push_back(s);
+    onstack[s] = true;
+    calls.push_back(std::make_pair(s, 0));
+    while (!calls.empty()) {
+      int v = calls.back().first;
+      int& k = calls.back().second;
+      if (k < reg_.n_daughters(v)) {
+        int w = reg_.daughter(v, k++);
+        if (index[w] < 0) {
+          index[w] = low[w] = next++;
+          stack.push_back(w);
+          onstack[w] = true;
+          calls.push_back(std::make_pair(w, 0));
+        } else if (onstack[w]) {
+          low[v] = std::min(low[v], index[w]);
+        }
+        continue;
+      }
+
+      if (low[v] == index[v]) {
+        comps.push_back(std::vector<int>());
+        int w;
+        do {
+          w = stack.back();
+          stack.pop_back();
+          onstack[w] = false;
+          comps.back().push_back(w);
+        } while (w != v);
+      }
+      calls.pop_back();
+      if (!calls.empty()) {
+        int u = calls.back().first;
+        low[u] = std::min(low[u], low[v]);
+      }
+    }
+  }
+
+  // reversing the components puts every parent before its daughters
+  pos_.resize(n);
+  block_.resize(n);
+  int p = 0;
+  for (int b = 0; b < comps.size(); ++b) {
+    const std::vector<int>& comp = comps[comps.size() - 1 - b];
+    for (int k = 0; k < comp.size(); ++k) {
+      pos_[comp[k]] = p++;
+      block_[comp[k]] = b;
+    }
+  }
+}
+
+CompVec DecayEngine::DecayVector(const CompVec& atoms, double secs) {
+  if (secs <= 0 || atoms.empty()) {
+    return atoms;
+  }
+
+  const std::vector<Nuc>& nucs = atoms.nucs();
+  const std::vector<double>& q = atoms.vals();
+  // ops keeps the columns alive if the duration is evicted meanwhile
+  std::vector<const OpColumn*> cols(nucs.size());
+  OpColumnsPtr ops;
+  {
+    std::lock_guard<std::mutex> lk(mu_);
+    ops = GetColumns(secs);
+    for (int k = 0; k < nucs.size(); ++k) {
+      cols[k] = &GetColumn(ops.get(), nucs[k], secs);
+    }
+  }
+
+  // accumulate the columns weighted by the initial quantities
+  std::vector<double> y(reg_.size(), 0);
+  std::vector<bool> seen(reg_.size(), false);
+  std::vector<int> touched;
+  std::vector<std::pair<Nuc, double> > out;
+  for (int k = 0; k < cols.size(); ++k) {
+    const std::vector<int>& idx = cols[k]->idx;
+    const std::vector<double>& a = cols[k]->vec.vals();
+    for (int e = 0; e < idx.size(); ++e) {
+      int j = idx[e];
+      if (j < 0) {
+        out.push_back(std::make_pair(nucs[k], q[k]));
+        continue;
+      }
+      if (!seen[j]) {
+        seen[j] = true;
+        touched.push_back(j);
+      }
+      y[j] += a[e] * q[k];
+    }
+  }
+  for (int k = 0; k < touched.size(); ++k) {
+    int j = touched[k];
+    if (y[j] > 0) {
+      out.push_back(std::make_pair(reg_.nuc(j), y[j]));
+    }
+  }
+
+  std::sort(out.begin(), out.end());
+  CompVec decayed;
+  decayed.reserve(out.size());
+  for (int k = 0; k < out.size(); ++k) {
+    decayed.Append(out[k].first, out[k].second);
+  }
+  return decayed;
+}
+
+CompVec DecayEngine::Column(Nuc nuc, double secs) {
+  std::lock_guard<std::mutex> lk(mu_);
+  return GetColumn(GetColumns(secs).get(), nuc, secs).vec;
+}
+
+int DecayEngine::n_cached() {
+  std::lock_guard<std::mutex> lk(mu_);
+  int n = 0;
+  std::map<double, Duration>::iterator it;
+  for (it = ops_.begin(); it != ops_.end(); ++it) {
+    n += it->second.cols->size();
+  }
+  return n;
+}
+
+void DecayEngine::ClearCache() {
+  std::lock_guard<std::mutex> lk(mu_);
+  ops_.clear();
+}
+
+DecayEngine::OpColumnsPtr DecayEngine::GetColumns(double secs) {
+  std::map<double, Duration>::iterator it = ops_.find(secs);
+  if (it == ops_.end()) {
+    if (ops_.size() >= kMaxDurations) {
+      std::map<double, Duration>::iterator lru = ops_.begin();
+      for (it = ops_.begin(); it != ops_.end(); ++it) {
+        if (it->second.used < lru->second.used) {
+          lru = it;
+        }
+      }
+      ops_.erase(lru);
+    }
+    it = ops_.insert(std::make_pair(secs, Duration())).first;
+    it->second.cols = OpColumnsPtr(new OpColumns());
+  }
+  it->second.used = nused_++;
+  return it->second.cols;
+}
+
+const DecayEngine::OpColumn& DecayEngine::GetColumn(OpColumns* cols, Nuc nuc,
+                                                    double secs) {
+  OpColumns::iterator it = cols->find(nuc);
+  if (it != cols->end()) {
+    return it->second;
+  }
+
+  OpColumn& col = (*cols)[nuc];
+  int i = reg_.Index(nuc);
+  if (i < 0) {
+    col.vec.Append(nuc, 1);
+    col.idx.push_back(-1);
+  } else {
+    Solve(i, secs, &col);
+  }
+  return col;
+}
+
+void DecayEngine::Solve(int i, double secs, OpColumn* col) const {
+  if (reg_.decay_const(i) == 0) {
+    col->vec.Append(reg_.nuc(i), 1);
+    col->idx.push_back(i);
+    return;
+  }
+
+  // the nuclides reachable from i, parents before daughters
+  int nreg = reg_.size();
+  std::vector<int> loc(nreg, -1);
+  std::vector<int> nodes(1, i);
+  loc[i] = 0;
+  for (int k = 0; k < nodes.size(); ++k) {
+    int v = nodes[k];
+    for (int j = 0; j < reg_.n_daughters(v); ++j) {
+      int d = reg_.daughter(v, j);
+      if (loc[d] < 0) {
+        loc[d] = nodes.size();
+        nodes.push_back(d);
+      }
+    }
+  }
+  std::vector<std::pair<int, int> > order(nodes.size());
+  for (int k = 0; k < nodes.size(); ++k) {
+    order[k] = std::make_pair(pos_[nodes[k]], nodes[k]);
+  }
+  std::sort(order.begin(), order.end());
+  int n = nodes.size();
+  for (int k = 0; k < n; ++k) {
+    nodes[k] = order[k].second;
+    loc[nodes[k]] = k;
+  }
+
+  std::vector<double> lt(n);
+  for (int k = 0; k < n; ++k) {
+    lt[k] = reg_.decay_const(nodes[k]) * secs;
+  }
+
+  // y = alpha0 * (n0 + sum 2 Re(alpha (A t - theta I)^-1 y))
+  std::vector<double> y(n, 0);
+  y[loc[i]] = 1;
+  std::vector<Complex> z(n);
+  std::vector<Complex> m;
+  std::vector<Complex> rhs;
+  for (int p = 0; p < kNumPoles; ++p) {
+    const Complex& theta = kTheta[p];
+    int k1;
+    for (int k0 = 0; k0 < n; k0 = k1) {
+      k1 = k0 + 1;
+      while (k1 < n && block_[nodes[k1]] == block_[nodes[k0]]) {
+        ++k1;
+      }
+
+      if (k1 - k0 == 1) {
+        int r = nodes[k0];
+        Complex s = y[k0];
+        for (int e = pstart_[r]; e < pstart_[r + 1]; ++e) {
+          int l = loc[parents_[e]];
+          if (l >= 0) {
+            s -= coeffs_[e] * secs * z[l];
+          }
+        }
+        z[k0] = s / (-lt[k0] - theta);
+        continue;
+      }
+
+      // a decay cycle: solve the diagonal block densely
+      int nb = k1 - k0;
+      m.assign(nb * nb, Complex(0));
+      rhs.assign(nb, Complex(0));
+      for (int a = 0; a < nb; ++a) {
+        int r = nodes[k0 + a];
+        m[a * nb + a] = -lt[k0 + a] - theta;
+        rhs[a] = y[k0 + a];
+        for (int e = pstart_[r]; e < pstart_[r + 1]; ++e) {
+          int l = loc[parents_[e]];
+          if (l >= k0 && l < k1) {
+            m[a * nb + l - k0] += coeffs_[e] * secs;
+          } else if (l >= 0) {
+            rhs[a] -= coeffs_[e] * secs * z[l];
+          }
+        }
+      }
+      SolveDense(&m, &rhs, nb);
+      std::copy(rhs.begin(), rhs.end(), z.begin() + k0);
+    }
+
+    for (int k = 0; k < n; ++k) {
+      y[k] += 2 * std::real(kAlpha[p] * z[k]);
+    }
+  }
+
+  std::vector<std::pair<Nuc, int> > out;
+  for (int k = 0; k < n; ++k) {
+    y[k] *= kAlpha0;
+    if (y[k] > 0) {
+      out.push_back(std::make_pair(reg_.nuc(nodes[k]), k));
+    }
+  }
+  std::sort(out.begin(), out.end());
+  col->vec.reserve(out.size());
+  col->idx.reserve(out.size());
+  for (int k = 0; k < out.size(); ++k) {
+    col->vec.Append(out[k].first, y[out[k].second]);
+    col->idx.push_back(nodes[out[k].second]);
+  }
+}
+
+}  // namespace cyclus
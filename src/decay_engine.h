@@ -0,0 +1,124 @@
+#ifndef CYCLUS_SRC_DECAY_ENGINE_H_
+#define CYCLUS_SRC_DECAY_ENGINE_H_
+
+#include <map>
+#include <mutex>
+#include <vector>
+#include <stdint.h>
+#include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
+
+#include "comp_vec.h"
+
+namespace cyclus {
+
+class NucRegistry;
+
+/// DecayEngine decays nuclide vectors with the Chebyshev rational
+/// approximation method (CRAM) of order 16, using the incomplete partial
+/// fraction form of Pusa (2016). The decay matrix is never stored densely: it
+/// is built once from the NucRegistry as sparse per-nuclide parent lists, with
+/// the nuclides ordered so that every parent comes before its daughters. Each
+/// of the eight shifted systems (A t - theta I) z = y of the approximation is
+/// then lower triangular and is solved by forward substitution over the
+/// nuclides that are actually reachable from the decaying parent. The rare
+/// decay cycles are ordered as blocks and solved densely.
+///
+/// Since decay is linear, the engine memoizes the decay operator per duration
+/// one column at a time: the decay of one unit of a parent nuclide is
+/// computed the first time it is needed for a given number of seconds and
+/// reused for every later vector decayed for the same time, e.g. every
+/// material decayed by n time steps of dt seconds. Only the operators of the
+/// kMaxDurations most recently used durations are kept, since a simulation
+/// mostly decays by a few multiples of its time step. Nuclides that are not
+/// in the registry do not decay.
+///
+/// The engine is safe to use from several threads.
+///
+/// @code
+/// DecayEngine& eng = DecayEngine::Instance();
+/// CompVec decayed = eng.DecayVector(c->atom_vec(), kDefaultTimeStepDur);
+/// @endcode
+class DecayEngine {
+ public:
+  /// the maximum number of durations whose operator columns are memoized
+  static const int kMaxDurations = 16;
+
+  /// Returns the engine, building it on first use. The nuclear data path
+  /// must be set (see Env::SetNucDataPath) before the first call.
+  static DecayEngine& Instance();
+
+  /// Returns atoms, an atom quantity vector, decayed for secs seconds.
+  CompVec DecayVector(const CompVec& atoms, double secs);
+
+  /// Returns the decay of one unit of nuc after secs seconds, i.e. the column
+  /// of the decay operator for nuc. The column is returned by value because
+  /// the memoized one is freed when its duration is evicted or the cache is
+  /// cleared, possibly by another thread.
+  CompVec Column(Nuc nuc, double secs);
+
+  /// Returns the number of memoized operator columns.
+  int n_cached();
+
+  /// Discards all memoized operator columns. Decays in progress keep the
+  /// columns they use until they are done.
+  void ClearCache();
+
+ private:
+  /// a memoized operator column with the registry indices of its nuclides
+  struct OpColumn {
+    CompVec vec;
+    std::vector<int> idx;
+  };
+
+  typedef boost::unordered_map<Nuc, OpColumn> OpColumns;
+  typedef boost::shared_ptr<OpColumns> OpColumnsPtr;
+
+  /// the memoized columns of one duration, stamped with their last use
+  struct Duration {
+    OpColumnsPtr cols;
+    uint64_t used;
+  };
+
+  DecayEngine();
+
+  /// Builds the sparse parent lists and the block-triangular nuclide order.
+  void Build();
+
+  /// Returns the memoized columns for secs, evicting the least recently used
+  /// duration if there are too many. mu_ must be held by the caller. Columns
+  /// that are added to the returned map later stay valid as long as the
+  /// caller holds on to it.
+  OpColumnsPtr GetColumns(double secs);
+
+  /// Returns the memoized column for nuc in cols, the columns for secs,
+  /// computing it if necessary. mu_ must be held by the caller.
+  const OpColumn& GetColumn(OpColumns* cols, Nuc nuc, double secs);
+
+  /// Computes the decay of one unit of the registry nuclide i for secs seconds.
+  void Solve(int i, double secs, OpColumn* col) const;
+
+  const NucRegistry& reg_;
+
+  /// the parents of nuclide i are parents_[pstart_[i]:pstart_[i + 1]] and
+  /// coeffs_ holds the matching production rates (branch ratio times the
+  /// parent's decay constant).
+  std::vector<int> pstart_;
+  std::vector<int> parents_;
+  std::vector<double> coeffs_;
+
+  /// position of each nuclide in the parents-before-daughters order
+  std::vector<int> pos_;
+
+  /// index of the strongly connected block holding each nuclide
+  std::vector<int> block_;
+
+  std::mutex mu_;
+  std::map<double, Duration> ops_;
+  /// the number of GetColumns calls, used to stamp durations
+  uint64_t nused_;
+};
+
+}  // namespace cyclus
+
+#endif  // CYCLUS_SRC_DECAY_ENGINE_H_
@@ -18,7 +18,7 @@ NucList Decayer::nuclides_tracked_ = NucList();
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 Decayer::Decayer(const CompMap& comp) {
   Warn<DEPRECATION_WARNING>(
-      "Decayer is deprecated in favor of pyne::decayers::decay");
+      "Decayer is deprecated in favor of DecayEngine");
 
   int nuc;
   int col;
@@ -61,8 +61,8 @@ void Decayer::AddNucToMaps(int nuc) {
     return;
 
   col = parent_.size() + 1;
-  parent_[nuc] = std::make_pair(col, pyne::decay_const(nuc));
   AddNucToList(nuc);
+  parent_[nuc] = std::make_pair(col, pyne::decay_const(nuc));
 
   i = 0;
   daughters = pyne::decay_children(nuc);
@@ -78,8 +78,7 @@ void Decayer::AddNucToMaps(int nuc) {
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 bool Decayer::IsNucTracked(int nuc) {
-  return (find(nuclides_tracked_.begin(), nuclides_tracked_.end(), nuc)
-          != nuclides_tracked_.end());
+  return parent_.count(nuc) > 0;
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
@@ -26,7 +26,7 @@ typedef std::map<int, std::vector<std::pair<int, double> > > DaughtersMap;
 
 typedef std::vector<int> NucList;
 
-/// Decayer is DEPRECATED.  Use pyne::decayers::decay.
+/// Decayer is DEPRECATED.  Use DecayEngine.
 class Decayer {
  public:
   Decayer(const CompMap& comp);
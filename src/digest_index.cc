@@ -0,0 +1,92 @@
+#include "digest_index.h"
+
+#include <algorithm>
+
+namespace cyclus {
+
+namespace {
+
+/// the number of filter bits set per digest
+const int kProbes = 4;
+
+/// the number of digests in each set of the cache
+const int kWays = 4;
+
+}  // namespace
+
+DigestIndex::DigestIndex(size_t nbits, size_t capacity) {
+  Resize(nbits, capacity);
+}
+
+DigestIndex::Status DigestIndex::Find(int tag, const Digest& d) {
+  Key k = {tag, d};
+  Key* set;
+  int i = Cached(k, &set);
+  if (i >= 0) {
+    std::rotate(set, set + i, set + i + 1);
+    return PRESENT;
+  }
+  return Filter(k, false) ? MAYBE : ABSENT;
+}
+
+void DigestIndex::Insert(int tag, const Digest& d) {
+  Key k = {tag, d};
+  Filter(k, true);
+  if (cache_.empty())
+    return;
+  Key* set;
+  int i = Cached(k, &set);
+  if (i < 0) {
+    // replace the least recently used digest
+    i = kWays - 1;
+    if (set[i].tag < 0)
+      ++ncached_;
+    set[i] = k;
+  }
+  std::rotate(set, set + i, set + i + 1);
+}
+
+void DigestIndex::Clear() {
+  std::fill(bits_.begin(), bits_.end(), 0);
+  Key empty = {-1, Digest()};
+  std::fill(cache_.begin(), cache_.end(), empty);
+  ncached_ = 0;
+}
+
+void DigestIndex::Resize(size_t nbits, size_t capacity) {
+  bits_.resize(std::max<size_t>((nbits + 63) / 64, 1));
+  cache_.resize((capacity + kWays - 1) / kWays * kWays);
+  Clear();
+}
+
+int DigestIndex::Cached(const Key& k, Key** set) {
+  if (cache_.empty())
+    return -1;
+  // the digest is already a uniformly distributed hash
+  size_t nsets = cache_.size() / kWays;
+  *set = &cache_[(k.d.val[0] ^ k.tag) % nsets * kWays];
+  for (int i = 0; i < kWays; ++i) {
+    if ((*set)[i] == k)
+      return i;
+  }
+  return -1;
+}
+
+bool DigestIndex::Filter(const Key& k, bool set) {
+  // double hashing on the digest's remaining words
+  uint64_t nbits = bits_.size() * 64;
+  uint64_t h1 = (static_cast<uint64_t>(k.d.val[2]) << 32 | k.d.val[3]) ^
+                (k.tag * 0x9e3779b97f4a7c15ULL);
+  uint64_t h2 = (static_cast<uint64_t>(k.d.val[4]) << 32 | k.d.val[1]) | 1;
+  bool all = true;
+  for (int i = 0; i < kProbes; ++i) {
+    uint64_t b = (h1 + i * h2) % nbits;
+    uint64_t mask = static_cast<uint64_t>(1) << (b % 64);
+    all = all && (bits_[b / 64] & mask);
+    if (set)
+      bits_[b / 64] |= mask;
+  }
+  return all;
+}
+
+}  // namespace cyclus
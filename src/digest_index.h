@@ -0,0 +1,86 @@
+#ifndef CYCLUS_SRC_DIGEST_INDEX_H_
+#define CYCLUS_SRC_DIGEST_INDEX_H_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "query_backend.h"
+
+namespace cyclus {
+
+/// A set of SHA1 digests, each tagged with a non-negative integer (e.g. the
+/// DbTypes of the value it digests), that uses a bounded amount of memory
+/// however many digests are inserted. It answers membership from a cache of
+/// recently used digests in front of a bloom filter over all the digests
+/// ever inserted. The cache is a fixed table of small sets of digests, each
+/// of which evicts its least recently used digest, so that it never
+/// allocates. The filter's size is fixed too, so its false positive rate
+/// grows with the number of digests, and a digest that misses the cache but
+/// passes the filter may or may not be in the set: the caller must resolve
+/// it from its own (e.g. on-disk) index.
+class DigestIndex {
+ public:
+  /// The result of a lookup.
+  enum Status {
+    ABSENT,   ///< the digest was never inserted
+    PRESENT,  ///< the digest was inserted
+    MAYBE,    ///< the digest may have been inserted
+  };
+
+  /// 1 MiB bloom filter, good for a 2% false positive rate at a million
+  /// digests.
+  static const size_t kDefaultBits = 1 << 23;
+  /// 1.5 MiB of cached digests.
+  static const size_t kDefaultCapacity = 1 << 16;
+
+  /// Creates an empty index with a bloom filter of nbits bits (rounded up to
+  /// a multiple of 64) that caches up to capacity digests (rounded up to a
+  /// multiple of 4).
+  DigestIndex(size_t nbits = kDefaultBits,
+              size_t capacity = kDefaultCapacity);
+
+  /// Looks up the digest d with tag tag, making it the most recently used
+  /// digest if it is cached.
+  Status Find(int tag, const Digest& d);
+
+  /// Adds the digest d with tag tag to the filter and the cache, evicting
+  /// the least recently used digest of its set in the cache if it is full.
+  void Insert(int tag, const Digest& d);
+
+  /// Removes all digests.
+  void Clear();
+
+  /// Removes all digests and resizes the filter and the cache.
+  void Resize(size_t nbits, size_t capacity);
+
+  /// Returns the number of cached digests.
+  inline size_t cached() const { return ncached_; }
+
+ private:
+  struct Key {
+    int tag;
+    Digest d;
+    inline bool operator==(const Key& rhs) const {
+      return tag == rhs.tag && d == rhs.d;
+    }
+  };
+
+  /// Returns the position of k in its set of the cache, from most to least
+  /// recently used, or -1 if it isn't cached. set is set to the set's first
+  /// entry.
+  int Cached(const Key& k, Key** set);
+
+  /// Sets (if set is true) or tests the filter bits of k, returning whether
+  /// they were all set.
+  bool Filter(const Key& k, bool set);
+
+  std::vector<uint64_t> bits_;
+  /// the sets of the cache back to back, with empty entries tagged -1
+  std::vector<Key> cache_;
+  size_t ncached_;
+};
+
+}  // namespace cyclus
+
+#endif  // CYCLUS_SRC_DIGEST_INDEX_H_
@@ -67,19 +67,25 @@ std::string AgentSpec::str() {
 
 std::map<std::string, DynamicModule*> DynamicModule::modules_;
 std::map<std::string, AgentCtor*> DynamicModule::man_ctors_;
+std::mutex DynamicModule::mu_;
 
 Agent* DynamicModule::Make(Context* ctx, AgentSpec spec) {
-  if (man_ctors_.count(spec.str()) > 0) {  // for testing
-    Agent* a = man_ctors_[spec.str()](ctx);
-    a->spec(spec.str());
-    return a;
-  } else if (modules_.count(spec.str()) == 0) {
-    DynamicModule* dyn = new DynamicModule(spec);
-    modules_[spec.str()] = dyn;
+  AgentCtor* ctor = NULL;
+  DynamicModule* dyn = NULL;
+  {
+    // simulations run concurrently (see Ensemble) share loaded modules
+    std::lock_guard<std::mutex> lk(mu_);
+    if (man_ctors_.count(spec.str()) > 0) {  // for testing
+      ctor = man_ctors_[spec.str()];
+    } else if (modules_.count(spec.str()) == 0) {
+      dyn = new DynamicModule(spec);
+      modules_[spec.str()] = dyn;
+    } else {
+      dyn = modules_[spec.str()];
+    }
   }
 
-  DynamicModule* dyn = modules_[spec.str()];
-  Agent* a = dyn->ConstructInstance(ctx);
+  Agent* a = ctor != NULL ? ctor(ctx) : dyn->ConstructInstance(ctx);
   a->spec(spec.str());
   return a;
 }
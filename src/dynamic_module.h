@@ -3,6 +3,7 @@
 
 #include <string>
 #include <map>
+#include <mutex>
 
 #include "error.h"
 
@@ -87,6 +88,9 @@ class DynamicModule {
   /// added to this map when loaded.
   static std::map<std::string, DynamicModule*> modules_;
 
+  /// guards modules_ and man_ctors_ in Make
+  static std::mutex mu_;
+
   /// for testing - see sim_init_tests
   friend class ::SimInitTest;
   /// for testing - see sim_init_tests
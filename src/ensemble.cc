@@ -0,0 +1,109 @@
+#include "ensemble.h"
+
+#include <sstream>
+#include <thread>
+
+#include <boost/filesystem.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include "column_back.h"
+#include "decay_engine.h"
+#include "env.h"
+#include "error.h"
+#include "hdf5_back.h"
+#include "infile_tree.h"
+#include "nuc_registry.h"
+#include "pyne.h"
+#include "recorder.h"
+#include "sim_init.h"
+#include "sqlite_back.h"
+#include "thread_pool.h"
+#include "xml_file_loader.h"
+#include "xml_flat_loader.h"
+#include "xml_parser.h"
+
+namespace fs = boost::filesystem;
+
+namespace cyclus {
+
+Ensemble::Ensemble(int nthreads) : nthreads_(nthreads) {
+  if (nthreads_ < 1) {
+    nthreads_ = std::thread::hardware_concurrency();
+  }
+}
+
+void Ensemble::Add(std::string infile, std::string outfile) {
+  cases_.push_back(EnsembleCase(infile, outfile));
+}
+
+int Ensemble::Run() {
+  // load the shared nuclear data up front: its lazy loads are not safe to
+  // race from several cases
+  if (pyne::NUC_DATA_PATH == "") {
+    Env::SetNucDataPath();
+  }
+  pyne::atomic_mass(922350000);
+  NucRegistry::Instance();
+  DecayEngine::Instance();
+
+  int nthreads = nthreads_;
+  hbool_t ts = false;
+  H5is_library_threadsafe(&ts);
+  for (int i = 0; i < cases_.size() && !ts; ++i) {
+    if (fs::path(cases_[i].outfile).extension().string() == ".h5") {
+      nthreads = 1;
+    }
+  }
+
+  ThreadPool pool(nthreads);
+  pool.ParallelFor(cases_.size(), [this](int i) { RunCase(&cases_[i]); });
+
+  int nfailed = 0;
+  for (int i = 0; i < cases_.size(); ++i) {
+    nfailed += cases_[i].error.empty() ? 0 : 1;
+  }
+  return nfailed;
+}
+
+void Ensemble::RunCase(EnsembleCase* c) {
+  try {
+    FullBackend* fback = NULL;
+    RecBackend::Deleter bdel;
+    Recorder rec;  // Must be after backend deleter because ~Rec does flushing
+
+    std::string ext = fs::path(c->outfile).extension().string();
+    if (ext == ".h5") {
+      fback = new Hdf5Back(c->outfile.c_str());
+    } else if (ext == ".col") {
+      fback = new ColumnBack(c->outfile);
+    } else {
+      fback = new SqliteBack(c->outfile);
+    }
+    rec.RegisterBackend(fback);
+    bdel.Add(fback);
+
+    std::stringstream input;
+    LoadStringstreamFromFile(input, c->infile);
+    XMLParser parser;
+    parser.Init(input);
+    InfileTree tree(parser);
+    bool flat = OptionalQuery<std::string>(&tree, "/simulation/schematype",
+                                           "") == "flat";
+    if (flat) {
+      XMLFlatLoader l(&rec, fback, Env::rng_schema(true), c->infile);
+      l.LoadSim();
+    } else {
+      XMLFileLoader l(&rec, fback, Env::rng_schema(false), c->infile);
+      l.LoadSim();
+    }
+
+    SimInit si;
+    si.Init(&rec, fback);
+    si.timer()->RunSim();
+    rec.Flush();
+  } catch (std::exception& e) {
+    c->error = e.what();
+  }
+}
+
+}  // namespace cyclus
@@ -0,0 +1,70 @@
+#ifndef CYCLUS_SRC_ENSEMBLE_H_
+#define CYCLUS_SRC_ENSEMBLE_H_
+
+#include <string>
+#include <vector>
+
+namespace cyclus {
+
+/// One simulation of an Ensemble.
+struct EnsembleCase {
+  EnsembleCase(std::string infile, std::string outfile)
+      : infile(infile), outfile(outfile) {}
+
+  /// path of the cyclus xml input file
+  std::string infile;
+  /// path of the output database; a ".h5" extension selects the hdf5
+  /// backend, anything else sqlite
+  std::string outfile;
+  /// the error message if the case failed, empty otherwise
+  std::string error;
+};
+
+/// @class Ensemble
+///
+/// @brief An Ensemble runs several independent simulations, e.g. the variants
+/// of a parameter sweep, concurrently on a thread pool within one process.
+/// Compared to running one cyclus process per case, the cases share the
+/// dynamically loaded archetype modules, the nuclear data and decay engine
+/// and the master schemas built for input validation, which are all loaded
+/// once.
+///
+/// Every simulation draws its agent, resource and composition ids from its
+/// own context (see IdCounters), as do the compositions it interns, so the
+/// output of each case is the same as that of a standalone run.
+///
+/// @code
+/// Ensemble e(4);
+/// e.Add("sweep-1.xml", "sweep-1.sqlite");
+/// e.Add("sweep-2.xml", "sweep-2.sqlite");
+/// int nfailed = e.Run();
+/// @endcode
+class Ensemble {
+ public:
+  /// @param nthreads the number of cases that run at the same time. Values
+  /// less than 1 select the number of hardware threads.
+  explicit Ensemble(int nthreads = 0);
+
+  /// Adds a case that runs the input file infile and writes its output to
+  /// outfile.
+  void Add(std::string infile, std::string outfile);
+
+  /// Runs all cases and returns the number that failed. The errors of failed
+  /// cases are available from cases(). Cases with hdf5 output run one at a
+  /// time unless the hdf5 library was built thread-safe.
+  int Run();
+
+  /// Returns the cases in the order they were added.
+  inline const std::vector<EnsembleCase>& cases() const { return cases_; }
+
+ private:
+  /// Loads, initializes and runs a single case.
+  static void RunCase(EnsembleCase* c);
+
+  int nthreads_;
+  std::vector<EnsembleCase> cases_;
+};
+
+}  // namespace cyclus
+
+#endif  // CYCLUS_SRC_ENSEMBLE_H_
@@ -17,6 +17,8 @@ bool warn_as_error = false;
 std::map<Warnings, unsigned int> warn_count = std::map<Warnings,
                                                        unsigned int>();
 
+std::mutex warn_mutex;
+
 std::map<Warnings, std::string> warn_prefixes() {
   std::map<Warnings, std::string> wp;
   wp[WARNING] = "Warning";
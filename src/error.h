@@ -4,6 +4,7 @@
 #include <exception>
 #include <iostream>
 #include <map>
+#include <mutex>
 #include <string>
 
 namespace cyclus {
@@ -96,6 +97,10 @@ extern bool warn_as_error;
 /// The number of warnings issues for each kind.
 extern std::map<Warnings, unsigned int> warn_count;
 
+/// Guards warn_count and the printing of warnings, which may be issued from
+/// several threads at once (e.g. by the cases of an Ensemble).
+extern std::mutex warn_mutex;
+
 /// Creates the warning prefixes mapping.
 std::map<Warnings, std::string> warn_prefixes();
 
@@ -124,6 +129,7 @@ void Warn(const std::string& msg) {
         throw Error(msg);
     }
   }
+  std::lock_guard<std::mutex> lock(warn_mutex);
   unsigned int cnt = warn_count[T]++;
   if (cnt < warn_limit) {
     std::cerr << warn_prefix[T] << ": " << msg << "\n";
@@ -107,16 +107,276 @@ void RequestGroup::AddExchangeNode(ExchangeNode::Ptr node) {
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-ExchangeGraph::ExchangeGraph() : next_arc_id_(0) { }
+void FlatExchangeGraph::Clear() {
+  nodes.clear();
+  node_qty.clear();
+  node_agent.clear();
+  node_excl.clear();
+  node_avg_pref.clear();
+  node_grp.clear();
+  node_arc_begin.clear();
+  node_arcs.clear();
+  groups.clear();
+  grp_request.clear();
+  grp_cap_begin.clear();
+  grp_caps.clear();
+  grp_node_begin.clear();
+  grp_nodes.clear();
+  arc_u.clear();
+  arc_v.clear();
+  arc_pref.clear();
+  arc_excl.clear();
+  arc_excl_val.clear();
+  arc_ucap_begin.clear();
+  arc_ucaps.clear();
+  arc_has_ucaps.clear();
+  arc_vcap_begin.clear();
+  arc_vcaps.clear();
+  arc_has_vcaps.clear();
+  node_index.clear();
+  grp_index.clear();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+int FlatExchangeGraph::NodeIndex(const ExchangeNode* n) const {
+  boost::unordered_map<const ExchangeNode*, int>::const_iterator it =
+      node_index.find(n);
+  return it == node_index.end() ? -1 : it->second;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+int FlatExchangeGraph::GroupIndex(const ExchangeNodeGroup* g) const {
+  boost::unordered_map<const ExchangeNodeGroup*, int>::const_iterator it =
+      grp_index.find(g);
+  return it == grp_index.end() ? -1 : it->second;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+/// adds a node to the flat graph if it is not already present
+/// @return the node's index
+int FlatAddNode(FlatExchangeGraph& f, ExchangeNode* n, int grp) {
+  int idx = f.NodeIndex(n);
+  if (idx >= 0)
+    return idx;
+
+  idx = f.nodes.size();
+  f.node_index[n] = idx;
+  f.nodes.push_back(n);
+  f.node_qty.push_back(n->qty);
+  f.node_agent.push_back(n->agent_id);
+  f.node_excl.push_back(n->exclusive);
+  f.node_grp.push_back(grp);
+
+  double sum = 0;
+  std::map<Arc, double>::const_iterator it;
+  for (it = n->prefs.begin(); it != n->prefs.end(); ++it) {
+    sum += it->second;
+  }
+  f.node_avg_pref.push_back(n->prefs.size() > 0 ? sum / n->prefs.size() : 0);
+  return idx;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void FlatAddGroup(FlatExchangeGraph& f, ExchangeNodeGroup* g,
+                  bool request) {
+  int gidx = f.groups.size();
+  f.grp_index[g] = gidx;
+  f.groups.push_back(g);
+  f.grp_request.push_back(request);
+
+  const std::vector<double>& caps = g->capacities();
+  f.grp_caps.insert(f.grp_caps.end(), caps.begin(), caps.end());
+  f.grp_cap_begin.push_back(f.grp_caps.size());
+
+  const std::vector<ExchangeNode::Ptr>& nodes = g->nodes();
+  for (int i = 0; i != nodes.size(); i++) {
+    f.grp_nodes.push_back(FlatAddNode(f, nodes[i].get(), gidx));
+  }
+  f.grp_node_begin.push_back(f.grp_nodes.size());
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+/// appends the unit capacities of node n for arc a to caps
+/// @return true if n has a unit capacity entry for a
+bool FlatAddUnitCaps(ExchangeNode* n, const Arc& a,
+                     std::vector<double>& caps) {
+  std::map<Arc, std::vector<double> >::const_iterator it =
+      n->unit_capacities.find(a);
+  if (it == n->unit_capacities.end())
+    return false;
+  caps.insert(caps.end(), it->second.begin(), it->second.end());
+  return true;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+ExchangeGraph::ExchangeGraph() : next_arc_id_(0), flat_dirty_(true) { }
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void ExchangeGraph::Flatten() {
+  FlatExchangeGraph& f = flat_;
+  f.Clear();
+
+  f.grp_cap_begin.push_back(0);
+  f.grp_node_begin.push_back(0);
+  for (int i = 0; i != request_groups_.size(); i++) {
+    FlatAddGroup(f, request_groups_[i].get(), true);
+  }
+  for (int i = 0; i != supply_groups_.size(); i++) {
+    FlatAddGroup(f, supply_groups_[i].get(), false);
+  }
+
+  int narcs = arcs_.size();
+  f.arc_u.reserve(narcs);
+  f.arc_v.reserve(narcs);
+  f.arc_pref.reserve(narcs);
+  f.arc_excl.reserve(narcs);
+  f.arc_excl_val.reserve(narcs);
+  f.arc_has_ucaps.reserve(narcs);
+  f.arc_has_vcaps.reserve(narcs);
+  f.arc_ucap_begin.reserve(narcs + 1);
+  f.arc_vcap_begin.reserve(narcs + 1);
+  f.arc_ucap_begin.push_back(0);
+  f.arc_vcap_begin.push_back(0);
+  for (int i = 0; i != narcs; i++) {
+    const Arc& a = arcs_[i];
+    ExchangeNode::Ptr u = a.unode();
+    ExchangeNode::Ptr v = a.vnode();
+    f.arc_u.push_back(FlatAddNode(f, u.get(), -1));
+    f.arc_v.push_back(FlatAddNode(f, v.get(), -1));
+
+    std::map<Arc, double>::const_iterator p_it = u->prefs.find(a);
+    f.arc_pref.push_back(p_it == u->prefs.end() ? 0 : p_it->second);
+    f.arc_excl.push_back(a.exclusive());
+    f.arc_excl_val.push_back(a.excl_val());
+
+    f.arc_has_ucaps.push_back(FlatAddUnitCaps(u.get(), a, f.arc_ucaps));
+    f.arc_ucap_begin.push_back(f.arc_ucaps.size());
+    f.arc_has_vcaps.push_back(FlatAddUnitCaps(v.get(), a, f.arc_vcaps));
+    f.arc_vcap_begin.push_back(f.arc_vcaps.size());
+  }
+
+  // build CSR adjacency, preserving arc insertion order for each node
+  int nnodes = f.nodes.size();
+  f.node_arc_begin.assign(nnodes + 1, 0);
+  for (int i = 0; i != narcs; i++) {
+    ++f.node_arc_begin[f.arc_u[i] + 1];
+    ++f.node_arc_begin[f.arc_v[i] + 1];
+  }
+  for (int i = 0; i != nnodes; i++) {
+    f.node_arc_begin[i + 1] += f.node_arc_begin[i];
+  }
+  std::vector<int> pos(f.node_arc_begin.begin(), f.node_arc_begin.end() - 1);
+  f.node_arcs.resize(2 * narcs);
+  for (int i = 0; i != narcs; i++) {
+    f.node_arcs[pos[f.arc_u[i]]++] = i;
+    f.node_arcs[pos[f.arc_v[i]]++] = i;
+  }
+
+  flat_dirty_ = false;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+const FlatExchangeGraph& ExchangeGraph::flat() {
+  if (flat_dirty_)
+    Flatten();
+  return flat_;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+/// @return the root of i's set in a disjoint-set forest, halving the path to
+/// it along the way
+int ComponentRoot(std::vector<int>& parent, int i) {
+  while (parent[i] != i) {
+    parent[i] = parent[parent[i]];
+    i = parent[i];
+  }
+  return i;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void ComponentUnion(std::vector<int>& parent, int i, int j) {
+  i = ComponentRoot(parent, i);
+  j = ComponentRoot(parent, j);
+  // the lower index becomes the root so that roots are stable
+  if (i < j) {
+    parent[j] = i;
+  } else if (j < i) {
+    parent[i] = j;
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+std::vector<ExchangeGraph::Ptr> ExchangeGraph::Components() {
+  const FlatExchangeGraph& f = flat();
+  int nnodes = f.n_nodes();
+  int narcs = f.n_arcs();
+  int nreq = request_groups_.size();
+
+  std::vector<int> parent(nnodes);
+  for (int i = 0; i != nnodes; i++) {
+    parent[i] = i;
+  }
+  for (int g = 0; g != f.n_groups(); g++) {
+    for (int k = f.grp_node_begin[g] + 1; k < f.grp_node_begin[g + 1]; k++) {
+      ComponentUnion(parent, f.grp_nodes[f.grp_node_begin[g]], f.grp_nodes[k]);
+    }
+  }
+  for (int a = 0; a != narcs; a++) {
+    ComponentUnion(parent, f.arc_u[a], f.arc_v[a]);
+  }
+
+  // node indices follow request group order, so labeling components by their
+  // lowest node index orders them by their first request group
+  std::vector<int> label(nnodes, -1);
+  std::vector<int> comp(nnodes);
+  int ncomps = 0;
+  for (int i = 0; i != nnodes; i++) {
+    int root = ComponentRoot(parent, i);
+    if (label[root] < 0)
+      label[root] = ncomps++;
+    comp[i] = label[root];
+  }
+
+  std::vector<ExchangeGraph::Ptr> graphs(ncomps);
+  for (int a = 0; a != narcs; a++) {
+    int c = comp[f.arc_u[a]];
+    if (graphs[c].get() == NULL)
+      graphs[c] = ExchangeGraph::Ptr(new ExchangeGraph());
+  }
+  for (int g = 0; g != f.n_groups(); g++) {
+    if (f.grp_node_begin[g] == f.grp_node_begin[g + 1])
+      continue;  // empty groups belong to no component
+    ExchangeGraph::Ptr& cg = graphs[comp[f.grp_nodes[f.grp_node_begin[g]]]];
+    if (cg.get() == NULL) {
+      continue;
+    } else if (g < nreq) {
+      cg->AddRequestGroup(request_groups_[g]);
+    } else {
+      cg->AddSupplyGroup(supply_groups_[g - nreq]);
+    }
+  }
+  for (int a = 0; a != narcs; a++) {
+    graphs[comp[f.arc_u[a]]]->AddArc(arcs_[a]);
+  }
+
+  std::vector<ExchangeGraph::Ptr> ret;
+  for (int c = 0; c != ncomps; c++) {
+    if (graphs[c].get() != NULL)
+      ret.push_back(graphs[c]);
+  }
+  return ret;
+}
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 void ExchangeGraph::AddRequestGroup(RequestGroup::Ptr prs) {
   request_groups_.push_back(prs);
+  flat_dirty_ = true;
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 void ExchangeGraph::AddSupplyGroup(ExchangeNodeGroup::Ptr pss) {
   supply_groups_.push_back(pss);
+  flat_dirty_ = true;
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
@@ -127,6 +387,7 @@ void ExchangeGraph::AddArc(const Arc& a) {
   arc_by_id_.insert(std::pair<int, Arc>(id, a));
   node_arc_map_[a.unode()].push_back(a);
   node_arc_map_[a.vnode()].push_back(a);
+  flat_dirty_ = true;
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
@@ -8,6 +8,7 @@
 #include <vector>
 
 #include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
 #include <boost/weak_ptr.hpp>
 
 namespace cyclus {
@@ -196,6 +197,86 @@ class RequestGroup : public ExchangeNodeGroup {
 
 typedef std::pair<Arc, double> Match;
 
+/// @class FlatExchangeGraph
+///
+/// @brief A FlatExchangeGraph is a compact, index-based form of an
+/// ExchangeGraph. Nodes, node groups, and arcs are identified by their
+/// position in contiguous arrays. The arcs incident on each node are stored in
+/// compressed sparse row (CSR) form, as are group capacities and the unit
+/// capacity coefficients of each arc. Solvers use this form in their inner
+/// loops to avoid map lookups and weak pointer locks; the ExchangeNode and Arc
+/// objects remain the public view of the same graph.
+///
+/// Node indices are assigned first to request group members, then to supply
+/// group members, and finally to any arc endpoints that belong to no group in
+/// the graph. Arc indices are equal to the arc ids of the ExchangeGraph.
+struct FlatExchangeGraph {
+  /// @brief clears all state
+  void Clear();
+
+  inline int n_nodes() const { return nodes.size(); }
+  inline int n_groups() const { return groups.size(); }
+  inline int n_arcs() const { return arc_u.size(); }
+
+  /// @return the index of a node, or -1 if it is not in the graph
+  int NodeIndex(const ExchangeNode* n) const;
+
+  /// @return the index of a node group, or -1 if it is not in the graph
+  int GroupIndex(const ExchangeNodeGroup* g) const;
+
+  /// @name node data, indexed by node index
+  /// @{
+  std::vector<ExchangeNode*> nodes;
+  std::vector<double> node_qty;
+  std::vector<int> node_agent;
+  std::vector<char> node_excl;
+  /// the average preference of a node's arcs (see AvgPref())
+  std::vector<double> node_avg_pref;
+  /// the group index of a node, -1 if it is not a member of any graph group
+  std::vector<int> node_grp;
+  /// the arcs of node i are node_arcs[node_arc_begin[i]:node_arc_begin[i + 1]]
+  std::vector<int> node_arc_begin;
+  std::vector<int> node_arcs;
+  /// @}
+
+  /// @name group data, indexed by group index
+  /// @{
+  std::vector<ExchangeNodeGroup*> groups;
+  std::vector<char> grp_request;
+  /// the capacities of group i are
+  /// grp_caps[grp_cap_begin[i]:grp_cap_begin[i + 1]]
+  std::vector<int> grp_cap_begin;
+  std::vector<double> grp_caps;
+  /// the nodes of group i are
+  /// grp_nodes[grp_node_begin[i]:grp_node_begin[i + 1]]
+  std::vector<int> grp_node_begin;
+  std::vector<int> grp_nodes;
+  /// @}
+
+  /// @name arc data, indexed by arc id
+  /// @{
+  std::vector<int> arc_u;
+  std::vector<int> arc_v;
+  /// the request (u) node's preference for the arc
+  std::vector<double> arc_pref;
+  std::vector<char> arc_excl;
+  std::vector<double> arc_excl_val;
+  /// unit capacity coefficients of arc i for its unode are
+  /// arc_ucaps[arc_ucap_begin[i]:arc_ucap_begin[i + 1]], and arc_has_ucaps[i]
+  /// is true if the unode has any unit capacity entry for the arc
+  std::vector<int> arc_ucap_begin;
+  std::vector<double> arc_ucaps;
+  std::vector<char> arc_has_ucaps;
+  /// unit capacity coefficients of arc i for its vnode, as above
+  std::vector<int> arc_vcap_begin;
+  std::vector<double> arc_vcaps;
+  std::vector<char> arc_has_vcaps;
+  /// @}
+
+  boost::unordered_map<const ExchangeNode*, int> node_index;
+  boost::unordered_map<const ExchangeNodeGroup*, int> grp_index;
+};
+
 /// @class ExchangeGraph
 ///
 /// @brief An ExchangeGraph is a resource-neutral representation of a
@@ -210,6 +291,28 @@ class ExchangeGraph {
 
   ExchangeGraph();
 
+  /// @brief (re)builds the flat representation of this graph from its current
+  /// groups, nodes, and arcs. ExchangeTranslator calls this once translation
+  /// is complete; it must be called again if node or arc state is modified
+  /// directly after the flat form has been built.
+  void Flatten();
+
+  /// @brief the flat representation of this graph, which is built on demand
+  /// if groups or arcs have been added since it was last built
+  const FlatExchangeGraph& flat();
+
+  /// @brief splits the graph into its connected components. Two nodes are
+  /// connected if an arc joins them or if they are members of the same node
+  /// group, because group capacities couple all of a group's nodes. The
+  /// components share this graph's groups, nodes, and arcs, so matches found
+  /// on a component refer to arcs of this graph.
+  ///
+  /// Components are ordered by their first request group (or, lacking one,
+  /// their first supply group), and groups and arcs within a component keep
+  /// their relative order in this graph. Components without arcs admit no
+  /// matches and are omitted.
+  std::vector<ExchangeGraph::Ptr> Components();
+
   /// @brief adds a request group to the graph
   void AddRequestGroup(RequestGroup::Ptr prs);
 
@@ -270,6 +373,8 @@ class ExchangeGraph {
   std::map<Arc, int> arc_ids_;
   std::map<int, Arc> arc_by_id_;
   int next_arc_id_;
+  FlatExchangeGraph flat_;
+  bool flat_dirty_;
 };
 
 }  // namespace cyclus
@@ -7,6 +7,7 @@
 #include "exchange_solver.h"
 #include "exchange_translator.h"
 #include "resource_exchange.h"
+#include "timings.h"
 #include "trade_executor.h"
 #include "trader_management.h"
 #include "env.h"
@@ -24,6 +25,16 @@ namespace cyclus {
 /// ExchangeManager<ResourceType> manager(ctx);
 /// manager.Execute();
 /// @endcode
+///
+/// If the context's solver can be cloned (see ExchangeSolver::Clone), the
+/// exchange graph is decomposed into its connected components (e.g.,
+/// independent commodity markets), each of which is solved by its own clone
+/// of the solver, concurrently if the context has a thread pool. Components
+/// are decomposed and their matches merged back into the full graph in
+/// component order however many threads there are, so the trades executed
+/// do not depend on the number of threads. Note that this can order the
+/// matches of solvers such as the GreedySolver differently than solving the
+/// whole graph at once would.
 template <class T>
 class ExchangeManager {
  public:
@@ -34,10 +45,21 @@ class ExchangeManager {
   /// @brief execute the full resource sequence
   void Execute() {
     // collect resource exchange information
+    Timings* timings = ctx_->timings();
+    const char* rtype = T::kType.c_str();
     ResourceExchange<T> exchng(ctx_);
-    exchng.AddAllRequests();
-    exchng.AddAllBids();
-    exchng.AdjustAll();
+    {
+      PhaseTimer pt(timings, "Requests", rtype);
+      exchng.AddAllRequests();
+    }
+    {
+      PhaseTimer pt(timings, "Bids", rtype);
+      exchng.AddAllBids();
+    }
+    {
+      PhaseTimer pt(timings, "Adjust", rtype);
+      exchng.AdjustAll();
+    }
     CLOG(LEV_DEBUG1) << "done with info gathering";
     
     if (debug_)
@@ -49,25 +71,83 @@ class ExchangeManager {
     // translate graph
     ExchangeTranslator<T> xlator(&exchng.ex_ctx());
     CLOG(LEV_DEBUG1) << "translating graph...";
-    ExchangeGraph::Ptr graph = xlator.Translate();
+    ExchangeGraph::Ptr graph;
+    {
+      PhaseTimer pt(timings, "Translate", rtype);
+      graph = xlator.Translate();
+    }
     CLOG(LEV_DEBUG1) << "graph translated!";
 
     // solve graph
     CLOG(LEV_DEBUG1) << "solving graph...";
-    ctx_->solver()->Solve(graph.get());
+    {
+      PhaseTimer pt(timings, "Solve", rtype);
+      Solve(graph.get());
+    }
     CLOG(LEV_DEBUG1) << "graph solved!";
 
     // get trades
     std::vector< Trade<T> > trades;
-    xlator.BackTranslateSolution(graph->matches(), trades);
+    {
+      PhaseTimer pt(timings, "BackTranslate", rtype);
+      xlator.BackTranslateSolution(graph->matches(), trades);
+    }
     CLOG(LEV_DEBUG1) << "trades translated!";
 
     // execute trades!
+    PhaseTimer pt(timings, "Trades", rtype);
     TradeExecutor<T> exec(trades);
     exec.ExecuteTrades(ctx_);
   }
 
  private:
+  /// @brief solves the graph, one connected component at a time if the
+  /// solver supports it, concurrently if the context has a thread pool
+  void Solve(ExchangeGraph* graph) {
+    ExchangeSolver* solver = ctx_->solver();
+    solver->res_type(T::kType);
+    ExchangeSolver* proto = solver->Clone();
+    std::vector<ExchangeGraph::Ptr> comps;
+    if (proto != NULL)
+      comps = graph->Components();
+    if (comps.size() <= 1) {
+      delete proto;
+      solver->Solve(graph);
+      return;
+    }
+
+    CLOG(LEV_DEBUG1) << "solving " << comps.size()
+                     << " independent graph components...";
+    // solvers hold per-solve state, so each component gets its own
+    std::vector<ExchangeSolver*> solvers(comps.size(), NULL);
+    solvers[0] = proto;
+    try {
+      for (int i = 1; i != comps.size(); i++) {
+        solvers[i] = proto->Clone();
+      }
+      // solvers may record data (e.g. the ProgSolver's warm starts), which
+      // is passed on in component order
+      ctx_->ParallelPhase(comps.size(), [&](int i) {
+        solvers[i]->Solve(comps[i].get());
+      });
+    } catch (...) {
+      for (int i = 0; i != solvers.size(); i++) {
+        delete solvers[i];
+      }
+      throw;
+    }
+    for (int i = 0; i != solvers.size(); i++) {
+      delete solvers[i];
+    }
+
+    for (int i = 0; i != comps.size(); i++) {
+      const std::vector<Match>& matches = comps[i]->matches();
+      for (int j = 0; j != matches.size(); j++) {
+        graph->AddMatch(matches[j].first, matches[j].second);
+      }
+    }
+  }
+
   void RecordDebugInfo(ExchangeContext<T>& exctx) {
     typename std::vector<typename RequestPortfolio<T>::Ptr>::iterator it;
     for (it = exctx.requests.begin(); it != exctx.requests.end(); ++it) {
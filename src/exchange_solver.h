@@ -2,6 +2,7 @@
 #define CYCLUS_SRC_EXCHANGE_SOLVER_H_
 
 #include <cstddef>
+#include <string>
 
 namespace cyclus {
 
@@ -26,12 +27,28 @@ class ExchangeSolver {
       verbose_(false) {}
   virtual ~ExchangeSolver() {}
 
+  /// @brief creates a new solver with the same configuration as this one,
+  /// which the caller owns. Solvers that can be cloned are assumed to solve
+  /// each connected component of a graph independently of the others, which
+  /// allows an ExchangeManager to decompose a graph and to solve its
+  /// components concurrently, each with its own clone. The default returns
+  /// NULL, in which case graphs are always solved whole by this solver.
+  virtual ExchangeSolver* Clone() const { return NULL; }
+
   /// simulation context get/set
   /// @{
   inline void sim_ctx(Context* c) { sim_ctx_ = c; }
   inline Context* sim_ctx() { return sim_ctx_; } 
   /// @}
   
+  /// @brief the resource type of the exchanges being solved. Solvers that
+  /// keep state between solves keep it separately for each resource type, so
+  /// that the exchanges of one type do not disturb those of another.
+  /// @{
+  inline void res_type(const std::string& t) { res_type_ = t; }
+  inline const std::string& res_type() const { return res_type_; }
+  /// @}
+
   /// tell the solver to be verbose
   inline void verbose() { verbose_ = true; }
   inline void graph(ExchangeGraph* graph) { graph_ = graph; }
@@ -69,6 +86,7 @@ class ExchangeSolver {
   bool exclusive_orders_;
   bool verbose_;
   Context* sim_ctx_;
+  std::string res_type_;
 };
 
 }  // namespace cyclus
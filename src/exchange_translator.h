@@ -73,6 +73,10 @@ class ExchangeTranslator {
       }
     }
 
+    // build the compact form used by solvers in one pass over the finished
+    // graph, whose nodes, arcs and maps back translation still needs
+    graph->Flatten();
+
     return graph;
   }
 
@@ -44,6 +44,7 @@ GreedyPreconditioner::GreedyPreconditioner(
 
 void GreedyPreconditioner::Condition(ExchangeGraph* graph) {
   avg_prefs_.clear();
+  group_weights_.clear();
 
   std::vector<RequestGroup::Ptr>& groups =
       const_cast<std::vector<RequestGroup::Ptr>&>(graph->request_groups());
@@ -15,20 +15,63 @@ void Capacity(cyclus::Arc const&, double, double) {};
 void Capacity(boost::shared_ptr<cyclus::ExchangeNode>, cyclus::Arc const&,
               double) {};
 
+/// @brief A comparison function for sorting flat node indices in the same
+/// order as AvgPrefComp sorts nodes
+struct FlatAvgPrefComp {
+  explicit FlatAvgPrefComp(const FlatExchangeGraph& f) : f(f) {}
+  bool operator()(int l, int r) const {
+    double lpref = f.node_avg_pref[l];
+    double rpref = f.node_avg_pref[r];
+    return (lpref != rpref) ? (lpref > rpref) :
+        (f.node_agent[l] > f.node_agent[r]);
+  }
+  const FlatExchangeGraph& f;
+};
+
+/// @brief A comparison function for sorting flat arc ids in the same order as
+/// ReqPrefComp sorts arcs
+struct FlatReqPrefComp {
+  explicit FlatReqPrefComp(const FlatExchangeGraph& f) : f(f) {}
+  bool operator()(int l, int r) const {
+    int lu = f.node_agent[f.arc_u[l]];
+    int lv = f.node_agent[f.arc_v[l]];
+    int ru = f.node_agent[f.arc_u[r]];
+    int rv = f.node_agent[f.arc_v[r]];
+    double lpref = f.arc_pref[l];
+    double rpref = f.arc_pref[r];
+    return (lpref != rpref) ? (lpref > rpref) :
+        (lu > ru || (lu == ru && lv > rv));
+  }
+  const FlatExchangeGraph& f;
+};
+
+/// @brief Orders positions in a request group by the average preference of
+/// the nodes at those positions
+struct GroupPosComp {
+  GroupPosComp(const std::vector<int>& idx, const FlatExchangeGraph& f)
+      : idx(idx), comp(f) {}
+  bool operator()(int l, int r) const { return comp(idx[l], idx[r]); }
+  const std::vector<int>& idx;
+  FlatAvgPrefComp comp;
+};
+
 GreedySolver::GreedySolver(bool exclusive_orders, GreedyPreconditioner* c)
-    : conditioner_(c),
-      ExchangeSolver(exclusive_orders) {}
+    : ExchangeSolver(exclusive_orders),
+      conditioner_(c),
+      flat_(NULL) {}
 
 GreedySolver::GreedySolver(bool exclusive_orders)
-    : ExchangeSolver(exclusive_orders) {
+    : ExchangeSolver(exclusive_orders),
+      flat_(NULL) {
   conditioner_ = new cyclus::GreedyPreconditioner();  
 }
 
 GreedySolver::GreedySolver(GreedyPreconditioner* c)
-    : conditioner_(c),
-      ExchangeSolver(true) {}
+    : ExchangeSolver(true),
+      conditioner_(c),
+      flat_(NULL) {}
 
-GreedySolver::GreedySolver() : ExchangeSolver(true) {
+GreedySolver::GreedySolver() : ExchangeSolver(true), flat_(NULL) {
   conditioner_ = new cyclus::GreedyPreconditioner();  
 }
 
@@ -37,23 +80,26 @@ GreedySolver::~GreedySolver() {
     delete conditioner_;
 }
 
+ExchangeSolver* GreedySolver::Clone() const {
+  GreedyPreconditioner* c = NULL;
+  if (conditioner_ != NULL)
+    c = new GreedyPreconditioner(*conditioner_);
+  GreedySolver* s = new GreedySolver(exclusive_orders_, c);
+  s->sim_ctx(sim_ctx_);
+  if (verbose_)
+    s->verbose();
+  return s;
+}
+
 void GreedySolver::Condition() {
   if (conditioner_ != NULL)
     conditioner_->Condition(graph_);
 }
 
 void GreedySolver::Init() {
- std::for_each(graph_->request_groups().begin(),
-                graph_->request_groups().end(),
-                std::bind1st(
-                    std::mem_fun(&GreedySolver::GetCaps),
-                    this));
-
-  std::for_each(graph_->supply_groups().begin(),
-                graph_->supply_groups().end(),
-                std::bind1st(
-                    std::mem_fun(&GreedySolver::GetCaps),
-                    this));
+  flat_ = &graph_->flat();
+  n_qty_.assign(flat_->n_nodes(), 0);
+  grp_caps_ = flat_->grp_caps;
 }
 
 double GreedySolver::SolveGraph() {
@@ -61,7 +107,6 @@ double GreedySolver::SolveGraph() {
   Condition();
   obj_ = 0;
   unmatched_ = 0;
-  n_qty_.clear();
   
   Init();
  
@@ -95,18 +140,36 @@ double GreedySolver::Capacity(ExchangeNode::Ptr n, const Arc& a, bool min_cap,
     throw cyclus::StateError("An notion of node capacity requires a nodegroup.");
   }
 
-  if (n->unit_capacities[a].size() == 0) {
+  std::map<Arc, std::vector<double> >::iterator it =
+      n->unit_capacities.find(a);
+  if (it == n->unit_capacities.end() || it->second.size() == 0) {
     return n->qty - curr_qty;
   }
 
-  std::vector<double>& unit_caps = n->unit_capacities[a];
-  const std::vector<double>& group_caps = grp_caps_[n->group];
-  std::vector<double> caps;
+  // outside of a solve of the node's graph, e.g. before the first one, the
+  // group's own capacities are used
+  int grp = flat_ != NULL ? flat_->GroupIndex(n->group) : -1;
+  const double* group_caps = grp >= 0 ?
+      grp_caps_.data() + flat_->grp_cap_begin[grp] :
+      &n->group->capacities()[0];
+  const std::vector<double>& unit_caps = it->second;
+  return NodeCapacity(n->qty, group_caps, &unit_caps[0], unit_caps.size(),
+                      min_cap, curr_qty);
+}
+
+double GreedySolver::NodeCapacity(double qty, const double* group_caps,
+                                  const double* ucaps, int n_ucaps,
+                                  bool min_cap, double curr_qty) {
+  if (n_ucaps == 0) {
+    return qty - curr_qty;
+  }
+
   double grp_cap, u_cap, cap;
+  double ret = 0;
 
-  for (int i = 0; i < unit_caps.size(); i++) {
+  for (int i = 0; i < n_ucaps; i++) {
     grp_cap = group_caps[i];
-    u_cap = unit_caps[i];
+    u_cap = ucaps[i];
     cap = grp_cap / u_cap;
     CLOG(cyclus::LEV_DEBUG1) << "Capacity for node: ";
     CLOG(cyclus::LEV_DEBUG1) << "   group capacity: " << grp_cap;
@@ -115,82 +178,116 @@ double GreedySolver::Capacity(ExchangeNode::Ptr n, const Arc& a, bool min_cap,
 
     // special case for unlimited capacities
     if (grp_cap == std::numeric_limits<double>::max()) {
-      caps.push_back(std::numeric_limits<double>::max());
-    } else {
-      caps.push_back(cap);
+      cap = std::numeric_limits<double>::max();
     }
-  }
 
-  if (min_cap) {  // the smallest value is constraining (for bids)
-    cap = *std::min_element(caps.begin(), caps.end());
-  } else {  // the largest value must be met (for requests)
-    cap = *std::max_element(caps.begin(), caps.end());
+    // the smallest value is constraining for bids, and the largest value must
+    // be met for requests
+    if (i == 0 || (min_cap && cap < ret) || (!min_cap && cap > ret)) {
+      ret = cap;
+    }
   }
-  return std::min(cap, n->qty - curr_qty);
+  return std::min(ret, qty - curr_qty);
 }
 
-void GreedySolver::GetCaps(ExchangeNodeGroup::Ptr g) {
-  for (int i = 0; i != g->nodes().size(); i++) {
-    n_qty_[g->nodes()[i]] = 0;
+double GreedySolver::ArcCapacity(int a, double u_curr_qty, double v_curr_qty) {
+  const FlatExchangeGraph& f = *flat_;
+  int u = f.arc_u[a];
+  int v = f.arc_v[a];
+  if (f.node_grp[u] < 0 || f.node_grp[v] < 0) {
+    throw cyclus::StateError(
+        "An notion of node capacity requires a nodegroup.");
   }
-  grp_caps_[g.get()] = g->capacities();
+
+  bool min = true;
+  int ubeg = f.arc_ucap_begin[a];
+  int vbeg = f.arc_vcap_begin[a];
+  const double* caps = grp_caps_.data();
+  double ucap = NodeCapacity(f.node_qty[u],
+                             caps + f.grp_cap_begin[f.node_grp[u]],
+                             f.arc_ucaps.data() + ubeg,
+                             f.arc_ucap_begin[a + 1] - ubeg, !min, u_curr_qty);
+  double vcap = NodeCapacity(f.node_qty[v],
+                             caps + f.grp_cap_begin[f.node_grp[v]],
+                             f.arc_vcaps.data() + vbeg,
+                             f.arc_vcap_begin[a + 1] - vbeg, min, v_curr_qty);
+
+  CLOG(cyclus::LEV_DEBUG1) << "Capacity for unode of arc: " << ucap;
+  CLOG(cyclus::LEV_DEBUG1) << "Capacity for vnode of arc: " << vcap;
+  CLOG(cyclus::LEV_DEBUG1) << "Capacity for arc         : "
+                           << std::min(ucap, vcap);
+
+  return std::min(ucap, vcap);
 }
 
 void GreedySolver::GreedilySatisfySet(RequestGroup::Ptr prs) {
+  const FlatExchangeGraph& f = *flat_;
+
+  // sort the group's nodes by preference, keeping the object view in the same
+  // order as the one used for solving
   std::vector<ExchangeNode::Ptr>& nodes = prs->nodes();
-  std::stable_sort(nodes.begin(), nodes.end(), AvgPrefComp);
+  std::vector<int> idx(nodes.size());
+  std::vector<int> order(nodes.size());
+  for (int i = 0; i != nodes.size(); i++) {
+    idx[i] = f.NodeIndex(nodes[i].get());
+    order[i] = i;
+  }
+  std::stable_sort(order.begin(), order.end(), GroupPosComp(idx, f));
+  std::vector<ExchangeNode::Ptr> unsorted(nodes);
+  for (int i = 0; i != order.size(); i++) {
+    nodes[i] = unsorted[order[i]];
+  }
 
-  std::vector<ExchangeNode::Ptr>::iterator req_it = nodes.begin();
+  std::vector<int>::iterator req_it = order.begin();
   double target = prs->qty();
   double match = 0;
 
-  ExchangeNode::Ptr u, v;
-  std::vector<Arc>::const_iterator arc_it;
-  std::vector<Arc> sorted;
+  int u, v, a;
+  std::vector<int>::const_iterator arc_it;
+  std::vector<int> sorted;
   double remain, tomatch, excl_val;
 
   CLOG(LEV_DEBUG1) << "Greedy Solving for " << target
                    << " amount of a resource.";
 
-  while ((match <= target) && (req_it != nodes.end())) {
-    // this if statement is needed because map.at() will throw if the key does
-    // not exist, which is a corner case for when there is a request with no bid
-    // arcs associated with it
-    if (graph_->node_arc_map().count(*req_it) > 0) {
-      const std::vector<Arc>& arcs = graph_->node_arc_map().at(*req_it);
-      sorted = std::vector<Arc>(arcs);  // make a copy for now
-      std::stable_sort(sorted.begin(), sorted.end(), ReqPrefComp);
-      arc_it = sorted.begin();
-
-      while ((match <= target) && (arc_it != sorted.end())) {
-        remain = target - match;
-        const Arc& a = *arc_it;
-        u = a.unode();
-        v = a.vnode();
-        // capacity adjustment
-        tomatch = std::min(remain, Capacity(a, n_qty_[u], n_qty_[v]));
-
-        // exclusivity adjustment
-        if (arc_it->exclusive()) {
-          excl_val = a.excl_val();
-          tomatch = (tomatch < excl_val) ? 0 : excl_val;
-        }
-
-        if (tomatch > eps()) {
-          CLOG(LEV_DEBUG1) << "Greedy Solver is matching " << tomatch
-                           << " amount of a resource.";
-          UpdateCapacity(u, a, tomatch);
-          UpdateCapacity(v, a, tomatch);
-          n_qty_[u] += tomatch;
-          n_qty_[v] += tomatch;
-          graph_->AddMatch(a, tomatch);
-
-          match += tomatch;
-          UpdateObj(tomatch, u->prefs[a]);
-        }
-        ++arc_it;
-      }  // while( (match =< target) && (arc_it != arcs.end()) )
-    }  // if(graph_->node_arc_map().count(*req_it) > 0)
+  while ((match <= target) && (req_it != order.end())) {
+    u = idx[*req_it];
+    sorted.assign(f.node_arcs.begin() + f.node_arc_begin[u],
+                  f.node_arcs.begin() + f.node_arc_begin[u + 1]);
+    std::stable_sort(sorted.begin(), sorted.end(), FlatReqPrefComp(f));
+    arc_it = sorted.begin();
+
+    while ((match <= target) && (arc_it != sorted.end())) {
+      remain = target - match;
+      a = *arc_it;
+      v = f.arc_v[a];
+      // capacity adjustment
+      tomatch = std::min(remain, ArcCapacity(a, n_qty_[u], n_qty_[v]));
+
+      // exclusivity adjustment
+      if (f.arc_excl[a]) {
+        excl_val = f.arc_excl_val[a];
+        tomatch = (tomatch < excl_val) ? 0 : excl_val;
+      }
+
+      if (tomatch > eps()) {
+        CLOG(LEV_DEBUG1) << "Greedy Solver is matching " << tomatch
+                         << " amount of a resource.";
+        int ubeg = f.arc_ucap_begin[a];
+        int vbeg = f.arc_vcap_begin[a];
+        UpdateCapacity(u, f.arc_ucaps.data() + ubeg,
+                       f.arc_ucap_begin[a + 1] - ubeg, tomatch);
+        UpdateCapacity(v, f.arc_vcaps.data() + vbeg,
+                       f.arc_vcap_begin[a + 1] - vbeg, tomatch);
+        n_qty_[u] += tomatch;
+        n_qty_[v] += tomatch;
+        graph_->AddMatch(graph_->arcs()[a], tomatch);
+
+        match += tomatch;
+        UpdateObj(tomatch, f.arc_pref[a]);
+      }
+      ++arc_it;
+    }  // while( (match =< target) && (arc_it != arcs.end()) )
     ++req_it;
   }  // while( (match =< target) && (req_it != nodes.end()) )
 
@@ -203,29 +300,32 @@ void GreedySolver::UpdateObj(double qty, double pref) {
   obj_ += qty / pref;
 }
 
-void GreedySolver::UpdateCapacity(ExchangeNode::Ptr n, const Arc& a,
+void GreedySolver::UpdateCapacity(int n, const double* ucaps, int n_ucaps,
                                   double qty) {
   using cyclus::IsNegative;
   using cyclus::ValueError;
 
-  std::vector<double>& unit_caps = n->unit_capacities[a];
-  std::vector<double>& caps = grp_caps_[n->group];
-  assert(unit_caps.size() == caps.size());
-  for (int i = 0; i < caps.size(); i++) {
+  const FlatExchangeGraph& f = *flat_;
+  int grp = f.node_grp[n];
+  int beg = f.grp_cap_begin[grp];
+  int ncaps = f.grp_cap_begin[grp + 1] - beg;
+  double* caps = grp_caps_.data() + beg;
+  assert(n_ucaps == ncaps);
+  for (int i = 0; i < ncaps; i++) {
     double prev = caps[i];
     // special case for unlimited capacities
     CLOG(cyclus::LEV_DEBUG1) << "Updating capacity value from: "
                              << prev;
     caps[i] = (prev == std::numeric_limits<double>::max()) ?
               std::numeric_limits<double>::max() :
-              prev - qty * unit_caps[i];
+              prev - qty * ucaps[i];
     CLOG(cyclus::LEV_DEBUG1) << "                          to: "
                              << caps[i];
   }
 
-  if (IsNegative(n->qty - qty)) {
+  if (IsNegative(f.node_qty[n] - qty)) {
     std::stringstream ss;
-    ss << "A bid for " << n->commod << " was set at " << n->qty
+    ss << "A bid for " << f.nodes[n]->commod << " was set at " << f.node_qty[n]
        << " but has been matched to a higher value " << qty
        << ". This could be due to a problem with your "
        << "bid portfolio constraints.";
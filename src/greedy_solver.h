@@ -76,6 +76,10 @@ class GreedySolver: public ExchangeSolver {
   
   virtual ~GreedySolver();
 
+  /// @brief a new GreedySolver with the same exclusivity and a copy of this
+  /// solver's conditioner, if any
+  virtual ExchangeSolver* Clone() const;
+
   /// Uses the provided (or a default) GreedyPreconditioner to condition the
   /// solver's ExchangeGraph so that RequestGroups are ordered by average
   /// preference and commodity weight.
@@ -112,6 +116,8 @@ class GreedySolver: public ExchangeSolver {
   /// @param curr_qty the currently allocated node quantity (if solving piecemeal)
   /// @return The minimum of the node's nodegroup capacities / the node's unit
   /// capacities, or the ExchangeNode's remaining qty -- whichever is smaller.
+  /// During a solve of the node's graph, the nodegroup capacities are those
+  /// remaining in the solve; otherwise they are the nodegroup's own.
   /// @{
   double Capacity(ExchangeNode::Ptr n, const Arc& a, bool min_cap,
                   double curr_qty);
@@ -133,22 +139,40 @@ class GreedySolver: public ExchangeSolver {
   virtual double SolveGraph();
 
  private:
-  /// @brief updates the capacity of a given ExchangeNode (i.e., its max_qty and the
-  /// capacities of its ExchangeNodeGroup)
+  /// @brief the capacity of a node given its unit capacities along an arc
   ///
-  /// @throws StateError if ExchangeNode does not have a ExchangeNodeGroup
-  /// @throws ValueError if the update results in a negative ExchangeNodeGroup
-  /// capacity or a negative ExchangeNode max_qty
-  /// @param n the ExchangeNode
+  /// @param qty the node's maximum quantity
+  /// @param group_caps the remaining capacities of the node's group
+  /// @param ucaps the node's unit capacity coefficients for the arc
+  /// @param n_ucaps the number of unit capacity coefficients
+  /// @param min_cap whether to use the minimum or maximum capacity value
+  /// @param curr_qty the currently allocated node quantity
+  double NodeCapacity(double qty, const double* group_caps,
+                      const double* ucaps, int n_ucaps, bool min_cap,
+                      double curr_qty);
+
+  /// @brief the capacity of an arc in the flat graph, i.e., the minimum of
+  /// its unode and vnode capacities
+  /// @throws StateError if either node does not belong to a group
+  double ArcCapacity(int a, double u_curr_qty, double v_curr_qty);
+
+  /// @brief updates the capacity of a given node (i.e., the capacities of its
+  /// ExchangeNodeGroup)
+  ///
+  /// @throws ValueError if the update results in a negative ExchangeNode
+  /// max_qty
+  /// @param n the node index
+  /// @param ucaps the node's unit capacity coefficients for the matched arc
+  /// @param n_ucaps the number of unit capacity coefficients
   /// @param qty the quantity for the node to update
-  void GetCaps(ExchangeNodeGroup::Ptr prs);
+  void UpdateCapacity(int n, const double* ucaps, int n_ucaps, double qty);
   void GreedilySatisfySet(RequestGroup::Ptr prs);
-  void UpdateCapacity(ExchangeNode::Ptr n, const Arc& a, double qty);
   void UpdateObj(double qty, double pref);
-  
+
   GreedyPreconditioner* conditioner_;
-  std::map<ExchangeNode::Ptr, double> n_qty_;
-  std::map<ExchangeNodeGroup*, std::vector<double> > grp_caps_;
+  const FlatExchangeGraph* flat_;
+  std::vector<double> n_qty_;
+  std::vector<double> grp_caps_;
   double obj_;
   double unmatched_;
 };
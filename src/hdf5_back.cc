@@ -1,13 +1,28 @@
 #include "hdf5_back.h"
 
+#include <algorithm>
 #include <cmath>
 #include <string.h>
 
+#include <thread>
+
+#include <boost/scoped_ptr.hpp>
+
 #include "blob.h"
+#include "thread_pool.h"
 
 namespace cyclus {
 
-Hdf5Back::Hdf5Back(std::string path) : path_(path) {
+const hsize_t Hdf5Back::vlchunk_[CYCLUS_SHA1_NINT] = {1, 1, 1, 1, 1};
+
+/// the group holding the zone maps, which is not a table
+static const char* kZoneMaps = "ZoneMaps";
+
+Hdf5Back::Hdf5Back(std::string path)
+    : path_(path),
+      nthreads_(std::thread::hardware_concurrency()),
+      pool_(NULL),
+      n_vl_reads_(0) {
   H5open();
   hasher_.Clear();
   if (boost::filesystem::exists(path_))
@@ -17,7 +32,7 @@ Hdf5Back::Hdf5Back(std::string path) : path_(path) {
   opened_types_.clear();
   vldatasets_.clear();
   vldts_.clear();
-  vlkeys_.clear();
+  vlkeys_.Clear();
 
   uuid_type_ = H5Tcopy(H5T_C_S1);
   H5Tset_size(uuid_type_, CYCLUS_UUID_SIZE);
@@ -43,6 +58,7 @@ void Hdf5Back::Close() {
     return;
 
   // cleanup HDF5
+  ClearVLBatch();
   Flush();
   H5Fclose(file_);
   std::set<hid_t>::iterator t;
@@ -71,6 +87,34 @@ void Hdf5Back::Close() {
 Hdf5Back::~Hdf5Back() {
   if (!closed_)
     Close();
+  delete pool_;
+}
+
+void Hdf5Back::set_nthreads(int n) {
+  nthreads_ = std::max(n, 1);
+  delete pool_;
+  pool_ = NULL;
+}
+
+void Hdf5Back::set_vlindex_size(size_t nbits, size_t capacity) {
+  vlkeys_.Resize(nbits, capacity);
+  // VLDataset reads the keys in as it reopens the key arrays
+  std::map<std::string, hid_t>::iterator it = vldatasets_.begin();
+  while (it != vldatasets_.end()) {
+    const std::string& name = it->first;
+    if (name.size() > 4 && name.compare(name.size() - 4, 4, "Keys") == 0) {
+      H5Dclose(it->second);
+      vldatasets_.erase(it++);
+    } else {
+      ++it;
+    }
+  }
+}
+
+ThreadPool* Hdf5Back::pool() {
+  if (pool_ == NULL)
+    pool_ = new ThreadPool(nthreads_);
+  return pool_;
 }
 
 void Hdf5Back::Notify(DatumList data) {
@@ -79,7 +123,7 @@ void Hdf5Back::Notify(DatumList data) {
     std::string name = (*it)->title();
     if (schema_sizes_.count(name) == 0) {
       if (H5Lexists(file_, name.c_str(), H5P_DEFAULT)) {
-        LoadTableTypes(name, (*it)->vals().size());
+        LoadTableTypes(name, (*it)->nfields());
       } else {
         // Datum* d = *it;
         // CreateTable(d);
@@ -98,6 +142,13 @@ void Hdf5Back::Notify(DatumList data) {
 template <>
 std::string Hdf5Back::VLRead<std::string, VL_STRING>(const char* rawkey) {
   using std::string;
+  const char* batched = BatchedVL(VL_STRING, rawkey);
+  if (batched != NULL) {
+    const char* x = *reinterpret_cast<char* const*>(batched);
+    return x == NULL ? string() : string(x);
+  }
+  std::lock_guard<std::recursive_mutex> lock(h5_mu_);
+  ++n_vl_reads_;
   // key is used as offset
   Digest key;
   memcpy(key.val, rawkey, CYCLUS_SHA1_SIZE);
@@ -131,6 +182,13 @@ std::string Hdf5Back::VLRead<std::string, VL_STRING>(const char* rawkey) {
 
 template <>
 Blob Hdf5Back::VLRead<Blob, BLOB>(const char* rawkey) {
+  const char* batched = BatchedVL(BLOB, rawkey);
+  if (batched != NULL) {
+    const char* x = *reinterpret_cast<char* const*>(batched);
+    return x == NULL ? Blob() : Blob(x);
+  }
+  std::lock_guard<std::recursive_mutex> lock(h5_mu_);
+  ++n_vl_reads_;
   // key is used as offset
   Digest key;
   memcpy(key.val, rawkey, CYCLUS_SHA1_SIZE);
@@ -159,843 +217,1501 @@ Blob Hdf5Back::VLRead<Blob, BLOB>(const char* rawkey) {
   return val;
 }
 
+namespace {
+
+/// returns the fixed size scalar value x of type t and size n (for strings)
+boost::spirit::hold_any RawVal(const char* x, DbTypes t, size_t n) {
+  switch (t) {
+    case BOOL:
+      return boost::spirit::hold_any(*reinterpret_cast<const bool*>(x));
+    case INT:
+      return boost::spirit::hold_any(*reinterpret_cast<const int*>(x));
+    case FLOAT:
+      return boost::spirit::hold_any(*reinterpret_cast<const float*>(x));
+    case DOUBLE:
+      return boost::spirit::hold_any(*reinterpret_cast<const double*>(x));
+    case UUID: {
+      boost::uuids::uuid v;
+      memcpy(&v, x, 16);
+      return boost::spirit::hold_any(v);
+    }
+    default:
+      return boost::spirit::hold_any(std::string(x, strnlen(x, n)));
+  }
+}
+
+/// returns the numeric value x of type t
+double RawDouble(const char* x, DbTypes t) {
+  switch (t) {
+    case BOOL:
+      return *reinterpret_cast<const bool*>(x);
+    case INT:
+      return *reinterpret_cast<const int*>(x);
+    case FLOAT:
+      return *reinterpret_cast<const float*>(x);
+    default:
+      return *reinterpret_cast<const double*>(x);
+  }
+}
+
+/// checks conds against the fixed size scalar value x of type t and size n
+bool RawConds(const char* x, DbTypes t, size_t n, std::vector<Cond*>* conds) {
+  switch (t) {
+    case BOOL: {
+      bool v = *reinterpret_cast<const bool*>(x);
+      return CmpConds<bool>(&v, conds);
+    }
+    case INT: {
+      int v = *reinterpret_cast<const int*>(x);
+      return CmpConds<int>(&v, conds);
+    }
+    case FLOAT: {
+      float v = *reinterpret_cast<const float*>(x);
+      return CmpConds<float>(&v, conds);
+    }
+    case DOUBLE: {
+      double v = *reinterpret_cast<const double*>(x);
+      return CmpConds<double>(&v, conds);
+    }
+    case UUID: {
+      boost::uuids::uuid v;
+      memcpy(&v, x, 16);
+      return CmpConds<boost::uuids::uuid>(&v, conds);
+    }
+    default: {
+      std::string v(x, strnlen(x, n));
+      return CmpConds<std::string>(&v, conds);
+    }
+  }
+}
+
+/// returns whether the columns of type t hold the keys of variable length
+/// values
+bool IsVLKey(DbTypes t) {
+  switch (t) {
+    case VL_STRING:
+    case BLOB:
+    case VL_VECTOR_INT:
+    case VL_VECTOR_FLOAT:
+    case VL_VECTOR_DOUBLE:
+    case VL_VECTOR_STRING:
+    case VL_VECTOR_VL_STRING:
+    case VL_SET_INT:
+    case VL_SET_STRING:
+    case VL_SET_VL_STRING:
+    case VL_LIST_INT:
+    case VL_LIST_STRING:
+    case VL_LIST_VL_STRING:
+    case VL_MAP_INT_INT:
+    case VL_MAP_INT_DOUBLE:
+    case VL_MAP_INT_STRING:
+    case VL_MAP_INT_VL_STRING:
+    case VL_MAP_STRING_INT:
+    case VL_MAP_VL_STRING_INT:
+    case VL_MAP_STRING_DOUBLE:
+    case VL_MAP_VL_STRING_DOUBLE:
+    case VL_MAP_STRING_STRING:
+    case VL_MAP_STRING_VL_STRING:
+    case VL_MAP_VL_STRING_STRING:
+    case VL_MAP_VL_STRING_VL_STRING:
+    case VL_MAP_PAIR_INT_STRING_DOUBLE:
+    case VL_MAP_PAIR_INT_VL_STRING_DOUBLE:
+      return true;
+    default:
+      return false;
+  }
+}
+
+/// Finds the keys of strings in the values of type t, which are arrays of
+/// items of *stride bytes with keys at the first n offsets of each item, and
+/// returns n (0 if t holds no keys of strings). These are the variable
+/// length containers of strings and the fixed-size columns of VL strings.
+/// size and fieldlen are the size in bytes and the number of items of a
+/// fixed-size column (see QueryPlan), needed by those with string items.
+int StringKeys(DbTypes t, size_t size, hsize_t fieldlen, size_t* stride,
+               size_t offsets[2]) {
+  const size_t key = CYCLUS_SHA1_SIZE;
+  offsets[0] = 0;
+  switch (t) {
+    case VECTOR_VL_STRING:
+    case SET_VL_STRING:
+    case LIST_VL_STRING:
+    case VL_VECTOR_STRING:
+    case VL_VECTOR_VL_STRING:
+    case VL_SET_STRING:
+    case VL_SET_VL_STRING:
+    case VL_LIST_STRING:
+    case VL_LIST_VL_STRING:
+      *stride = key;
+      return 1;
+    case PAIR_INT_VL_STRING:
+    case MAP_INT_VL_STRING:
+    case VL_MAP_INT_STRING:
+    case VL_MAP_INT_VL_STRING:
+      *stride = sizeof(int) + key;
+      offsets[0] = sizeof(int);
+      return 1;
+    case MAP_VL_STRING_INT:
+    case VL_MAP_STRING_INT:
+    case VL_MAP_VL_STRING_INT:
+      *stride = key + sizeof(int);
+      return 1;
+    case MAP_VL_STRING_DOUBLE:
+    case VL_MAP_STRING_DOUBLE:
+    case VL_MAP_VL_STRING_DOUBLE:
+      *stride = key + sizeof(double);
+      return 1;
+    case MAP_STRING_VL_STRING:
+      *stride = size / fieldlen;
+      offsets[0] = *stride - key;
+      return 1;
+    case MAP_VL_STRING_STRING:
+      *stride = size / fieldlen;
+      return 1;
+    case MAP_VL_STRING_VL_STRING:
+    case VL_MAP_STRING_STRING:
+    case VL_MAP_STRING_VL_STRING:
+    case VL_MAP_VL_STRING_STRING:
+    case VL_MAP_VL_STRING_VL_STRING:
+      *stride = 2 * key;
+      offsets[1] = key;
+      return 2;
+    case MAP_PAIR_INT_VL_STRING_DOUBLE:
+    case VL_MAP_PAIR_INT_STRING_DOUBLE:
+    case VL_MAP_PAIR_INT_VL_STRING_DOUBLE:
+      *stride = sizeof(int) + key + sizeof(double);
+      offsets[0] = sizeof(int);
+      return 1;
+    default:
+      return 0;
+  }
+}
+
+/// Appends the keys at the first n offsets of each of the nitems items of
+/// stride bytes at p to keys.
+void AppendKeys(const char* p, size_t nitems, size_t stride,
+                const size_t* offsets, int n, std::vector<Digest>* keys) {
+  Digest key;
+  for (size_t i = 0; i < nitems; ++i) {
+    for (int k = 0; k < n; ++k) {
+      memcpy(key.val, p + i * stride + offsets[k], CYCLUS_SHA1_SIZE);
+      keys->push_back(key);
+    }
+  }
+}
+
+}  // namespace
+
+/// Reads a table a batch of chunks at a time as rows are requested. The
+/// chunks of a batch and the variable length values they reference are read
+/// in turn, since HDF5 is not thread safe, and then decoded in parallel, each
+/// into its own slot. Chunk buffers are reused
+/// from batch to batch.
+class Hdf5Back::ChunkCursor : public QueryCursor {
+ public:
+  ChunkCursor(Hdf5Back* b, std::string table, std::vector<Cond>* conds,
+              std::vector<std::string>* cols)
+      : b_(b),
+        p_(b->PlanQuery(table, conds, cols)),
+        all_(cols == NULL),
+        chunk_(0),
+        pos_(0) {
+    idx_ = Project(p_->qr.fields, p_->qr.types, cols);
+  }
+
+  virtual bool Next(std::vector<QueryRow>* rows, int n = kBatchSize) {
+    rows->clear();
+    while (rows->size() < n) {
+      if (pos_ == pending_.size()) {
+        if (chunk_ == p_->nchunks)
+          break;
+        ReadBatch();
+        continue;
+      }
+      QueryRow& r = pending_[pos_++];
+      if (all_) {
+        rows->push_back(std::move(r));
+      } else {
+        QueryRow proj(idx_.size());
+        for (int i = 0; i < idx_.size(); ++i) {
+          proj[i] = r[idx_[i]];
+        }
+        rows->push_back(proj);
+      }
+    }
+    return !rows->empty();
+  }
+
+ private:
+  /// reads and decodes the next batch of chunks into pending_
+  void ReadBatch() {
+    ThreadPool* tp = b_->pool();
+    int nslots = tp->size();
+    bufs_.resize(nslots);
+    counts_.resize(nslots);
+    slots_.resize(nslots);
+    int nread = 0;
+    for (; chunk_ < p_->nchunks && nread < nslots; ++chunk_) {
+      if (b_->ChunkMayMatch(p_.get(), chunk_)) {
+        counts_[nread] = b_->ReadRaw(p_.get(), chunk_, &bufs_[nread]);
+        ++nread;
+      }
+    }
+    b_->ReadVLBatch(p_.get(), bufs_, counts_, nread);
+    tp->ParallelFor(nread, [this](int k) {
+      slots_[k].clear();
+      b_->DecodeChunk(p_.get(), &bufs_[k][0], counts_[k], &slots_[k]);
+    });
+    b_->ClearVLBatch();
+
+    pending_.clear();
+    pos_ = 0;
+    for (int k = 0; k < nread; ++k) {
+      if (pending_.empty()) {
+        pending_.swap(slots_[k]);
+      } else {
+        pending_.insert(pending_.end(),
+                        std::make_move_iterator(slots_[k].begin()),
+                        std::make_move_iterator(slots_[k].end()));
+      }
+    }
+  }
+
+  Hdf5Back* b_;
+  boost::scoped_ptr<QueryPlan> p_;
+  bool all_;
+  std::vector<int> idx_;
+  unsigned int chunk_;
+  std::vector<std::vector<char> > bufs_;
+  std::vector<hsize_t> counts_;
+  std::vector<std::vector<QueryRow> > slots_;
+  std::vector<QueryRow> pending_;
+  size_t pos_;
+};
+
 QueryResult Hdf5Back::Query(std::string table, std::vector<Cond>* conds) {
-  using std::string;
-  using std::vector;
-  using std::set;
-  using std::list;
-  using std::pair;
-  using std::map;
+  return Cursor(table, conds)->ReadAll();
+}
+
+QueryCursor::Ptr Hdf5Back::Cursor(std::string table, std::vector<Cond>* conds,
+                                  std::vector<std::string>* cols) {
+  return QueryCursor::Ptr(new ChunkCursor(this, table, conds, cols));
+}
+
+QueryResult Hdf5Back::Aggregate(std::string table, std::vector<Cond>* conds,
+                                std::vector<std::string>* group_by,
+                                std::vector<Agg>* aggs, int bucket) {
+  std::vector<std::string> keys;
+  if (group_by != NULL)
+    keys = *group_by;
+  std::vector<Agg> a;
+  if (aggs != NULL)
+    a = *aggs;
+  std::vector<std::string> cols = keys;
+  for (int i = 0; i < a.size(); ++i) {
+    if (a[i].opcode != AGG_COUNT)
+      cols.push_back(a[i].field);
+  }
+  boost::scoped_ptr<QueryPlan> p(PlanQuery(table, conds, &cols));
+  QueryResult& info = p->qr;
+
+  // the table columns of the group_by and aggregated fields
+  std::vector<int> key_cols;
+  std::vector<int> agg_cols;
+  std::vector<DbTypes> key_types;
+  std::vector<DbTypes> agg_types;
+  for (int i = 0; i < cols.size(); ++i) {
+    int j = std::find(info.fields.begin(), info.fields.end(), cols[i]) -
+            info.fields.begin();
+    if (j == info.fields.size())
+      throw KeyError("table " + table + " has no such field " + cols[i]);
+  }
+  for (int i = 0; i < keys.size(); ++i) {
+    int j = std::find(info.fields.begin(), info.fields.end(), keys[i]) -
+            info.fields.begin();
+    key_cols.push_back(j);
+    key_types.push_back(info.types[j]);
+  }
+  for (int i = 0; i < a.size(); ++i) {
+    int j = -1;
+    if (a[i].opcode != AGG_COUNT) {
+      j = std::find(info.fields.begin(), info.fields.end(), a[i].field) -
+          info.fields.begin();
+    }
+    agg_cols.push_back(j);
+    agg_types.push_back(j < 0 ? INT : info.types[j]);
+  }
+  AggTable total(keys, key_types, a, agg_types, bucket);
+
+  // chunks can only be aggregated in parallel without decoding their
+  // variable length values, which needs HDF5 calls
+  std::vector<int> cond_cols;
+  for (int j = 0; j < info.fields.size(); ++j) {
+    if (!p->decode[j])
+      continue;
+    switch (info.types[j]) {
+      case BOOL:
+      case INT:
+      case FLOAT:
+      case DOUBLE:
+      case STRING:
+      case UUID:
+        break;
+      default:
+        return QueryableBackend::Aggregate(table, conds, group_by, aggs,
+                                           bucket);
+    }
+    if (!p->field_conds[info.fields[j]].empty())
+      cond_cols.push_back(j);
+  }
+
+  // chunks are read in turn on this thread, as HDF5 is not thread safe, and
+  // aggregated in parallel a batch at a time, each slot of the batch into
+  // its own table
+  ThreadPool* tp = pool();
+  int nslots = tp->size();
+  std::vector<std::vector<char> > bufs(nslots);
+  std::vector<hsize_t> counts(nslots);
+  std::vector<AggTable> tables(nslots, total);
+  for (unsigned int n = 0; n < p->nchunks;) {
+    int nread = 0;
+    for (; n < p->nchunks && nread < nslots; ++n) {
+      if (ChunkMayMatch(p.get(), n)) {
+        counts[nread] = ReadRaw(p.get(), n, &bufs[nread]);
+        ++nread;
+      }
+    }
+    tp->ParallelFor(nread, [&](int k) {
+      AggregateRaw(p.get(), &bufs[k][0], counts[k], cond_cols, key_cols,
+                   agg_cols, &tables[k]);
+    });
+  }
+  for (int k = 0; k < nslots; ++k) {
+    total.Merge(tables[k]);
+  }
+  return total.Result();
+}
+
+void Hdf5Back::AggregateRaw(QueryPlan* p, const char* buf, hsize_t count,
+                            const std::vector<int>& cond_cols,
+                            const std::vector<int>& key_cols,
+                            const std::vector<int>& agg_cols, AggTable* t) {
+  const std::vector<DbTypes>& types = p->qr.types;
+  const size_t* offsets = col_offsets_.find(p->table)->second;
+  const size_t* sizes = col_sizes_.find(p->table)->second;
+  std::vector<std::vector<Cond*>*> conds;
+  for (int k = 0; k < cond_cols.size(); ++k) {
+    conds.push_back(&(p->field_conds.find(p->qr.fields[cond_cols[k]])->second));
+  }
+
+  QueryRow key(key_cols.size());
+  std::vector<double> vals(agg_cols.size(), 0);
+  for (hsize_t i = 0; i < count; ++i) {
+    const char* row = buf + i * p->tb_typesize;
+    bool is_row_selected = true;
+    for (int k = 0; k < cond_cols.size() && is_row_selected; ++k) {
+      int j = cond_cols[k];
+      is_row_selected = RawConds(row + offsets[j], types[j], sizes[j],
+                                 conds[k]);
+    }
+    if (!is_row_selected)
+      continue;
+    for (int k = 0; k < key_cols.size(); ++k) {
+      int j = key_cols[k];
+      key[k] = RawVal(row + offsets[j], types[j], sizes[j]);
+    }
+    for (int k = 0; k < agg_cols.size(); ++k) {
+      int j = agg_cols[k];
+      if (j >= 0)
+        vals[k] = RawDouble(row + offsets[j], types[j]);
+    }
+    t->Add(key, vals.empty() ? NULL : &vals[0]);
+  }
+}
+
+Hdf5Back::QueryPlan::~QueryPlan() {
+  H5Tclose(tb_type);
+  H5Pclose(tb_plist);
+  H5Sclose(tb_space);
+  H5Dclose(tb_set);
+}
+
+Hdf5Back::QueryPlan* Hdf5Back::PlanQuery(std::string table,
+                                         std::vector<Cond>* conds,
+                                         std::vector<std::string>* cols) {
   if (!H5Lexists(file_, table.c_str(), H5P_DEFAULT))
     throw IOError("table '" + table + "' does not exist in '" + path_ + "'.");
   int i;
   int j;
-  int jlen;
-  herr_t status = 0;
-  hid_t tb_set = H5Dopen2(file_, table.c_str(), H5P_DEFAULT);
-  hid_t tb_space = H5Dget_space(tb_set);
-  hid_t tb_plist = H5Dget_create_plist(tb_set);
-  hid_t tb_type = H5Dget_type(tb_set);
-  size_t tb_typesize = H5Tget_size(tb_type);
-  int tb_length = H5Sget_simple_extent_npoints(tb_space);
-  hsize_t tb_chunksize;
-  H5Pget_chunk(tb_plist, 1, &tb_chunksize);
-  unsigned int nchunks =
-      (tb_length/tb_chunksize) + (tb_length%tb_chunksize == 0?0:1);
-
-  // set up field-conditions map
-  std::map<std::string, std::vector<Cond*> > field_conds =
-      std::map<std::string, std::vector<Cond*> >();
-  if (conds != NULL) {
-    Cond* cond;
-    for (i = 0; i < conds->size(); ++i) {
-      cond = &((*conds)[i]);
-      if (field_conds.count(cond->field) == 0)
-        field_conds[cond->field] = std::vector<Cond*>();
-      field_conds[cond->field].push_back(cond);
-    }
+  QueryPlan* p = new QueryPlan();
+  p->table = table;
+  p->tb_set = H5Dopen2(file_, table.c_str(), H5P_DEFAULT);
+  p->tb_space = H5Dget_space(p->tb_set);
+  p->tb_plist = H5Dget_create_plist(p->tb_set);
+  p->tb_type = H5Dget_type(p->tb_set);
+  p->tb_typesize = H5Tget_size(p->tb_type);
+  p->tb_length = H5Sget_simple_extent_npoints(p->tb_space);
+  H5Pget_chunk(p->tb_plist, 1, &p->tb_chunksize);
+  p->nchunks = (p->tb_length/p->tb_chunksize) +
+               (p->tb_length%p->tb_chunksize == 0?0:1);
+
+  // set up field-conditions map, pointing into the plan's own copy of the
+  // conditions so that cursors don't depend on the caller's
+  if (conds != NULL)
+    p->conds = *conds;
+  std::map<std::string, std::vector<Cond*> >& field_conds = p->field_conds;
+  for (i = 0; i < p->conds.size(); ++i) {
+    Cond* cond = &(p->conds[i]);
+    field_conds[cond->field].push_back(cond);
   }
 
-  // read in data
-  QueryResult qr = GetTableInfo(table, tb_set, tb_type);
+  QueryResult& qr = p->qr;
+  qr = GetTableInfo(table, p->tb_set, p->tb_type);
   int nfields = qr.fields.size();
   for (i = 0; i < nfields; ++i) {
     if (field_conds.count(qr.fields[i]) == 0) {
       field_conds[qr.fields[i]] = std::vector<Cond*>();
     }
   }
-  for (unsigned int n = 0; n < nchunks; ++n) {
-    // This loop is meant to be OpenMP-izable
-    hid_t field_type;
-    hsize_t start = n * tb_chunksize;
-    hsize_t count =
-        (tb_length-start) < tb_chunksize ? tb_length - start : tb_chunksize;
-    char* buf = new char[tb_typesize * count];
-    hid_t memspace = H5Screate_simple(1, &count, NULL);
-    status = H5Sselect_hyperslab(tb_space, H5S_SELECT_SET, &start, NULL,
-                                 &count, NULL);
-    status = H5Dread(tb_set, tb_type, memspace, tb_space, H5P_DEFAULT, buf);
-    int offset = 0;
-    bool is_row_selected;
-    for (i = 0; i < count; ++i) {
-      offset = i * tb_typesize;
-      is_row_selected = true;
-      QueryRow row = QueryRow(nfields);
-      for (j = 0; j < nfields; ++j) {
-        switch (qr.types[j]) {
-          case BOOL: {
-            bool x = *reinterpret_cast<bool*>(buf + offset);
-            is_row_selected = CmpConds<bool>(&x, &(field_conds[qr.fields[j]]));
-            if (is_row_selected)
-              row[j] = x;
-            break;
-          }
-          case INT: {
-            int x = *reinterpret_cast<int*>(buf + offset);
-            is_row_selected = CmpConds<int>(&x, &(field_conds[qr.fields[j]]));
-            if (is_row_selected)
-              row[j] = x;
-            break;
-          }
-          case FLOAT: {
-            float x = *reinterpret_cast<float*>(buf + offset);
-            is_row_selected = CmpConds<float>(&x, &(field_conds[qr.fields[j]]));
-            if (is_row_selected)
-              row[j] = x;
-            break;
-          }
-          case DOUBLE: {
-            double x = *reinterpret_cast<double*>(buf + offset);
-            is_row_selected = CmpConds<double>(&x, &(field_conds[qr.fields[j]]));
-            if (is_row_selected)
-              row[j] = x;
-            break;
-          }
-          case STRING: {
-            std::string x = std::string(buf + offset, col_sizes_[table][j]);
-            size_t nullpos = x.find('\0');
-            if (nullpos != std::string::npos)
-              x.resize(nullpos);
-            is_row_selected =
-                CmpConds<std::string>(&x, &(field_conds[qr.fields[j]]));
-            if (is_row_selected)
-              row[j] = x;
-            break;
-          }
-          case VL_STRING: {
-            std::string x = VLRead<std::string, VL_STRING>(buf + offset);
-            is_row_selected =
-                CmpConds<std::string>(&x, &(field_conds[qr.fields[j]]));
-            if (is_row_selected)
-              row[j] = x;
-            break;
-          }
-          case BLOB: {
-            Blob x = VLRead<Blob, BLOB>(buf + offset);
-            is_row_selected = CmpConds<Blob>(&x, &(field_conds[qr.fields[j]]));
-            if (is_row_selected)
-              row[j] = x;
-            break;
-          }
-          case UUID: {
-            boost::uuids::uuid x;
-            memcpy(&x, buf + offset, 16);
-            is_row_selected =
-                CmpConds<boost::uuids::uuid>(&x, &(field_conds[qr.fields[j]]));
-            if (is_row_selected)
-              row[j] = x;
-            break;
-          }
-          case VECTOR_INT: {
-            std::vector<int> x =
-                std::vector<int>(col_sizes_[table][j] / sizeof(int));
-            memcpy(&x[0], buf + offset, col_sizes_[table][j]);
-            is_row_selected =
-                CmpConds<std::vector<int> >(&x, &(field_conds[qr.fields[j]]));
-            if (is_row_selected)
-              row[j] = x;
-            break;
-          }
-          case VL_VECTOR_INT: {
-            std::vector<int> x =
-                VLRead<std::vector<int>, VL_VECTOR_INT>(buf + offset);
-            is_row_selected =
-                CmpConds<std::vector<int> >(&x, &(field_conds[qr.fields[j]]));
-            if (is_row_selected)
-              row[j] = x;
-            break;
-          }
-          case VECTOR_FLOAT: {
-            std::vector<float> x = std::vector<float>(
-                                        col_sizes_[table][j] / sizeof(float));
-            memcpy(&x[0], buf + offset, col_sizes_[table][j]);
-            is_row_selected = CmpConds<std::vector<float> >(&x,
-                                                 &(field_conds[qr.fields[j]]));
-            if (is_row_selected)
-              row[j] = x;
-            break;
-          }
-          case VL_VECTOR_FLOAT: {
-            std::vector<float> x =
-                VLRead<std::vector<float>, VL_VECTOR_FLOAT>(buf + offset);
-            is_row_selected =
-                CmpConds<std::vector<float> >(&x, &(field_conds[qr.fields[j]]));
-            if (is_row_selected)
-              row[j] = x;
-            break;
-          }
-          case VECTOR_DOUBLE: {
-            std::vector<double> x = std::vector<double>(
-                                        col_sizes_[table][j] / sizeof(double));
-            memcpy(&x[0], buf + offset, col_sizes_[table][j]);
-            is_row_selected = CmpConds<std::vector<double> >(&x,
-                                                 &(field_conds[qr.fields[j]]));
-            if (is_row_selected)
-              row[j] = x;
-            break;
-          }
-          case VL_VECTOR_DOUBLE: {
-            std::vector<double> x =
-                VLRead<std::vector<double>, VL_VECTOR_DOUBLE>(buf + offset);
-            is_row_selected =
-                CmpConds<std::vector<double> >(&x, &(field_conds[qr.fields[j]]));
-            if (is_row_selected)
-              row[j] = x;
-            break;
-          }
-          case VECTOR_STRING: {
-            hid_t field_type = H5Tget_member_type(tb_type, j);
-            size_t nullpos;
-            hsize_t fieldlen;
-            H5Tget_array_dims2(field_type, &fieldlen);
-            unsigned int strlen = col_sizes_[table][j] / fieldlen;
-            vector<string> x = vector<string>(fieldlen);
-            for (unsigned int k = 0; k < fieldlen; ++k) {
-              x[k] = string(buf + offset + strlen*k, strlen);
-              nullpos = x[k].find('\0');
-              if (nullpos != std::string::npos)
-                x[k].resize(nullpos);
-            }
-            is_row_selected =
-                CmpConds<vector<string> >(&x, &(field_conds[qr.fields[j]]));
-            if (is_row_selected)
-              row[j] = x;
-            H5Tclose(field_type);
-            break;
-          }
-          case VECTOR_VL_STRING: {
-            jlen = col_sizes_[table][j] / CYCLUS_SHA1_SIZE;
-            vector<string> x = vector<string>(jlen);
-            for (unsigned int k = 0; k < jlen; ++k) {
-              x[k] = VLRead<std::string,
-                     VL_STRING>(buf + offset + CYCLUS_SHA1_SIZE*k);
-            }
-            is_row_selected =
-                CmpConds<vector<string> >(&x, &(field_conds[qr.fields[j]]));
-            if (is_row_selected)
-              row[j] = x;
-            break;
-          }
-          case VL_VECTOR_STRING: {
-            vector<string> x =
-                VLRead<vector<string>, VL_VECTOR_STRING>(buf + offset);
-            is_row_selected =
-                CmpConds<vector<string> >(&x, &(field_conds[qr.fields[j]]));
-            if (is_row_selected)
-              row[j] = x;
-            break;
-          }
-          case VL_VECTOR_VL_STRING: {
-            vector<string> x =
-                VLRead<vector<string>, VL_VECTOR_VL_STRING>(buf + offset);
-            is_row_selected =
-                CmpConds<vector<string> >(&x, &(field_conds[qr.fields[j]]));
-            if (is_row_selected)
-              row[j] = x;
-            break;
-          }
-          case SET_INT: {
-            jlen = col_sizes_[table][j] / sizeof(int);
-            int* xraw = reinterpret_cast<int*>(buf + offset);
-            std::set<int> x = std::set<int>(xraw, xraw+jlen);
-            is_row_selected =
-                CmpConds<std::set<int> >(&x, &(field_conds[qr.fields[j]]));
-            if (is_row_selected)
-              row[j] = x;
-            break;
-          }
-          case VL_SET_INT: {
-            std::set<int> x = VLRead<std::set<int>, VL_SET_INT>(buf + offset);
-            is_row_selected =
-                CmpConds<std::set<int> >(&x, &(field_conds[qr.fields[j]]));
-            if (is_row_selected)
-              row[j] = x;
-            break;
-          }
-          case SET_STRING: {
-            hid_t field_type = H5Tget_member_type(tb_type, j);
-            size_t nullpos;
-            hsize_t fieldlen;
-            H5Tget_array_dims2(field_type, &fieldlen);
-            unsigned int strlen = col_sizes_[table][j] / fieldlen;
-            set<string> x;
-            for (unsigned int k = 0; k < fieldlen; ++k) {
-              string s = string(buf + offset + strlen*k, strlen);
-              nullpos = s.find('\0');
-              if (nullpos != std::string::npos)
-                s.resize(nullpos);
-              x.insert(s);
-            }
-            is_row_selected =
-                CmpConds<set<string> >(&x, &(field_conds[qr.fields[j]]));
-            if (is_row_selected)
-              row[j] = x;
-            H5Tclose(field_type);
-            break;
-          }
-          case SET_VL_STRING: {
-            jlen = col_sizes_[table][j] / CYCLUS_SHA1_SIZE;
-            set<string> x;
-            for (unsigned int k = 0; k < jlen; ++k) {
-              x.insert(VLRead<string,
-                       VL_STRING>(buf + offset + CYCLUS_SHA1_SIZE*k));
-            }
-            is_row_selected =
-                CmpConds<set<string> >(&x, &(field_conds[qr.fields[j]]));
-            if (is_row_selected)
-              row[j] = x;
-            break;
-          }
-          case VL_SET_STRING: {
-            set<string> x = VLRead<set<string>, VL_SET_STRING>(buf + offset);
-            is_row_selected =
-                CmpConds<set<string> >(&x, &(field_conds[qr.fields[j]]));
-            if (is_row_selected)
-              row[j] = x;
-            break;
-          }
-          case VL_SET_VL_STRING: {
-            set<string> x = VLRead<set<string>, VL_SET_VL_STRING>(buf + offset);
-            is_row_selected =
-                CmpConds<set<string> >(&x, &(field_conds[qr.fields[j]]));
-            if (is_row_selected)
-              row[j] = x;
-            break;
-          }
-          case LIST_INT: {
-            jlen = col_sizes_[table][j] / sizeof(int);
-            int* xraw = reinterpret_cast<int*>(buf + offset);
-            std::list<int> x = std::list<int>(xraw, xraw+jlen);
-            is_row_selected =
-                CmpConds<std::list<int> >(&x, &(field_conds[qr.fields[j]]));
-            if (is_row_selected)
-              row[j] = x;
-            break;
-          }
-          case VL_LIST_INT: {
-            std::list<int> x =
-                VLRead<std::list<int>, VL_LIST_INT>(buf + offset);
-            is_row_selected =
-                CmpConds<std::list<int> >(&x, &(field_conds[qr.fields[j]]));
-            if (is_row_selected)
-              row[j] = x;
-            break;
-          }
-          case LIST_STRING: {
-            hid_t field_type = H5Tget_member_type(tb_type, j);
-            size_t nullpos;
-            hsize_t fieldlen;
-            H5Tget_array_dims2(field_type, &fieldlen);
-            unsigned int strlen = col_sizes_[table][j] / fieldlen;
-            list<string> x;
-            for (unsigned int k = 0; k < fieldlen; ++k) {
-              string s = string(buf + offset + strlen*k, strlen);
-              nullpos = s.find('\0');
-              if (nullpos != std::string::npos)
-                s.resize(nullpos);
-              x.push_back(s);
-            }
-            is_row_selected =
-                CmpConds<list<string> >(&x, &(field_conds[qr.fields[j]]));
-            if (is_row_selected)
-              row[j] = x;
-            H5Tclose(field_type);
-            break;
-          }
-          case LIST_VL_STRING: {
-            jlen = col_sizes_[table][j] / CYCLUS_SHA1_SIZE;
-            list<string> x;
-            for (unsigned int k = 0; k < jlen; ++k) {
-              x.push_back(VLRead<string,
-                          VL_STRING>(buf + offset + CYCLUS_SHA1_SIZE*k));
-            }
-            is_row_selected =
-                CmpConds<list<string> >(&x, &(field_conds[qr.fields[j]]));
-            if (is_row_selected)
-              row[j] = x;
-            break;
-          }
-          case VL_LIST_STRING: {
-            list<string> x = VLRead<list<string>, VL_LIST_STRING>(buf + offset);
-            is_row_selected =
-                CmpConds<list<string> >(&x, &(field_conds[qr.fields[j]]));
-            if (is_row_selected)
-              row[j] = x;
-            break;
-          }
-          case VL_LIST_VL_STRING: {
-            list<string> x =
-                VLRead<list<string>, VL_LIST_VL_STRING>(buf + offset);
-            is_row_selected =
-                CmpConds<list<string> >(&x, &(field_conds[qr.fields[j]]));
-            if (is_row_selected)
-              row[j] = x;
-            break;
+
+  // conditions on fixed size scalar columns are checked before anything else
+  // in a row is decoded, and those on INT columns also against the zone map
+  // to skip whole chunks
+  std::vector<std::pair<int, Cond*> >& zone_conds = p->zone_conds;
+  p->zm = NULL;
+  for (j = 0; j < nfields; ++j) {
+    std::vector<Cond*>& fc = field_conds[qr.fields[j]];
+    if (fc.empty())
+      continue;
+    switch (qr.types[j]) {
+      case INT: {
+        for (i = 0; i < fc.size(); ++i) {
+          if (fc[i]->val.type() == typeid(int))
+            zone_conds.push_back(std::make_pair(j, fc[i]));
+        }
+      }  // fall through
+      case BOOL:
+      case FLOAT:
+      case DOUBLE:
+      case UUID: {
+        p->prefilter.push_back(j);
+        break;
+      }
+      default:
+        break;
+    }
+  }
+  if (!zone_conds.empty()) {
+    p->zm = GetZoneMap(table, p->tb_set, nfields);
+    for (i = 0; i < zone_conds.size(); ++i) {
+      zone_conds[i].first = std::find(p->zm->cols.begin(), p->zm->cols.end(),
+                                      zone_conds[i].first) -
+                            p->zm->cols.begin();
+    }
+  }
+
+  // only the returned columns and those with conditions are decoded
+  p->decode.assign(nfields, cols == NULL);
+  for (j = 0; j < nfields; ++j) {
+    if (!field_conds[qr.fields[j]].empty() ||
+        (cols != NULL &&
+         std::find(cols->begin(), cols->end(), qr.fields[j]) != cols->end()))
+      p->decode[j] = true;
+  }
+
+  // everything chunks are decoded with, so that decoding needs no lookups
+  // or HDF5 calls besides those of VL values
+  p->tb_offsets = col_offsets_[table];
+  p->tb_sizes = col_sizes_[table];
+  p->fieldlens.assign(nfields, 0);
+  p->keylens.assign(nfields, 0);
+  for (j = 0; j < nfields; ++j) {
+    p->col_conds.push_back(&field_conds[qr.fields[j]]);
+    hid_t field_type = H5Tget_member_type(p->tb_type, j);
+    if (H5Tget_class(field_type) == H5T_ARRAY)
+      H5Tget_array_dims2(field_type, &p->fieldlens[j]);
+    if (qr.types[j] == MAP_STRING_STRING) {
+      hid_t item_type = H5Tget_super(field_type);
+      hid_t key_type = H5Tget_member_type(item_type, 0);
+      p->keylens[j] = H5Tget_size(key_type);
+      H5Tclose(key_type);
+      H5Tclose(item_type);
+    }
+    H5Tclose(field_type);
+  }
+  return p;
+}
+
+bool Hdf5Back::ChunkMayMatch(QueryPlan* p, unsigned int n) {
+  ZoneMap* zm = p->zm;
+  std::vector<std::pair<int, Cond*> >& zone_conds = p->zone_conds;
+  if (zm == NULL || zm->chunksize != p->tb_chunksize ||
+      (n + 1) * zm->cols.size() * 2 > zm->bounds.size())
+    return true;
+  bool may_match = true;
+  for (int i = 0; i < zone_conds.size() && may_match; ++i) {
+    const int* b = &zm->bounds[2 * (n * zm->cols.size() +
+                                     zone_conds[i].first)];
+    int v = zone_conds[i].second->val.cast<int>();
+    switch (zone_conds[i].second->opcode) {
+      case LT: may_match = b[0] < v; break;
+      case GT: may_match = b[1] > v; break;
+      case LE: may_match = b[0] <= v; break;
+      case GE: may_match = b[1] >= v; break;
+      case EQ: may_match = b[0] <= v && v <= b[1]; break;
+      case NE: may_match = b[0] != v || b[1] != v; break;
+    }
+  }
+  return may_match;
+}
+
+hsize_t Hdf5Back::ReadRaw(QueryPlan* p, unsigned int n,
+                          std::vector<char>* buf) {
+  std::lock_guard<std::recursive_mutex> lock(h5_mu_);
+  hsize_t start = n * p->tb_chunksize;
+  hsize_t count = (p->tb_length-start) < p->tb_chunksize ?
+                  p->tb_length - start : p->tb_chunksize;
+  buf->resize(p->tb_typesize * count);
+  hid_t memspace = H5Screate_simple(1, &count, NULL);
+  H5Sselect_hyperslab(p->tb_space, H5S_SELECT_SET, &start, NULL, &count,
+                      NULL);
+  H5Dread(p->tb_set, p->tb_type, memspace, p->tb_space, H5P_DEFAULT,
+          &(*buf)[0]);
+  H5Sclose(memspace);
+  return count;
+}
+
+void Hdf5Back::ReadVLBatch(QueryPlan* p,
+                           const std::vector<std::vector<char> >& bufs,
+                           const std::vector<hsize_t>& counts, int n) {
+  std::lock_guard<std::recursive_mutex> lock(h5_mu_);
+  ClearVLBatch();
+  // the columns of the keys of VL values and the fixed-size columns of keys
+  // of strings
+  std::vector<int> cols;
+  std::vector<int> strcols;
+  size_t stride;
+  size_t offsets[2];
+  for (int j = 0; j < p->qr.types.size(); ++j) {
+    DbTypes t = p->qr.types[j];
+    if (!p->decode[j]) {
+      continue;
+    } else if (IsVLKey(t)) {
+      cols.push_back(j);
+    } else if (StringKeys(t, p->tb_sizes[j], p->fieldlens[j], &stride,
+                          offsets) > 0) {
+      strcols.push_back(j);
+    }
+  }
+  if (cols.empty() && strcols.empty())
+    return;
+
+  std::map<DbTypes, std::vector<Digest> > keys;
+  std::vector<Digest> strs;
+  Digest key;
+  for (int k = 0; k < n; ++k) {
+    for (hsize_t i = 0; i < counts[k]; ++i) {
+      const char* row = &bufs[k][0] + i * p->tb_typesize;
+      if (!RowMayMatch(p, row))
+        continue;
+      for (int c = 0; c < cols.size(); ++c) {
+        memcpy(key.val, row + p->tb_offsets[cols[c]], CYCLUS_SHA1_SIZE);
+        keys[p->qr.types[cols[c]]].push_back(key);
+      }
+      for (int c = 0; c < strcols.size(); ++c) {
+        int j = strcols[c];
+        int nkeys = StringKeys(p->qr.types[j], p->tb_sizes[j],
+                               p->fieldlens[j], &stride, offsets);
+        AppendKeys(row + p->tb_offsets[j], p->tb_sizes[j] / stride, stride,
+                   offsets, nkeys, &strs);
+      }
+    }
+  }
+
+  // strings last, so that those of containers of strings are read with them
+  std::map<DbTypes, std::vector<Digest> >::iterator it;
+  for (it = keys.begin(); it != keys.end(); ++it) {
+    if (it->first == VL_STRING) {
+      strs.insert(strs.end(), it->second.begin(), it->second.end());
+      continue;
+    }
+    ReadVLVals(it->first, &it->second);
+    int nkeys = StringKeys(it->first, 0, 0, &stride, offsets);
+    if (nkeys == 0)
+      continue;
+    const VLBatch& b = vlbatch_[it->first];
+    for (int i = 0; i < b.keys.size(); ++i) {
+      const hvl_t* x = reinterpret_cast<const hvl_t*>(&b.buf[i * b.size]);
+      AppendKeys(static_cast<const char*>(x->p), x->len, stride, offsets,
+                 nkeys, &strs);
+    }
+  }
+  ReadVLVals(VL_STRING, &strs);
+}
+
+void Hdf5Back::ReadVLVals(DbTypes dbtype, std::vector<Digest>* keys) {
+  std::sort(keys->begin(), keys->end());
+  keys->erase(std::unique(keys->begin(), keys->end()), keys->end());
+  if (keys->empty())
+    return;
+
+  // Selections of several values make HDF5 visit the chunks of their
+  // bounding box (and point selections overflow in the 5D address space), so
+  // each value is read as a selection of its own chunk, in key order.
+  hid_t dset = VLDataset(dbtype, false);
+  hid_t dt = vldts_[dbtype];
+  size_t n = keys->size();
+  VLBatch& b = vlbatch_[dbtype];
+  b.keys.swap(*keys);
+  b.size = H5Tget_size(dt);
+  b.buf.assign(b.size * n, 0);
+  hsize_t extent = n;
+  b.mspace = H5Screate_simple(1, &extent, NULL);
+  hid_t dspace = H5Dget_space(dset);
+  hid_t mspace = H5Screate_simple(CYCLUS_SHA1_NINT, vlchunk_, NULL);
+  hsize_t idx[CYCLUS_SHA1_NINT];
+  herr_t status = 0;
+  for (int i = 0; i < n && status >= 0; ++i) {
+    for (int k = 0; k < CYCLUS_SHA1_NINT; ++k)
+      idx[k] = b.keys[i].val[k];
+    status = H5Sselect_hyperslab(dspace, H5S_SELECT_SET, idx, NULL, vlchunk_,
+                                 NULL);
+    if (status >= 0) {
+      status = H5Dread(dset, dt, mspace, dspace, H5P_DEFAULT,
+                       &b.buf[i * b.size]);
+    }
+  }
+  H5Sclose(mspace);
+  H5Sclose(dspace);
+  if (status < 0) {
+    // the values read so far are reclaimed with the others
+    throw IOError("failed to read in variable length data "
+                  "in the database '" + path_ + "'.");
+  }
+}
+
+void Hdf5Back::ClearVLBatch() {
+  std::lock_guard<std::recursive_mutex> lock(h5_mu_);
+  std::map<DbTypes, VLBatch>::iterator it;
+  for (it = vlbatch_.begin(); it != vlbatch_.end(); ++it) {
+    H5Dvlen_reclaim(vldts_[it->first], it->second.mspace, H5P_DEFAULT,
+                    &it->second.buf[0]);
+    H5Sclose(it->second.mspace);
+  }
+  vlbatch_.clear();
+}
+
+const char* Hdf5Back::BatchedVL(DbTypes dbtype, const char* rawkey) {
+  std::map<DbTypes, VLBatch>::iterator it = vlbatch_.find(dbtype);
+  if (it == vlbatch_.end())
+    return NULL;
+  Digest key;
+  memcpy(key.val, rawkey, CYCLUS_SHA1_SIZE);
+  const std::vector<Digest>& keys = it->second.keys;
+  std::vector<Digest>::const_iterator k =
+      std::lower_bound(keys.begin(), keys.end(), key);
+  if (k == keys.end() || *k != key)
+    return NULL;
+  return &it->second.buf[(k - keys.begin()) * it->second.size];
+}
+
+bool Hdf5Back::RowMayMatch(QueryPlan* p, const char* row) {
+  bool may_match = true;
+  for (int k = 0; k < p->prefilter.size() && may_match; ++k) {
+    int j = p->prefilter[k];
+    const char* x = row + p->tb_offsets[j];
+    std::vector<Cond*>* fc = p->col_conds[j];
+    switch (p->qr.types[j]) {
+      case BOOL: {
+        bool v = *reinterpret_cast<const bool*>(x);
+        may_match = CmpConds<bool>(&v, fc);
+        break;
+      }
+      case INT: {
+        int v = *reinterpret_cast<const int*>(x);
+        may_match = CmpConds<int>(&v, fc);
+        break;
+      }
+      case FLOAT: {
+        float v = *reinterpret_cast<const float*>(x);
+        may_match = CmpConds<float>(&v, fc);
+        break;
+      }
+      case DOUBLE: {
+        double v = *reinterpret_cast<const double*>(x);
+        may_match = CmpConds<double>(&v, fc);
+        break;
+      }
+      case UUID: {
+        boost::uuids::uuid v;
+        memcpy(&v, x, 16);
+        may_match = CmpConds<boost::uuids::uuid>(&v, fc);
+        break;
+      }
+      default:
+        break;
+    }
+  }
+  return may_match;
+}
+
+void Hdf5Back::DecodeChunk(QueryPlan* p, char* buf, hsize_t count,
+                           std::vector<QueryRow>* rows) {
+  using std::string;
+  using std::vector;
+  using std::set;
+  using std::list;
+  using std::pair;
+  using std::map;
+  int i;
+  int j;
+  int jlen;
+  const std::string& table = p->table;
+  QueryResult& qr = p->qr;
+  int nfields = qr.fields.size();
+  const std::vector<std::vector<Cond*>*>& col_conds = p->col_conds;
+  size_t tb_typesize = p->tb_typesize;
+  const size_t* tb_sizes = p->tb_sizes;
+  int offset = 0;
+  bool is_row_selected;
+  for (i = 0; i < count; ++i) {
+    offset = i * tb_typesize;
+    is_row_selected = RowMayMatch(p, buf + offset);
+    if (!is_row_selected)
+      continue;
+    QueryRow row = QueryRow(nfields);
+    for (j = 0; j < nfields; ++j) {
+      if (!p->decode[j]) {
+        offset += tb_sizes[j];
+        continue;
+      }
+      switch (qr.types[j]) {
+        case BOOL: {
+          bool x = *reinterpret_cast<bool*>(buf + offset);
+          is_row_selected = CmpConds<bool>(&x, col_conds[j]);
+          if (is_row_selected)
+            row[j] = x;
+          break;
+        }
+        case INT: {
+          int x = *reinterpret_cast<int*>(buf + offset);
+          is_row_selected = CmpConds<int>(&x, col_conds[j]);
+          if (is_row_selected)
+            row[j] = x;
+          break;
+        }
+        case FLOAT: {
+          float x = *reinterpret_cast<float*>(buf + offset);
+          is_row_selected = CmpConds<float>(&x, col_conds[j]);
+          if (is_row_selected)
+            row[j] = x;
+          break;
+        }
+        case DOUBLE: {
+          double x = *reinterpret_cast<double*>(buf + offset);
+          is_row_selected = CmpConds<double>(&x, col_conds[j]);
+          if (is_row_selected)
+            row[j] = x;
+          break;
+        }
+        case STRING: {
+          std::string x = std::string(buf + offset, tb_sizes[j]);
+          size_t nullpos = x.find('\0');
+          if (nullpos != std::string::npos)
+            x.resize(nullpos);
+          is_row_selected =
+              CmpConds<std::string>(&x, col_conds[j]);
+          if (is_row_selected)
+            row[j] = x;
+          break;
+        }
+        case VL_STRING: {
+          std::string x = VLRead<std::string, VL_STRING>(buf + offset);
+          is_row_selected =
+              CmpConds<std::string>(&x, col_conds[j]);
+          if (is_row_selected)
+            row[j] = x;
+          break;
+        }
+        case BLOB: {
+          Blob x = VLRead<Blob, BLOB>(buf + offset);
+          is_row_selected = CmpConds<Blob>(&x, col_conds[j]);
+          if (is_row_selected)
+            row[j] = x;
+          break;
+        }
+        case UUID: {
+          boost::uuids::uuid x;
+          memcpy(&x, buf + offset, 16);
+          is_row_selected =
+              CmpConds<boost::uuids::uuid>(&x, col_conds[j]);
+          if (is_row_selected)
+            row[j] = x;
+          break;
+        }
+        case VECTOR_INT: {
+          std::vector<int> x =
+              std::vector<int>(tb_sizes[j] / sizeof(int));
+          memcpy(&x[0], buf + offset, tb_sizes[j]);
+          is_row_selected =
+              CmpConds<std::vector<int> >(&x, col_conds[j]);
+          if (is_row_selected)
+            row[j] = x;
+          break;
+        }
+        case VL_VECTOR_INT: {
+          std::vector<int> x =
+              VLRead<std::vector<int>, VL_VECTOR_INT>(buf + offset);
+          is_row_selected =
+              CmpConds<std::vector<int> >(&x, col_conds[j]);
+          if (is_row_selected)
+            row[j] = x;
+          break;
+        }
+        case VECTOR_FLOAT: {
+          std::vector<float> x = std::vector<float>(
+                                      tb_sizes[j] / sizeof(float));
+          memcpy(&x[0], buf + offset, tb_sizes[j]);
+          is_row_selected = CmpConds<std::vector<float> >(&x,
+                                               col_conds[j]);
+          if (is_row_selected)
+            row[j] = x;
+          break;
+        }
+        case VL_VECTOR_FLOAT: {
+          std::vector<float> x =
+              VLRead<std::vector<float>, VL_VECTOR_FLOAT>(buf + offset);
+          is_row_selected =
+              CmpConds<std::vector<float> >(&x, col_conds[j]);
+          if (is_row_selected)
+            row[j] = x;
+          break;
+        }
+        case VECTOR_DOUBLE: {
+          std::vector<double> x = std::vector<double>(
+                                      tb_sizes[j] / sizeof(double));
+          memcpy(&x[0], buf + offset, tb_sizes[j]);
+          is_row_selected = CmpConds<std::vector<double> >(&x,
+                                               col_conds[j]);
+          if (is_row_selected)
+            row[j] = x;
+          break;
+        }
+        case VL_VECTOR_DOUBLE: {
+          std::vector<double> x =
+              VLRead<std::vector<double>, VL_VECTOR_DOUBLE>(buf + offset);
+          is_row_selected =
+              CmpConds<std::vector<double> >(&x, col_conds[j]);
+          if (is_row_selected)
+            row[j] = x;
+          break;
+        }
+        case VECTOR_STRING: {
+          size_t nullpos;
+          hsize_t fieldlen = p->fieldlens[j];
+          unsigned int strlen = tb_sizes[j] / fieldlen;
+          vector<string> x = vector<string>(fieldlen);
+          for (unsigned int k = 0; k < fieldlen; ++k) {
+            x[k] = string(buf + offset + strlen*k, strlen);
+            nullpos = x[k].find('\0');
+            if (nullpos != std::string::npos)
+              x[k].resize(nullpos);
           }
-          case PAIR_INT_INT: {
-            pair<int, int> x =
-                std::make_pair(*reinterpret_cast<int*>(buf + offset),
-                               *reinterpret_cast<int*>(buf + offset + \
-                                                       sizeof(int)));
-            is_row_selected =
-                CmpConds<pair<int, int> >(&x, &(field_conds[qr.fields[j]]));
-            if (is_row_selected)
-              row[j] = x;
-            break;
+          is_row_selected =
+              CmpConds<vector<string> >(&x, col_conds[j]);
+          if (is_row_selected)
+            row[j] = x;
+          break;
+        }
+        case VECTOR_VL_STRING: {
+          jlen = tb_sizes[j] / CYCLUS_SHA1_SIZE;
+          vector<string> x = vector<string>(jlen);
+          for (unsigned int k = 0; k < jlen; ++k) {
+            x[k] = VLRead<std::string,
+                   VL_STRING>(buf + offset + CYCLUS_SHA1_SIZE*k);
           }
-          case PAIR_INT_STRING: {
-            size_t nullpos;
-            unsigned int strlen = col_sizes_[table][j] - sizeof(int);
-            int xfirst = *reinterpret_cast<int*>(buf + offset);
-            string s = string(buf + offset + sizeof(int), strlen);
+          is_row_selected =
+              CmpConds<vector<string> >(&x, col_conds[j]);
+          if (is_row_selected)
+            row[j] = x;
+          break;
+        }
+        case VL_VECTOR_STRING: {
+          vector<string> x =
+              VLRead<vector<string>, VL_VECTOR_STRING>(buf + offset);
+          is_row_selected =
+              CmpConds<vector<string> >(&x, col_conds[j]);
+          if (is_row_selected)
+            row[j] = x;
+          break;
+        }
+        case VL_VECTOR_VL_STRING: {
+          vector<string> x =
+              VLRead<vector<string>, VL_VECTOR_VL_STRING>(buf + offset);
+          is_row_selected =
+              CmpConds<vector<string> >(&x, col_conds[j]);
+          if (is_row_selected)
+            row[j] = x;
+          break;
+        }
+        case SET_INT: {
+          jlen = tb_sizes[j] / sizeof(int);
+          int* xraw = reinterpret_cast<int*>(buf + offset);
+          std::set<int> x = std::set<int>(xraw, xraw+jlen);
+          is_row_selected =
+              CmpConds<std::set<int> >(&x, col_conds[j]);
+          if (is_row_selected)
+            row[j] = x;
+          break;
+        }
+        case VL_SET_INT: {
+          std::set<int> x = VLRead<std::set<int>, VL_SET_INT>(buf + offset);
+          is_row_selected =
+              CmpConds<std::set<int> >(&x, col_conds[j]);
+          if (is_row_selected)
+            row[j] = x;
+          break;
+        }
+        case SET_STRING: {
+          size_t nullpos;
+          hsize_t fieldlen = p->fieldlens[j];
+          unsigned int strlen = tb_sizes[j] / fieldlen;
+          set<string> x;
+          for (unsigned int k = 0; k < fieldlen; ++k) {
+            string s = string(buf + offset + strlen*k, strlen);
             nullpos = s.find('\0');
             if (nullpos != std::string::npos)
               s.resize(nullpos);
-            pair<int, string> x = std::make_pair(xfirst, s);
-            is_row_selected =
-                CmpConds<pair<int, string> >(&x, &(field_conds[qr.fields[j]]));
-            if (is_row_selected)
-              row[j] = x;
-            break;
-          }
-          case PAIR_INT_VL_STRING: {
-            unsigned int itemsize = sizeof(int) + CYCLUS_SHA1_SIZE;
-            jlen = col_sizes_[table][j] / itemsize;
-            pair<int, string> x = std::make_pair(
-              *reinterpret_cast<int*>(buf + offset),
-              VLRead<string, VL_STRING>(buf + offset + sizeof(int)));
-            is_row_selected =
-                CmpConds<pair<int, string> >(&x, &(field_conds[qr.fields[j]]));
-            if (is_row_selected)
-              row[j] = x;
-            break;
-          }
-          case MAP_INT_INT: {
-            map<int, int> x = map<int, int>();
-            jlen = col_sizes_[table][j] / (2*sizeof(int));
-            for (unsigned int k = 0; k < jlen; ++k) {
-              x[*reinterpret_cast<int*>(buf + offset + 2*sizeof(int)*k)] = \
-                *reinterpret_cast<int*>(buf + offset + 2*sizeof(int)*k + \
-                                        sizeof(int));
-            }
-            is_row_selected =
-                CmpConds<map<int, int> >(&x, &(field_conds[qr.fields[j]]));
-            if (is_row_selected)
-              row[j] = x;
-            break;
-          }
-          case VL_MAP_INT_INT: {
-            map<int, int> x =
-                VLRead<map<int, int>, VL_MAP_INT_INT>(buf + offset);
-            is_row_selected =
-                CmpConds<map<int, int> >(&x, &(field_conds[qr.fields[j]]));
-            if (is_row_selected)
-              row[j] = x;
-            break;
-          }
-          case MAP_INT_DOUBLE: {
-            map<int, double> x = map<int, double>();
-            size_t itemsize = sizeof(int) + sizeof(double);
-            jlen = col_sizes_[table][j] / itemsize;
-            for (unsigned int k = 0; k < jlen; ++k) {
-              x[*reinterpret_cast<int*>(buf + offset + itemsize*k)] = \
-                *reinterpret_cast<double*>(buf + offset + itemsize*k + \
-                                           sizeof(int));
-            }
-            is_row_selected =
-                CmpConds<map<int, double> >(&x, &(field_conds[qr.fields[j]]));
-            if (is_row_selected)
-              row[j] = x;
-            break;
-          }
-          case VL_MAP_INT_DOUBLE: {
-            map<int, double> x =
-                VLRead<map<int, double>, VL_MAP_INT_DOUBLE>(buf + offset);
-            is_row_selected =
-                CmpConds<map<int, double> >(&x, &(field_conds[qr.fields[j]]));
-            if (is_row_selected)
-              row[j] = x;
-            break;
-          }
-          case MAP_INT_STRING: {
-            hid_t field_type = H5Tget_member_type(tb_type, j);
-            size_t nullpos;
-            hsize_t fieldlen;
-            H5Tget_array_dims2(field_type, &fieldlen);
-            unsigned int itemsize = col_sizes_[table][j] / fieldlen;
-            unsigned int strlen = itemsize - sizeof(int);
-            map<int, string> x;
-            for (unsigned int k = 0; k < fieldlen; ++k) {
-              string s = string(buf + offset + itemsize*k + sizeof(int), strlen);
-              nullpos = s.find('\0');
-              if (nullpos != std::string::npos)
-                s.resize(nullpos);
-              x[*reinterpret_cast<int*>(buf + offset + itemsize*k)] = s;
-            }
-            is_row_selected =
-                CmpConds<map<int, string> >(&x, &(field_conds[qr.fields[j]]));
-            if (is_row_selected)
-              row[j] = x;
-            H5Tclose(field_type);
-            break;
-          }
-          case MAP_INT_VL_STRING: {
-            unsigned int itemsize = sizeof(int) + CYCLUS_SHA1_SIZE;
-            jlen = col_sizes_[table][j] / itemsize;
-            map<int, string> x;
-            for (unsigned int k = 0; k < jlen; ++k) {
-              x[*reinterpret_cast<int*>(buf + offset + itemsize*k)] = \
-                VLRead<string, VL_STRING>(buf + offset + itemsize*k + \
-                                          sizeof(int));
-            }
-            is_row_selected =
-                CmpConds<map<int, string> >(&x, &(field_conds[qr.fields[j]]));
-            if (is_row_selected)
-              row[j] = x;
-            break;
-          }
-          case VL_MAP_INT_STRING: {
-            map<int, string> x =
-                VLRead<map<int, string>, VL_MAP_INT_STRING>(buf + offset);
-            is_row_selected =
-                CmpConds<map<int, string> >(&x, &(field_conds[qr.fields[j]]));
-            if (is_row_selected)
-              row[j] = x;
-            break;
-          }
-          case VL_MAP_INT_VL_STRING: {
-            map<int, string> x =
-                VLRead<map<int, string>, VL_MAP_INT_VL_STRING>(buf + offset);
-            is_row_selected =
-                CmpConds<map<int, string> >(&x, &(field_conds[qr.fields[j]]));
-            if (is_row_selected)
-              row[j] = x;
-            break;
-          }
-          case MAP_STRING_INT: {
-            hid_t field_type = H5Tget_member_type(tb_type, j);
-            size_t nullpos;
-            hsize_t fieldlen;
-            H5Tget_array_dims2(field_type, &fieldlen);
-            unsigned int itemsize = col_sizes_[table][j] / fieldlen;
-            unsigned int strlen = itemsize - sizeof(int);
-            map<string, int> x;
-            for (unsigned int k = 0; k < fieldlen; ++k) {
-              string s = string(buf + offset + itemsize*k, strlen);
-              nullpos = s.find('\0');
-              if (nullpos != std::string::npos)
-                s.resize(nullpos);
-              x[s] = *reinterpret_cast<int*>(buf + offset + itemsize*k + strlen);
-            }
-            is_row_selected =
-                CmpConds<map<string, int> >(&x, &(field_conds[qr.fields[j]]));
-            if (is_row_selected)
-              row[j] = x;
-            H5Tclose(field_type);
-            break;
-          }
-          case VL_MAP_STRING_INT: {
-            map<string, int> x =
-                VLRead<map<string, int>, VL_MAP_STRING_INT>(buf + offset);
-            is_row_selected =
-                CmpConds<map<string, int> >(&x, &(field_conds[qr.fields[j]]));
-            if (is_row_selected)
-              row[j] = x;
-            break;
+            x.insert(s);
           }
-          case MAP_VL_STRING_INT: {
-            unsigned int itemsize = sizeof(int) + CYCLUS_SHA1_SIZE;
-            jlen = col_sizes_[table][j] / itemsize;
-            map<string, int> x;
-            for (unsigned int k = 0; k < jlen; ++k) {
-              x[VLRead<string, VL_STRING>(buf + offset + itemsize*k)] = \
-                *reinterpret_cast<int*>(buf + offset + itemsize*k + CYCLUS_SHA1_SIZE);
-            }
-            is_row_selected =
-                CmpConds<map<string, int> >(&x, &(field_conds[qr.fields[j]]));
-            if (is_row_selected)
-              row[j] = x;
-            break;
-          }
-          case VL_MAP_VL_STRING_INT: {
-            map<string, int> x =
-                VLRead<map<string, int>, VL_MAP_VL_STRING_INT>(buf + offset);
-            is_row_selected =
-                CmpConds<map<string, int> >(&x, &(field_conds[qr.fields[j]]));
-            if (is_row_selected)
-              row[j] = x;
-            break;
-          }
-          case MAP_STRING_DOUBLE: {
-            hid_t field_type = H5Tget_member_type(tb_type, j);
-            size_t nullpos;
-            hsize_t fieldlen;
-            H5Tget_array_dims2(field_type, &fieldlen);
-            unsigned int itemsize = col_sizes_[table][j] / fieldlen;
-            unsigned int strlen = itemsize - sizeof(double);
-            map<string, double> x;
-            for (unsigned int k = 0; k < fieldlen; ++k) {
-              string s = string(buf + offset + itemsize*k, strlen);
-              nullpos = s.find('\0');
-              if (nullpos != std::string::npos)
-                s.resize(nullpos);
-              x[s] = *reinterpret_cast<double*>(buf + offset + itemsize*k + strlen);
-            }
-            is_row_selected =
-                CmpConds<map<string, double> >(&x, &(field_conds[qr.fields[j]]));
-            if (is_row_selected)
-              row[j] = x;
-            H5Tclose(field_type);
-            break;
+          is_row_selected =
+              CmpConds<set<string> >(&x, col_conds[j]);
+          if (is_row_selected)
+            row[j] = x;
+          break;
+        }
+        case SET_VL_STRING: {
+          jlen = tb_sizes[j] / CYCLUS_SHA1_SIZE;
+          set<string> x;
+          for (unsigned int k = 0; k < jlen; ++k) {
+            x.insert(VLRead<string,
+                     VL_STRING>(buf + offset + CYCLUS_SHA1_SIZE*k));
           }
-          case VL_MAP_STRING_DOUBLE: {
-            map<string, double> x =
-              VLRead<map<string, double>, VL_MAP_STRING_DOUBLE>(buf + offset);
-            is_row_selected =
-                CmpConds<map<string, double> >(&x, &(field_conds[qr.fields[j]]));
-            if (is_row_selected)
-              row[j] = x;
-            break;
+          is_row_selected =
+              CmpConds<set<string> >(&x, col_conds[j]);
+          if (is_row_selected)
+            row[j] = x;
+          break;
+        }
+        case VL_SET_STRING: {
+          set<string> x = VLRead<set<string>, VL_SET_STRING>(buf + offset);
+          is_row_selected =
+              CmpConds<set<string> >(&x, col_conds[j]);
+          if (is_row_selected)
+            row[j] = x;
+          break;
+        }
+        case VL_SET_VL_STRING: {
+          set<string> x = VLRead<set<string>, VL_SET_VL_STRING>(buf + offset);
+          is_row_selected =
+              CmpConds<set<string> >(&x, col_conds[j]);
+          if (is_row_selected)
+            row[j] = x;
+          break;
+        }
+        case LIST_INT: {
+          jlen = tb_sizes[j] / sizeof(int);
+          int* xraw = reinterpret_cast<int*>(buf + offset);
+          std::list<int> x = std::list<int>(xraw, xraw+jlen);
+          is_row_selected =
+              CmpConds<std::list<int> >(&x, col_conds[j]);
+          if (is_row_selected)
+            row[j] = x;
+          break;
+        }
+        case VL_LIST_INT: {
+          std::list<int> x =
+              VLRead<std::list<int>, VL_LIST_INT>(buf + offset);
+          is_row_selected =
+              CmpConds<std::list<int> >(&x, col_conds[j]);
+          if (is_row_selected)
+            row[j] = x;
+          break;
+        }
+        case LIST_STRING: {
+          size_t nullpos;
+          hsize_t fieldlen = p->fieldlens[j];
+          unsigned int strlen = tb_sizes[j] / fieldlen;
+          list<string> x;
+          for (unsigned int k = 0; k < fieldlen; ++k) {
+            string s = string(buf + offset + strlen*k, strlen);
+            nullpos = s.find('\0');
+            if (nullpos != std::string::npos)
+              s.resize(nullpos);
+            x.push_back(s);
           }
-          case MAP_STRING_STRING: {
-            hid_t field_type = H5Tget_member_type(tb_type, j);
-            hid_t item_type = H5Tget_super(field_type);
-            hid_t key_type = H5Tget_member_type(item_type, 0);
-            size_t nullpos;
-            hsize_t fieldlen;
-            H5Tget_array_dims2(field_type, &fieldlen);
-            unsigned int itemsize = col_sizes_[table][j] / fieldlen;
-            unsigned int keylen = H5Tget_size(key_type);
-            unsigned int vallen = itemsize - keylen;
-            map<string, string> x;
-            for (unsigned int k = 0; k < fieldlen; ++k) {
-              string key = string(buf + offset + itemsize*k, keylen);
-              nullpos = key.find('\0');
-              if (nullpos != std::string::npos)
-                key.resize(nullpos);
-              string val = string(buf + offset + itemsize*k + keylen, vallen);
-              nullpos = val.find('\0');
-              if (nullpos != std::string::npos)
-                val.resize(nullpos);
-              x[key] = val;
-            }
-            is_row_selected =
-                CmpConds<map<string, string> >(&x, &(field_conds[qr.fields[j]]));
-            if (is_row_selected)
-              row[j] = x;
-            H5Tclose(key_type);
-            H5Tclose(item_type);
-            H5Tclose(field_type);
-            break;
+          is_row_selected =
+              CmpConds<list<string> >(&x, col_conds[j]);
+          if (is_row_selected)
+            row[j] = x;
+          break;
+        }
+        case LIST_VL_STRING: {
+          jlen = tb_sizes[j] / CYCLUS_SHA1_SIZE;
+          list<string> x;
+          for (unsigned int k = 0; k < jlen; ++k) {
+            x.push_back(VLRead<string,
+                        VL_STRING>(buf + offset + CYCLUS_SHA1_SIZE*k));
           }
-          case VL_MAP_STRING_STRING: {
-            map<string, string> x =
-              VLRead<map<string, string>, VL_MAP_STRING_STRING>(buf + offset);
-            is_row_selected =
-                CmpConds<map<string, string> >(&x, &(field_conds[qr.fields[j]]));
-            if (is_row_selected)
-              row[j] = x;
-            break;
+          is_row_selected =
+              CmpConds<list<string> >(&x, col_conds[j]);
+          if (is_row_selected)
+            row[j] = x;
+          break;
+        }
+        case VL_LIST_STRING: {
+          list<string> x = VLRead<list<string>, VL_LIST_STRING>(buf + offset);
+          is_row_selected =
+              CmpConds<list<string> >(&x, col_conds[j]);
+          if (is_row_selected)
+            row[j] = x;
+          break;
+        }
+        case VL_LIST_VL_STRING: {
+          list<string> x =
+              VLRead<list<string>, VL_LIST_VL_STRING>(buf + offset);
+          is_row_selected =
+              CmpConds<list<string> >(&x, col_conds[j]);
+          if (is_row_selected)
+            row[j] = x;
+          break;
+        }
+        case PAIR_INT_INT: {
+          pair<int, int> x =
+              std::make_pair(*reinterpret_cast<int*>(buf + offset),
+                             *reinterpret_cast<int*>(buf + offset + \
+                                                     sizeof(int)));
+          is_row_selected =
+              CmpConds<pair<int, int> >(&x, col_conds[j]);
+          if (is_row_selected)
+            row[j] = x;
+          break;
+        }
+        case PAIR_INT_STRING: {
+          size_t nullpos;
+          unsigned int strlen = tb_sizes[j] - sizeof(int);
+          int xfirst = *reinterpret_cast<int*>(buf + offset);
+          string s = string(buf + offset + sizeof(int), strlen);
+          nullpos = s.find('\0');
+          if (nullpos != std::string::npos)
+            s.resize(nullpos);
+          pair<int, string> x = std::make_pair(xfirst, s);
+          is_row_selected =
+              CmpConds<pair<int, string> >(&x, col_conds[j]);
+          if (is_row_selected)
+            row[j] = x;
+          break;
+        }
+        case PAIR_INT_VL_STRING: {
+          unsigned int itemsize = sizeof(int) + CYCLUS_SHA1_SIZE;
+          jlen = tb_sizes[j] / itemsize;
+          pair<int, string> x = std::make_pair(
+            *reinterpret_cast<int*>(buf + offset),
+            VLRead<string, VL_STRING>(buf + offset + sizeof(int)));
+          is_row_selected =
+              CmpConds<pair<int, string> >(&x, col_conds[j]);
+          if (is_row_selected)
+            row[j] = x;
+          break;
+        }
+        case MAP_INT_INT: {
+          map<int, int> x = map<int, int>();
+          jlen = tb_sizes[j] / (2*sizeof(int));
+          for (unsigned int k = 0; k < jlen; ++k) {
+            x[*reinterpret_cast<int*>(buf + offset + 2*sizeof(int)*k)] = \
+              *reinterpret_cast<int*>(buf + offset + 2*sizeof(int)*k + \
+                                      sizeof(int));
           }
-          case MAP_STRING_VL_STRING: {
-            hid_t field_type = H5Tget_member_type(tb_type, j);
-            size_t nullpos;
-            hsize_t fieldlen;
-            H5Tget_array_dims2(field_type, &fieldlen);
-            unsigned int itemsize = col_sizes_[table][j] / fieldlen;
-            unsigned int keylen = itemsize - CYCLUS_SHA1_SIZE;
-            map<string, string> x;
-            for (unsigned int k = 0; k < fieldlen; ++k) {
-              string key = string(buf + offset + itemsize*k, keylen);
-              nullpos = key.find('\0');
-              if (nullpos != std::string::npos)
-                key.resize(nullpos);
-              x[key] =
-                  VLRead<string, VL_STRING>(buf + offset + itemsize*k + keylen);
-            }
-            is_row_selected =
-                CmpConds<map<string, string> >(&x, &(field_conds[qr.fields[j]]));
-            if (is_row_selected)
-              row[j] = x;
-            H5Tclose(field_type);
-            break;
+          is_row_selected =
+              CmpConds<map<int, int> >(&x, col_conds[j]);
+          if (is_row_selected)
+            row[j] = x;
+          break;
+        }
+        case VL_MAP_INT_INT: {
+          map<int, int> x =
+              VLRead<map<int, int>, VL_MAP_INT_INT>(buf + offset);
+          is_row_selected =
+              CmpConds<map<int, int> >(&x, col_conds[j]);
+          if (is_row_selected)
+            row[j] = x;
+          break;
+        }
+        case MAP_INT_DOUBLE: {
+          map<int, double> x = map<int, double>();
+          size_t itemsize = sizeof(int) + sizeof(double);
+          jlen = tb_sizes[j] / itemsize;
+          for (unsigned int k = 0; k < jlen; ++k) {
+            x[*reinterpret_cast<int*>(buf + offset + itemsize*k)] = \
+              *reinterpret_cast<double*>(buf + offset + itemsize*k + \
+                                         sizeof(int));
           }
-          case VL_MAP_STRING_VL_STRING: {
-            map<string, string> x =
-              VLRead<map<string, string>, VL_MAP_STRING_VL_STRING>(buf + offset);
-            is_row_selected =
-                CmpConds<map<string, string> >(&x, &(field_conds[qr.fields[j]]));
-            if (is_row_selected)
-              row[j] = x;
-            break;
+          is_row_selected =
+              CmpConds<map<int, double> >(&x, col_conds[j]);
+          if (is_row_selected)
+            row[j] = x;
+          break;
+        }
+        case VL_MAP_INT_DOUBLE: {
+          map<int, double> x =
+              VLRead<map<int, double>, VL_MAP_INT_DOUBLE>(buf + offset);
+          is_row_selected =
+              CmpConds<map<int, double> >(&x, col_conds[j]);
+          if (is_row_selected)
+            row[j] = x;
+          break;
+        }
+        case MAP_INT_STRING: {
+          size_t nullpos;
+          hsize_t fieldlen = p->fieldlens[j];
+          unsigned int itemsize = tb_sizes[j] / fieldlen;
+          unsigned int strlen = itemsize - sizeof(int);
+          map<int, string> x;
+          for (unsigned int k = 0; k < fieldlen; ++k) {
+            string s = string(buf + offset + itemsize*k + sizeof(int), strlen);
+            nullpos = s.find('\0');
+            if (nullpos != std::string::npos)
+              s.resize(nullpos);
+            x[*reinterpret_cast<int*>(buf + offset + itemsize*k)] = s;
           }
-          case MAP_VL_STRING_DOUBLE: {
-            unsigned int itemsize = sizeof(double) + CYCLUS_SHA1_SIZE;
-            jlen = col_sizes_[table][j] / itemsize;
-            map<string, double> x;
-            for (unsigned int k = 0; k < jlen; ++k) {
-              x[VLRead<string, VL_STRING>(buf + offset + itemsize*k)] = \
-                *reinterpret_cast<double*>(buf + offset + itemsize*k + CYCLUS_SHA1_SIZE);
-            }
-            is_row_selected =
-                CmpConds<map<string, double> >(&x, &(field_conds[qr.fields[j]]));
-            if (is_row_selected)
-              row[j] = x;
-            break;
+          is_row_selected =
+              CmpConds<map<int, string> >(&x, col_conds[j]);
+          if (is_row_selected)
+            row[j] = x;
+          break;
+        }
+        case MAP_INT_VL_STRING: {
+          unsigned int itemsize = sizeof(int) + CYCLUS_SHA1_SIZE;
+          jlen = tb_sizes[j] / itemsize;
+          map<int, string> x;
+          for (unsigned int k = 0; k < jlen; ++k) {
+            x[*reinterpret_cast<int*>(buf + offset + itemsize*k)] = \
+              VLRead<string, VL_STRING>(buf + offset + itemsize*k + \
+                                        sizeof(int));
           }
-          case VL_MAP_VL_STRING_DOUBLE: {
-            map<string, double> x =
-              VLRead<map<string, double>, VL_MAP_VL_STRING_DOUBLE>(buf + offset);
-            is_row_selected =
-                CmpConds<map<string, double> >(&x, &(field_conds[qr.fields[j]]));
-            if (is_row_selected)
-              row[j] = x;
-            break;
+          is_row_selected =
+              CmpConds<map<int, string> >(&x, col_conds[j]);
+          if (is_row_selected)
+            row[j] = x;
+          break;
+        }
+        case VL_MAP_INT_STRING: {
+          map<int, string> x =
+              VLRead<map<int, string>, VL_MAP_INT_STRING>(buf + offset);
+          is_row_selected =
+              CmpConds<map<int, string> >(&x, col_conds[j]);
+          if (is_row_selected)
+            row[j] = x;
+          break;
+        }
+        case VL_MAP_INT_VL_STRING: {
+          map<int, string> x =
+              VLRead<map<int, string>, VL_MAP_INT_VL_STRING>(buf + offset);
+          is_row_selected =
+              CmpConds<map<int, string> >(&x, col_conds[j]);
+          if (is_row_selected)
+            row[j] = x;
+          break;
+        }
+        case MAP_STRING_INT: {
+          size_t nullpos;
+          hsize_t fieldlen = p->fieldlens[j];
+          unsigned int itemsize = tb_sizes[j] / fieldlen;
+          unsigned int strlen = itemsize - sizeof(int);
+          map<string, int> x;
+          for (unsigned int k = 0; k < fieldlen; ++k) {
+            string s = string(buf + offset + itemsize*k, strlen);
+            nullpos = s.find('\0');
+            if (nullpos != std::string::npos)
+              s.resize(nullpos);
+            x[s] = *reinterpret_cast<int*>(buf + offset + itemsize*k + strlen);
           }
-          case MAP_VL_STRING_STRING: {
-            hid_t field_type = H5Tget_member_type(tb_type, j);
-            size_t nullpos;
-            hsize_t fieldlen;
-            H5Tget_array_dims2(field_type, &fieldlen);
-            unsigned int itemsize = col_sizes_[table][j] / fieldlen;
-            unsigned int vallen = itemsize - CYCLUS_SHA1_SIZE;
-            map<string, string> x;
-            for (unsigned int k = 0; k < fieldlen; ++k) {
-              string val = string(buf + offset + itemsize*k + CYCLUS_SHA1_SIZE, vallen);
-              nullpos = val.find('\0');
-              if (nullpos != std::string::npos)
-                val.resize(nullpos);
-              x[VLRead<string, VL_STRING>(buf + offset + itemsize*k)] = val;
-            }
-            is_row_selected =
-                CmpConds<map<string, string> >(&x, &(field_conds[qr.fields[j]]));
-            if (is_row_selected)
-              row[j] = x;
-            H5Tclose(field_type);
-            break;
+          is_row_selected =
+              CmpConds<map<string, int> >(&x, col_conds[j]);
+          if (is_row_selected)
+            row[j] = x;
+          break;
+        }
+        case VL_MAP_STRING_INT: {
+          map<string, int> x =
+              VLRead<map<string, int>, VL_MAP_STRING_INT>(buf + offset);
+          is_row_selected =
+              CmpConds<map<string, int> >(&x, col_conds[j]);
+          if (is_row_selected)
+            row[j] = x;
+          break;
+        }
+        case MAP_VL_STRING_INT: {
+          unsigned int itemsize = sizeof(int) + CYCLUS_SHA1_SIZE;
+          jlen = tb_sizes[j] / itemsize;
+          map<string, int> x;
+          for (unsigned int k = 0; k < jlen; ++k) {
+            x[VLRead<string, VL_STRING>(buf + offset + itemsize*k)] = \
+              *reinterpret_cast<int*>(buf + offset + itemsize*k + CYCLUS_SHA1_SIZE);
           }
-          case VL_MAP_VL_STRING_STRING: {
-            map<string, string> x = \
-              VLRead<map<string, string>, VL_MAP_VL_STRING_STRING>(buf + offset);
-            is_row_selected =
-                CmpConds<map<string, string> >(&x, &(field_conds[qr.fields[j]]));
-            if (is_row_selected)
-              row[j] = x;
-            break;
+          is_row_selected =
+              CmpConds<map<string, int> >(&x, col_conds[j]);
+          if (is_row_selected)
+            row[j] = x;
+          break;
+        }
+        case VL_MAP_VL_STRING_INT: {
+          map<string, int> x =
+              VLRead<map<string, int>, VL_MAP_VL_STRING_INT>(buf + offset);
+          is_row_selected =
+              CmpConds<map<string, int> >(&x, col_conds[j]);
+          if (is_row_selected)
+            row[j] = x;
+          break;
+        }
+        case MAP_STRING_DOUBLE: {
+          size_t nullpos;
+          hsize_t fieldlen = p->fieldlens[j];
+          unsigned int itemsize = tb_sizes[j] / fieldlen;
+          unsigned int strlen = itemsize - sizeof(double);
+          map<string, double> x;
+          for (unsigned int k = 0; k < fieldlen; ++k) {
+            string s = string(buf + offset + itemsize*k, strlen);
+            nullpos = s.find('\0');
+            if (nullpos != std::string::npos)
+              s.resize(nullpos);
+            x[s] = *reinterpret_cast<double*>(buf + offset + itemsize*k + strlen);
           }
-          case MAP_VL_STRING_VL_STRING: {
-            hid_t field_type = H5Tget_member_type(tb_type, j);
-            size_t nullpos;
-            hsize_t fieldlen;
-            H5Tget_array_dims2(field_type, &fieldlen);
-            unsigned int itemsize = 2*CYCLUS_SHA1_SIZE;
-            map<string, string> x;
-            for (unsigned int k = 0; k < fieldlen; ++k) {
-              x[VLRead<string, VL_STRING>(buf + offset + itemsize*k)] = \
-                VLRead<string, VL_STRING>(buf + offset + itemsize*k + CYCLUS_SHA1_SIZE);
-            }
-            is_row_selected =
-                CmpConds<map<string, string> >(&x, &(field_conds[qr.fields[j]]));
-            if (is_row_selected)
-              row[j] = x;
-            H5Tclose(field_type);
-            break;
+          is_row_selected =
+              CmpConds<map<string, double> >(&x, col_conds[j]);
+          if (is_row_selected)
+            row[j] = x;
+          break;
+        }
+        case VL_MAP_STRING_DOUBLE: {
+          map<string, double> x =
+            VLRead<map<string, double>, VL_MAP_STRING_DOUBLE>(buf + offset);
+          is_row_selected =
+              CmpConds<map<string, double> >(&x, col_conds[j]);
+          if (is_row_selected)
+            row[j] = x;
+          break;
+        }
+        case MAP_STRING_STRING: {
+          size_t nullpos;
+          hsize_t fieldlen = p->fieldlens[j];
+          unsigned int itemsize = tb_sizes[j] / fieldlen;
+          unsigned int keylen = p->keylens[j];
+          unsigned int vallen = itemsize - keylen;
+          map<string, string> x;
+          for (unsigned int k = 0; k < fieldlen; ++k) {
+            string key = string(buf + offset + itemsize*k, keylen);
+            nullpos = key.find('\0');
+            if (nullpos != std::string::npos)
+              key.resize(nullpos);
+            string val = string(buf + offset + itemsize*k + keylen, vallen);
+            nullpos = val.find('\0');
+            if (nullpos != std::string::npos)
+              val.resize(nullpos);
+            x[key] = val;
           }
-          case VL_MAP_VL_STRING_VL_STRING: {
-            map<string, string> x = \
-              VLRead<map<string, string>, VL_MAP_VL_STRING_VL_STRING>(buf + offset);
-            is_row_selected =
-                CmpConds<map<string, string> >(&x, &(field_conds[qr.fields[j]]));
-            if (is_row_selected)
-              row[j] = x;
-            break;
+          is_row_selected =
+              CmpConds<map<string, string> >(&x, col_conds[j]);
+          if (is_row_selected)
+            row[j] = x;
+          break;
+        }
+        case VL_MAP_STRING_STRING: {
+          map<string, string> x =
+            VLRead<map<string, string>, VL_MAP_STRING_STRING>(buf + offset);
+          is_row_selected =
+              CmpConds<map<string, string> >(&x, col_conds[j]);
+          if (is_row_selected)
+            row[j] = x;
+          break;
+        }
+        case MAP_STRING_VL_STRING: {
+          size_t nullpos;
+          hsize_t fieldlen = p->fieldlens[j];
+          unsigned int itemsize = tb_sizes[j] / fieldlen;
+          unsigned int keylen = itemsize - CYCLUS_SHA1_SIZE;
+          map<string, string> x;
+          for (unsigned int k = 0; k < fieldlen; ++k) {
+            string key = string(buf + offset + itemsize*k, keylen);
+            nullpos = key.find('\0');
+            if (nullpos != std::string::npos)
+              key.resize(nullpos);
+            x[key] =
+                VLRead<string, VL_STRING>(buf + offset + itemsize*k + keylen);
           }
-          case MAP_PAIR_INT_STRING_DOUBLE: {
-            hid_t field_type = H5Tget_member_type(tb_type, j);
-            size_t nullpos;
-            hsize_t fieldlen;
-            H5Tget_array_dims2(field_type, &fieldlen);
-            unsigned int itemsize = col_sizes_[table][j] / fieldlen;
-            unsigned int strlen = itemsize - sizeof(int) - sizeof(double);
-            pair<int, string> key;
-            map<pair<int, string>, double> x;
-            for (unsigned int k = 0; k < fieldlen; ++k) {
-              string s = string(buf + offset + itemsize*k + sizeof(int), strlen);
-              nullpos = s.find('\0');
-              if (nullpos != std::string::npos)
-                s.resize(nullpos);
-              key = std::make_pair(
-                *reinterpret_cast<int*>(buf + offset + itemsize*k), s);
-              x[key] = *reinterpret_cast<double*>(buf + offset + itemsize*k + \
-                                                  sizeof(int) + strlen);
-            }
-            is_row_selected = CmpConds<map<pair<int, string>, double> >(&x, 
-              &(field_conds[qr.fields[j]]));
-            if (is_row_selected)
-              row[j] = x;
-            H5Tclose(field_type);
-            break;
+          is_row_selected =
+              CmpConds<map<string, string> >(&x, col_conds[j]);
+          if (is_row_selected)
+            row[j] = x;
+          break;
+        }
+        case VL_MAP_STRING_VL_STRING: {
+          map<string, string> x =
+            VLRead<map<string, string>, VL_MAP_STRING_VL_STRING>(buf + offset);
+          is_row_selected =
+              CmpConds<map<string, string> >(&x, col_conds[j]);
+          if (is_row_selected)
+            row[j] = x;
+          break;
+        }
+        case MAP_VL_STRING_DOUBLE: {
+          unsigned int itemsize = sizeof(double) + CYCLUS_SHA1_SIZE;
+          jlen = tb_sizes[j] / itemsize;
+          map<string, double> x;
+          for (unsigned int k = 0; k < jlen; ++k) {
+            x[VLRead<string, VL_STRING>(buf + offset + itemsize*k)] = \
+              *reinterpret_cast<double*>(buf + offset + itemsize*k + CYCLUS_SHA1_SIZE);
           }
-          case VL_MAP_PAIR_INT_STRING_DOUBLE: {
-            map<pair<int, string>, double> x = VLRead<map<pair<int, string>, double>, 
-                                                      VL_MAP_PAIR_INT_STRING_DOUBLE>(
-                buf + offset);
-            is_row_selected = CmpConds<map<pair<int, string>, double> >(
-              &x, &(field_conds[qr.fields[j]]));
-            if (is_row_selected)
-              row[j] = x;
-            break;
+          is_row_selected =
+              CmpConds<map<string, double> >(&x, col_conds[j]);
+          if (is_row_selected)
+            row[j] = x;
+          break;
+        }
+        case VL_MAP_VL_STRING_DOUBLE: {
+          map<string, double> x =
+            VLRead<map<string, double>, VL_MAP_VL_STRING_DOUBLE>(buf + offset);
+          is_row_selected =
+              CmpConds<map<string, double> >(&x, col_conds[j]);
+          if (is_row_selected)
+            row[j] = x;
+          break;
+        }
+        case MAP_VL_STRING_STRING: {
+          size_t nullpos;
+          hsize_t fieldlen = p->fieldlens[j];
+          unsigned int itemsize = tb_sizes[j] / fieldlen;
+          unsigned int vallen = itemsize - CYCLUS_SHA1_SIZE;
+          map<string, string> x;
+          for (unsigned int k = 0; k < fieldlen; ++k) {
+            string val = string(buf + offset + itemsize*k + CYCLUS_SHA1_SIZE, vallen);
+            nullpos = val.find('\0');
+            if (nullpos != std::string::npos)
+              val.resize(nullpos);
+            x[VLRead<string, VL_STRING>(buf + offset + itemsize*k)] = val;
           }
-          case MAP_PAIR_INT_VL_STRING_DOUBLE: {
-            unsigned int itemsize = sizeof(int) + CYCLUS_SHA1_SIZE + sizeof(double);
-            jlen = col_sizes_[table][j] / itemsize;
-            pair<int, string> key;
-            map<pair<int, string>, double> x;
-            for (unsigned int k = 0; k < jlen; ++k) {
-              key = std::make_pair(*reinterpret_cast<int*>(buf + offset + itemsize*k),
-                VLRead<string, VL_STRING>(buf + offset + itemsize*k + sizeof(int)));
-              x[key] = *reinterpret_cast<double*>(buf + offset + itemsize*k + \
-                sizeof(int) + CYCLUS_SHA1_SIZE);
-            }
-            is_row_selected = CmpConds<map<pair<int, string>, double> >(
-              &x, &(field_conds[qr.fields[j]]));
-            if (is_row_selected)
-              row[j] = x;
-            break;
+          is_row_selected =
+              CmpConds<map<string, string> >(&x, col_conds[j]);
+          if (is_row_selected)
+            row[j] = x;
+          break;
+        }
+        case VL_MAP_VL_STRING_STRING: {
+          map<string, string> x = \
+            VLRead<map<string, string>, VL_MAP_VL_STRING_STRING>(buf + offset);
+          is_row_selected =
+              CmpConds<map<string, string> >(&x, col_conds[j]);
+          if (is_row_selected)
+            row[j] = x;
+          break;
+        }
+        case MAP_VL_STRING_VL_STRING: {
+          size_t nullpos;
+          hsize_t fieldlen = p->fieldlens[j];
+          unsigned int itemsize = 2*CYCLUS_SHA1_SIZE;
+          map<string, string> x;
+          for (unsigned int k = 0; k < fieldlen; ++k) {
+            x[VLRead<string, VL_STRING>(buf + offset + itemsize*k)] = \
+              VLRead<string, VL_STRING>(buf + offset + itemsize*k + CYCLUS_SHA1_SIZE);
           }
-          case VL_MAP_PAIR_INT_VL_STRING_DOUBLE: {
-            map<pair<int, string>, double> x = VLRead<map<pair<int, string>, double>, 
-              VL_MAP_PAIR_INT_VL_STRING_DOUBLE>(buf + offset);
-            is_row_selected = CmpConds<map<pair<int, string>, double> >(
-              &x, &(field_conds[qr.fields[j]]));
-            if (is_row_selected)
-              row[j] = x;
-            break;
+          is_row_selected =
+              CmpConds<map<string, string> >(&x, col_conds[j]);
+          if (is_row_selected)
+            row[j] = x;
+          break;
+        }
+        case VL_MAP_VL_STRING_VL_STRING: {
+          map<string, string> x = \
+            VLRead<map<string, string>, VL_MAP_VL_STRING_VL_STRING>(buf + offset);
+          is_row_selected =
+              CmpConds<map<string, string> >(&x, col_conds[j]);
+          if (is_row_selected)
+            row[j] = x;
+          break;
+        }
+        case MAP_PAIR_INT_STRING_DOUBLE: {
+          size_t nullpos;
+          hsize_t fieldlen = p->fieldlens[j];
+          unsigned int itemsize = tb_sizes[j] / fieldlen;
+          unsigned int strlen = itemsize - sizeof(int) - sizeof(double);
+          pair<int, string> key;
+          map<pair<int, string>, double> x;
+          for (unsigned int k = 0; k < fieldlen; ++k) {
+            string s = string(buf + offset + itemsize*k + sizeof(int), strlen);
+            nullpos = s.find('\0');
+            if (nullpos != std::string::npos)
+              s.resize(nullpos);
+            key = std::make_pair(
+              *reinterpret_cast<int*>(buf + offset + itemsize*k), s);
+            x[key] = *reinterpret_cast<double*>(buf + offset + itemsize*k + \
+                                                sizeof(int) + strlen);
           }
-          default: {
-            throw IOError("querying column '" + qr.fields[j] + "' in table '" + \
-                          table + "' failed due to unsupported data type.");
-            break;
+          is_row_selected = CmpConds<map<pair<int, string>, double> >(&x, 
+            col_conds[j]);
+          if (is_row_selected)
+            row[j] = x;
+          break;
+        }
+        case VL_MAP_PAIR_INT_STRING_DOUBLE: {
+          map<pair<int, string>, double> x = VLRead<map<pair<int, string>, double>, 
+                                                    VL_MAP_PAIR_INT_STRING_DOUBLE>(
+              buf + offset);
+          is_row_selected = CmpConds<map<pair<int, string>, double> >(
+            &x, col_conds[j]);
+          if (is_row_selected)
+            row[j] = x;
+          break;
+        }
+        case MAP_PAIR_INT_VL_STRING_DOUBLE: {
+          unsigned int itemsize = sizeof(int) + CYCLUS_SHA1_SIZE + sizeof(double);
+          jlen = tb_sizes[j] / itemsize;
+          pair<int, string> key;
+          map<pair<int, string>, double> x;
+          for (unsigned int k = 0; k < jlen; ++k) {
+            key = std::make_pair(*reinterpret_cast<int*>(buf + offset + itemsize*k),
+              VLRead<string, VL_STRING>(buf + offset + itemsize*k + sizeof(int)));
+            x[key] = *reinterpret_cast<double*>(buf + offset + itemsize*k + \
+              sizeof(int) + CYCLUS_SHA1_SIZE);
           }
+          is_row_selected = CmpConds<map<pair<int, string>, double> >(
+            &x, col_conds[j]);
+          if (is_row_selected)
+            row[j] = x;
+          break;
         }
-        if (!is_row_selected)
+        case VL_MAP_PAIR_INT_VL_STRING_DOUBLE: {
+          map<pair<int, string>, double> x = VLRead<map<pair<int, string>, double>, 
+            VL_MAP_PAIR_INT_VL_STRING_DOUBLE>(buf + offset);
+          is_row_selected = CmpConds<map<pair<int, string>, double> >(
+            &x, col_conds[j]);
+          if (is_row_selected)
+            row[j] = x;
           break;
-        offset += col_sizes_[table][j];
-      }
-      if (is_row_selected) {
-        qr.rows.push_back(row);
+        }
+        default: {
+          throw IOError("querying column '" + qr.fields[j] + "' in table '" + \
+                        table + "' failed due to unsupported data type.");
+          break;
+        }
       }
+      if (!is_row_selected)
+        break;
+      offset += tb_sizes[j];
+    }
+    if (is_row_selected) {
+      rows->push_back(row);
     }
-    delete[] buf;
-    H5Sclose(memspace);
   }
-
-  // close and return
-  H5Tclose(tb_type);
-  H5Pclose(tb_plist);
-  H5Sclose(tb_space);
-  H5Dclose(tb_set);
-  return qr;
 }
 
 QueryResult Hdf5Back::GetTableInfo(std::string title, hid_t dset, hid_t dt) {
@@ -1081,10 +1797,10 @@ void Hdf5Back::CreateTable(Datum* d) {
   using std::pair;
   using std::list;
   using std::map;
-  Datum::Vals vals = d->vals();
+  const Datum::Vals& vals = d->vals();
   hsize_t nvals = vals.size();
   Datum::Shape shape;
-  Datum::Shapes shapes = d->shapes();
+  const Datum::Shapes& shapes = d->shapes();
 
   herr_t status;
   size_t dst_size = 0;
@@ -1664,7 +2380,8 @@ void Hdf5Back::CreateTable(Datum* d) {
     dst_size += dst_sizes[i];
   }
 
-  const char* title = d->title().c_str();
+  std::string title_str = d->title();
+  const char* title = title_str.c_str();
   int compress = 1;
   int chunk_size = 1024;
   void* fill_data = NULL;
@@ -1751,7 +2468,9 @@ std::set<std::string> Hdf5Back::Tables() {
                                  NULL, 0, H5P_DEFAULT);
     H5Lget_name_by_idx(root, ".", H5_INDEX_NAME, H5_ITER_NATIVE, i,
                        name, namelen+1, H5P_DEFAULT);
-    rtn.insert(string(name, namelen));
+    string tab(name, namelen);
+    if (tab != kZoneMaps)
+      rtn.insert(tab);
   }
   H5Gclose(root);
   return rtn;
@@ -1786,6 +2505,7 @@ void Hdf5Back::WriteGroup(DatumList& group) {
   hsize_t offset[1];
   hsize_t count[1];
   H5TBget_table_info(file_, c_title, &nfields, &nrecords_orig);
+  ZoneMap* zm = GetZoneMap(title, dset, nfields);
   dims[0] = nrecords_add + nrecords_orig;
   offset[0] = nrecords_orig;
   count[0] = nrecords_add;
@@ -1803,7 +2523,7 @@ void Hdf5Back::WriteGroup(DatumList& group) {
        << "  table     " << title << "\n" \
        << "  num. rows " << group.size() << "\n"
        << "  rowsize   " << rowsize << "\n";
-    for (int i = 0; i < group.front()->vals().size(); ++i) {
+    for (int i = 0; i < group.front()->nfields(); ++i) {
       ss << "    # Column " << i << "\n" \
          << "      dbtype: " << schemas_[title][i] << "\n" \
          << "      size:   " << sizes[i] << "\n" \
@@ -1812,6 +2532,12 @@ void Hdf5Back::WriteGroup(DatumList& group) {
     throw IOError(ss.str());
   }
 
+  if (!zm->cols.empty()) {
+    hsize_t first = std::min(zm->nrows / zm->chunksize, zm->nsaved);
+    UpdateZoneMap(title, zm, buf, nrecords_add);
+    SaveZoneMap(title, zm, first);
+  }
+
   H5Sclose(memspace);
   H5Sclose(dspace);
   H5Tclose(dtype);
@@ -1819,6 +2545,169 @@ void Hdf5Back::WriteGroup(DatumList& group) {
   delete[] buf;
 }
 
+Hdf5Back::ZoneMap* Hdf5Back::GetZoneMap(std::string title, hid_t dset,
+                                        hsize_t ncols) {
+  if (zonemaps_.count(title) > 0)
+    return &zonemaps_[title];
+
+  LoadTableTypes(title, dset, ncols);
+  ZoneMap& zm = zonemaps_[title];
+  DbTypes* dbtypes = schemas_[title];
+  for (int i = 0; i < ncols; ++i) {
+    if (dbtypes[i] == INT)
+      zm.cols.push_back(i);
+  }
+  zm.chunksize = 0;
+  zm.nrows = 0;
+  zm.nsaved = 0;
+  hid_t plist = H5Dget_create_plist(dset);
+  if (H5Pget_chunk(plist, 1, &zm.chunksize) < 1 || zm.chunksize == 0)
+    zm.cols.clear();
+  H5Pclose(plist);
+  if (zm.cols.empty())
+    return &zm;
+  hid_t dspace = H5Dget_space(dset);
+  hsize_t nrows = H5Sget_simple_extent_npoints(dspace);
+  H5Sclose(dspace);
+
+  // load the stored zone map if it is consistent with the table
+  hsize_t nchunks = nrows / zm.chunksize + (nrows % zm.chunksize == 0 ? 0 : 1);
+  hsize_t width = 2 * zm.cols.size();
+  std::string zmname = std::string(kZoneMaps) + "/" + title;
+  if (H5Lexists(file_, kZoneMaps, H5P_DEFAULT) &&
+      H5Lexists(file_, zmname.c_str(), H5P_DEFAULT)) {
+    hid_t zmset = H5Dopen2(file_, zmname.c_str(), H5P_DEFAULT);
+    hid_t zmspace = H5Dget_space(zmset);
+    hsize_t dims[2] = {0, 0};
+    H5Sget_simple_extent_dims(zmspace, dims, NULL);
+    if (dims[0] == nchunks && dims[1] == width) {
+      zm.bounds.resize(nchunks * width);
+      if (nchunks == 0 || H5Dread(zmset, H5T_NATIVE_INT, H5S_ALL, H5S_ALL,
+                                  H5P_DEFAULT, &zm.bounds[0]) >= 0) {
+        zm.nrows = nrows;
+        zm.nsaved = nchunks;
+      } else {
+        zm.bounds.clear();
+      }
+    }
+    H5Sclose(zmspace);
+    H5Dclose(zmset);
+  }
+  if (zm.nrows == nrows)
+    return &zm;
+
+  // otherwise build it from the table, one chunk at a time
+  hid_t dtype = H5Dget_type(dset);
+  size_t rowsize = H5Tget_size(dtype);
+  dspace = H5Dget_space(dset);
+  char* buf = new char[rowsize * zm.chunksize];
+  for (hsize_t start = 0; start < nrows; start += zm.chunksize) {
+    hsize_t count = std::min(zm.chunksize, nrows - start);
+    hid_t memspace = H5Screate_simple(1, &count, NULL);
+    H5Sselect_hyperslab(dspace, H5S_SELECT_SET, &start, NULL, &count, NULL);
+    herr_t status = H5Dread(dset, dtype, memspace, dspace, H5P_DEFAULT, buf);
+    H5Sclose(memspace);
+    if (status < 0) {
+      delete[] buf;
+      H5Sclose(dspace);
+      H5Tclose(dtype);
+      throw IOError("could not read table '" + title + "' to build its zone "
+                    "map in the database '" + path_ + "'.");
+    }
+    UpdateZoneMap(title, &zm, buf, count);
+  }
+  delete[] buf;
+  H5Sclose(dspace);
+  H5Tclose(dtype);
+  return &zm;
+}
+
+void Hdf5Back::UpdateZoneMap(std::string title, ZoneMap* zm, const char* buf,
+                             hsize_t nrows) {
+  size_t* offsets = col_offsets_[title];
+  size_t rowsize = schema_sizes_[title];
+  size_t ncols = zm->cols.size();
+  for (hsize_t r = 0; r < nrows; ++r) {
+    hsize_t row = zm->nrows + r;
+    hsize_t chunk = row / zm->chunksize;
+    bool fresh = row % zm->chunksize == 0;
+    if (fresh)
+      zm->bounds.resize((chunk + 1) * ncols * 2);
+    int* b = &zm->bounds[chunk * ncols * 2];
+    for (size_t c = 0; c < ncols; ++c) {
+      int x;
+      memcpy(&x, buf + r * rowsize + offsets[zm->cols[c]], sizeof(int));
+      if (fresh || x < b[2 * c])
+        b[2 * c] = x;
+      if (fresh || x > b[2 * c + 1])
+        b[2 * c + 1] = x;
+    }
+  }
+  zm->nrows += nrows;
+}
+
+void Hdf5Back::SaveZoneMap(std::string title, ZoneMap* zm, hsize_t first) {
+  hsize_t width = 2 * zm->cols.size();
+  hsize_t nchunks = zm->bounds.size() / width;
+  if (first >= nchunks)
+    return;
+
+  std::string zmname = std::string(kZoneMaps) + "/" + title;
+  hid_t zmset;
+  if (!H5Lexists(file_, kZoneMaps, H5P_DEFAULT)) {
+    hid_t grp = H5Gcreate2(file_, kZoneMaps, H5P_DEFAULT, H5P_DEFAULT,
+                           H5P_DEFAULT);
+    H5Gclose(grp);
+  }
+  zmset = -1;
+  if (H5Lexists(file_, zmname.c_str(), H5P_DEFAULT)) {
+    // replace stored zone maps that don't match the table's schema
+    zmset = H5Dopen2(file_, zmname.c_str(), H5P_DEFAULT);
+    hid_t space = H5Dget_space(zmset);
+    hsize_t dims[2] = {0, 0};
+    H5Sget_simple_extent_dims(space, dims, NULL);
+    H5Sclose(space);
+    if (dims[1] != width) {
+      H5Dclose(zmset);
+      H5Ldelete(file_, zmname.c_str(), H5P_DEFAULT);
+      zmset = -1;
+    }
+  }
+  if (zmset < 0) {
+    first = 0;
+    hsize_t dims[2] = {0, width};
+    hsize_t maxdims[2] = {H5S_UNLIMITED, width};
+    hsize_t chunkdims[2] = {64, width};
+    hid_t space = H5Screate_simple(2, dims, maxdims);
+    hid_t prop = H5Pcreate(H5P_DATASET_CREATE);
+    H5Pset_chunk(prop, 2, chunkdims);
+    zmset = H5Dcreate2(file_, zmname.c_str(), H5T_NATIVE_INT, space,
+                       H5P_DEFAULT, prop, H5P_DEFAULT);
+    H5Pclose(prop);
+    H5Sclose(space);
+  }
+
+  hsize_t dims[2] = {nchunks, width};
+  herr_t status = H5Dset_extent(zmset, dims);
+  hid_t dspace = H5Dget_space(zmset);
+  hsize_t start[2] = {first, 0};
+  hsize_t count[2] = {nchunks - first, width};
+  hid_t memspace = H5Screate_simple(2, count, NULL);
+  if (status >= 0)
+    status = H5Sselect_hyperslab(dspace, H5S_SELECT_SET, start, NULL, count,
+                                 NULL);
+  if (status >= 0)
+    status = H5Dwrite(zmset, H5T_NATIVE_INT, memspace, dspace, H5P_DEFAULT,
+                      &zm->bounds[first * width]);
+  H5Sclose(memspace);
+  H5Sclose(dspace);
+  H5Dclose(zmset);
+  if (status < 0)
+    throw IOError("could not write the zone map of table '" + title +
+                  "' in the database '" + path_ + "'.");
+  zm->nsaved = nchunks;
+}
+
 template <typename T, DbTypes U>
 Digest Hdf5Back::VLWrite(const T& x) {
   hasher_.Clear();
@@ -1826,7 +2715,7 @@ Digest Hdf5Back::VLWrite(const T& x) {
   Digest key = hasher_.digest();
   hid_t keysds = VLDataset(U, true);
   hid_t valsds = VLDataset(U, false);
-  if (vlkeys_[U].count(key) == 1)
+  if (VLKeyStatus(keysds, valsds, U, key) == DigestIndex::PRESENT)
     return key;
   hvl_t buf = VLValToBuf(x);
   AppendVLKey(keysds, U, key);
@@ -1836,29 +2725,24 @@ Digest Hdf5Back::VLWrite(const T& x) {
 
 template <>
 Digest Hdf5Back::VLWrite<std::string, VL_STRING>(const std::string& x) {
-  hasher_.Clear();
-  hasher_.Update(x);
-  Digest key = hasher_.digest();
-  hid_t keysds = VLDataset(VL_STRING, true);
-  hid_t valsds = VLDataset(VL_STRING, false);
-  if (vlkeys_[VL_STRING].count(key) == 1)
-    return key;
-  AppendVLKey(keysds, VL_STRING, key);
-  InsertVLVal(valsds, VL_STRING, key, x);
-  return key;
+  return VLWriteBytes(VL_STRING, x.c_str(), x.size());
 }
 
 template <>
 Digest Hdf5Back::VLWrite<Blob, BLOB>(const Blob& x) {
+  return VLWriteBytes(BLOB, x.str().c_str(), x.str().size());
+}
+
+Digest Hdf5Back::VLWriteBytes(DbTypes dbtype, const char* x, size_t n) {
   hasher_.Clear();
-  hasher_.Update(x);
+  hasher_.Update(x, n);
   Digest key = hasher_.digest();
-  hid_t keysds = VLDataset(BLOB, true);
-  hid_t valsds = VLDataset(BLOB, false);
-  if (vlkeys_[BLOB].count(key) == 1)
+  hid_t keysds = VLDataset(dbtype, true);
+  hid_t valsds = VLDataset(dbtype, false);
+  if (VLKeyStatus(keysds, valsds, dbtype, key) == DigestIndex::PRESENT)
     return key;
-  AppendVLKey(keysds, BLOB, key);
-  InsertVLVal(valsds, BLOB, key, x.str());
+  AppendVLKey(keysds, dbtype, key);
+  InsertVLVal(valsds, dbtype, key, std::string(x, n));
   return key;
 }
 
@@ -1871,11 +2755,8 @@ void Hdf5Back::FillBuf(std::string title, char* buf, DatumList& group,
   using std::list;
   using std::pair;
   using std::map;
-  Datum::Vals vals;
   Datum::Shape shape;
-  Datum::Shapes shapes;
-  Datum::Vals header = group.front()->vals();
-  int ncols = header.size();
+  int ncols = group.front()->nfields();
   DbTypes* dbtypes = schemas_[title];
 
   size_t offset = 0;
@@ -1884,40 +2765,39 @@ void Hdf5Back::FillBuf(std::string title, char* buf, DatumList& group,
   size_t valuelen;
   DatumList::iterator it;
   for (it = group.begin(); it != group.end(); ++it) {
-    vals = (*it)->vals();
-    shapes = (*it)->shapes();
+    Datum* d = *it;
+    const Datum::Shapes& shapes = d->shapes();
     for (int col = 0; col < ncols; ++col) {
-      const boost::spirit::hold_any* a = &(vals[col].second);
+      // scalars, strings, blobs, and uuids are read straight from the datum's
+      // row buffer; only containers are boxed
+      const Datum::Field& field = d->field(col);
+      const boost::spirit::hold_any* a = NULL;
+      if (field.type == Datum::ANY_FIELD)
+        a = &d->box(col);
       switch (dbtypes[col]) {
         case BOOL:
         case INT:
         case FLOAT:
         case DOUBLE: {
-          val = a->castsmallvoid();
+          val = a == NULL ? d->data(col) : a->castsmallvoid();
           memcpy(buf + offset, val, sizes[col]);
           break;
         }
         case STRING: {
-          const std::string s = a->cast<std::string>();
           fieldlen = sizes[col];
-          valuelen = std::min(s.size(), fieldlen);
-          memcpy(buf + offset, s.c_str(), valuelen);
+          valuelen = std::min(field.size, fieldlen);
+          memcpy(buf + offset, d->data(col), valuelen);
           memset(buf + offset + valuelen, 0, fieldlen - valuelen);
           break;
         }
-        case VL_STRING: {
-          Digest key = VLWrite<std::string, VL_STRING>(a);
-          memcpy(buf + offset, key.val, CYCLUS_SHA1_SIZE);
-          break;
-        }
+        case VL_STRING:
         case BLOB: {
-          Digest key = VLWrite<Blob, BLOB>(a);
+          Digest key = VLWriteBytes(dbtypes[col], d->data(col), field.size);
           memcpy(buf + offset, key.val, CYCLUS_SHA1_SIZE);
           break;
         }
         case UUID: {
-          boost::uuids::uuid uuid = a->cast<boost::uuids::uuid>();
-          memcpy(buf + offset, &uuid, CYCLUS_UUID_SIZE);
+          memcpy(buf + offset, d->data(col), CYCLUS_UUID_SIZE);
           break;
         }
         case VECTOR_INT: {
@@ -2533,6 +3413,11 @@ void Hdf5Back::FillBuf(std::string title, char* buf, DatumList& group,
 
 template <typename T, DbTypes U>
 T Hdf5Back::VLRead(const char* rawkey) {
+  const char* batched = BatchedVL(U, rawkey);
+  if (batched != NULL)
+    return VLBufToVal<T>(*reinterpret_cast<const hvl_t*>(batched));
+  std::lock_guard<std::recursive_mutex> lock(h5_mu_);
+  ++n_vl_reads_;
   // key is used as offset
   Digest key;
   memcpy(key.val, rawkey, CYCLUS_SHA1_SIZE);
@@ -2665,20 +3550,25 @@ hid_t Hdf5Back::VLDataset(DbTypes dbtype, bool forkeys) {
   if (H5Lexists(file_, name.c_str(), H5P_DEFAULT)) {
     dset = H5Dopen2(file_, name.c_str(), H5P_DEFAULT);
     if (forkeys) {
-      // read in existing keys to vlkeys_
+      // read in existing keys to vlkeys_, a block at a time
       dspace = H5Dget_space(dset);
-      unsigned int nkeys = H5Sget_simple_extent_npoints(dspace);
-      char* buf = new char[CYCLUS_SHA1_SIZE * nkeys];
-      status = H5Dread(dset, sha1_type_, H5S_ALL, H5S_ALL, H5P_DEFAULT, buf);
-      if (status < 0)
-        throw IOError("failed to read in keys for " + name);
-      for (int n = 0; n < nkeys; ++n) {
-        Digest d = Digest();
-        memcpy(d.val, buf + (n * CYCLUS_SHA1_SIZE), CYCLUS_SHA1_SIZE);
-        vlkeys_[dbtype].insert(d);
+      hsize_t nkeys = H5Sget_simple_extent_npoints(dspace);
+      hsize_t block = 4096;
+      std::vector<Digest> buf(block);
+      for (hsize_t start = 0; start < nkeys; start += block) {
+        hsize_t count = std::min(block, nkeys - start);
+        hid_t mspace = H5Screate_simple(1, &count, NULL);
+        H5Sselect_hyperslab(dspace, H5S_SELECT_SET, &start, NULL, &count,
+                            NULL);
+        status = H5Dread(dset, sha1_type_, mspace, dspace, H5P_DEFAULT,
+                         &buf[0]);
+        H5Sclose(mspace);
+        if (status < 0)
+          throw IOError("failed to read in keys for " + name);
+        for (int n = 0; n < count; ++n)
+          vlkeys_.Insert(dbtype, buf[n]);
       }
       H5Sclose(dspace);
-      delete[] buf;
     } else {
       if (vldts_.count(dbtype) == 0) {
         dt = H5Dget_type(dset);
@@ -2739,7 +3629,59 @@ void Hdf5Back::AppendVLKey(hid_t dset, DbTypes dbtype, const Digest& key) {
                   "in the database '" + path_ + "'.");
   H5Sclose(mspace);
   H5Sclose(dspace);
-  vlkeys_[dbtype].insert(key);
+  vlkeys_.Insert(dbtype, key);
+}
+
+DigestIndex::Status Hdf5Back::VLKeyStatus(hid_t keysds, hid_t valsds,
+                                          DbTypes dbtype,
+                                          const Digest& key) {
+  DigestIndex::Status status = vlkeys_.Find(dbtype, key);
+  if (status != DigestIndex::MAYBE)
+    return status;
+  bool found;
+#if H5_VERSION_GE(1, 10, 5)
+  // each value has a chunk of its own, which is only stored once written
+  const std::vector<hsize_t> idx = key.cast<hsize_t>();
+  unsigned int filter_mask;
+  haddr_t addr;
+  hsize_t nbytes = 0;
+  if (H5Dget_chunk_info_by_coord(valsds, &idx[0], &filter_mask, &addr,
+                                 &nbytes) < 0)
+    throw IOError("could not look up a value chunk "
+                  "in the database '" + path_ + "'.");
+  found = nbytes > 0;
+#else
+  found = VLKeyWritten(keysds, key);
+#endif
+  if (!found)
+    return DigestIndex::ABSENT;
+  vlkeys_.Insert(dbtype, key);
+  return DigestIndex::PRESENT;
+}
+
+bool Hdf5Back::VLKeyWritten(hid_t keysds, const Digest& key) {
+  hid_t dspace = H5Dget_space(keysds);
+  hsize_t nkeys = H5Sget_simple_extent_npoints(dspace);
+  hsize_t block = 4096;
+  std::vector<Digest> buf(std::min(block, nkeys));
+  bool found = false;
+  for (hsize_t start = 0; start < nkeys && !found; start += block) {
+    hsize_t count = std::min(block, nkeys - start);
+    hid_t mspace = H5Screate_simple(1, &count, NULL);
+    H5Sselect_hyperslab(dspace, H5S_SELECT_SET, &start, NULL, &count, NULL);
+    herr_t status = H5Dread(keysds, sha1_type_, mspace, dspace, H5P_DEFAULT,
+                            &buf[0]);
+    H5Sclose(mspace);
+    if (status < 0) {
+      H5Sclose(dspace);
+      throw IOError("could not read the key array "
+                    "in the database '" + path_ + "'.");
+    }
+    found = std::find(buf.begin(), buf.begin() + count, key) !=
+            buf.begin() + count;
+  }
+  H5Sclose(dspace);
+  return found;
 }
 
 void Hdf5Back::InsertVLVal(hid_t dset, DbTypes dbtype, const Digest& key,
@@ -2,18 +2,23 @@
 #define CYCLUS_SRC_HDF5_BACK_H_
 
 #include <map>
+#include <mutex>
 #include <set>
 #include <string>
 #include <sstream>
+#include <vector>
 
 #include "boost/filesystem.hpp"
 
+#include "digest_index.h"
 #include "hdf5.h"
 #include "hdf5_hl.h"
 #include "query_backend.h"
 
 namespace cyclus {
 
+class ThreadPool;
+
 /// An Recorder backend that writes data to an hdf5 file.  Identically named
 /// Datum objects have their data placed as rows in a single table.
 ///
@@ -55,14 +60,18 @@ namespace cyclus {
 /// instance, BLOB is stored in the arrays BlobKeys and BlobVals while VL_VECTOR_INT
 /// is stored in the arrays VectorIntKeys and VectorIntVals.
 ///
-/// In memory, all active keys are stored in vlkeys_ private member of this class.
-/// This maps the DbType to a set of the SHA1 digests. This is used to prevent
-/// excessive writing of values to disk that already exist.
+/// To avoid writing values that are already on disk again, the keys are
+/// indexed in memory by vlkeys_, a DigestIndex of bounded size: recently used
+/// keys are cached and all of them are summarized by a bloom filter. Keys the
+/// filter cannot rule out are looked up in the chunk index of the values
+/// array itself, which has a chunk for exactly the values that were written,
+/// or with HDF5 older than 1.10.5 in the keys array.
 ///
 /// The cost of the bidirectional hash map strategy is that the values need to be
 /// looked up in a separate read() from that of the table itself.  However, by
 /// using VL data types users should expect a performance hit and this is one of
-/// the more effiecient strategies.
+/// the more effiecient strategies. Queries read each distinct value referenced by
+/// a batch of chunks once, before the chunks are decoded.
 ///
 /// Another implicit problem with all hash mappings is the possibility of collision.
 /// However, this is in practice impossible here.  For SHA1, there is a 3.4e-13 chance
@@ -71,6 +80,15 @@ namespace cyclus {
 /// Still, if the address space of SHA1 ever becomes insufficient for some reason,
 /// please  move to a larger SHA value such as SHA224 or SHA256 or higher. Such a
 /// migration is not anticipated but would be straighforward.
+///
+/// To speed up point queries (e.g. on ResourceId during restarts), the backend
+/// keeps a zone map for every table with INT columns: the minimum and maximum
+/// value of each INT column in each chunk of the table. Zone maps are stored
+/// as 2D int datasets (one row per chunk, a min and max column per INT column)
+/// in the ZoneMaps group, named after their table, and are updated as rows
+/// are written. Query uses them to skip chunks that cannot satisfy its
+/// conditions. Tables written without a zone map get one built in memory the
+/// first time they are queried.
 class Hdf5Back : public FullBackend {
  public:
   /// Creates a new backend writing data to the specified file.
@@ -92,10 +110,37 @@ class Hdf5Back : public FullBackend {
 
   virtual QueryResult Query(std::string table, std::vector<Cond>* conds);
 
+  /// Returns a cursor that reads the table a batch of chunks at a time as
+  /// rows are requested, decoding the chunks of a batch in parallel on
+  /// nthreads threads. Only the fields in cols (if not NULL) and those with
+  /// conditions are decoded. The cursor must not outlive the backend.
+  virtual QueryCursor::Ptr Cursor(std::string table, std::vector<Cond>* conds,
+                                  std::vector<std::string>* cols = NULL);
+
+  /// Computes the aggregates in a scan of the table that reads its chunks in
+  /// turn and aggregates them in parallel, on nthreads threads. Queries that
+  /// need to decode variable length values are aggregated from a Cursor.
+  virtual QueryResult Aggregate(std::string table, std::vector<Cond>* conds,
+                                std::vector<std::string>* group_by,
+                                std::vector<Agg>* aggs, int bucket = 0);
+
   virtual std::map<std::string, DbTypes> ColumnTypes(std::string table);
 
   virtual std::set<std::string> Tables();
 
+  /// Sets the number of threads used by queries (at least 1). It defaults to
+  /// the number of hardware threads.
+  void set_nthreads(int n);
+
+  /// Sets the number of bits of the bloom filter and the number of cached
+  /// keys of the in-memory index of variable length keys. The keys of the
+  /// open key arrays are read in again.
+  void set_vlindex_size(size_t nbits, size_t capacity);
+
+  /// Returns the number of variable length values that queries read one at a
+  /// time, rather than in a batch with the others of their chunks.
+  inline int n_vl_reads() const { return n_vl_reads_; }
+
  private:
   /// Creates a QueryResult from a table description.
   QueryResult GetTableInfo(std::string title, hid_t dset, hid_t dt);
@@ -116,6 +161,127 @@ class Hdf5Back : public FullBackend {
   /// corresponding hdf5 dataset.
   void WriteGroup(DatumList& group);
 
+  /// Per-chunk bounds of the INT columns of a table, see the class docs.
+  struct ZoneMap {
+    /// indices of the table's INT columns
+    std::vector<int> cols;
+    /// number of rows per table chunk
+    hsize_t chunksize;
+    /// number of table rows covered by bounds
+    hsize_t nrows;
+    /// min and max of each INT column in each chunk, with the min of column c
+    /// in chunk k at index 2 * (k * cols.size() + c) and the max just after
+    std::vector<int> bounds;
+    /// number of chunks whose bounds are up to date in the file
+    hsize_t nsaved;
+  };
+
+  /// Returns the zone map of a table, loading it from the file or building it
+  /// from the table's contents if needed.
+  ZoneMap* GetZoneMap(std::string title, hid_t dset, hsize_t ncols);
+
+  /// Widens the zone map's bounds with nrows rows, in the on-disk layout,
+  /// that follow the rows already covered.
+  void UpdateZoneMap(std::string title, ZoneMap* zm, const char* buf,
+                     hsize_t nrows);
+
+  /// Writes the bounds of chunks first and later to the file.
+  void SaveZoneMap(std::string title, ZoneMap* zm, hsize_t first);
+
+  /// An open table and the conditions of a query on it, see PlanQuery.
+  struct QueryPlan {
+    ~QueryPlan();
+
+    std::string table;
+    hid_t tb_set;
+    hid_t tb_space;
+    hid_t tb_plist;
+    hid_t tb_type;
+    size_t tb_typesize;
+    int tb_length;
+    hsize_t tb_chunksize;
+    unsigned int nchunks;
+    /// all fields and types of the table
+    QueryResult qr;
+    /// the query's conditions, which field_conds points into
+    std::vector<Cond> conds;
+    std::map<std::string, std::vector<Cond*> > field_conds;
+    /// fixed size scalar columns with conditions, checked first
+    std::vector<int> prefilter;
+    /// conditions checked against the zone map, by zone map column
+    std::vector<std::pair<int, Cond*> > zone_conds;
+    ZoneMap* zm;
+    /// whether each column is decoded
+    std::vector<bool> decode;
+    /// the conditions on each column
+    std::vector<std::vector<Cond*>*> col_conds;
+    /// offset and size in bytes of each column
+    const size_t* tb_offsets;
+    const size_t* tb_sizes;
+    /// number of items of array columns (0 for other columns)
+    std::vector<hsize_t> fieldlens;
+    /// size of the keys of MAP_STRING_STRING columns (0 for other columns)
+    std::vector<size_t> keylens;
+  };
+
+  class ChunkCursor;
+
+  /// Opens table for a query with the given conditions (conds may be NULL)
+  /// that returns the fields in cols (all of them if cols is NULL).
+  QueryPlan* PlanQuery(std::string table, std::vector<Cond>* conds,
+                       std::vector<std::string>* cols);
+
+  /// Returns false if the zone map shows that no row of the n-th chunk of the
+  /// planned table satisfies the query's conditions.
+  bool ChunkMayMatch(QueryPlan* p, unsigned int n);
+
+  /// Reads the n-th chunk of the planned table into buf, in the on-disk row
+  /// layout, and returns its number of rows.
+  hsize_t ReadRaw(QueryPlan* p, unsigned int n, std::vector<char>* buf);
+
+  /// Adds the count rows in buf (read by ReadRaw) that satisfy the conditions
+  /// on the conditioned columns cond_cols to t. key_cols and agg_cols are the
+  /// columns of the group_by and aggregated fields (-1 for counts). Only
+  /// fixed size scalar columns can be used, and no HDF5 calls are made.
+  void AggregateRaw(QueryPlan* p, const char* buf, hsize_t count,
+                    const std::vector<int>& cond_cols,
+                    const std::vector<int>& key_cols,
+                    const std::vector<int>& agg_cols, AggTable* t);
+
+  /// Returns false if the fixed size scalar columns with conditions show that
+  /// row (in the on-disk row layout) does not satisfy the query.
+  bool RowMayMatch(QueryPlan* p, const char* row);
+
+  /// Appends the rows of a chunk of count rows in buf (read by ReadRaw) that
+  /// satisfy the query's conditions to rows, with the columns that aren't
+  /// decoded left empty. It may be called from several threads at once.
+  void DecodeChunk(QueryPlan* p, char* buf, hsize_t count,
+                   std::vector<QueryRow>* rows);
+
+  /// Reads the variable length values of the decoded columns of the rows of
+  /// the first n chunks of bufs (of counts[k] rows each) that may satisfy the
+  /// query, and the strings of containers of strings among them and of the
+  /// fixed-size columns of VL strings, so that VLRead finds them there until
+  /// ClearVLBatch is called.
+  void ReadVLBatch(QueryPlan* p, const std::vector<std::vector<char> >& bufs,
+                   const std::vector<hsize_t>& counts, int n);
+
+  /// Reads the values of dbtype with the given keys into vlbatch_, once each
+  /// and in key order. keys is sorted and its duplicates removed.
+  void ReadVLVals(DbTypes dbtype, std::vector<Digest>* keys);
+
+  /// Releases the values read by ReadVLBatch.
+  void ClearVLBatch();
+
+  /// Returns the value of dbtype with the given key read by ReadVLBatch, as
+  /// the HDF5 in-memory element (a char* or an hvl_t), or NULL if there is
+  /// no such value. It doesn't lock h5_mu_, so that the chunks of a batch
+  /// are decoded concurrently.
+  const char* BatchedVL(DbTypes dbtype, const char* rawkey);
+
+  /// Returns the pool of nthreads threads used by queries.
+  ThreadPool* pool();
+
   /// Fill a contiguous memory buffer with data from group for writing to an
   /// hdf5 dataset.
   void FillBuf(std::string title, char* buf, DatumList& group, size_t* sizes,
@@ -141,6 +307,14 @@ class Hdf5Back : public FullBackend {
   }
   /// \}
 
+  /// Writes a string or blob, given as raw bytes, to its on-disk
+  /// bidirectional hash map. The bytes are only copied if they are new.
+  /// @param dbtype either VL_STRING or BLOB
+  /// @param x the bytes to write
+  /// @param n the number of bytes
+  /// @return the key of x
+  Digest VLWriteBytes(DbTypes dbtype, const char* x, size_t n);
+
   /// Gets an HDF5 reference dataset for a variable length datatype
   /// If the dataset does not exist in the database, it will create it.
   ///
@@ -157,6 +331,17 @@ class Hdf5Back : public FullBackend {
   /// @param key the SHA1 digest to append
   void AppendVLKey(hid_t dset, DbTypes dbtype, const Digest& key);
 
+  /// Returns whether the value of dbtype with the given key has been
+  /// written, either PRESENT or ABSENT. The keys vlkeys_ is not sure about
+  /// are resolved from the chunk index of the value dataset valsds or, with
+  /// HDF5 older than 1.10.5, by scanning the key dataset keysds.
+  DigestIndex::Status VLKeyStatus(hid_t keysds, hid_t valsds, DbTypes dbtype,
+                                  const Digest& key);
+
+  /// Returns whether key is in the key dataset keysds, reading it a block
+  /// at a time.
+  bool VLKeyWritten(hid_t keysds, const Digest& key);
+
 
   /// Inserts a variable length data into it value dataset
   ///
@@ -242,12 +427,43 @@ class Hdf5Back : public FullBackend {
   /// Map of database type to the cooresponding HDF5 datatype.
   std::map<DbTypes, hid_t> vldts_;
 
-  /// Map of database type to the set of current keys present in the database.
-  std::map<DbTypes, std::set<Digest> > vlkeys_;
+  /// Index of the keys present in the database, tagged with their database
+  /// type.
+  DigestIndex vlkeys_;
+
+  /// Variable length values read by ReadVLBatch, with their sorted keys. buf
+  /// holds the HDF5 in-memory elements of size size each, described by
+  /// mspace for reclaiming. It is only changed by ReadVLBatch and
+  /// ClearVLBatch, before and after a cursor decodes a batch, and is read
+  /// without locking in between. Hence the cursors of a backend must not be
+  /// advanced concurrently.
+  struct VLBatch {
+    std::vector<Digest> keys;
+    std::vector<char> buf;
+    size_t size;
+    hid_t mspace;
+  };
+  std::map<DbTypes, VLBatch> vlbatch_;
+
+  /// Zone maps of the tables that have been written or queried.
+  std::map<std::string, ZoneMap> zonemaps_;
+
+  /// The number of threads used by queries and their pool, created on first
+  /// use.
+  int nthreads_;
+  ThreadPool* pool_;
+
+  /// Serializes the HDF5 calls of ReadRaw, ReadVLBatch and VLRead, which can
+  /// be made from several query threads. VLRead only takes it for values
+  /// that are not in vlbatch_. It is recursive since VLRead of containers of
+  /// VL strings reads each string with VLRead.
+  std::recursive_mutex h5_mu_;
+
+  /// The number of values read by VLRead outside of a batch, guarded by
+  /// h5_mu_.
+  int n_vl_reads_;
 };
 
-const hsize_t Hdf5Back::vlchunk_[CYCLUS_SHA1_NINT] = {1, 1, 1, 1, 1};
-
 }  // namespace cyclus
 
 #endif  // CYCLUS_SRC_HDF5_BACK_H_
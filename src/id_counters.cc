@@ -0,0 +1,49 @@
+#include "id_counters.h"
+
+#include <sstream>
+
+#include "composition.h"
+#include "error.h"
+
+namespace cyclus {
+
+const double IdCounters::kMinInternTol = 1e-15;
+const int IdCounters::kInternSweepMin;
+
+thread_local IdCounters* IdCounters::current_ = NULL;
+IdCounters IdCounters::default_;
+
+int IdCounters::ProductId(const std::string& q, bool* added) {
+  std::lock_guard<std::mutex> lk(product_mu);
+  std::map<std::string, int>::iterator it = qualids.find(q);
+  if (added == NULL) {
+    return it != qualids.end() ? it->second : 0;
+  }
+  *added = it == qualids.end();
+  if (*added) {
+    CheckUnfrozen();
+    it = qualids.insert(std::make_pair(q, product++)).first;
+  }
+  return it->second;
+}
+
+void IdCounters::ThrowFrozen() {
+  throw StateError("resources, compositions and products cannot be created "
+                   "or modified while ids are frozen, e.g. by agents ticked "
+                   "concurrently (see TimeListener::ThreadSafeTick)");
+}
+
+void IdCounters::InternTol(double tol) {
+  if (tol > 0 && tol < kMinInternTol) {
+    std::stringstream ss;
+    ss << "composition interning tolerance " << tol
+       << " is below the minimum of " << kMinInternTol;
+    throw ValueError(ss.str());
+  }
+  std::lock_guard<std::mutex> lk(intern_mu);
+  intern_tol = tol > 0 ? tol : 0;
+  interned.clear();
+  intern_sweep = kInternSweepMin;
+}
+
+}  // namespace cyclus
@@ -0,0 +1,146 @@
+#ifndef CYCLUS_SRC_ID_COUNTERS_H_
+#define CYCLUS_SRC_ID_COUNTERS_H_
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include <boost/functional/hash.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/weak_ptr.hpp>
+
+namespace cyclus {
+
+class Composition;
+
+/// The normalized, quantized form of a composition under which it is
+/// interned: (nuclide, multiple of the tolerance) pairs in nuclide order
+/// followed by a (0, basis) pair that keeps atom- and mass-based
+/// compositions apart.
+typedef std::vector<std::pair<int, long long> > InternKey;
+
+/// IdCounters holds the counters from which a simulation assigns the unique
+/// ids of its agents, resources, compositions and products, along with the
+/// compositions interned by the simulation. Every Context has its own
+/// counters, so that several simulations can run in one process without
+/// sharing id sequences or interned compositions.
+///
+/// Agents, tracked resources and products take their ids from the counters
+/// of their context. Compositions and untracked resources have no context and
+/// take theirs from the counters that are current on the creating thread:
+/// those of the simulation that is being loaded or run on it (see Scope), or
+/// a process-wide default otherwise.
+class IdCounters {
+ public:
+  /// Makes a set of counters current on the calling thread for the lifetime
+  /// of the scope.
+  class Scope {
+   public:
+    explicit Scope(IdCounters* c) : prev_(current_) { current_ = c; }
+    ~Scope() { current_ = prev_; }
+
+   private:
+    IdCounters* prev_;
+  };
+
+  /// Forbids assigning resource, composition and product ids from a set of
+  /// counters for the lifetime of the guard. Agents ticked concurrently run
+  /// under it (see TimeListener::ThreadSafeTick), because ids assigned by
+  /// concurrent threads would depend on their timing.
+  class Freeze {
+   public:
+    explicit Freeze(IdCounters* c) : c_(c) { c_->frozen = true; }
+    ~Freeze() { c_->frozen = false; }
+
+   private:
+    IdCounters* c_;
+  };
+
+  IdCounters()
+      : frozen(false),
+        agent(0),
+        res_state(1),
+        res_obj(1),
+        comp(1),
+        product(1),
+        intern_tol(0),
+        intern_dups(0),
+        intern_sweep(kInternSweepMin) {}
+
+  /// Returns the counters that are current on the calling thread.
+  static IdCounters* current() {
+    return current_ != NULL ? current_ : &default_;
+  }
+
+  /// Makes c current on the calling thread until it is changed again, e.g.
+  /// for the whole life of a worker thread. NULL selects the default.
+  static void current(IdCounters* c) { current_ = c; }
+
+  /// Returns the id of the product quality q. If added is not NULL, a
+  /// quality without an id is assigned the next product id and *added is set
+  /// to whether that happened. Otherwise 0 is returned for such a quality.
+  int ProductId(const std::string& q, bool* added = NULL);
+
+  /// Throws a StateError if ids are frozen (see Freeze). Called before an id
+  /// is assigned from these counters.
+  inline void CheckUnfrozen() const {
+    if (frozen.load(std::memory_order_relaxed)) {
+      ThrowFrozen();
+    }
+  }
+
+  /// Sets the composition interning tolerance, clearing the interned
+  /// compositions. A tol of zero or less disables interning. Throws a
+  /// ValueError for a positive tol below kMinInternTol, finer than the
+  /// precision of the quantities and too fine for their bucket numbers.
+  void InternTol(double tol);
+
+  /// the smallest positive composition interning tolerance
+  static const double kMinInternTol;
+
+  /// the table size at which interned compositions are first swept
+  static const int kInternSweepMin = 1024;
+
+  /// whether ids are frozen
+  std::atomic<bool> frozen;
+  /// next agent id
+  std::atomic<int> agent;
+  /// next resource state id
+  std::atomic<int> res_state;
+  /// next resource object id
+  std::atomic<int> res_obj;
+  /// next composition (material QualId) id
+  std::atomic<int> comp;
+
+  /// next product QualId and the ids of all product qualities, guarded by
+  /// product_mu
+  int product;
+  std::map<std::string, int> qualids;
+  std::mutex product_mu;
+
+  /// the composition interning tolerance (see Composition::intern_tol), the
+  /// interned compositions and the number of created compositions they
+  /// replaced, guarded by intern_mu. The table does not keep compositions
+  /// alive: entries of destroyed compositions are replaced when their key is
+  /// interned again, and all of them are erased whenever the table grows to
+  /// intern_sweep entries, which is then set to twice the remaining size.
+  double intern_tol;
+  boost::unordered_map<InternKey, boost::weak_ptr<Composition>,
+                       boost::hash<InternKey> > interned;
+  int intern_dups;
+  int intern_sweep;
+  std::mutex intern_mu;
+
+ private:
+  static void ThrowFrozen();
+
+  static thread_local IdCounters* current_;
+  static IdCounters default_;
+};
+
+}  // namespace cyclus
+
+#endif  // CYCLUS_SRC_ID_COUNTERS_H_
@@ -1,6 +1,7 @@
 // Implements the Institution class
 #include "institution.h"
 
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 #include <string>
@@ -60,4 +61,18 @@ void Institution::Tock() {
   }
 }
 
+int Institution::NextChildExit() {
+  // children past their exit time whose decommissioning was refused are
+  // checked again every timestep
+  int next = kNeverWake;
+  std::set<Agent*>::iterator it;
+  for (it = children().begin(); it != children().end(); ++it) {
+    Agent* a = *it;
+    if (a->lifetime() != -1) {
+      next = std::min(next, std::max(a->exit_time(), context()->time() + 1));
+    }
+  }
+  return next;
+}
+
 }  // namespace cyclus
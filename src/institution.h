@@ -66,6 +66,12 @@ class Institution : public Agent, public TimeListener {
 
  protected:
   void InitFrom(Institution* m);
+
+  /// Returns the next timestep at which the base Tock must check the
+  /// lifetimes of the children, i.e. the exit time of the next child to
+  /// reach the end of its lifetime, or kNeverWake. Institutions that only
+  /// use the base Tick and Tock can return this from NextWakeup.
+  int NextChildExit();
 };
 
 }  // namespace cyclus
@@ -4,9 +4,11 @@
 
 #include "comp_math.h"
 #include "context.h"
+#include "decay_batch.h"
 #include "decayer.h"
 #include "error.h"
 #include "logger.h"
+#include "nuc_registry.h"
 
 namespace cyclus {
 
@@ -18,6 +20,7 @@ Material::Ptr Material::Create(Agent* creator, double quantity,
                                Composition::Ptr c) {
   Material::Ptr m(new Material(creator->context(), quantity, c));
   m->tracker_.Create(creator);
+  m->ctx_->RegisterMaterial(m);
   return m;
 }
 
@@ -77,11 +80,11 @@ Material::Ptr Material::ExtractComp(double qty, Composition::Ptr c,
 
   // TODO: decide if ExtractComp should force lazy-decay by calling comp()
   if (comp_ != c) {
-    CompMap v(comp_->mass());
+    CompVec v(comp_->mass_vec());
     compmath::Normalize(&v, qty_);
-    CompMap otherv(c->mass());
+    CompVec otherv(c->mass_vec());
     compmath::Normalize(&otherv, qty);
-    CompMap newv = compmath::Sub(v, otherv);
+    CompVec newv = compmath::Sub(v, otherv);
     compmath::ApplyThreshold(&newv, threshold);
     comp_ = Composition::CreateFromMass(newv);
   }
@@ -89,6 +92,9 @@ Material::Ptr Material::ExtractComp(double qty, Composition::Ptr c,
   qty_ -= qty;
 
   Material::Ptr other(new Material(ctx_, qty, c));
+  if (ctx_ != NULL) {
+    ctx_->RegisterMaterial(other);
+  }
 
   // Decay called on the extracted material should have the same dt as for
   // this material regardless of composition.
@@ -105,9 +111,9 @@ void Material::Absorb(Material::Ptr mat) {
   Composition::Ptr c1 = mat->comp();
 
   if (c0 != c1) {
-    CompMap v(c0->mass());
+    CompVec v(c0->mass_vec());
     compmath::Normalize(&v, qty_);
-    CompMap otherv(c1->mass());
+    CompVec otherv(c1->mass_vec());
     compmath::Normalize(&otherv, mat->qty_);
     comp_ = Composition::CreateFromMass(compmath::Add(v, otherv));
   }
@@ -157,35 +163,12 @@ void Material::Decay(int curr_time) {
     return;
   }
 
-  double eps = 1e-3;
-  const CompMap c = comp_->atom();
-
-  // If composition has too many nuclides (i.e. > 100), it is cheaper to
-  // just do the decay rather than check all the decay constants.
-  bool decay = c.size() > 100;
-
   uint64_t secs_per_timestep = kDefaultTimeStepDur;
   if (ctx_ != NULL) {
     secs_per_timestep = ctx_->sim_info().dt;
   }
-
-  if (!decay) {
-    // Only do the decay calc if one of the nuclides would change in number
-    // density more than fraction eps.
-    // i.e. decay if   (1 - eps) > exp(-lambda*dt)
-    CompMap::const_reverse_iterator it;
-    for (it = c.rbegin(); it != c.rend(); ++it) {
-      int nuc = it->first;
-      double lambda_timesteps = pyne::decay_const(nuc) * static_cast<double>(secs_per_timestep);
-      double change = 1.0 - std::exp(-lambda_timesteps * static_cast<double>(dt));
-      if (change >= eps) {
-        decay = true;
-        break;
-      }
-    }
-    if (!decay) {
-      return;
-    }
+  if (!DecayNeeded(dt, secs_per_timestep)) {
+    return;
   }
 
   prev_decay_time_ = curr_time; // this must go before Transmute call
@@ -193,6 +176,39 @@ void Material::Decay(int curr_time) {
   Transmute(decayed);
 }
 
+bool Material::DecayNeeded(int dt, uint64_t secs_per_timestep) {
+  double eps = 1e-3;
+  const CompVec& c = comp_->atom_vec();
+
+  // If composition has too many nuclides (i.e. > 100), it is cheaper to
+  // just do the decay rather than check all the decay constants.
+  if (c.size() > 100) {
+    return true;
+  }
+
+  // Only do the decay calc if one of the nuclides would change in number
+  // density more than fraction eps.
+  // i.e. decay if   (1 - eps) > exp(-lambda*dt)
+  const NucRegistry& reg = NucRegistry::Instance();
+  const std::vector<Nuc>& nucs = c.nucs();
+  for (int i = nucs.size() - 1; i >= 0; --i) {
+    double lambda_timesteps = reg.DecayConst(nucs[i]) * static_cast<double>(secs_per_timestep);
+    double change = 1.0 - std::exp(-lambda_timesteps * static_cast<double>(dt));
+    if (change >= eps) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void Material::QueueDecay(DecayBatch* batch, int curr_time) {
+  int dt = curr_time - prev_decay_time_;
+  uint64_t secs_per_timestep = ctx_->sim_info().dt;
+  if (dt > 0 && DecayNeeded(dt, secs_per_timestep)) {
+    batch->Add(comp_, dt, secs_per_timestep);
+  }
+}
+
 Composition::Ptr Material::comp() const {
   throw Error("comp() const is deprecated - use non-const comp() function."
               " Recompilation should fix the problem.");
@@ -206,7 +222,8 @@ Composition::Ptr Material::comp() {
 }
 
 Material::Material(Context* ctx, double quantity, Composition::Ptr c)
-    : qty_(quantity),
+    : Resource(ctx),
+      qty_(quantity),
       comp_(c),
       tracker_(ctx, this),
       ctx_(ctx),
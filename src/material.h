@@ -11,6 +11,8 @@
 
 namespace cyclus {
 
+class DecayBatch;
+
 class Context;
 
 namespace units {
@@ -153,6 +155,15 @@ class Material: public Resource {
   Material(Context* ctx, double quantity, Composition::Ptr c);
 
  private:
+  friend class Context;
+
+  /// Returns true if decaying the material's composition by dt time steps of
+  /// secs_per_timestep seconds would change it significantly.
+  bool DecayNeeded(int dt, uint64_t secs_per_timestep);
+
+  /// Queues the decay that Decay(curr_time) would perform into batch.
+  void QueueDecay(DecayBatch* batch, int curr_time);
+
   Context* ctx_;
   double qty_;
   Composition::Ptr comp_;
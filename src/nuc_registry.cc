@@ -0,0 +1,70 @@
+#include "nuc_registry.h"
+
+#include <set>
+
+#include "pyne.h"
+#include "pyne_decay.h"
+
+namespace cyclus {
+
+const NucRegistry& NucRegistry::Instance() {
+  static NucRegistry reg;
+  return reg;
+}
+
+NucRegistry::NucRegistry() {
+  Load();
+}
+
+void NucRegistry::Load() {
+  const int* all = pyne::decayers::all_nucs;
+  int nall = sizeof(pyne::decayers::all_nucs) / sizeof(*all);
+
+  // register nuclides breadth-first so that every daughter gets an index even
+  // if it is missing from the decay data's nuclide list.
+  std::vector<Nuc> todo(all, all + nall);
+  std::vector<std::set<int> > children;
+  for (int k = 0; k < todo.size(); ++k) {
+    Nuc nuc = todo[k];
+    if (index_.count(nuc) > 0) {
+      continue;
+    }
+    index_[nuc] = nucs_.size();
+    nucs_.push_back(nuc);
+    masses_.push_back(pyne::atomic_mass(nuc));
+    lambdas_.push_back(pyne::decay_const(nuc));
+    children.push_back(pyne::decay_children(nuc));
+    todo.insert(todo.end(), children.back().begin(), children.back().end());
+  }
+
+  dstart_.reserve(nucs_.size() + 1);
+  dstart_.push_back(0);
+  for (int i = 0; i < nucs_.size(); ++i) {
+    std::set<int>::iterator it;
+    for (it = children[i].begin(); it != children[i].end(); ++it) {
+      daughters_.push_back(index_[*it]);
+      ratios_.push_back(pyne::branch_ratio(nucs_[i], *it));
+    }
+    dstart_.push_back(daughters_.size());
+  }
+}
+
+double NucRegistry::AtomicMass(Nuc nuc) const {
+  int i = Index(nuc);
+  if (i >= 0) {
+    return masses_[i];
+  }
+  std::lock_guard<std::mutex> lk(pyne_mu_);
+  return pyne::atomic_mass(nuc);
+}
+
+double NucRegistry::DecayConst(Nuc nuc) const {
+  int i = Index(nuc);
+  if (i >= 0) {
+    return lambdas_[i];
+  }
+  std::lock_guard<std::mutex> lk(pyne_mu_);
+  return pyne::decay_const(nuc);
+}
+
+}  // namespace cyclus
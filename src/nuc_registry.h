@@ -0,0 +1,98 @@
+#ifndef CYCLUS_SRC_NUC_REGISTRY_H_
+#define CYCLUS_SRC_NUC_REGISTRY_H_
+
+#include <mutex>
+#include <vector>
+#include <boost/unordered_map.hpp>
+
+#include "comp_vec.h"
+
+namespace cyclus {
+
+/// NucRegistry assigns every nuclide known to the decay data a dense index and
+/// holds per-nuclide properties in contiguous arrays indexed by it: atomic
+/// mass, decay constant and the decay daughters with their branching ratios.
+///
+/// The registry is filled by a single bulk load of pyne's nuclear data the
+/// first time Instance is called and is immutable afterwards, so it can be
+/// read from several threads without locking. Hot loops should look a
+/// nuclide's index up once and then read the arrays directly, rather than
+/// calling the pyne functions, each of which is a std::map lookup that may
+/// trigger a lazy load of the nuclear data.
+///
+/// @code
+/// const NucRegistry& reg = NucRegistry::Instance();
+/// int i = reg.Index(922350000);
+/// double lambda = i >= 0 ? reg.decay_const(i) : 0;
+/// @endcode
+class NucRegistry {
+ public:
+  /// Returns the registry, loading it on first use. The nuclear data path
+  /// must be set (see Env::SetNucDataPath) before the first call.
+  static const NucRegistry& Instance();
+
+  /// Returns the number of registered nuclides.
+  inline int size() const { return nucs_.size(); }
+
+  /// Returns the dense index of nuc or -1 if nuc is not registered.
+  inline int Index(Nuc nuc) const {
+    boost::unordered_map<Nuc, int>::const_iterator it = index_.find(nuc);
+    return it == index_.end() ? -1 : it->second;
+  }
+
+  /// Returns the nuclide with index i.
+  inline Nuc nuc(int i) const { return nucs_[i]; }
+
+  /// Returns the atomic mass, in amu, of the nuclide with index i.
+  inline double atomic_mass(int i) const { return masses_[i]; }
+
+  /// Returns the decay constant, in 1/s, of the nuclide with index i.
+  inline double decay_const(int i) const { return lambdas_[i]; }
+
+  /// Returns the number of decay daughters of the nuclide with index i.
+  inline int n_daughters(int i) const {
+    return dstart_[i + 1] - dstart_[i];
+  }
+
+  /// Returns the index of the j-th decay daughter of the nuclide with index i.
+  inline int daughter(int i, int j) const { return daughters_[dstart_[i] + j]; }
+
+  /// Returns the branching ratio from the nuclide with index i to its j-th
+  /// decay daughter.
+  inline double branch_ratio(int i, int j) const {
+    return ratios_[dstart_[i] + j];
+  }
+
+  /// Returns the atomic mass of nuc, falling back to pyne for nuclides that
+  /// are not registered. The fallback is serialized, since pyne fills its
+  /// data maps lazily and is not thread-safe.
+  double AtomicMass(Nuc nuc) const;
+
+  /// Returns the decay constant of nuc, falling back to pyne (serialized like
+  /// AtomicMass's) for nuclides that are not registered.
+  double DecayConst(Nuc nuc) const;
+
+ private:
+  NucRegistry();
+
+  /// Registers every nuclide in pyne's decay data together with all of their
+  /// decay daughters.
+  void Load();
+
+  boost::unordered_map<Nuc, int> index_;
+  std::vector<Nuc> nucs_;
+  std::vector<double> masses_;
+  std::vector<double> lambdas_;
+
+  /// daughters of nuclide i are daughters_[dstart_[i]:dstart_[i + 1]]
+  std::vector<int> dstart_;
+  std::vector<int> daughters_;
+  std::vector<double> ratios_;
+
+  /// guards the calls to pyne for unregistered nuclides
+  mutable std::mutex pyne_mu_;
+};
+
+}  // namespace cyclus
+
+#endif  // CYCLUS_SRC_NUC_REGISTRY_H_
@@ -34,9 +34,10 @@ class Product : public Resource {
   /// the simulation and is untracked.
   static Ptr CreateUntracked(double quantity, std::string quality);
 
-  /// Returns 0 (for now).
+  /// Returns the id of the product's quality, which is unique within its
+  /// simulation.
   virtual int qual_id() const {
-    return qualids_[quality_];
+    return qualid_;
   }
 
   /// Returns Product::kType.
@@ -77,12 +78,9 @@ class Product : public Resource {
   /// @param quality the resource quality
   Product(Context* ctx, double quantity, std::string quality);
 
-  // map<quality, quality_id>
-  static std::map<std::string, int> qualids_;
-  static int next_qualid_;
-
   Context* ctx_;
   std::string quality_;
+  int qualid_;
   double quantity_;
   ResTracker tracker_;
 };
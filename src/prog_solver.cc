@@ -1,5 +1,9 @@
 #include "prog_solver.h"
 
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <set>
 #include <sstream>
 
 #include "context.h"
@@ -9,6 +13,11 @@
 
 namespace cyclus {
 
+/// the fraction of a program's columns that must be kept from the previous
+/// program for it to be warm-started; below it the previous basis is of
+/// little use and the program is loaded from scratch
+const double kMinKeptCols = 0.5;
+
 void Report(OsiSolverInterface* iface) {
   std::cout << iface->getNumCols() << " total variables, "
             << iface->getNumIntegers() << " integer.\n";
@@ -16,35 +25,117 @@ void Report(OsiSolverInterface* iface) {
 }
 
 ProgSolver::ProgSolver(std::string solver_t)
-    : solver_t_(solver_t),
+    : ExchangeSolver(false),
+      solver_t_(solver_t),
       tmax_(ProgSolver::kDefaultTimeout),
       verbose_(false),
       mps_(false),
-      ExchangeSolver(false) {}
+      persistent_(false),
+      iface_(NULL),
+      programs_(new Programs()) {}
 
 ProgSolver::ProgSolver(std::string solver_t, bool exclusive_orders)
-    : solver_t_(solver_t),
+    : ExchangeSolver(exclusive_orders),
+      solver_t_(solver_t),
       tmax_(ProgSolver::kDefaultTimeout),
       verbose_(false),
       mps_(false),
-      ExchangeSolver(exclusive_orders) {}
+      persistent_(false),
+      iface_(NULL),
+      programs_(new Programs()) {}
 
 ProgSolver::ProgSolver(std::string solver_t, double tmax)
-    : solver_t_(solver_t),
+    : ExchangeSolver(false),
+      solver_t_(solver_t),
       tmax_(tmax),
       verbose_(false),
       mps_(false),
-      ExchangeSolver(false) {}
+      persistent_(false),
+      iface_(NULL),
+      programs_(new Programs()) {}
 
 ProgSolver::ProgSolver(std::string solver_t, double tmax, bool exclusive_orders,
                        bool verbose, bool mps)
-    : solver_t_(solver_t),
+    : ExchangeSolver(exclusive_orders),
+      solver_t_(solver_t),
       tmax_(tmax),
       verbose_(verbose),
       mps_(mps),
-      ExchangeSolver(exclusive_orders) {}
+      persistent_(false),
+      iface_(NULL),
+      programs_(new Programs()) {}
+
+ProgSolver::ProgSolver(std::string solver_t, double tmax, bool exclusive_orders,
+                       bool verbose, bool mps, bool persistent)
+    : ExchangeSolver(exclusive_orders),
+      solver_t_(solver_t),
+      tmax_(tmax),
+      verbose_(verbose),
+      mps_(mps),
+      persistent_(persistent),
+      iface_(NULL),
+      programs_(new Programs()) {}
+
+ProgSolver::~ProgSolver() {
+  delete iface_;
+}
+
+ProgSolver::Programs::~Programs() {
+  std::map<std::string, Program>::iterator it;
+  for (it = progs.begin(); it != progs.end(); ++it) {
+    delete it->second.iface;
+  }
+}
+
+ExchangeSolver* ProgSolver::Clone() const {
+  if (mps_)
+    return NULL;
+  ProgSolver* s = new ProgSolver(solver_t_, tmax_, exclusive_orders_,
+                                 verbose_, mps_, persistent_);
+  s->programs_ = programs_;
+  s->sim_ctx(sim_ctx_);
+  return s;
+}
 
-ProgSolver::~ProgSolver() {}
+int ProgSolver::n_solves() const {
+  std::lock_guard<std::mutex> lk(programs_->mu);
+  int n = 0;
+  std::map<std::string, Program>::const_iterator it;
+  for (it = programs_->progs.begin(); it != programs_->progs.end(); ++it) {
+    n += it->second.n_solves;
+  }
+  return n;
+}
+
+int ProgSolver::n_warm_starts() const {
+  std::lock_guard<std::mutex> lk(programs_->mu);
+  int n = 0;
+  std::map<std::string, Program>::const_iterator it;
+  for (it = programs_->progs.begin(); it != programs_->progs.end(); ++it) {
+    n += it->second.n_warm;
+  }
+  return n;
+}
+
+std::string ProgSolver::ProgramKey() {
+  std::set<std::string> commods;
+  int min_id = -1;
+  const FlatExchangeGraph& f = graph_->flat();
+  for (int i = 0; i != f.n_nodes(); i++) {
+    const ExchangeNode* n = f.nodes[i];
+    commods.insert(n->commod);
+    if (min_id < 0 || (n->agent_id >= 0 && n->agent_id < min_id))
+      min_id = n->agent_id;
+  }
+
+  std::stringstream ss;
+  ss << res_type_ << ":" << min_id;
+  std::set<std::string>::iterator it;
+  for (it = commods.begin(); it != commods.end(); ++it) {
+    ss << ":" << *it;
+  }
+  return ss.str();
+}
 
 void ProgSolver::WriteMPS() {
   std::stringstream ss;
@@ -53,6 +144,9 @@ void ProgSolver::WriteMPS() {
 }
 
 double ProgSolver::SolveGraph() {
+  if (persistent_)
+    return SolvePersistent();
+
   SolverFactory sf(solver_t_, tmax_);
   iface_ = sf.get();
   try {
@@ -87,11 +181,377 @@ double ProgSolver::SolveGraph() {
     xlator.FromProg();
   } catch(...) {
     delete iface_;
+    iface_ = NULL;
     throw;
   }
   double ret = iface_->getObjValue(); 
   delete iface_;
+  iface_ = NULL;
   return ret;
 }
 
+double ProgSolver::SolvePersistent() {
+  if (graph_->arcs().empty())
+    return 0;
+
+  // take the kept program, unless another component with the same key
+  // holds it, in which case this one is solved from scratch and not kept
+  std::string key = ProgramKey();
+  Program* p = NULL;
+  {
+    std::lock_guard<std::mutex> lk(programs_->mu);
+    Program& kept = programs_->progs[key];
+    if (!kept.in_use) {
+      p = &kept;
+      p->in_use = true;
+      iface_ = p->iface;
+      p->iface = NULL;
+      col_keys_.swap(p->col_keys);
+      row_keys_.swap(p->row_keys);
+    }
+  }
+  double obj;
+  bool warm;
+  try {
+    bool first = iface_ == NULL;
+    if (first) {
+      SolverFactory sf(solver_t_, tmax_);
+      iface_ = sf.get();
+      col_keys_.clear();
+      row_keys_.clear();
+    }
+
+    double pseudo_cost = PseudoCost(); // from ExchangeSolver API
+    ProgTranslator xlator(graph_, iface_, exclusive_orders_, pseudo_cost);
+    xlator.track_keys(true);
+    xlator.Translate();
+
+    // the greedy solution only provides a reference objective, which is not
+    // worth its cost once a previous incumbent is available. It is found
+    // after translation because conditioning reorders the graph's groups,
+    // which would change the keys of otherwise identical programs.
+    double greedy_obj = std::numeric_limits<double>::max();
+    if (first) {
+      GreedySolver greedy(exclusive_orders_);
+      greedy_obj = greedy.Solve(graph_);
+      graph_->ClearMatches();
+    }
+
+    const FlatExchangeGraph& f = graph_->flat();
+    std::vector<char> integers(xlator.ctx().m.getNumCols(), 0);
+    for (int i = 0; i != f.n_arcs(); i++) {
+      integers[i] = exclusive_orders_ && f.arc_excl[i];
+    }
+
+    std::vector<int> cols;
+    warm = Update(xlator.ctx(), integers, &cols);
+    if (mps_)
+      WriteMPS();
+
+    handler_.setLogLevel(verbose_ ? 4 : 0);
+    iface_->passInMessageHandler(&handler_);
+    if (verbose_)
+      Report(iface_);
+
+    SolveProg(iface_, greedy_obj, verbose_, warm);
+
+    // back translate, in program column order
+    const double* isol = iface_->getColSolution();
+    std::vector<double> sol(cols.size());
+    for (int i = 0; i != cols.size(); i++) {
+      sol[i] = isol[cols[i]];
+    }
+    xlator.FromProg(sol.data());
+    obj = iface_->getObjValue();
+  } catch(...) {
+    // the interface may be partially updated, start over next time
+    delete iface_;
+    iface_ = NULL;
+    col_keys_.clear();
+    row_keys_.clear();
+    if (p != NULL) {
+      std::lock_guard<std::mutex> lk(programs_->mu);
+      p->in_use = false;
+    }
+    throw;
+  }
+
+  double rate = warm ? 1 : 0;
+  {
+    std::lock_guard<std::mutex> lk(programs_->mu);
+    if (p != NULL) {
+      ++p->n_solves;
+      if (warm)
+        ++p->n_warm;
+      rate = static_cast<double>(p->n_warm) / p->n_solves;
+      p->iface = iface_;
+      iface_ = NULL;
+      col_keys_.swap(p->col_keys);
+      row_keys_.swap(p->row_keys);
+      p->in_use = false;
+    }
+  }
+  delete iface_;
+  iface_ = NULL;
+  col_keys_.clear();
+  row_keys_.clear();
+  RecordWarmStart(warm, rate);
+  return obj;
+}
+
+/// indexes keys by their position
+std::map<std::string, int> KeyIndex(const std::vector<std::string>& keys) {
+  std::map<std::string, int> idx;
+  for (int i = 0; i != keys.size(); i++) {
+    idx[keys[i]] = i;
+  }
+  return idx;
+}
+
+/// maps each key to its position in a previous set of keys
+/// @param prev_idx the previous keys, indexed by KeyIndex
+/// @param prev_to filled with the previous position of each key, or -1
+/// @param kept filled with whether each previous key is still present
+void MapKeys(const std::vector<std::string>& keys,
+             const std::map<std::string, int>& prev_idx,
+             std::vector<int>* prev_to, std::vector<char>* kept) {
+  prev_to->assign(keys.size(), -1);
+  kept->assign(prev_idx.size(), 0);
+  std::map<std::string, int>::const_iterator it;
+  for (int i = 0; i != keys.size(); i++) {
+    it = prev_idx.find(keys[i]);
+    if (it != prev_idx.end()) {
+      (*prev_to)[i] = it->second;
+      (*kept)[it->second] = 1;
+    }
+  }
+}
+
+/// @return the position of each kept entry once all others are deleted
+std::vector<int> Compact(const std::vector<char>& kept) {
+  std::vector<int> pos(kept.size(), -1);
+  int n = 0;
+  for (int i = 0; i != kept.size(); i++) {
+    if (kept[i])
+      pos[i] = n++;
+  }
+  return pos;
+}
+
+bool ProgSolver::Update(const ProgTranslator::Context& ctx,
+                        const std::vector<char>& integers,
+                        std::vector<int>* cols) {
+  const CoinPackedMatrix& m = ctx.m;
+  int ncols = m.getNumCols();
+  int nrows = m.getNumRows();
+  int prev_ncols = col_keys_.size();
+  int prev_nrows = row_keys_.size();
+  if (prev_ncols == 0 || iface_->getNumCols() != prev_ncols ||
+      iface_->getNumRows() != prev_nrows) {
+    Load(ctx, integers, cols);
+    return false;
+  }
+
+  std::vector<int> col_prev, row_prev;
+  std::vector<char> col_kept, row_kept;
+  MapKeys(ctx.col_keys, KeyIndex(col_keys_), &col_prev, &col_kept);
+  MapKeys(ctx.row_keys, KeyIndex(row_keys_), &row_prev, &row_kept);
+  int nkept = std::count(col_kept.begin(), col_kept.end(), 1);
+  if (nkept == 0 || nkept < kMinKeptCols * ncols) {
+    Load(ctx, integers, cols);
+    return false;
+  }
+
+  // coefficients of kept rows in kept columns must be unchanged to update in
+  // place, since the interface does not support modifying them
+  const CoinPackedMatrix* prev_m = iface_->getMatrixByRow();
+  std::vector<std::pair<int, double> > prev_row, row;
+  for (int i = 0; i != nrows; i++) {
+    if (row_prev[i] < 0)
+      continue;
+    prev_row.clear();
+    row.clear();
+    const CoinShallowPackedVector pv = prev_m->getVector(row_prev[i]);
+    for (int k = 0; k != pv.getNumElements(); k++) {
+      if (col_kept[pv.getIndices()[k]])
+        prev_row.push_back(std::make_pair(pv.getIndices()[k],
+                                          pv.getElements()[k]));
+    }
+    const CoinShallowPackedVector v = m.getVector(i);
+    for (int k = 0; k != v.getNumElements(); k++) {
+      int j = col_prev[v.getIndices()[k]];
+      if (j >= 0)
+        row.push_back(std::make_pair(j, v.getElements()[k]));
+    }
+    std::sort(prev_row.begin(), prev_row.end());
+    std::sort(row.begin(), row.end());
+    if (prev_row != row) {
+      Load(ctx, integers, cols);
+      return false;
+    }
+  }
+
+  // remove stale columns and rows
+  std::vector<double> prev_sol(iface_->getColSolution(),
+                               iface_->getColSolution() + prev_ncols);
+  std::vector<int> del;
+  for (int i = 0; i != prev_nrows; i++) {
+    if (!row_kept[i])
+      del.push_back(i);
+  }
+  if (!del.empty())
+    iface_->deleteRows(del.size(), &del[0]);
+  removed_rows_ = del.size();
+  del.clear();
+  for (int j = 0; j != prev_ncols; j++) {
+    if (!col_kept[j])
+      del.push_back(j);
+  }
+  if (!del.empty())
+    iface_->deleteCols(del.size(), &del[0]);
+  removed_cols_ = del.size();
+  std::vector<int> col_pos = Compact(col_kept);
+  std::vector<int> row_pos = Compact(row_kept);
+  int next_col = prev_ncols - removed_cols_;
+  int next_row = prev_nrows - removed_rows_;
+
+  // update kept columns
+  std::vector<double> lbs(iface_->getColLower(),
+                          iface_->getColLower() + next_col);
+  std::vector<double> ubs(iface_->getColUpper(),
+                          iface_->getColUpper() + next_col);
+  std::vector<double> objs(iface_->getObjCoefficients(),
+                           iface_->getObjCoefficients() + next_col);
+  cols->assign(ncols, -1);
+  for (int j = 0; j != ncols; j++) {
+    if (col_prev[j] < 0)
+      continue;
+    int c = col_pos[col_prev[j]];
+    (*cols)[j] = c;
+    if (lbs[c] != ctx.col_lbs[j] || ubs[c] != ctx.col_ubs[j])
+      iface_->setColBounds(c, ctx.col_lbs[j], ctx.col_ubs[j]);
+    if (objs[c] != ctx.obj_coeffs[j])
+      iface_->setObjCoeff(c, ctx.obj_coeffs[j]);
+    if (iface_->isInteger(c) != static_cast<bool>(integers[j])) {
+      if (integers[j]) {
+        iface_->setInteger(c);
+      } else {
+        iface_->setContinuous(c);
+      }
+    }
+  }
+
+  // add new columns with their coefficients in kept rows
+  CoinPackedMatrix by_col;
+  by_col.reverseOrderedCopyOf(m);
+  added_cols_ = 0;
+  for (int j = 0; j != ncols; j++) {
+    if (col_prev[j] >= 0)
+      continue;
+    CoinPackedVector col;
+    const CoinShallowPackedVector v = by_col.getVector(j);
+    for (int k = 0; k != v.getNumElements(); k++) {
+      int i = row_prev[v.getIndices()[k]];
+      if (i >= 0)
+        col.insert(row_pos[i], v.getElements()[k]);
+    }
+    iface_->addCol(col, ctx.col_lbs[j], ctx.col_ubs[j], ctx.obj_coeffs[j]);
+    (*cols)[j] = next_col++;
+    if (integers[j])
+      iface_->setInteger((*cols)[j]);
+    ++added_cols_;
+  }
+
+  // update kept rows and add new rows with all of their coefficients
+  std::vector<double> rlbs(iface_->getRowLower(),
+                           iface_->getRowLower() + next_row);
+  std::vector<double> rubs(iface_->getRowUpper(),
+                           iface_->getRowUpper() + next_row);
+  std::vector<int> rows(nrows, -1);
+  added_rows_ = 0;
+  for (int i = 0; i != nrows; i++) {
+    if (row_prev[i] >= 0) {
+      int r = row_pos[row_prev[i]];
+      rows[i] = r;
+      if (rlbs[r] != ctx.row_lbs[i] || rubs[r] != ctx.row_ubs[i])
+        iface_->setRowBounds(r, ctx.row_lbs[i], ctx.row_ubs[i]);
+      continue;
+    }
+    CoinPackedVector row;
+    const CoinShallowPackedVector v = m.getVector(i);
+    for (int k = 0; k != v.getNumElements(); k++) {
+      row.insert((*cols)[v.getIndices()[k]], v.getElements()[k]);
+    }
+    iface_->addRow(row, ctx.row_lbs[i], ctx.row_ubs[i]);
+    rows[i] = next_row++;
+    ++added_rows_;
+  }
+
+  // start from the previous incumbent, within the new bounds
+  std::vector<double> x(ncols, 0);
+  for (int j = 0; j != ncols; j++) {
+    if (col_prev[j] >= 0) {
+      x[(*cols)[j]] = std::max(ctx.col_lbs[j],
+                               std::min(ctx.col_ubs[j], prev_sol[col_prev[j]]));
+    }
+  }
+  if (ncols > 0)
+    iface_->setColSolution(&x[0]);
+
+  col_keys_.resize(ncols);
+  for (int j = 0; j != ncols; j++) {
+    col_keys_[(*cols)[j]] = ctx.col_keys[j];
+  }
+  row_keys_.resize(nrows);
+  for (int i = 0; i != nrows; i++) {
+    row_keys_[rows[i]] = ctx.row_keys[i];
+  }
+  return true;
+}
+
+void ProgSolver::Load(const ProgTranslator::Context& ctx,
+                      const std::vector<char>& integers,
+                      std::vector<int>* cols) {
+  int ncols = ctx.m.getNumCols();
+  iface_->setObjSense(1.0);  // minimize
+  iface_->loadProblem(ctx.m, ctx.col_lbs.data(), ctx.col_ubs.data(),
+                      ctx.obj_coeffs.data(), ctx.row_lbs.data(),
+                      ctx.row_ubs.data());
+  cols->resize(ncols);
+  for (int j = 0; j != ncols; j++) {
+    (*cols)[j] = j;
+    if (integers[j]) {
+      iface_->setInteger(j);
+    } else {
+      iface_->setContinuous(j);
+    }
+  }
+  col_keys_ = ctx.col_keys;
+  row_keys_ = ctx.row_keys;
+  added_cols_ = ncols;
+  added_rows_ = ctx.m.getNumRows();
+  removed_cols_ = 0;
+  removed_rows_ = 0;
+}
+
+void ProgSolver::RecordWarmStart(bool warm, double rate) {
+  if (verbose_) {
+    std::cout << (warm ? "Warm" : "Cold") << " start: " << added_cols_
+              << " columns added, " << removed_cols_ << " removed; "
+              << added_rows_ << " rows added, " << removed_rows_
+              << " removed. Warm start rate: " << rate << "\n";
+  }
+  if (sim_ctx_ == NULL)
+    return;
+  sim_ctx_->NewDatum("CoinSolverWarmStarts")
+      ->AddVal("Time", sim_ctx_->time())
+      ->AddVal("Warm", warm)
+      ->AddVal("AddedCols", added_cols_)
+      ->AddVal("RemovedCols", removed_cols_)
+      ->AddVal("AddedRows", added_rows_)
+      ->AddVal("RemovedRows", removed_rows_)
+      ->AddVal("HitRate", rate)
+      ->Record();
+}
+
 }  // namespace cyclus
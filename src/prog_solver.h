@@ -1,12 +1,18 @@
 #ifndef CYCLUS_SRC_PROG_SOLVER_H_
 #define CYCLUS_SRC_PROG_SOLVER_H_
 
+#include <map>
+#include <mutex>
 #include <string>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
 
 #include "OsiSolverInterface.hpp"
 
 #include "exchange_graph.h"
 #include "exchange_solver.h"
+#include "prog_translator.h"
 
 namespace cyclus {
 
@@ -14,6 +20,30 @@ class ExchangeGraph;
 
 /// @brief The ProgSolver provides the implementation for a mathematical
 /// programming solution to a resource exchange graph.
+///
+/// In persistent mode, the solver interface is kept between solves. Each
+/// column and row of a program is identified by the requester, bidder, and
+/// commodity it represents, and successive programs are applied to the
+/// interface as the columns and rows that were added or removed and the
+/// bounds and costs that changed. The next solve then starts from the
+/// previous basis (for linear programs) or incumbent (for mixed integer
+/// programs). If coefficients shared by both programs differ, or too few of
+/// the new program's columns were in the previous one (e.g. when exchanges
+/// of different commodities alternate), the program is loaded from scratch
+/// instead. The fraction of solves that are warm-started
+/// is recorded in the CoinSolverWarmStarts table.
+///
+/// A separate program is kept for each resource type (see
+/// ExchangeSolver::res_type) and graph component, so that the exchanges of
+/// different resource types in a time step, and the independent markets of
+/// one exchange, do not replace each other's programs. A component is
+/// identified by its commodities and the lowest agent id among its nodes.
+/// Persistent solvers can be cloned; the clones share the kept programs, so
+/// an ExchangeManager still solves the components of a graph concurrently.
+/// If two components of one graph have the same identity, the one solved
+/// second is solved from scratch and its program is not kept. Graphs without
+/// arcs have no matches to find; they are not solved and leave the kept
+/// programs untouched.
 class ProgSolver: public ExchangeSolver {
  public:
   static const int kDefaultTimeout = 5 * 60; // 5 * 60 s/min == 5 minutes
@@ -24,26 +54,104 @@ class ProgSolver: public ExchangeSolver {
   /// default false
   /// @param verbose print out a lot to stdout, default false
   /// @param mps dump mps files for every solve, default false
+  /// @param persistent keep and warm-start the solver interface between
+  /// solves, default false
   /// @{
   ProgSolver(std::string solver_t);
   ProgSolver(std::string solver_t, double tmax);
   ProgSolver(std::string solver_t, bool exclusive_orders);
   ProgSolver(std::string solver_t, double tmax, bool exclusive_orders,
              bool verbose, bool mps);
+  ProgSolver(std::string solver_t, double tmax, bool exclusive_orders,
+             bool verbose, bool mps, bool persistent);
   /// @}
   virtual ~ProgSolver();
 
+  /// @brief a new ProgSolver with the same configuration, which in
+  /// persistent mode shares this solver's kept programs. Returns NULL if MPS
+  /// files are being dumped, so that each exchange is still written to a
+  /// single file.
+  virtual ExchangeSolver* Clone() const;
+
+  /// @brief the number of persistent mode solves by this solver and its
+  /// clones and how many of them were warm-started
+  /// @{
+  int n_solves() const;
+  int n_warm_starts() const;
+  /// @}
+
  protected:
   /// @brief the ProgSolver solves an ExchangeGraph...
   virtual double SolveGraph();
   
  private:
   void WriteMPS();
-  
+
+  /// @brief solves the graph, updating and warm-starting the persistent
+  /// solver interface
+  double SolvePersistent();
+
+  /// @brief applies a translated program to the persistent solver interface
+  ///
+  /// @param ctx the translated program, with keys
+  /// @param integers whether each column of the program is integer-valued
+  /// @param cols filled with the interface index of each program column
+  /// @return true if the previous program was updated in place, false if the
+  /// program was loaded from scratch because the interface was empty, kept
+  /// coefficients changed or less than kMinKeptCols of its columns were kept
+  bool Update(const ProgTranslator::Context& ctx,
+              const std::vector<char>& integers, std::vector<int>* cols);
+
+  /// @brief loads a translated program into a new solver interface
+  void Load(const ProgTranslator::Context& ctx,
+            const std::vector<char>& integers, std::vector<int>* cols);
+
+  /// @brief the key of the kept program for the graph being solved, built
+  /// from the resource type, commodities and lowest agent id of the graph
+  std::string ProgramKey();
+
+  /// @brief records the outcome of a persistent mode solve
+  ///
+  /// @param warm whether the solve was warm-started
+  /// @param rate the fraction of the kept program's solves that were
+  /// warm-started
+  void RecordWarmStart(bool warm, double rate);
+
   std::string solver_t_;
   double tmax_;
-  bool verbose_, mps_;
+  bool verbose_, mps_, persistent_;
   OsiSolverInterface* iface_;
+
+  /// @name persistent mode state
+  /// @{
+  /// a kept program: its solver interface, the keys of the interface's
+  /// columns and rows, in interface order, and its warm start counts
+  struct Program {
+    Program() : iface(NULL), in_use(false), n_solves(0), n_warm(0) {}
+    OsiSolverInterface* iface;
+    std::vector<std::string> col_keys;
+    std::vector<std::string> row_keys;
+    /// whether a solve currently holds the program
+    bool in_use;
+    int n_solves;
+    int n_warm;
+  };
+
+  /// the kept programs by key (see ProgramKey), shared by a solver and its
+  /// clones. During a persistent solve, the program being solved is moved
+  /// into iface_, col_keys_ and row_keys_.
+  struct Programs {
+    ~Programs();
+    std::mutex mu;
+    std::map<std::string, Program> progs;
+  };
+
+  boost::shared_ptr<Programs> programs_;
+  CoinMessageHandler handler_;
+  std::vector<std::string> col_keys_;
+  std::vector<std::string> row_keys_;
+  int added_cols_, removed_cols_, added_rows_, removed_rows_;
+  /// @}
 };
 
 }  // namespace cyclus
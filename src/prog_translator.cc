@@ -1,6 +1,7 @@
 #include "prog_translator.h"
 
 #include <algorithm>
+#include <sstream>
 
 #include "CoinPackedVector.hpp"
 #include "OsiSolverInterface.hpp"
@@ -17,7 +18,8 @@ ProgTranslator::ProgTranslator(ExchangeGraph* g, OsiSolverInterface* iface)
     : g_(g),
       iface_(iface),
       excl_(false),
-      pseudo_cost_(std::numeric_limits<double>::max()) {
+      pseudo_cost_(std::numeric_limits<double>::max()),
+      track_keys_(false) {
   Init();
 }
 
@@ -26,7 +28,8 @@ ProgTranslator::ProgTranslator(ExchangeGraph* g, OsiSolverInterface* iface,
     : g_(g),
       iface_(iface),
       excl_(exclusive),
-      pseudo_cost_(std::numeric_limits<double>::max()) {
+      pseudo_cost_(std::numeric_limits<double>::max()),
+      track_keys_(false) {
   Init();
 }
 
@@ -35,7 +38,8 @@ ProgTranslator::ProgTranslator(ExchangeGraph* g, OsiSolverInterface* iface,
     : g_(g),
       iface_(iface),
       excl_(false),
-      pseudo_cost_(pseudo_cost) {
+      pseudo_cost_(pseudo_cost),
+      track_keys_(false) {
   Init();
 }
 
@@ -44,7 +48,8 @@ ProgTranslator::ProgTranslator(ExchangeGraph* g, OsiSolverInterface* iface,
     : g_(g),
       iface_(iface),
       excl_(exclusive),
-      pseudo_cost_(pseudo_cost) {
+      pseudo_cost_(pseudo_cost),
+      track_keys_(false) {
   Init();
 }
 
@@ -78,6 +83,22 @@ void ProgTranslator::Translate() {
   int n_cols = g_->arcs().size() + nfalse;
   ctx_.m.setDimensions(0, n_cols);
 
+  ctx_.col_keys.clear();
+  ctx_.row_keys.clear();
+  key_counts_.clear();
+  if (track_keys_) {
+    // arcs are identified by requester, bidder, and commodity
+    ctx_.col_keys.resize(n_cols);
+    std::vector<Arc>& arcs = g_->arcs();
+    for (int i = 0; i != arcs.size(); i++) {
+      ExchangeNode::Ptr u = arcs[i].unode();
+      std::stringstream ss;
+      ss << "a" << u->agent_id << "." << arcs[i].vnode()->agent_id << "."
+         << u->commod;
+      ctx_.col_keys[i] = NextKey_(ss.str());
+    }
+  }
+
   bool request;
   std::vector<ExchangeNodeGroup::Ptr>& sgs = g_->supply_groups();
   for (int i = 0; i != sgs.size(); i++) {
@@ -110,11 +131,10 @@ void ProgTranslator::Populate() {
 
   
   if (excl_) {
-    std::vector<Arc>& arcs = g_->arcs();
-    for (int i = 0; i != arcs.size(); i++) {
-      Arc& a = arcs[i];
-      if (a.exclusive()) {
-        iface_->setInteger(g_->arc_ids()[a]);
+    const FlatExchangeGraph& f = g_->flat();
+    for (int i = 0; i != f.n_arcs(); i++) {
+      if (f.arc_excl[i]) {
+        iface_->setInteger(i);
       }
     }
   }
@@ -126,46 +146,71 @@ void ProgTranslator::ToProg() {
   Populate();
 }
 
+std::string ProgTranslator::NextKey_(const std::string& prefix) {
+  std::stringstream ss;
+  ss << prefix << "#" << key_counts_[prefix]++;
+  return ss.str();
+}
+
 void ProgTranslator::XlateGrp_(ExchangeNodeGroup* grp, bool request) {
   double inf = iface_->getInfinity();
   std::vector<double>& caps = grp->capacities();
 
   if (request && !grp->HasArcs())
     return; // no arcs, no reason to add variables/constraints
-  
+
+  // groups are identified by the agent of their first node
+  std::string grp_key;
+  if (track_keys_) {
+    std::stringstream ss;
+    ss << (request ? "r" : "s")
+       << (grp->nodes().empty() ? -1 : grp->nodes()[0]->agent_id);
+    grp_key = NextKey_(ss.str());
+  }
+
+  const FlatExchangeGraph& f = g_->flat();
+  int gidx = f.GroupIndex(grp);
+  const std::vector<int>& ucap_begin =
+      request ? f.arc_ucap_begin : f.arc_vcap_begin;
+  const std::vector<double>& ucap_vals = request ? f.arc_ucaps : f.arc_vcaps;
+  const std::vector<char>& has_ucaps =
+      request ? f.arc_has_ucaps : f.arc_has_vcaps;
+  const std::vector<int>& arc_node = request ? f.arc_u : f.arc_v;
+  std::vector<Arc>& arcs = g_->arcs();
+
   std::vector<CoinPackedVector> cap_rows;
   std::vector<CoinPackedVector> excl_rows;
+  std::vector<std::string> excl_keys;
   for (int i = 0; i != caps.size(); i++) {
     cap_rows.push_back(CoinPackedVector());
   }
 
-  std::vector<ExchangeNode::Ptr>& nodes = grp->nodes();
-  for (int i = 0; i != nodes.size(); i++) {
-    std::map<Arc, std::vector<double> >& ucap_map = nodes[i]->unit_capacities;
-    std::map<Arc, std::vector<double> >::iterator cap_it;
+  for (int i = f.grp_node_begin[gidx]; i != f.grp_node_begin[gidx + 1]; i++) {
+    int n = f.grp_nodes[i];
 
     // add each arc
-    for (cap_it = ucap_map.begin(); cap_it != ucap_map.end(); ++cap_it) {
-      const Arc& a = cap_it->first;
-      std::vector<double>& ucaps = cap_it->second;
-      int arc_id = g_->arc_ids()[a];
+    for (int j = f.node_arc_begin[n]; j != f.node_arc_begin[n + 1]; j++) {
+      int arc_id = f.node_arcs[j];
+      if (arc_node[arc_id] != n || !has_ucaps[arc_id])
+        continue;
+      bool excl = excl_ && f.arc_excl[arc_id];
 
       // add each unit capacity coefficient
-      for (int j = 0; j != ucaps.size(); j++) {
-        double coeff = ucaps[j];
-        if (excl_ && a.exclusive()) {
-          coeff *= a.excl_val();
+      for (int k = ucap_begin[arc_id]; k != ucap_begin[arc_id + 1]; k++) {
+        double coeff = ucap_vals[k];
+        if (excl) {
+          coeff *= f.arc_excl_val[arc_id];
         }
 
-        cap_rows[j].insert(arc_id, coeff);
+        cap_rows[k - ucap_begin[arc_id]].insert(arc_id, coeff);
       }
 
       if (request) {
+        const Arc& a = arcs[arc_id];
         CheckPref(a.pref());
         ctx_.obj_coeffs[arc_id] = ExchangeSolver::Cost(a, excl_);
         ctx_.col_lbs[arc_id] = 0;
-        ctx_.col_ubs[arc_id] = (excl_ && a.exclusive()) ? 1 :
-                               std::min(nodes[i]->qty, inf);
+        ctx_.col_ubs[arc_id] = excl ? 1 : std::min(f.node_qty[n], inf);
       }
     }
   }
@@ -173,6 +218,8 @@ void ProgTranslator::XlateGrp_(ExchangeNodeGroup* grp, bool request) {
   int faux_id;
   if (request) {
     faux_id = arc_offset_++;
+    if (track_keys_)
+      ctx_.col_keys[faux_id] = grp_key + ":f";
   }
 
   // add all capacity rows
@@ -187,6 +234,11 @@ void ProgTranslator::XlateGrp_(ExchangeNodeGroup* grp, bool request) {
     ctx_.row_lbs.push_back(request ? rlb : 0);
     ctx_.row_ubs.push_back(request ? inf : caps[i]);
     ctx_.m.appendRow(cap_rows[i]);
+    if (track_keys_) {
+      std::stringstream ss;
+      ss << grp_key << ":c" << i;
+      ctx_.row_keys.push_back(ss.str());
+    }
   }
 
   if (excl_) {
@@ -197,13 +249,20 @@ void ProgTranslator::XlateGrp_(ExchangeNodeGroup* grp, bool request) {
       CoinPackedVector excl_row;
       std::vector<ExchangeNode::Ptr>& nodes = exngs[i];
       for (int j = 0; j != nodes.size(); j++) {
-        std::vector<Arc>& arcs = g_->node_arc_map()[nodes[j]];
-        for (int k = 0; k != arcs.size(); k++) {
-          excl_row.insert(g_->arc_ids()[arcs[k]], 1.0);
+        int n = f.NodeIndex(nodes[j].get());
+        if (n < 0)
+          continue;
+        for (int k = f.node_arc_begin[n]; k != f.node_arc_begin[n + 1]; k++) {
+          excl_row.insert(f.node_arcs[k], 1.0);
         }
       }
       if (excl_row.getNumElements() > 0) {
         excl_rows.push_back(excl_row);
+        if (track_keys_) {
+          std::stringstream ss;
+          ss << grp_key << ":x" << i;
+          excl_keys.push_back(ss.str());
+        }
       }
     }
 
@@ -213,19 +272,24 @@ void ProgTranslator::XlateGrp_(ExchangeNodeGroup* grp, bool request) {
       ctx_.row_ubs.push_back(1.0);
       ctx_.m.appendRow(excl_rows[i]);
     }
+    ctx_.row_keys.insert(ctx_.row_keys.end(), excl_keys.begin(),
+                         excl_keys.end());
   }
 }
 
 void ProgTranslator::FromProg() {
-  const double* sol = iface_->getColSolution();
+  FromProg(iface_->getColSolution());
+}
+
+void ProgTranslator::FromProg(const double* sol) {
+  const FlatExchangeGraph& f = g_->flat();
   std::vector<Arc>& arcs = g_->arcs();
   double flow;
   for (int i = 0; i < arcs.size(); i++) {
-    Arc& a = g_->arc_by_id().at(i);
     flow = sol[i];
-    flow = (excl_ && a.exclusive()) ? flow * a.excl_val() : flow;
+    flow = (excl_ && f.arc_excl[i]) ? flow * f.arc_excl_val[i] : flow;
     if (flow > cyclus::eps()) {
-      g_->AddMatch(a, flow);
+      g_->AddMatch(arcs[i], flow);
     }
   }
 }
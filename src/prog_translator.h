@@ -1,6 +1,8 @@
 #ifndef CYCLUS_SRC_PROG_TRANSLATOR_H_
 #define CYCLUS_SRC_PROG_TRANSLATOR_H_
 
+#include <map>
+#include <string>
 #include <vector>
 
 #include "CoinPackedMatrix.hpp"
@@ -20,6 +22,12 @@ struct ProgTranslatorContext {
   std::vector<double> col_ubs;
   std::vector<double> col_lbs;
   CoinPackedMatrix m;
+
+  /// identifiers for each column and row that are stable between exchanges
+  /// with the same traders, filled only if key tracking is enabled (see
+  /// ProgTranslator::track_keys())
+  std::vector<std::string> col_keys;
+  std::vector<std::string> row_keys;
 };
 
 /// a helper class to translate a product exchange into a mathematical
@@ -65,6 +73,15 @@ class ProgTranslator {
   /// @brief translates solution from iface back into graph matches
   void FromProg();
 
+  /// @brief translates a solution back into graph matches
+  /// @param sol the value of each column, in translation order
+  void FromProg(const double* sol);
+
+  /// @brief whether to identify each column and row with a key built from the
+  /// agents and commodities involved, so that programs from successive
+  /// exchanges can be compared (e.g., to update a solver incrementally)
+  inline void track_keys(bool t) { track_keys_ = t; }
+
   const Context& ctx() const { return ctx_; }
 
  private:
@@ -78,12 +95,17 @@ class ProgTranslator {
   /// @param req a boolean flag, true if grp is a request group
   void XlateGrp_(ExchangeNodeGroup* grp, bool req);
 
+  /// @return a key for the next instance of the given key prefix
+  std::string NextKey_(const std::string& prefix);
+
   ExchangeGraph* g_;
   OsiSolverInterface* iface_;
   bool excl_;
   int arc_offset_;
   ProgTranslator::Context ctx_;
   double pseudo_cost_;
+  bool track_keys_;
+  std::map<std::string, int> key_counts_;
 };
 
 }  // namespace cyclus
@@ -0,0 +1,261 @@
+#include "query_backend.h"
+
+#include <algorithm>
+
+#include <boost/uuid/uuid.hpp>
+
+namespace cyclus {
+
+namespace {
+
+bool Aggregable(DbTypes t) {
+  return t == BOOL || t == INT || t == FLOAT || t == DOUBLE;
+}
+
+bool Groupable(DbTypes t) {
+  return Aggregable(t) || t == STRING || t == VL_STRING || t == UUID;
+}
+
+double AsDouble(const boost::spirit::hold_any& v, DbTypes t) {
+  switch (t) {
+    case BOOL:
+      return v.cast<bool>();
+    case INT:
+      return v.cast<int>();
+    case FLOAT:
+      return v.cast<float>();
+    default:
+      return v.cast<double>();
+  }
+}
+
+boost::spirit::hold_any FromDouble(double x, DbTypes t) {
+  switch (t) {
+    case BOOL:
+      return boost::spirit::hold_any(x != 0);
+    case INT:
+      return boost::spirit::hold_any(static_cast<int>(x));
+    case FLOAT:
+      return boost::spirit::hold_any(static_cast<float>(x));
+    default:
+      return boost::spirit::hold_any(x);
+  }
+}
+
+template <typename T>
+int Compare(const boost::spirit::hold_any& a, const boost::spirit::hold_any& b) {
+  const T& x = a.cast<T>();
+  const T& y = b.cast<T>();
+  return x < y ? -1 : (y < x ? 1 : 0);
+}
+
+}  // namespace
+
+AggTable::AggTable(const std::vector<std::string>& group_by,
+                   const std::vector<DbTypes>& key_types,
+                   const std::vector<Agg>& aggs,
+                   const std::vector<DbTypes>& agg_types, int bucket)
+    : desc_(Describe(group_by, key_types, aggs, agg_types, bucket)),
+      aggs_(aggs),
+      agg_types_(agg_types),
+      bucket_(bucket) {
+  KeyLess less;
+  less.types = key_types;
+  groups_ = std::map<QueryRow, Group, KeyLess>(less);
+}
+
+QueryResult AggTable::Describe(const std::vector<std::string>& group_by,
+                               const std::vector<DbTypes>& key_types,
+                               const std::vector<Agg>& aggs,
+                               const std::vector<DbTypes>& agg_types,
+                               int bucket) {
+  QueryResult qr;
+  for (int i = 0; i < group_by.size(); ++i) {
+    if (!Groupable(key_types[i])) {
+      throw ValueError("cannot group by non-scalar field " + group_by[i]);
+    }
+    qr.fields.push_back(group_by[i]);
+    qr.types.push_back(key_types[i]);
+  }
+  if (bucket > 0 && (group_by.empty() || key_types[0] != INT)) {
+    throw ValueError("time buckets need an INT field to group by first");
+  }
+
+  for (int i = 0; i < aggs.size(); ++i) {
+    DbTypes t = INT;
+    if (aggs[i].opcode != AGG_COUNT) {
+      if (!Aggregable(agg_types[i])) {
+        throw ValueError("cannot aggregate non-numeric field " +
+                         aggs[i].field);
+      }
+      t = agg_types[i];
+      if (aggs[i].opcode == AGG_SUM || aggs[i].opcode == AGG_MEAN) {
+        t = DOUBLE;
+      }
+    }
+    qr.fields.push_back(aggs[i].name());
+    qr.types.push_back(t);
+  }
+  return qr;
+}
+
+void AggTable::Add(QueryRow key, const double* vals) {
+  if (bucket_ > 0) {
+    int t = key[0].cast<int>();
+    int r = ((t % bucket_) + bucket_) % bucket_;
+    key[0] = t - r;
+  }
+
+  Group& g = groups_[key];
+  if (g.count == 0) {
+    g.accs.resize(aggs_.size());
+    for (int i = 0; i < aggs_.size(); ++i) {
+      g.accs[i].sum = 0;
+      g.accs[i].min = vals[i];
+      g.accs[i].max = vals[i];
+    }
+  }
+  ++g.count;
+  for (int i = 0; i < aggs_.size(); ++i) {
+    Acc& a = g.accs[i];
+    a.sum += vals[i];
+    a.min = std::min(a.min, vals[i]);
+    a.max = std::max(a.max, vals[i]);
+  }
+}
+
+void AggTable::Merge(const AggTable& other) {
+  std::map<QueryRow, Group, KeyLess>::const_iterator it;
+  for (it = other.groups_.begin(); it != other.groups_.end(); ++it) {
+    Group& g = groups_[it->first];
+    if (g.count == 0) {
+      g = it->second;
+      continue;
+    }
+    g.count += it->second.count;
+    for (int i = 0; i < aggs_.size(); ++i) {
+      const Acc& b = it->second.accs[i];
+      g.accs[i].sum += b.sum;
+      g.accs[i].min = std::min(g.accs[i].min, b.min);
+      g.accs[i].max = std::max(g.accs[i].max, b.max);
+    }
+  }
+}
+
+QueryResult AggTable::Result() const {
+  QueryResult qr = desc_;
+  std::map<QueryRow, Group, KeyLess>::const_iterator it;
+  for (it = groups_.begin(); it != groups_.end(); ++it) {
+    const Group& g = it->second;
+    QueryRow row = it->first;
+    for (int i = 0; i < aggs_.size(); ++i) {
+      const Acc& a = g.accs[i];
+      switch (aggs_[i].opcode) {
+        case AGG_COUNT:
+          row.push_back(boost::spirit::hold_any(static_cast<int>(g.count)));
+          break;
+        case AGG_SUM:
+          row.push_back(boost::spirit::hold_any(a.sum));
+          break;
+        case AGG_MIN:
+          row.push_back(FromDouble(a.min, agg_types_[i]));
+          break;
+        case AGG_MAX:
+          row.push_back(FromDouble(a.max, agg_types_[i]));
+          break;
+        case AGG_MEAN:
+          row.push_back(boost::spirit::hold_any(a.sum / g.count));
+          break;
+      }
+    }
+    qr.rows.push_back(row);
+  }
+  return qr;
+}
+
+bool AggTable::KeyLess::operator()(const QueryRow& a,
+                                   const QueryRow& b) const {
+  for (int i = 0; i < types.size(); ++i) {
+    int c;
+    switch (types[i]) {
+      case BOOL:
+        c = Compare<bool>(a[i], b[i]);
+        break;
+      case INT:
+        c = Compare<int>(a[i], b[i]);
+        break;
+      case FLOAT:
+        c = Compare<float>(a[i], b[i]);
+        break;
+      case DOUBLE:
+        c = Compare<double>(a[i], b[i]);
+        break;
+      case UUID:
+        c = Compare<boost::uuids::uuid>(a[i], b[i]);
+        break;
+      default:
+        c = Compare<std::string>(a[i], b[i]);
+        break;
+    }
+    if (c != 0) {
+      return c < 0;
+    }
+  }
+  return false;
+}
+
+QueryResult QueryableBackend::Aggregate(std::string table,
+                                        std::vector<Cond>* conds,
+                                        std::vector<std::string>* group_by,
+                                        std::vector<Agg>* aggs, int bucket) {
+  std::vector<std::string> keys;
+  if (group_by != NULL) {
+    keys = *group_by;
+  }
+  std::vector<Agg> a;
+  if (aggs != NULL) {
+    a = *aggs;
+  }
+
+  // read the group_by fields followed by the aggregated ones
+  std::vector<std::string> cols = keys;
+  std::vector<int> val_idx;
+  for (int i = 0; i < a.size(); ++i) {
+    if (a[i].opcode == AGG_COUNT) {
+      val_idx.push_back(-1);
+      continue;
+    }
+    int j = std::find(cols.begin(), cols.end(), a[i].field) - cols.begin();
+    if (j == cols.size()) {
+      cols.push_back(a[i].field);
+    }
+    val_idx.push_back(j);
+  }
+
+  QueryCursor::Ptr c = Cursor(table, conds, cols.empty() ? NULL : &cols);
+  std::vector<DbTypes> key_types(c->types().begin(),
+                                 c->types().begin() + keys.size());
+  std::vector<DbTypes> agg_types;
+  for (int i = 0; i < a.size(); ++i) {
+    agg_types.push_back(val_idx[i] < 0 ? INT : c->types()[val_idx[i]]);
+  }
+  AggTable t(keys, key_types, a, agg_types, bucket);
+
+  std::vector<QueryRow> rows;
+  std::vector<double> vals(a.size(), 0);
+  while (c->Next(&rows)) {
+    for (int i = 0; i < rows.size(); ++i) {
+      QueryRow& r = rows[i];
+      for (int k = 0; k < a.size(); ++k) {
+        if (val_idx[k] >= 0) {
+          vals[k] = AsDouble(r[val_idx[k]], agg_types[k]);
+        }
+      }
+      r.resize(keys.size());
+      t.Add(r, vals.empty() ? NULL : &vals[0]);
+    }
+  }
+  return t.Result();
+}
+
+}  // namespace cyclus
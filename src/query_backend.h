@@ -1,11 +1,14 @@
 #ifndef CYCLUS_SRC_QUERY_BACKEND_H_
 #define CYCLUS_SRC_QUERY_BACKEND_H_
 
+#include <algorithm>
 #include <climits>
+#include <iterator>
 #include <list>
 #include <map>
 #include <set>
 
+#include <boost/shared_ptr.hpp>
 #include <boost/uuid/sha1.hpp>
 
 #include "blob.h"
@@ -296,6 +299,57 @@ class Cond {
   boost::spirit::hold_any val;
 };
 
+/// Represents aggregate function codes.
+enum AggOpCode {
+  AGG_COUNT = 0,
+  AGG_SUM,
+  AGG_MIN,
+  AGG_MAX,
+  AGG_MEAN,
+};
+
+/// Represents an aggregate computed over each group of rows by an aggregate
+/// query, see QueryableBackend::Aggregate.
+class Agg {
+ public:
+  Agg() {}
+
+  Agg(std::string op, std::string field = "")
+      : op(op),
+        field(field) {
+    if (op == "count")
+      opcode = AGG_COUNT;
+    else if (op == "sum")
+      opcode = AGG_SUM;
+    else if (op == "min")
+      opcode = AGG_MIN;
+    else if (op == "max")
+      opcode = AGG_MAX;
+    else if (op == "mean")
+      opcode = AGG_MEAN;
+    else
+      throw ValueError("aggregate '" + op + "' not valid for field '" + \
+                       field + "'.");
+    if (opcode != AGG_COUNT && field == "")
+      throw ValueError("aggregate '" + op + "' needs a field.");
+  }
+
+  /// Returns the name of the aggregate's field in query results: "count" for
+  /// counts and e.g. "sum(Quantity)" otherwise.
+  std::string name() const {
+    return opcode == AGG_COUNT ? op : op + "(" + field + ")";
+  }
+
+  /// One of: "count", "sum", "min", "max", "mean"
+  std::string op;
+
+  /// The AggOpCode cooresponding to op.
+  AggOpCode opcode;
+
+  /// table column name, ignored for counts
+  std::string field;
+};
+
 typedef std::vector<boost::spirit::hold_any> QueryRow;
 
 /// Meta data and results of a query.
@@ -356,6 +410,184 @@ class QueryResult {
   }
 };
 
+/// A forward-only cursor over the rows matching a query, as returned by
+/// QueryableBackend::Cursor. Rows are produced lazily in batches so that
+/// large tables can be processed without holding all of their rows in memory.
+/// Example use:
+///
+/// @code
+///
+/// std::vector<std::string> cols;
+/// cols.push_back("Quantity");
+/// QueryCursor::Ptr c = b->Cursor("Resources", NULL, &cols);
+/// std::vector<QueryRow> rows;
+/// double total = 0;
+/// while (c->Next(&rows)) {
+///   for (int i = 0; i < rows.size(); ++i) {
+///     total += rows[i][0].cast<double>();
+///   }
+/// }
+///
+/// @endcode
+class QueryCursor {
+ public:
+  typedef boost::shared_ptr<QueryCursor> Ptr;
+
+  /// default maximum number of rows returned by each call to Next
+  static const int kBatchSize = 4096;
+
+  virtual ~QueryCursor() {}
+
+  /// names of each field returned by the cursor
+  const std::vector<std::string>& fields() const { return fields_; }
+
+  /// types of each field returned by the cursor
+  const std::vector<DbTypes>& types() const { return types_; }
+
+  /// Replaces the contents of rows with the next (at most n) rows. Returns
+  /// false, leaving rows empty, once all rows have been returned.
+  virtual bool Next(std::vector<QueryRow>* rows, int n = kBatchSize) = 0;
+
+  /// Reads all remaining rows into a QueryResult.
+  QueryResult ReadAll() {
+    QueryResult qr;
+    qr.fields = fields_;
+    qr.types = types_;
+    std::vector<QueryRow> rows;
+    while (Next(&rows, INT_MAX)) {
+      if (qr.rows.empty()) {
+        qr.rows.swap(rows);
+      } else {
+        qr.rows.insert(qr.rows.end(), std::make_move_iterator(rows.begin()),
+                       std::make_move_iterator(rows.end()));
+      }
+    }
+    return qr;
+  }
+
+ protected:
+  /// Sets fields and types to the projection of all_fields and all_types on
+  /// cols (or all of them if cols is NULL) and returns the index of each
+  /// projected field in all_fields.
+  std::vector<int> Project(const std::vector<std::string>& all_fields,
+                           const std::vector<DbTypes>& all_types,
+                           const std::vector<std::string>* cols) {
+    std::vector<int> idx;
+    if (cols == NULL) {
+      for (int i = 0; i < all_fields.size(); ++i) {
+        idx.push_back(i);
+      }
+    } else {
+      for (int i = 0; i < cols->size(); ++i) {
+        int j = std::find(all_fields.begin(), all_fields.end(), (*cols)[i]) -
+                all_fields.begin();
+        if (j == all_fields.size()) {
+          throw KeyError("query has no such field " + (*cols)[i]);
+        }
+        idx.push_back(j);
+      }
+    }
+    fields_.clear();
+    types_.clear();
+    for (int i = 0; i < idx.size(); ++i) {
+      fields_.push_back(all_fields[idx[i]]);
+      types_.push_back(all_types[idx[i]]);
+    }
+    return idx;
+  }
+
+  std::vector<std::string> fields_;
+  std::vector<DbTypes> types_;
+};
+
+/// A cursor over the rows of an already materialized QueryResult. It adapts
+/// backends that only implement Query to the cursor interface.
+class ResultCursor : public QueryCursor {
+ public:
+  ResultCursor(const QueryResult& qr, const std::vector<std::string>* cols)
+      : qr_(qr),
+        pos_(0) {
+    idx_ = Project(qr_.fields, qr_.types, cols);
+  }
+
+  virtual bool Next(std::vector<QueryRow>* rows, int n = kBatchSize) {
+    rows->clear();
+    for (; pos_ < qr_.rows.size() && rows->size() < n; ++pos_) {
+      QueryRow r(idx_.size());
+      for (int i = 0; i < idx_.size(); ++i) {
+        r[i] = qr_.rows[pos_][idx_[i]];
+      }
+      rows->push_back(r);
+    }
+    return !rows->empty();
+  }
+
+ private:
+  QueryResult qr_;
+  std::vector<int> idx_;
+  size_t pos_;
+};
+
+/// Groups rows and accumulates aggregates over each group, for backends that
+/// compute aggregate queries by scanning rows. Tables filled from different
+/// parts of a table (e.g. in parallel) can be merged.
+class AggTable {
+ public:
+  /// @param group_by the fields rows are grouped by
+  /// @param key_types the types of the group_by fields
+  /// @param aggs the aggregates computed over each group
+  /// @param agg_types the types of the aggregates' fields (ignored for counts)
+  /// @param bucket as for QueryableBackend::Aggregate
+  AggTable(const std::vector<std::string>& group_by,
+           const std::vector<DbTypes>& key_types, const std::vector<Agg>& aggs,
+           const std::vector<DbTypes>& agg_types, int bucket);
+
+  /// Returns an empty result with the fields and types of the results of an
+  /// aggregate query, throwing a ValueError if the query is not supported
+  /// (arguments as for the constructor).
+  static QueryResult Describe(const std::vector<std::string>& group_by,
+                              const std::vector<DbTypes>& key_types,
+                              const std::vector<Agg>& aggs,
+                              const std::vector<DbTypes>& agg_types,
+                              int bucket);
+
+  /// Adds a row to the group of the group_by values in key. vals holds the
+  /// value of each aggregate's field (ignored for counts).
+  void Add(QueryRow key, const double* vals);
+
+  /// Adds all rows added to other, which must aggregate the same query.
+  void Merge(const AggTable& other);
+
+  /// Returns a row per group, ordered by group.
+  QueryResult Result() const;
+
+ private:
+  /// running sum, minimum and maximum of an aggregate's field in a group
+  struct Acc {
+    double sum;
+    double min;
+    double max;
+  };
+
+  struct Group {
+    Group() : count(0) {}
+    long long count;
+    std::vector<Acc> accs;
+  };
+
+  /// orders keys by the values of their fields, as typed by types
+  struct KeyLess {
+    std::vector<DbTypes> types;
+    bool operator()(const QueryRow& a, const QueryRow& b) const;
+  };
+
+  QueryResult desc_;
+  std::vector<Agg> aggs_;
+  std::vector<DbTypes> agg_types_;
+  int bucket_;
+  std::map<QueryRow, Group, KeyLess> groups_;
+};
+
 /// Interface implemented by backends that support rudimentary querying.
 class QueryableBackend {
  public:
@@ -365,6 +597,35 @@ class QueryableBackend {
   /// conditions.  Conditions are AND'd together.  conds may be NULL.
   virtual QueryResult Query(std::string table, std::vector<Cond>* conds) = 0;
 
+  /// Return a cursor over the rows from the specified table that match all
+  /// given conditions (as for Query). If cols is not NULL, only the named
+  /// fields are returned, in that order. Backends that can read rows lazily
+  /// override this; by default the rows are queried all at once.
+  virtual QueryCursor::Ptr Cursor(std::string table, std::vector<Cond>* conds,
+                                  std::vector<std::string>* cols = NULL) {
+    return QueryCursor::Ptr(new ResultCursor(Query(table, conds), cols));
+  }
+
+  /// Return the aggregates of the rows from the specified table that match
+  /// all given conditions (conds may be NULL), grouped by the values of the
+  /// group_by fields (group_by may be NULL or empty for a single group of all
+  /// rows). If bucket is positive, the values of the first group_by field,
+  /// which must be INT (e.g. a time), are rounded down to multiples of bucket
+  /// before grouping.
+  ///
+  /// The result has a row per non-empty group, ordered by group, holding the
+  /// group_by fields followed by a field per aggregate named by Agg::name.
+  /// Counts are INT, sums and means are DOUBLE and minimums and maximums have
+  /// the type of their field. Only BOOL, INT, FLOAT and DOUBLE fields can be
+  /// aggregated, and only scalar fields grouped by.
+  ///
+  /// Backends that can compute aggregates without returning rows override
+  /// this; by default the rows are read through Cursor and aggregated in an
+  /// AggTable.
+  virtual QueryResult Aggregate(std::string table, std::vector<Cond>* conds,
+                                std::vector<std::string>* group_by,
+                                std::vector<Agg>* aggs, int bucket = 0);
+
   /// Return a map of column names of the specified table to the associated 
   /// database type.
   virtual std::map<std::string, DbTypes> ColumnTypes(std::string table) = 0;
@@ -406,6 +667,25 @@ class CondInjector: public QueryableBackend {
     return b_->Query(table, &c);
   }
 
+  virtual QueryCursor::Ptr Cursor(std::string table, std::vector<Cond>* conds,
+                                  std::vector<std::string>* cols = NULL) {
+    std::vector<Cond> c = to_inject_;
+    if (conds != NULL) {
+      c.insert(c.begin(), conds->begin(), conds->end());
+    }
+    return b_->Cursor(table, &c, cols);
+  }
+
+  virtual QueryResult Aggregate(std::string table, std::vector<Cond>* conds,
+                                std::vector<std::string>* group_by,
+                                std::vector<Agg>* aggs, int bucket = 0) {
+    std::vector<Cond> c = to_inject_;
+    if (conds != NULL) {
+      c.insert(c.begin(), conds->begin(), conds->end());
+    }
+    return b_->Aggregate(table, &c, group_by, aggs, bucket);
+  }
+
   virtual std::map<std::string, DbTypes> ColumnTypes(std::string table) {
     return b_->ColumnTypes(table);
   }
@@ -431,6 +711,17 @@ class PrefixInjector: public QueryableBackend {
     return b_->Query(prefix_ + table, conds);
   }
 
+  virtual QueryCursor::Ptr Cursor(std::string table, std::vector<Cond>* conds,
+                                  std::vector<std::string>* cols = NULL) {
+    return b_->Cursor(prefix_ + table, conds, cols);
+  }
+
+  virtual QueryResult Aggregate(std::string table, std::vector<Cond>* conds,
+                                std::vector<std::string>* group_by,
+                                std::vector<Agg>* aggs, int bucket = 0) {
+    return b_->Aggregate(prefix_ + table, conds, group_by, aggs, bucket);
+  }
+
   virtual std::map<std::string, DbTypes> ColumnTypes(std::string table) {
     return b_->ColumnTypes(table);
   }
@@ -575,6 +866,10 @@ class Sha1 {
     hash_.process_bytes(s.c_str(), s.size());
   }
 
+  inline void Update(const char* data, size_t n) {
+    hash_.process_bytes(data, n);
+  }
+
   inline void Update(const Blob& b) { Update(b.str()); }
 
   inline void Update(const std::vector<int>& x) {
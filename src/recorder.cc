@@ -1,5 +1,7 @@
 #include "recorder.h"
 
+#include <chrono>
+#include <utility>
 #include <boost/uuid/uuid_generators.hpp>
 #include <boost/uuid/uuid_io.hpp>
 #include <boost/lexical_cast.hpp>
@@ -10,35 +12,102 @@
 
 namespace cyclus {
 
-Recorder::Recorder() : index_(0), inject_sim_id_(true) {
+namespace {
+
+/// the recorder and staging buffer selected on this thread, see
+/// Recorder::SelectStage
+thread_local Recorder* stage_rec = NULL;
+thread_local int stage_idx = -1;
+
+/// adds the time from its construction to its destruction to *secs
+class WriteTimer {
+ public:
+  explicit WriteTimer(double* secs)
+      : secs_(secs), start_(std::chrono::steady_clock::now()) {}
+
+  ~WriteTimer() {
+    std::chrono::duration<double> d = std::chrono::steady_clock::now() - start_;
+    *secs_ += d.count();
+  }
+
+ private:
+  double* secs_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+}  // namespace
+
+Recorder::Recorder()
+    : index_(0),
+      write_secs_(0),
+      inject_sim_id_(true),
+      nbuffers_(kDefaultNumBuffers),
+      writing_(false),
+      stop_(false) {
   uuid_ = boost::uuids::random_generator()();
   set_dump_count(kDefaultDumpCount);
 }
 
-Recorder::Recorder(bool inject_sim_id) : index_(0), inject_sim_id_(inject_sim_id) {
+Recorder::Recorder(bool inject_sim_id)
+    : index_(0),
+      write_secs_(0),
+      inject_sim_id_(inject_sim_id),
+      nbuffers_(kDefaultNumBuffers),
+      writing_(false),
+      stop_(false) {
   uuid_ = boost::uuids::random_generator()();
   set_dump_count(kDefaultDumpCount);
 }
 
-Recorder::Recorder(unsigned int dump_count) : index_(0), inject_sim_id_(true) {
+Recorder::Recorder(unsigned int dump_count)
+    : index_(0),
+      write_secs_(0),
+      inject_sim_id_(true),
+      nbuffers_(kDefaultNumBuffers),
+      writing_(false),
+      stop_(false) {
   uuid_ = boost::uuids::random_generator()();
   set_dump_count(dump_count);
 }
 
-Recorder::Recorder(boost::uuids::uuid simid) : index_(0), uuid_(simid), \
-                                               inject_sim_id_(true) {
+Recorder::Recorder(boost::uuids::uuid simid)
+    : index_(0),
+      write_secs_(0),
+      uuid_(simid),
+      inject_sim_id_(true),
+      nbuffers_(kDefaultNumBuffers),
+      writing_(false),
+      stop_(false) {
   set_dump_count(kDefaultDumpCount);
 }
 
 Recorder::~Recorder() {
+  // nothing may escape a destructor: backends can throw anything from
+  // Notify, and the writer thread must be joined even if flushing failed
   try {
     Flush();
-  } catch (Error err) {
+  } catch (std::exception& err) {
     CLOG(LEV_ERROR) << "Error in Recorder destructor: " << err.what();
+  } catch (...) {
+    CLOG(LEV_ERROR) << "Unknown error in Recorder destructor";
+  }
+  try {
+    StopWriter();
+  } catch (std::exception& err) {
+    CLOG(LEV_ERROR) << "Error stopping Recorder writer thread: " << err.what();
+  } catch (...) {
+    CLOG(LEV_ERROR) << "Unknown error stopping Recorder writer thread";
   }
 
-  for (int i = 0; i < data_.size(); ++i) {
-    delete data_[i];
+  DeleteBuffer(data_);
+  for (int i = 0; i < free_.size(); ++i) {
+    DeleteBuffer(free_[i]);
+  }
+  for (int i = 0; i < full_.size(); ++i) {
+    DeleteBuffer(full_[i]);
+  }
+  for (int i = 0; i < stages_.size(); ++i) {
+    DeleteBuffer(stages_[i].data);
   }
 }
 
@@ -51,43 +120,102 @@ boost::uuids::uuid Recorder::sim_id() {
 }
 
 void Recorder::set_dump_count(unsigned int count) {
-  for (int i = 0; i < data_.size(); ++i) {
-    delete data_[i];
-  }
-  data_.clear();
-  data_.reserve(count);
-  for (int i = 0; i < count; ++i) {
-    Datum* d = new Datum(this, "");
-    if (inject_sim_id_) {
-      d->AddVal("SimId", uuid_);
+  Drain();
+  dump_count_ = count;
+  DeleteBuffer(data_);
+  data_ = NewBuffer();
+  for (int i = 0; i < stages_.size(); ++i) {
+    DeleteBuffer(stages_[i].data);
+    stages_[i].n = 0;
+  }
+
+  std::lock_guard<std::mutex> lk(mu_);
+  for (int i = 0; i < free_.size(); ++i) {
+    DeleteBuffer(free_[i]);
+    free_[i] = NewBuffer();
+  }
+}
+
+unsigned int Recorder::nbuffers() {
+  return nbuffers_;
+}
+
+void Recorder::set_nbuffers(unsigned int n) {
+  n = n < 1 ? 1 : n;
+  Drain();
+  {
+    // every buffer but the current one is free once drained
+    std::lock_guard<std::mutex> lk(mu_);
+    while (free_.size() > n - 1) {
+      DeleteBuffer(free_.back());
+      free_.pop_back();
+    }
+    while (free_.size() < n - 1) {
+      free_.push_back(NewBuffer());
     }
-    data_.push_back(d);
   }
-  dump_count_ = count;
+  nbuffers_ = n;
+
+  if (n == 1) {
+    StopWriter();
+  } else if (!writer_.joinable()) {
+    writer_ = std::thread(&Recorder::WriterLoop, this);
+  }
 }
 
-Datum* Recorder::NewDatum(std::string title) {
-  Datum* d = data_[index_];
-  d->title_ = title;
+DatumList Recorder::NewBuffer() {
+  DatumList buf;
+  buf.reserve(dump_count_);
+  for (int i = 0; i < dump_count_; ++i) {
+    buf.push_back(MakeDatum());
+  }
+  return buf;
+}
+
+Datum* Recorder::MakeDatum() {
+  Datum* d = new Datum(this, "");
   if (inject_sim_id_) {
-    d->vals_.resize(1);
-    d->shapes_.resize(1);
-  } else {
-    d->vals_.resize(0);
-    d->shapes_.resize(0);
+    d->AddVal("SimId", uuid_);
+  }
+  return d;
+}
+
+void Recorder::DeleteBuffer(DatumList& buf) {
+  for (int i = 0; i < buf.size(); ++i) {
+    delete buf[i];
   }
+  buf.clear();
+}
 
-  index_++;
+Datum* Recorder::NewDatum(std::string title) {
+  Datum* d;
+  if (stage_rec == this) {
+    Stage& s = stages_[stage_idx];
+    if (s.n == s.data.size()) {
+      s.data.push_back(MakeDatum());
+    }
+    d = s.data[s.n++];
+  } else {
+    d = data_[index_];
+    index_++;
+  }
+  d->title_ = title;
+  d->Truncate(inject_sim_id_ ? 1 : 0);
   return d;
 }
 
 void Recorder::AddDatum(Datum* d) {
+  if (stage_rec == this) {
+    return;  // staged until MergeStages
+  }
   if (index_ >= data_.size()) {
     NotifyBackends();
   }
 }
 
 void Recorder::Flush() {
+  WriteTimer wt(&write_secs_);
+  Drain();
   if (index_ == 0)
     return;
   DatumList tmp = data_;
@@ -101,14 +229,149 @@ void Recorder::Flush() {
 }
 
 void Recorder::NotifyBackends() {
+  WriteTimer wt(&write_secs_);
   index_ = 0;
-  std::list<RecBackend*>::iterator it;
-  for (it = backs_.begin(); it != backs_.end(); it++) {
-    (*it)->Notify(data_);
+  if (!writer_.joinable()) {
+    std::list<RecBackend*>::iterator it;
+    for (it = backs_.begin(); it != backs_.end(); it++) {
+      (*it)->Notify(data_);
+    }
+    return;
+  }
+
+  // hand the full buffer to the writer and continue with a free one, waiting
+  // for the writer if there is none
+  std::exception_ptr err;
+  {
+    std::unique_lock<std::mutex> lk(mu_);
+    while (free_.empty()) {
+      free_cv_.wait(lk);
+    }
+    full_.push_back(DatumList());
+    full_.back().swap(data_);
+    data_.swap(free_.back());
+    free_.pop_back();
+    err = err_;
+    err_ = std::exception_ptr();
+  }
+  full_cv_.notify_one();
+  if (err) {
+    std::rethrow_exception(err);
+  }
+}
+
+void Recorder::Drain() {
+  if (!writer_.joinable())
+    return;
+
+  std::exception_ptr err;
+  {
+    std::unique_lock<std::mutex> lk(mu_);
+    while (!full_.empty() || writing_) {
+      free_cv_.wait(lk);
+    }
+    err = err_;
+    err_ = std::exception_ptr();
+  }
+  if (err) {
+    std::rethrow_exception(err);
   }
 }
 
+void Recorder::StopWriter() {
+  if (!writer_.joinable())
+    return;
+
+  {
+    std::lock_guard<std::mutex> lk(mu_);
+    stop_ = true;
+  }
+  full_cv_.notify_all();
+  writer_.join();
+  stop_ = false;
+}
+
+void Recorder::WriterLoop() {
+  std::unique_lock<std::mutex> lk(mu_);
+  while (true) {
+    while (!stop_ && full_.empty()) {
+      full_cv_.wait(lk);
+    }
+    if (full_.empty()) {
+      return;  // stopped with nothing left to write
+    }
+
+    DatumList buf;
+    buf.swap(full_.front());
+    full_.pop_front();
+    writing_ = true;
+    bool failed = static_cast<bool>(err_);
+    lk.unlock();
+
+    // once a write fails, queued data is discarded until the error is seen
+    std::exception_ptr err;
+    if (!failed) {
+      try {
+        std::list<RecBackend*>::iterator it;
+        for (it = backs_.begin(); it != backs_.end(); it++) {
+          (*it)->Notify(buf);
+        }
+      } catch (...) {
+        err = std::current_exception();
+      }
+    }
+
+    lk.lock();
+    if (err)
+      err_ = err;
+    free_.push_back(DatumList());
+    free_.back().swap(buf);
+    writing_ = false;
+    free_cv_.notify_all();
+  }
+}
+
+void Recorder::OpenStages(int n) {
+  if (stages_.size() < n) {
+    stages_.resize(n);
+  }
+  for (int i = 0; i < stages_.size(); ++i) {
+    stages_[i].n = 0;
+  }
+}
+
+void Recorder::SelectStage(int i) {
+  stage_rec = i >= 0 ? this : NULL;
+  stage_idx = i;
+}
+
+void Recorder::MergeStages() {
+  // staged Datum objects trade places with unused ones of the shared buffer
+  for (int i = 0; i < stages_.size(); ++i) {
+    Stage& s = stages_[i];
+    int n = s.n;
+    s.n = 0;
+    for (int k = 0; k < n; ++k) {
+      std::swap(data_[index_], s.data[k]);
+      index_++;
+      if (index_ >= data_.size()) {
+        NotifyBackends();
+      }
+    }
+  }
+}
+
+DatumList Recorder::Staged(int i) {
+  Stage& s = stages_[i];
+  return DatumList(s.data.begin(), s.data.begin() + s.n);
+}
+
+void Recorder::DropStage(int i) {
+  stages_[i].n = 0;
+}
+
 void Recorder::RegisterBackend(RecBackend* b) {
+  Drain();
   backs_.push_back(b);
 }
 
@@ -117,4 +380,11 @@ void Recorder::Close() {
   backs_.clear();
 }
 
+void Recorder::Detach(boost::uuids::uuid simid) {
+  backs_.clear();
+  uuid_ = simid;
+  set_dump_count(dump_count_);  // rebuild buffers with the new sim id
+  index_ = 0;
+}
+
 }  // namespace cyclus
@@ -1,8 +1,13 @@
 #ifndef CYCLUS_SRC_RECORDER_H_
 #define CYCLUS_SRC_RECORDER_H_
 
+#include <condition_variable>
+#include <deque>
+#include <exception>
 #include <list>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 #include <boost/uuid/uuid.hpp>
 #include <boost/uuid/uuid_io.hpp>
@@ -20,6 +25,9 @@ typedef std::vector<Datum*> DatumList;
 /// default number of Datum objects to collect before flushing to backends.
 static unsigned int const kDefaultDumpCount = 10000;
 
+/// default number of Datum buffers, a single buffer records synchronously.
+static unsigned int const kDefaultNumBuffers = 1;
+
 /// Collects and manages output data generation for the cyclus core and agents
 /// during a simulation.  By default, datum managers are auto-initialized with a
 /// unique uuid simulation id.
@@ -42,6 +50,31 @@ static unsigned int const kDefaultDumpCount = 10000;
 /// manager->Close();
 ///
 /// @endcode
+///
+/// By default, the simulation waits while backends write each full buffer of
+/// Datum objects. With two or more buffers (see set_nbuffers()), full buffers
+/// are instead written by a dedicated writer thread while the simulation fills
+/// the next free buffer. The simulation only waits when every buffer is full
+/// or being written. Errors thrown by backends on the writer thread are
+/// rethrown on the simulation thread by the next call that hands off a full
+/// buffer or by Flush() or Close(); data queued behind a failed write is
+/// discarded.
+///
+/// NewDatum may also be called concurrently from the tasks of a parallel
+/// phase. Each task selects its own staging buffer with SelectStage, and the
+/// Datum objects it creates are held there until MergeStages appends every
+/// stage to the shared buffer in stage order. Output therefore does not depend
+/// on how tasks were scheduled across threads:
+///
+/// @code
+/// manager->OpenStages(n);
+/// pool->ParallelFor(n, [&](int i) {
+///   manager->SelectStage(i);
+///   Work(i);  // may call manager->NewDatum(...)->...->Record()
+///   manager->SelectStage(-1);
+/// });
+/// manager->MergeStages();
+/// @endcode
 class Recorder {
   friend class Datum;
 
@@ -76,9 +109,25 @@ class Recorder {
   /// @warning this deletes all buffered data from the recorder.
   void set_dump_count(unsigned int count);
 
+  /// Return the number of Datum buffers, values greater than one indicate that
+  /// backends are written to asynchronously.
+  unsigned int nbuffers();
+
+  /// set the number of Datum buffers the Recorder cycles through. With two or
+  /// more buffers, full buffers are passed to backends on a dedicated writer
+  /// thread. Buffered data is preserved.
+  ///
+  /// @param n # Datum buffers, values less than 1 are treated as 1.
+  void set_nbuffers(unsigned int n);
+
   /// returns the unique id associated with this cyclus simulation.
   boost::uuids::uuid sim_id();
 
+  /// returns the total wall-clock time, in seconds, that the simulation has
+  /// spent waiting on backends to write (or, with several buffers, to accept)
+  /// Datum objects.
+  inline double write_secs() const { return write_secs_; }
+
   /// returns whether or not the unique simulation id will be injected.
   bool inject_sim_id() { return inject_sim_id_; };
 
@@ -114,16 +163,86 @@ class Recorder {
   /// Unregisters all backends and resets.
   void Close();
 
+  /// Unregisters all backends without flushing or closing them and records
+  /// all subsequent Datum objects with the simulation id simid. Used by
+  /// processes forked from a running simulation (see Timer::Fork), whose
+  /// inherited backends belong to the parent. Buffered Datum objects that
+  /// were not flushed before the fork are discarded.
+  void Detach(boost::uuids::uuid simid);
+
+  /// Returns the registered backends.
+  const std::list<RecBackend*>& backends() const { return backs_; }
+
+  /// Prepares n empty staging buffers for a parallel phase.
+  void OpenStages(int n);
+
+  /// Directs Datum objects created on the calling thread to staging buffer i,
+  /// or back to the shared buffer if i is negative.
+  void SelectStage(int i);
+
+  /// Appends the Datum objects of every staging buffer to the shared buffer,
+  /// in stage order, and empties the stages. Must not be called while any
+  /// thread has a stage selected.
+  void MergeStages();
+
+  /// Returns the Datum objects currently held by staging buffer i, in the
+  /// order they were created.
+  DatumList Staged(int i);
+
+  /// Discards the Datum objects currently held by staging buffer i.
+  void DropStage(int i);
+
  private:
+  /// Datum objects created by a single task of a parallel phase
+  struct Stage {
+    DatumList data;
+    int n;
+  };
+
   void NotifyBackends();
   void AddDatum(Datum* d);
 
+  /// @return a new Datum object with the simulation id injected if enabled
+  Datum* MakeDatum();
+
+  /// @return a new buffer of dump_count_ Datum objects
+  DatumList NewBuffer();
+
+  /// deletes the Datum objects of a buffer
+  void DeleteBuffer(DatumList& buf);
+
+  /// waits until the writer thread has written all full buffers, then
+  /// rethrows any error it encountered
+  void Drain();
+
+  /// stops and joins the writer thread, if any
+  void StopWriter();
+
+  /// writer thread main loop
+  void WriterLoop();
+
   DatumList data_;
   int index_;
+  double write_secs_;
+  std::vector<Stage> stages_;
   std::list<RecBackend*> backs_;
   unsigned int dump_count_;
   boost::uuids::uuid uuid_;
   bool inject_sim_id_;
+
+  /// @name asynchronous writing state, guarded by mu_
+  /// @{
+  unsigned int nbuffers_;
+  std::thread writer_;
+  std::mutex mu_;
+  std::condition_variable full_cv_;
+  std::condition_variable free_cv_;
+  std::deque<DatumList> full_;
+  std::vector<DatumList> free_;
+  bool writing_;
+  bool stop_;
+  std::exception_ptr err_;
+  /// @}
 };
 
 }  // namespace cyclus
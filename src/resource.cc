@@ -1,13 +1,26 @@
 #include "resource.h"
 
+#include "context.h"
+#include "id_counters.h"
+
 namespace cyclus {
 
-int Resource::nextstate_id_ = 1;
-int Resource::nextobj_id_ = 1;
+Resource::Resource() : ids_(IdCounters::current()) {
+  ids_->CheckUnfrozen();
+  state_id_ = ids_->res_state++;
+  obj_id_ = ids_->res_obj++;
+}
+
+Resource::Resource(Context* ctx)
+    : ids_(ctx != NULL ? ctx->ids() : IdCounters::current()) {
+  ids_->CheckUnfrozen();
+  state_id_ = ids_->res_state++;
+  obj_id_ = ids_->res_obj++;
+}
 
 void Resource::BumpStateId() {
-  state_id_ = nextstate_id_;
-  nextstate_id_++;
+  ids_->CheckUnfrozen();
+  state_id_ = ids_->res_state++;
 }
 
 }  // namespace cyclus
@@ -10,6 +10,7 @@ class SimInitTest;
 namespace cyclus {
 
 class Context;
+class IdCounters;
 
 typedef std::string ResourceType;
 
@@ -23,7 +24,13 @@ class Resource {
  public:
   typedef boost::shared_ptr<Resource> Ptr;
 
-  Resource() : state_id_(nextstate_id_++), obj_id_(nextobj_id_++) {}
+  /// Creates a resource whose ids come from the counters current on the
+  /// calling thread (see IdCounters).
+  Resource();
+
+  /// Creates a resource whose ids come from ctx's counters, or from the
+  /// counters current on the calling thread if ctx is NULL.
+  explicit Resource(Context* ctx);
 
   virtual ~Resource() {}
 
@@ -80,8 +87,8 @@ class Resource {
   virtual Ptr ExtractRes(double quantity) = 0;
 
  private:
-  static int nextstate_id_;
-  static int nextobj_id_;
+  /// the counters the resource's ids come from
+  IdCounters* ids_;
   int state_id_;
   int obj_id_;
 };
@@ -11,6 +11,7 @@
 #include "product.h"
 #include "material.h"
 #include "request_portfolio.h"
+#include "thread_pool.h"
 #include "trader.h"
 #include "trader_management.h"
 
@@ -57,6 +58,13 @@ inline static void AdjustPrefs(Trader* t, PrefMap<Product>::type& prefs) {
 /// exchng.AddAllBids();
 /// exchng.AdjustAll();
 /// @endcode
+///
+/// When the simulation is run with more than one thread (see
+/// SimInfo::nthreads), requests and bids are collected from traders that
+/// declare themselves thread safe (see Trader::ThreadSafeExchange)
+/// concurrently, while all other traders are queried serially. In either
+/// case, portfolios are added to the ExchangeContext in trader order, so the
+/// resulting exchange is the same as that of a serial collection.
 template <class T>
 class ResourceExchange {
  public:
@@ -74,6 +82,10 @@ class ResourceExchange {
   /// @brief queries traders and collects all requests for bids
   void AddAllRequests() {
     InitTraders();
+    if (sim_ctx_->thread_pool() != NULL) {
+      ParallelAddRequests();
+      return;
+    }
     std::for_each(
         traders_.begin(),
         traders_.end(),
@@ -84,6 +96,10 @@ class ResourceExchange {
   /// @brief queries traders and collects all responses to requests for bids
   void AddAllBids() {
     InitTraders();
+    if (sim_ctx_->thread_pool() != NULL) {
+      ParallelAddBids();
+      return;
+    }
     std::for_each(
         traders_.begin(),
         traders_.end(),
@@ -120,23 +136,80 @@ class ResourceExchange {
 
   /// @brief queries a given facility agent for
   void AddRequests_(Trader* t) {
-    std::set<typename RequestPortfolio<T>::Ptr> rp = QueryRequests<T>(t);
-    typename std::set<typename RequestPortfolio<T>::Ptr>::iterator it;
+    MergeRequests(QueryRequests<T>(t));
+  }
+
+  /// @brief queries a given facility agent for
+  void AddBids_(Trader* t) {
+    MergeBids(QueryBids<T>(t, ex_ctx_.commod_requests));
+  }
+
+  void MergeRequests(const std::set<typename RequestPortfolio<T>::Ptr>& rp) {
+    typename std::set<typename RequestPortfolio<T>::Ptr>::const_iterator it;
     for (it = rp.begin(); it != rp.end(); ++it) {
       ex_ctx_.AddRequestPortfolio(*it);
     }
   }
 
-  /// @brief queries a given facility agent for
-  void AddBids_(Trader* t) {
-    std::set<typename BidPortfolio<T>::Ptr> bp =
-        QueryBids<T>(t, ex_ctx_.commod_requests);
-    typename std::set<typename BidPortfolio<T>::Ptr>::iterator it;
+  void MergeBids(const std::set<typename BidPortfolio<T>::Ptr>& bp) {
+    typename std::set<typename BidPortfolio<T>::Ptr>::const_iterator it;
     for (it = bp.begin(); it != bp.end(); ++it) {
       ex_ctx_.AddBidPortfolio(*it);
     }
   }
 
+  /// @brief queries thread-safe traders for requests on the simulation's
+  /// thread pool, then queries the remaining traders and merges all
+  /// portfolios in trader order
+  void ParallelAddRequests() {
+    std::vector<Trader*> traders(traders_.begin(), traders_.end());
+    std::vector<char> safe(traders.size());
+    for (int i = 0; i < traders.size(); ++i) {
+      safe[i] = traders[i]->ThreadSafeExchange();
+    }
+
+    std::vector<std::set<typename RequestPortfolio<T>::Ptr> >
+        rps(traders.size());
+    sim_ctx_->thread_pool()->ParallelFor(traders.size(), [&](int i) {
+      if (safe[i]) {
+        rps[i] = QueryRequests<T>(traders[i]);
+      }
+    });
+
+    for (int i = 0; i < traders.size(); ++i) {
+      if (!safe[i]) {
+        rps[i] = QueryRequests<T>(traders[i]);
+      }
+      MergeRequests(rps[i]);
+    }
+  }
+
+  /// @brief queries thread-safe traders for bids on the simulation's thread
+  /// pool, then queries the remaining traders and merges all portfolios in
+  /// trader order
+  void ParallelAddBids() {
+    std::vector<Trader*> traders(traders_.begin(), traders_.end());
+    std::vector<char> safe(traders.size());
+    for (int i = 0; i < traders.size(); ++i) {
+      safe[i] = traders[i]->ThreadSafeExchange();
+    }
+
+    typename CommodMap<T>::type& commod_requests = ex_ctx_.commod_requests;
+    std::vector<std::set<typename BidPortfolio<T>::Ptr> > bps(traders.size());
+    sim_ctx_->thread_pool()->ParallelFor(traders.size(), [&](int i) {
+      if (safe[i]) {
+        bps[i] = QueryBids<T>(traders[i], commod_requests);
+      }
+    });
+
+    for (int i = 0; i < traders.size(); ++i) {
+      if (!safe[i]) {
+        bps[i] = QueryBids<T>(traders[i], commod_requests);
+      }
+      MergeBids(bps[i]);
+    }
+  }
+
   /// @brief allows a trader and its parents to adjust any preferences in the
   /// system
   void AdjustPrefs_(Trader* t) {
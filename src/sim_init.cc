@@ -1,5 +1,11 @@
 #include "sim_init.h"
 
+#include <algorithm>
+#include <string.h>
+
+#include <boost/lexical_cast.hpp>
+
+#include "binary_encoding.h"
 #include "greedy_preconditioner.h"
 #include "greedy_solver.h"
 #include "prog_solver.h"
@@ -13,7 +19,73 @@ class Dummy : public Region {
   Dummy* Clone() { return NULL; }
 };
 
-SimInit::SimInit() : rec_(NULL), ctx_(NULL) {}
+namespace {
+
+/// A solver configuration table and its columns.
+struct SolverTable {
+  const char* name;
+  const char* fields[5];
+};
+
+/// The tables a restart reads the solver configuration from (see
+/// SimInit::LoadSolverInfo). Their rows are copied column by column since a
+/// datum doesn't own its field names.
+const SolverTable kSolverTables[] = {
+    {"SolverInfo", {"Solver", "ExclusiveOrders"}},
+    {"GreedySolverInfo", {"Preconditioner"}},
+    {"CoinSolverInfo", {"Timeout", "Verbose", "Mps", "Persistent"}},
+    {"CommodPriority", {"Commodity", "SolutionPriority"}},
+};
+
+const int kNumSolverTables = sizeof(kSolverTables) / sizeof(kSolverTables[0]);
+
+/// Ids at most this far apart are read with a single query, which also reads
+/// and drops the rows of the ids in between.
+const int kMaxIdGap = 64;
+
+/// Returns the rows of table whose INT field is one of ids. The backends have
+/// no set-membership condition, so the ids are split into runs of ids at most
+/// kMaxIdGap apart, and the rows of each run's id range are streamed through
+/// a cursor, keeping only those of the given ids. A sparse id set thus doesn't
+/// read everything between its smallest and largest id.
+QueryResult QueryIds(QueryableBackend* b, const std::string& table,
+                     const std::string& field, const std::set<int>& ids) {
+  QueryResult qr;
+  std::vector<QueryRow> rows;
+  std::set<int>::const_iterator first = ids.begin();
+  while (first != ids.end()) {
+    std::set<int>::const_iterator last = first;
+    std::set<int>::const_iterator next = first;
+    for (++next; next != ids.end() && *next - *last <= kMaxIdGap; ++next) {
+      last = next;
+    }
+
+    std::vector<Cond> conds;
+    conds.push_back(Cond(field, ">=", *first));
+    conds.push_back(Cond(field, "<=", *last));
+    QueryCursor::Ptr c = b->Cursor(table, &conds);
+    qr.fields = c->fields();
+    qr.types = c->types();
+    int j = std::find(qr.fields.begin(), qr.fields.end(), field) -
+            qr.fields.begin();
+    if (j == qr.fields.size()) {
+      throw KeyError("table " + table + " has no field " + field);
+    }
+    while (c->Next(&rows)) {
+      for (int i = 0; i < rows.size(); ++i) {
+        if (ids.count(rows[i][j].cast<int>()) > 0) {
+          qr.rows.push_back(rows[i]);
+        }
+      }
+    }
+    first = next;
+  }
+  return qr;
+}
+
+}  // namespace
+
+SimInit::SimInit() : rec_(NULL), ctx_(NULL), tbase_(0) {}
 
 SimInit::~SimInit() {
   if (ctx_ != NULL) {
@@ -47,6 +119,7 @@ void SimInit::Branch(QueryableBackend* b, boost::uuids::uuid prev_sim_id,
 
 void SimInit::InitBase(QueryableBackend* b, boost::uuids::uuid simid, int t) {
   ctx_ = new Context(&ti_, rec_);
+  IdCounters::Scope scope(ctx_->ids());
 
   std::vector<Cond> conds;
   conds.push_back(Cond("SimId", "==", simid));
@@ -59,6 +132,7 @@ void SimInit::InitBase(QueryableBackend* b, boost::uuids::uuid simid, int t) {
   LoadRecipes();
   LoadSolverInfo();
   LoadPrototypes();
+  LoadSnapshotBase();
   LoadInitialAgents();
   LoadInventories();
   LoadBuildSched();
@@ -71,25 +145,52 @@ void SimInit::InitBase(QueryableBackend* b, boost::uuids::uuid simid, int t) {
 }
 
 void SimInit::Snapshot(Context* ctx) {
+  int ndelta = ctx->si_.delta_snapshots;
+  bool delta = ndelta > 0 && ctx->n_delta_snaps_ >= 0 &&
+               ctx->n_delta_snaps_ < ndelta;
+  if (ndelta <= 0) {
+    ctx->n_delta_snaps_ = -1;  // the next snapshot with deltas enabled is full
+  } else {
+    ctx->n_delta_snaps_ = delta ? ctx->n_delta_snaps_ + 1 : 0;
+  }
+
   ctx->NewDatum("Snapshots")
      ->AddVal("Time", ctx->time())
      ->Record();
+  if (delta) {
+    ctx->NewDatum("DeltaSnapshots")
+       ->AddVal("Time", ctx->time())
+       ->Record();
+  }
 
   // snapshot all agent internal state
+  std::map<int, Context::AgentSnap> snaps;
   std::set<Agent*> mlist = ctx->agent_list_;
   std::set<Agent*>::iterator it;
   for (it = mlist.begin(); it != mlist.end(); ++it) {
     Agent* m = *it;
-    if (m->enter_time() != -1) {
+    if (m->enter_time() == -1) {
+      continue;
+    } else if (ndelta <= 0) {
       SimInit::SnapAgent(m);
+      continue;
+    }
+
+    // agents that entered since the previous snapshot are recorded in full
+    std::map<int, Context::AgentSnap>::iterator prev = ctx->snaps_.find(m->id());
+    if (delta && prev != ctx->snaps_.end()) {
+      SimInit::SnapAgent(m, &prev->second, &snaps[m->id()]);
+    } else {
+      SimInit::SnapAgent(m, NULL, &snaps[m->id()]);
     }
   }
+  ctx->snaps_.swap(snaps);
 
   // snapshot all next ids
   ctx->NewDatum("NextIds")
       ->AddVal("Time", ctx->time())
       ->AddVal("Object", std::string("Agent"))
-      ->AddVal("NextId", Agent::next_id_)
+      ->AddVal("NextId", static_cast<int>(ctx->ids_.agent))
       ->Record();
   ctx->NewDatum("NextIds")
       ->AddVal("Time", ctx->time())
@@ -99,47 +200,326 @@ void SimInit::Snapshot(Context* ctx) {
   ctx->NewDatum("NextIds")
       ->AddVal("Time", ctx->time())
       ->AddVal("Object", std::string("Composition"))
-      ->AddVal("NextId", Composition::next_id_)
+      ->AddVal("NextId", static_cast<int>(ctx->ids_.comp))
       ->Record();
   ctx->NewDatum("NextIds")
       ->AddVal("Time", ctx->time())
       ->AddVal("Object", std::string("ResourceState"))
-      ->AddVal("NextId", Resource::nextstate_id_)
+      ->AddVal("NextId", static_cast<int>(ctx->ids_.res_state))
       ->Record();
   ctx->NewDatum("NextIds")
       ->AddVal("Time", ctx->time())
       ->AddVal("Object", std::string("ResourceObj"))
-      ->AddVal("NextId", Resource::nextobj_id_)
+      ->AddVal("NextId", static_cast<int>(ctx->ids_.res_obj))
       ->Record();
+  int next_product;
+  {
+    std::lock_guard<std::mutex> lk(ctx->ids_.product_mu);
+    next_product = ctx->ids_.product;
+  }
   ctx->NewDatum("NextIds")
       ->AddVal("Time", ctx->time())
       ->AddVal("Object", std::string("Product"))
-      ->AddVal("NextId", Product::next_qualid_)
+      ->AddVal("NextId", next_product)
       ->Record();
 }
 
+SimInit::SolverTables SimInit::QuerySolverInfo(Recorder* rec) {
+  SolverTables solver;
+  QueryableBackend* b = NULL;
+  const std::list<RecBackend*>& backs = rec->backends();
+  std::list<RecBackend*>::const_iterator it;
+  for (it = backs.begin(); b == NULL && it != backs.end(); ++it) {
+    b = dynamic_cast<QueryableBackend*>(*it);
+  }
+  if (b == NULL) {
+    return solver;
+  }
+
+  std::vector<Cond> conds;
+  conds.push_back(Cond("SimId", "==", rec->sim_id()));
+  CondInjector ci(b, conds);
+  std::set<std::string> tables = b->Tables();
+  for (int i = 0; i < kNumSolverTables; ++i) {
+    std::string name = kSolverTables[i].name;
+    if (tables.count(name) > 0) {
+      solver[name] = ci.Query(name, NULL);
+    }
+  }
+  return solver;
+}
+
+void SimInit::SnapContext(Context* ctx, const SolverTables& solver) {
+  for (int i = 0; i < kNumSolverTables; ++i) {
+    const SolverTable& table = kSolverTables[i];
+    SolverTables::const_iterator st = solver.find(table.name);
+    if (st == solver.end()) {
+      continue;
+    }
+    const QueryResult& qr = st->second;
+    for (int row = 0; row < qr.rows.size(); ++row) {
+      Datum* d = ctx->NewDatum(table.name);
+      for (int j = 0; j < 5 && table.fields[j] != NULL; ++j) {
+        std::vector<std::string>::const_iterator f =
+            std::find(qr.fields.begin(), qr.fields.end(), table.fields[j]);
+        if (f != qr.fields.end()) {
+          d->AddVal(table.fields[j], qr.rows[row][f - qr.fields.begin()]);
+        }
+      }
+      d->Record();
+    }
+  }
+
+  // record the prototypes like ones added in situ, with the versions of
+  // their archetypes
+  ctx->rec_ver_.clear();
+  std::map<std::string, Agent*> protos = ctx->protos_;
+  std::map<std::string, Agent*>::iterator pit;
+  for (pit = protos.begin(); pit != protos.end(); ++pit) {
+    ctx->AddPrototype(pit->first, pit->second, true);
+  }
+
+  // collect the resources held by the agents in the simulation
+  std::vector<Composition::Ptr> comps;
+  std::map<int, Resource::Ptr> resources;
+  std::set<Agent*>::const_iterator ait;
+  for (ait = ctx->agent_list_.begin(); ait != ctx->agent_list_.end(); ++ait) {
+    Agent* m = *ait;
+    if (m->enter_time() == -1) {
+      continue;  // prototype
+    }
+    m->AddToTable();
+    Inventories invs = m->SnapshotInv();
+    Inventories::iterator iit;
+    for (iit = invs.begin(); iit != invs.end(); ++iit) {
+      std::vector<Resource::Ptr>& inv = iit->second;
+      for (int i = 0; i < inv.size(); ++i) {
+        resources[inv[i]->state_id()] = inv[i];
+        if (inv[i]->type() == Material::kType) {
+          comps.push_back(ResCast<Material>(inv[i])->comp());
+        }
+      }
+    }
+  }
+
+  // compositions recorded to the output of the simulation this one
+  // continues are recorded again
+  std::map<std::string, Composition::Ptr> recipes = ctx->recipes_;
+  std::map<std::string, Composition::Ptr>::iterator rit;
+  for (rit = recipes.begin(); rit != recipes.end(); ++rit) {
+    comps.push_back(rit->second);
+  }
+  for (int i = 0; i < comps.size(); ++i) {
+    comps[i]->recorded_ = false;
+  }
+  for (rit = recipes.begin(); rit != recipes.end(); ++rit) {
+    ctx->AddRecipe(rit->first, rit->second);
+    rit->second->Record(ctx);
+  }
+
+  {
+    std::lock_guard<std::mutex> lk(ctx->ids_.product_mu);
+    std::map<std::string, int>::iterator qit;
+    for (qit = ctx->ids_.qualids.begin(); qit != ctx->ids_.qualids.end();
+         ++qit) {
+      ctx->NewDatum("Products")
+          ->AddVal("QualId", qit->second)
+          ->AddVal("Quality", qit->first)
+          ->Record();
+    }
+  }
+
+  // the resources' parents are left out, their history is in the output of
+  // the simulation they were created in
+  std::map<int, Resource::Ptr>::iterator it;
+  for (it = resources.begin(); it != resources.end(); ++it) {
+    Resource::Ptr r = it->second;
+    ctx->NewDatum("Resources")
+        ->AddVal("ResourceId", r->state_id())
+        ->AddVal("ObjId", r->obj_id())
+        ->AddVal("Type", r->type())
+        ->AddVal("TimeCreated", ctx->time())
+        ->AddVal("Quantity", r->quantity())
+        ->AddVal("Units", r->units())
+        ->AddVal("QualId", r->qual_id())
+        ->AddVal("Parent1", 0)
+        ->AddVal("Parent2", 0)
+        ->Record();
+    r->Record(ctx);
+  }
+}
+
 void SimInit::SnapAgent(Agent* m) {
-  // call manually without agent impl injected to keep all Agent state in a
-  // single, consolidated db table
-  m->Agent::Snapshot(DbInit(m, true));
+  SnapAgent(m, NULL, NULL);
+}
 
-  m->Snapshot(DbInit(m));
-  Inventories invs = m->SnapshotInv();
-  Context* ctx = m->context();
+void SimInit::SnapAgent(Agent* m, const Context::AgentSnap* prev,
+                        Context::AgentSnap* cur) {
+  Recorder* rec = m->context()->rec_;
+  if (cur == NULL) {
+    // call manually without agent impl injected to keep all Agent state in a
+    // single, consolidated db table
+    m->Agent::Snapshot(DbInit(m, true));
+    m->Snapshot(DbInit(m));
+  } else if (prev != NULL && !m->SnapshotDirty()) {
+    cur->state = prev->state;
+    cur->comparable = prev->comparable;
+  } else {
+    // stage the state so that it can be dropped if it didn't change
+    rec->OpenStages(1);
+    rec->SelectStage(0);
+    try {
+      m->Agent::Snapshot(DbInit(m, true));
+      m->Snapshot(DbInit(m));
+    } catch (...) {
+      rec->SelectStage(-1);
+      rec->DropStage(0);
+      throw;
+    }
+    rec->SelectStage(-1);
+
+    cur->comparable = StateBytes(rec->Staged(0), &cur->state);
+    if (prev != NULL && cur->comparable && prev->comparable &&
+        cur->state == prev->state) {
+      rec->DropStage(0);
+    } else {
+      rec->MergeStages();
+    }
+  }
+  m->ClearSnapshotDirty();
 
+  std::map<std::string, std::vector<int> > ids;
+  Inventories invs = m->SnapshotInv();
   Inventories::iterator it;
   for (it = invs.begin(); it != invs.end(); ++it) {
-    std::string name = it->first;
-    std::vector<Resource::Ptr> inv = it->second;
-    for (int i = 0; i < inv.size(); ++i) {
-      ctx->NewDatum("AgentStateInventories")
-          ->AddVal("AgentId", m->id())
-          ->AddVal("SimTime", ctx->time())
-          ->AddVal("InventoryName", name)
-          ->AddVal("ResourceId", inv[i]->state_id())
-          ->Record();
+    std::vector<int>& inv = ids[it->first];
+    for (int i = 0; i < it->second.size(); ++i) {
+      inv.push_back(it->second[i]->state_id());
+    }
+  }
+
+  std::map<std::string, std::vector<int> >::const_iterator iit;
+  if (prev == NULL) {
+    for (iit = ids.begin(); iit != ids.end(); ++iit) {
+      SnapInv(m, iit->first, iit->second);
+    }
+  } else {
+    std::vector<int> none;
+    for (iit = ids.begin(); iit != ids.end(); ++iit) {
+      std::map<std::string, std::vector<int> >::const_iterator old =
+          prev->invs.find(iit->first);
+      SnapInvDelta(m, iit->first,
+                   old != prev->invs.end() ? old->second : none, iit->second);
+    }
+    for (iit = prev->invs.begin(); iit != prev->invs.end(); ++iit) {
+      if (ids.count(iit->first) == 0) {
+        SnapInvDelta(m, iit->first, iit->second, none);
+      }
+    }
+  }
+
+  if (cur != NULL) {
+    cur->invs.swap(ids);
+  }
+}
+
+void SimInit::SnapInvDelta(Agent* m, const std::string& name,
+                           const std::vector<int>& prev,
+                           const std::vector<int>& cur) {
+  if (prev == cur) {
+    return;
+  }
+
+  std::set<int> now(cur.begin(), cur.end());
+  std::vector<int> kept;
+  std::vector<int> removed;
+  for (int i = 0; i < prev.size(); ++i) {
+    if (now.count(prev[i]) > 0) {
+      kept.push_back(prev[i]);
+    } else {
+      removed.push_back(prev[i]);
+    }
+  }
+
+  // the difference is only recorded if replaying it restores the order of
+  // the inventory, i.e. if resources were only removed and appended
+  if (kept.size() > cur.size() ||
+      !std::equal(kept.begin(), kept.end(), cur.begin())) {
+    SnapInv(m, name, cur);
+    return;
+  }
+
+  Context* ctx = m->context();
+  for (int i = 0; i < removed.size(); ++i) {
+    ctx->NewDatum("AgentStateInventoryDeltas")
+        ->AddVal("AgentId", m->id())
+        ->AddVal("SimTime", ctx->time())
+        ->AddVal("InventoryName", name)
+        ->AddVal("ResourceId", removed[i])
+        ->AddVal("Removed", true)
+        ->Record();
+  }
+  for (int i = kept.size(); i < cur.size(); ++i) {
+    ctx->NewDatum("AgentStateInventoryDeltas")
+        ->AddVal("AgentId", m->id())
+        ->AddVal("SimTime", ctx->time())
+        ->AddVal("InventoryName", name)
+        ->AddVal("ResourceId", cur[i])
+        ->AddVal("Removed", false)
+        ->Record();
+  }
+}
+
+void SimInit::SnapInv(Agent* m, const std::string& name,
+                      const std::vector<int>& ids) {
+  Context* ctx = m->context();
+  for (int i = 0; i < ids.size(); ++i) {
+    ctx->NewDatum("AgentStateInventories")
+        ->AddVal("AgentId", m->id())
+        ->AddVal("SimTime", ctx->time())
+        ->AddVal("InventoryName", name)
+        ->AddVal("ResourceId", ids[i])
+        ->Record();
+  }
+}
+
+bool SimInit::StateBytes(const DatumList& data, std::string* state) {
+  state->clear();
+  for (int i = 0; i < data.size(); ++i) {
+    Datum* d = data[i];
+    state->append(d->title());
+    state->push_back('\0');
+    for (int k = 0; k < d->nfields(); ++k) {
+      const Datum::Field& f = d->field(k);
+      if (strcmp(f.name, "SimTime") == 0) {
+        continue;
+      }
+      state->append(f.name);
+      state->push_back(static_cast<char>(f.type));
+      if (f.type != Datum::ANY_FIELD) {
+        size_t size = f.size;
+        state->append(reinterpret_cast<const char*>(&size), sizeof(size));
+        state->append(d->data(k), size);
+        continue;
+      }
+
+      // boxed containers are compared by their binary encoding, which is
+      // prefixed with their type and length
+      std::string bytes;
+      try {
+        DbTypes type = BinType(d->box(k));
+        BinEncodeAny(d->box(k), type, &bytes);
+        state->push_back(static_cast<char>(type));
+      } catch (ValueError err) {
+        state->clear();
+        return false;
+      }
+      size_t size = bytes.size();
+      state->append(reinterpret_cast<const char*>(&size), sizeof(size));
+      state->append(bytes);
     }
   }
+  return true;
 }
 
 void SimInit::LoadInfo() {
@@ -170,11 +550,16 @@ void SimInit::LoadRecipes() {
     return;
   }  // table doesn't exist (okay)
 
+  std::set<int> qualids;
+  for (int i = 0; i < qr.rows.size(); ++i) {
+    qualids.insert(qr.GetVal<int>("QualId", i));
+  }
+  LoadCompositions(b_, qualids, &comps_);
+
   for (int i = 0; i < qr.rows.size(); ++i) {
     std::string recipe = qr.GetVal<std::string>("Recipe", i);
     int stateid = qr.GetVal<int>("QualId", i);
-    Composition::Ptr c = LoadComposition(b_, stateid);
-    ctx_->AddRecipe(recipe, c);
+    ctx_->AddRecipe(recipe, comps_[stateid]);
   }
 }
 
@@ -236,6 +621,7 @@ ExchangeSolver* SimInit::LoadCoinSolver(bool exclusive,
   ExchangeSolver* solver;
   double timeout;
   bool verbose, mps;
+  bool persistent = false;
   
   std::string solver_info = "CoinSolverInfo";
   if (0 < tables.count(solver_info)) {
@@ -243,11 +629,16 @@ ExchangeSolver* SimInit::LoadCoinSolver(bool exclusive,
     timeout = qr.GetVal<double>("Timeout");
     verbose = qr.GetVal<bool>("Verbose");
     mps = qr.GetVal<bool>("Mps");
+    // databases written by older versions have no persistent column
+    if (std::find(qr.fields.begin(), qr.fields.end(), "Persistent") !=
+        qr.fields.end()) {
+      persistent = qr.GetVal<bool>("Persistent");
+    }
   }
 
   // set timeout to default if input value is non-positive
   timeout = timeout <= 0 ? ProgSolver::kDefaultTimeout : timeout;
-  solver = new ProgSolver("cbc", timeout, exclusive, verbose, mps);
+  solver = new ProgSolver("cbc", timeout, exclusive, verbose, mps, persistent);
   return solver;
 }
 
@@ -307,7 +698,40 @@ void SimInit::LoadPrototypes() {
 
     pi = PrefixInjector(&ci, "AgentState" + spec.Sanitize());
     m->InitFrom(&pi);
-    ctx_->AddPrototype(proto, m);
+    // a prototype recorded again, e.g. replaced in a forked branch, replaces
+    // the earlier one
+    ctx_->AddPrototype(proto, m, true);
+  }
+}
+
+void SimInit::LoadSnapshotBase() {
+  tbase_ = t_;
+  QueryResult dq;
+  try {
+    dq = b_->Query("DeltaSnapshots", NULL);
+  } catch (std::exception err) {return;}  // table doesn't exist (okay)
+
+  std::set<int> deltas;
+  for (int i = 0; i < dq.rows.size(); ++i) {
+    deltas.insert(dq.GetVal<int>("Time", i));
+  }
+  if (deltas.count(t_) == 0) {
+    return;  // full snapshot
+  }
+
+  std::vector<Cond> conds;
+  conds.push_back(Cond("Time", "<=", t_));
+  QueryResult qr = b_->Query("Snapshots", &conds);
+  tbase_ = -1;
+  for (int i = 0; i < qr.rows.size(); ++i) {
+    int t = qr.GetVal<int>("Time", i);
+    if (deltas.count(t) == 0) {
+      tbase_ = std::max(tbase_, t);
+    }
+  }
+  if (tbase_ < 0) {
+    throw IOError("No full snapshot found for the incremental snapshot at "
+                  "time " + boost::lexical_cast<std::string>(t_));
   }
 }
 
@@ -323,6 +747,24 @@ void SimInit::LoadInitialAgents() {
   QueryResult qentry = b_->Query("AgentEntry", &conds);
   std::map<int, int> parentmap;  // map<agentid, parentid>
   std::map<int, Agent*> unbuilt;  // map<agentid, agent_ptr>
+
+  // with incremental snapshots, each agent's state is the one recorded last
+  // since the full snapshot
+  std::map<int, int> state_times;  // map<agentid, simtime>
+  if (tbase_ < t_) {
+    std::vector<Cond> conds;
+    conds.push_back(Cond("SimTime", ">=", tbase_));
+    conds.push_back(Cond("SimTime", "<=", t_));
+    QueryResult qstate = b_->Query("AgentStateAgent", &conds);
+    for (int i = 0; i < qstate.rows.size(); ++i) {
+      int id = qstate.GetVal<int>("AgentId", i);
+      int t = qstate.GetVal<int>("SimTime", i);
+      if (state_times.count(id) == 0 || t > state_times[id]) {
+        state_times[id] = t;
+      }
+    }
+  }
+
   for (int i = 0; i < qentry.rows.size(); ++i) {
     if (t_ > 0 && qentry.GetVal<int>("EnterTime", i) == t_) {
       // agent is scheduled to be built already
@@ -355,7 +797,8 @@ void SimInit::LoadInitialAgents() {
 
     // agent-custom init
     conds.pop_back();
-    conds.push_back(Cond("SimTime", "==", t_));
+    int t = state_times.count(id) > 0 ? state_times[id] : t_;
+    conds.push_back(Cond("SimTime", "==", t));
     CondInjector ci(b_, conds);
     PrefixInjector pi(&ci, "AgentState");
     m->Agent::InitFrom(&pi);
@@ -399,24 +842,97 @@ void SimInit::LoadInitialAgents() {
 }
 
 void SimInit::LoadInventories() {
-  std::map<int, Agent*>::iterator it;
-  for (it = agents_.begin(); it != agents_.end(); ++it) {
-    Agent* m = it->second;
-    std::vector<Cond> conds;
-    conds.push_back(Cond("SimTime", "==", t_));
-    conds.push_back(Cond("AgentId", "==", m->id()));
-    QueryResult qr;
+  typedef std::pair<int, std::string> InvKey;  // (AgentId, InventoryName)
+  std::vector<Cond> conds;
+  conds.push_back(Cond("SimTime", ">=", tbase_));
+  conds.push_back(Cond("SimTime", "<=", t_));
+  QueryResult qr;
+  QueryResult dqr;
+  bool found = false;
+  try {
+    qr = b_->Query("AgentStateInventories", &conds);
+    found = true;
+  } catch (std::exception err) {}  // table doesn't exist (okay)
+  if (tbase_ < t_) {
     try {
-      qr = b_->Query("AgentStateInventories", &conds);
-    } catch (std::exception err) {return;}  // table doesn't exist (okay)
+      dqr = b_->Query("AgentStateInventoryDeltas", &conds);
+      found = true;
+    } catch (std::exception err) {}  // table doesn't exist (okay)
+  }
+  if (!found) {
+    return;
+  }
 
-    Inventories invs;
-    for (int i = 0; i < qr.rows.size(); ++i) {
-      std::string inv_name = qr.GetVal<std::string>("InventoryName", i);
-      int state_id = qr.GetVal<int>("ResourceId", i);
-      invs[inv_name].push_back(LoadResource(ctx_, b_, state_id));
+  // start from the time each inventory was last recorded in full
+  std::map<InvKey, int> full_times;
+  for (int i = 0; i < qr.rows.size(); ++i) {
+    InvKey k(qr.GetVal<int>("AgentId", i),
+             qr.GetVal<std::string>("InventoryName", i));
+    int t = qr.GetVal<int>("SimTime", i);
+    if (agents_.count(k.first) > 0 &&
+        (full_times.count(k) == 0 || t > full_times[k])) {
+      full_times[k] = t;
     }
-    m->InitInv(invs);
+  }
+  std::map<InvKey, std::vector<int> > ids;
+  for (int i = 0; i < qr.rows.size(); ++i) {
+    InvKey k(qr.GetVal<int>("AgentId", i),
+             qr.GetVal<std::string>("InventoryName", i));
+    if (full_times.count(k) > 0 &&
+        qr.GetVal<int>("SimTime", i) == full_times[k]) {
+      ids[k].push_back(qr.GetVal<int>("ResourceId", i));
+    }
+  }
+
+  // and replay the changes recorded after that in time order
+  std::vector<std::pair<int, int> > changes;  // (SimTime, row)
+  for (int i = 0; i < dqr.rows.size(); ++i) {
+    InvKey k(dqr.GetVal<int>("AgentId", i),
+             dqr.GetVal<std::string>("InventoryName", i));
+    int t = dqr.GetVal<int>("SimTime", i);
+    if (agents_.count(k.first) > 0 &&
+        (full_times.count(k) == 0 || t > full_times[k])) {
+      changes.push_back(std::make_pair(t, i));
+    }
+  }
+  std::sort(changes.begin(), changes.end());
+  for (int j = 0; j < changes.size(); ++j) {
+    int i = changes[j].second;
+    InvKey k(dqr.GetVal<int>("AgentId", i),
+             dqr.GetVal<std::string>("InventoryName", i));
+    int state_id = dqr.GetVal<int>("ResourceId", i);
+    std::vector<int>& inv = ids[k];
+    if (dqr.GetVal<bool>("Removed", i)) {
+      inv.erase(std::remove(inv.begin(), inv.end(), state_id), inv.end());
+    } else {
+      inv.push_back(state_id);
+    }
+  }
+
+  // reconstruct every inventoried resource up front so the backend is hit a
+  // fixed number of times regardless of how many resources there are.
+  std::set<int> resids;
+  std::map<InvKey, std::vector<int> >::iterator iit;
+  for (iit = ids.begin(); iit != ids.end(); ++iit) {
+    resids.insert(iit->second.begin(), iit->second.end());
+  }
+  std::map<int, Resource::Ptr> rs = LoadResources(ctx_, b_, resids, &comps_);
+
+  std::map<int, Inventories> invs;
+  for (iit = ids.begin(); iit != ids.end(); ++iit) {
+    if (iit->second.empty()) {
+      continue;
+    }
+    std::vector<Resource::Ptr>& inv =
+        invs[iit->first.first][iit->first.second];
+    for (int i = 0; i < iit->second.size(); ++i) {
+      inv.push_back(rs[iit->second[i]]);
+    }
+  }
+
+  std::map<int, Agent*>::iterator it;
+  for (it = agents_.begin(); it != agents_.end(); ++it) {
+    it->second->InitInv(invs[it->first]);
   }
 }
 
@@ -458,17 +974,18 @@ void SimInit::LoadNextIds() {
   for (int i = 0; i < qr.rows.size(); ++i) {
     std::string obj = qr.GetVal<std::string>("Object", i);
     if (obj == "Agent") {
-      Agent::next_id_ = qr.GetVal<int>("NextId", i);
+      ctx_->ids_.agent = qr.GetVal<int>("NextId", i);
     } else if (obj == "Transaction") {
       ctx_->trans_id_ = qr.GetVal<int>("NextId", i);
     } else if (obj == "Composition") {
-      Composition::next_id_ = qr.GetVal<int>("NextId", i);
+      ctx_->ids_.comp = qr.GetVal<int>("NextId", i);
     } else if (obj == "ResourceState") {
-      Resource::nextstate_id_ = qr.GetVal<int>("NextId", i);
+      ctx_->ids_.res_state = qr.GetVal<int>("NextId", i);
     } else if (obj == "ResourceObj") {
-      Resource::nextobj_id_ = qr.GetVal<int>("NextId", i);
+      ctx_->ids_.res_obj = qr.GetVal<int>("NextId", i);
     } else if (obj == "Product") {
-      Product::next_qualid_ = qr.GetVal<int>("NextId", i);
+      std::lock_guard<std::mutex> lk(ctx_->ids_.product_mu);
+      ctx_->ids_.product = qr.GetVal<int>("NextId", i);
     } else {
       throw IOError("Unexpected value in NextIds table: " + obj);
     }
@@ -486,6 +1003,7 @@ Material::Ptr SimInit::BuildMaterial(QueryableBackend* b, int resid) {
   Material::Ptr m = ResCast<Material>(SimInit::LoadResource(&ctx, b, resid));
   m->tracker_.DontTrack();
   m->ctx_ = NULL;
+  m->ids_ = IdCounters::current();
   return m;
 }
 
@@ -500,91 +1018,148 @@ Product::Ptr SimInit::BuildProduct(QueryableBackend* b, int resid) {
   Product::Ptr p = ResCast<Product>(SimInit::LoadResource(&ctx, b, resid));
   p->tracker_.DontTrack();
   p->ctx_ = NULL;
+  p->ids_ = IdCounters::current();
   return p;
 }
 
 Resource::Ptr SimInit::LoadResource(Context* ctx, QueryableBackend* b, int state_id) {
-  std::vector<Cond> conds;
-  conds.push_back(Cond("ResourceId", "==", state_id));
-  QueryResult qr = b->Query("Resources", &conds);
-  ResourceType type = qr.GetVal<ResourceType>("Type");
-  int obj_id = qr.GetVal<int>("ObjId");
-
-  Resource::Ptr r;
-  if (type == Material::kType) {
-    r = LoadMaterial(ctx, b, state_id);
-  } else if (type == Product::kType) {
-    r = LoadProduct(ctx, b, state_id);
-  } else {
-    throw IOError("Invalid resource type in output database: " + type);
+  std::set<int> resids;
+  resids.insert(state_id);
+  std::map<int, Composition::Ptr> comps;
+  return LoadResources(ctx, b, resids, &comps)[state_id];
+}
+
+std::map<int, Resource::Ptr> SimInit::LoadResources(
+    Context* ctx, QueryableBackend* b, const std::set<int>& resids,
+    std::map<int, Composition::Ptr>* comps) {
+  std::map<int, Resource::Ptr> rs;
+  if (resids.empty()) {
+    return rs;
   }
 
-  r->state_id_ = state_id;
-  r->obj_id_ = obj_id;
-  return r;
-}
+  // get general resource object info for every requested state id
+  QueryResult qr = QueryIds(b, "Resources", "ResourceId", resids);
+
+  std::map<int, int> rows;  // std::map<ResourceId, row>
+  std::set<int> matids;
+  std::set<int> compids;
+  std::set<int> prodids;
+  for (int i = 0; i < qr.rows.size(); ++i) {
+    int state_id = qr.GetVal<int>("ResourceId", i);
+    rows[state_id] = i;
+    ResourceType type = qr.GetVal<ResourceType>("Type", i);
+    int qualid = qr.GetVal<int>("QualId", i);
+    if (type == Material::kType) {
+      matids.insert(state_id);
+      if (comps->count(qualid) == 0) {
+        compids.insert(qualid);
+      }
+    } else if (type == Product::kType) {
+      prodids.insert(qualid);
+    } else {
+      throw IOError("Invalid resource type in output database: " + type);
+    }
+  }
+  if (rows.size() != resids.size()) {
+    std::set<int>::const_iterator it;
+    for (it = resids.begin(); rows.count(*it) > 0; ++it) {}
+    throw IOError("Resource state id " + boost::lexical_cast<std::string>(*it) +
+                  " not found in output database");
+  }
 
-Material::Ptr SimInit::LoadMaterial(Context* ctx, QueryableBackend* b, int state_id) {
   // get special material object state
-  std::vector<Cond> conds;
-  conds.push_back(Cond("ResourceId", "==", state_id));
-  QueryResult qr = b->Query("MaterialInfo", &conds);
-  int prev_decay = qr.GetVal<int>("PrevDecayTime");
-
-  // get general resource object info
-  conds.clear();
-  conds.push_back(Cond("ResourceId", "==", state_id));
-  qr = b->Query("Resources", &conds);
-  double qty = qr.GetVal<double>("Quantity");
-  int stateid = qr.GetVal<int>("QualId");
-
-  // create the composition and material
-  Composition::Ptr comp = LoadComposition(b, stateid);
+  std::map<int, int> prev_decays;
+  if (!matids.empty()) {
+    QueryResult mqr = QueryIds(b, "MaterialInfo", "ResourceId", matids);
+    for (int i = 0; i < mqr.rows.size(); ++i) {
+      int state_id = mqr.GetVal<int>("ResourceId", i);
+      prev_decays[state_id] = mqr.GetVal<int>("PrevDecayTime", i);
+    }
+  }
+
+  // get special Product internal state
+  std::map<int, std::string> qualities;
+  if (!prodids.empty()) {
+    QueryResult pqr = QueryIds(b, "Products", "QualId", prodids);
+    for (int i = 0; i < pqr.rows.size(); ++i) {
+      int qualid = pqr.GetVal<int>("QualId", i);
+      qualities[qualid] = pqr.GetVal<std::string>("Quality", i);
+    }
+  }
+
+  LoadCompositions(b, compids, comps);
+
+  // create the resources, sharing one composition object per QualId
   Agent* dummy = new Dummy(ctx);
-  Material::Ptr mat = Material::Create(dummy, qty, comp);
-  mat->prev_decay_time_ = prev_decay;
+  std::map<int, int>::iterator it;
+  for (it = rows.begin(); it != rows.end(); ++it) {
+    int state_id = it->first;
+    int i = it->second;
+    double qty = qr.GetVal<double>("Quantity", i);
+    int qualid = qr.GetVal<int>("QualId", i);
+
+    Resource::Ptr r;
+    if (matids.count(state_id) > 0) {
+      if (prev_decays.count(state_id) == 0) {
+        throw IOError("Resource state id " + boost::lexical_cast<std::string>(state_id) +
+                      " has no MaterialInfo entry in output database");
+      }
+      Material::Ptr mat = Material::Create(dummy, qty, (*comps)[qualid]);
+      mat->prev_decay_time_ = prev_decays[state_id];
+      r = mat;
+    } else {
+      if (qualities.count(qualid) == 0) {
+        throw IOError("Product QualId " + boost::lexical_cast<std::string>(qualid) +
+                      " not found in output database");
+      }
+      // set the context's quality-qualid map to have same vals as db
+      {
+        std::lock_guard<std::mutex> lk(ctx->ids_.product_mu);
+        ctx->ids_.qualids[qualities[qualid]] = qualid;
+      }
+      r = Product::Create(dummy, qty, qualities[qualid]);
+    }
+    r->state_id_ = state_id;
+    r->obj_id_ = qr.GetVal<int>("ObjId", i);
+    rs[state_id] = r;
+  }
   ctx->DelAgent(dummy);
 
-  return mat;
+  return rs;
 }
 
 Composition::Ptr SimInit::LoadComposition(QueryableBackend* b, int stateid) {
-  std::vector<Cond> conds;
-  conds.push_back(Cond("QualId", "==", stateid));
-  QueryResult qr = b->Query("Compositions", &conds);
-  CompMap cm;
-  for (int i = 0; i < qr.rows.size(); ++i) {
-    int nucid = qr.GetVal<int>("NucId", i);
-    double mass_frac = qr.GetVal<double>("MassFrac", i);
-    cm[nucid] = mass_frac;
-  }
-  Composition::Ptr c = Composition::CreateFromMass(cm);
-  c->recorded_ = true;
-  c->id_ = stateid;
-  return c;
+  std::set<int> qualids;
+  qualids.insert(stateid);
+  std::map<int, Composition::Ptr> comps;
+  LoadCompositions(b, qualids, &comps);
+  return comps[stateid];
 }
 
-Product::Ptr SimInit::LoadProduct(Context* ctx, QueryableBackend* b, int state_id) {
-  // get general resource object info
-  std::vector<Cond> conds;
-  conds.push_back(Cond("ResourceId", "==", state_id));
-  QueryResult qr = b->Query("Resources", &conds);
-  double qty = qr.GetVal<double>("Quantity");
-  int stateid = qr.GetVal<int>("QualId");
+void SimInit::LoadCompositions(QueryableBackend* b, const std::set<int>& qualids,
+                               std::map<int, Composition::Ptr>* comps) {
+  if (qualids.empty()) {
+    return;
+  }
 
-  // get special Product internal state
-  conds.clear();
-  conds.push_back(Cond("QualId", "==", stateid));
-  qr = b->Query("Products", &conds);
-  std::string quality = qr.GetVal<std::string>("Quality");
+  QueryResult qr = QueryIds(b, "Compositions", "QualId", qualids);
 
-  // set static quality-stateid map to have same vals as db
-  Product::qualids_[quality] = stateid;
+  std::map<int, CompMap> cms;
+  for (int i = 0; i < qr.rows.size(); ++i) {
+    int qualid = qr.GetVal<int>("QualId", i);
+    int nucid = qr.GetVal<int>("NucId", i);
+    double mass_frac = qr.GetVal<double>("MassFrac", i);
+    cms[qualid][nucid] = mass_frac;
+  }
 
-  Agent* dummy = new Dummy(ctx);
-  Product::Ptr r = Product::Create(dummy, qty, quality);
-  ctx->DelAgent(dummy);
-  return r;
+  // bypass interning so every QualId in the database keeps its own object
+  std::set<int>::const_iterator it;
+  for (it = qualids.begin(); it != qualids.end(); ++it) {
+    Composition::Ptr c = Composition::New(CompVec(cms[*it]), false);
+    c->recorded_ = true;
+    c->id_ = *it;
+    (*comps)[*it] = c;
+  }
 }
 
 }  // namespace cyclus
@@ -8,6 +8,8 @@
 #include "timer.h"
 #include "recorder.h"
 
+class SimInitTest;
+
 namespace cyclus {
 
 class Context;
@@ -22,6 +24,8 @@ class Context;
 /// @warning the SimInit class manages the memory of the initialized Context,
 /// Timer, and Recorder.
 class SimInit {
+  friend class ::SimInitTest;
+
  public:
   SimInit();
 
@@ -38,7 +42,8 @@ class SimInit {
   void Restart(QueryableBackend* b, boost::uuids::uuid sim_id, int t);
 
   /// NOT IMPLEMENTED. Initializes a simulation branched from prev_sim_id at
-  /// time t with diverging state described in new_sim_id.
+  /// time t with diverging state described in new_sim_id. A running
+  /// simulation can be branched in memory with Timer::Fork instead.
   ///
   /// TODO(rwcarlsen): implement
   void Branch(QueryableBackend* b, boost::uuids::uuid prev_sim_id, int t,
@@ -46,6 +51,17 @@ class SimInit {
 
   /// Records a snapshot of the current state of the simulation being managed by
   /// ctx into the simulation's output database.
+  ///
+  /// If incremental snapshots are enabled (see SimInfo::delta_snapshots),
+  /// each full snapshot is followed by the given number of incremental ones,
+  /// which are also listed in the DeltaSnapshots table. An incremental
+  /// snapshot only records the state of agents that entered since the
+  /// previous snapshot or whose state changed (see
+  /// StateWrangler::SnapshotDirty), and records the resources added to and
+  /// removed from each inventory in the AgentStateInventoryDeltas table. An
+  /// inventory that was reordered is recorded in full instead. Restarting
+  /// from an incremental snapshot replays the preceding full snapshot and the
+  /// incremental ones since.
   static void Snapshot(Context* ctx);
 
   /// Records a snapshot of the agent's current internal state into the
@@ -53,6 +69,25 @@ class SimInit {
   /// called directly.
   static void SnapAgent(Agent* m);
 
+  /// The solver configuration of a simulation, i.e. the rows of its
+  /// SolverInfo, GreedySolverInfo, CoinSolverInfo and CommodPriority tables,
+  /// keyed by table name.
+  typedef std::map<std::string, QueryResult> SolverTables;
+
+  /// Reads the solver configuration of the simulation recorded by rec from
+  /// the first of rec's backends that can be queried. Tables that don't exist
+  /// (or all of them, if no backend can be queried) are left out.
+  static SolverTables QuerySolverInfo(Recorder* rec);
+
+  /// Records what restarting the simulation managed by ctx needs besides a
+  /// snapshot into the simulation's output database: the solver
+  /// configuration solver, the prototypes and recipes, the entries of the
+  /// agents in the simulation and the resources held in the agents'
+  /// inventories, with their compositions. This makes the output of a
+  /// simulation that is only recorded from part way through, such as a branch
+  /// forked with Timer::Fork, self-contained.
+  static void SnapContext(Context* ctx, const SolverTables& solver);
+
   /// Returns the initialized context. Note that either Init, Restart, or Branch
   /// must be called first.
   Context* context() { return ctx_; }
@@ -78,6 +113,31 @@ class SimInit {
  private:
   void InitBase(QueryableBackend* b, boost::uuids::uuid simid, int t);
 
+  /// Snapshots agent m. If cur is not NULL, what is recorded is also stored
+  /// in cur, and if prev is not NULL as well, only the differences to what
+  /// the previous snapshot recorded in prev are recorded.
+  static void SnapAgent(Agent* m, const Context::AgentSnap* prev,
+                        Context::AgentSnap* cur);
+
+  /// Records the changes of agent m's inventory name from the resource state
+  /// ids prev to cur.
+  static void SnapInvDelta(Agent* m, const std::string& name,
+                           const std::vector<int>& prev,
+                           const std::vector<int>& cur);
+
+  /// Records the resource state ids of agent m's inventory name.
+  static void SnapInv(Agent* m, const std::string& name,
+                      const std::vector<int>& ids);
+
+  /// Serializes the values of the datums in data, except for the snapshot
+  /// time, into state. Boxed values are serialized with their binary
+  /// encoding (see BinEncodeAny). Returns false if they contain values that
+  /// can't be serialized.
+  static bool StateBytes(const DatumList& data, std::string* state);
+
+  /// Finds the full snapshot that an incremental snapshot at t_ builds on.
+  void LoadSnapshotBase();
+
   void LoadInfo();
   void LoadRecipes();
   void LoadSolverInfo();
@@ -92,13 +152,28 @@ class SimInit {
   ExchangeSolver* LoadGreedySolver(bool exclusive, std::set<std::string> tables);
   ExchangeSolver* LoadCoinSolver(bool exclusive, std::set<std::string> tables);
   static Resource::Ptr LoadResource(Context* ctx, QueryableBackend* b, int resid);
-  static Material::Ptr LoadMaterial(Context* ctx, QueryableBackend* b, int resid);
-  static Product::Ptr LoadProduct(Context* ctx, QueryableBackend* b, int resid);
   static Composition::Ptr LoadComposition(QueryableBackend* b, int stateid);
 
+  /// Reconstructs every resource in resids and returns them keyed by resource
+  /// state id. Each table is read with a query per run of nearby ids, which
+  /// keeps reads of sparse id sets proportional to their size.  Materials share
+  /// one composition object per QualId: compositions already in comps are
+  /// reused and newly loaded ones are added to it.
+  static std::map<int, Resource::Ptr> LoadResources(
+      Context* ctx, QueryableBackend* b, const std::set<int>& resids,
+      std::map<int, Composition::Ptr>* comps);
+
+  /// Loads the compositions with the given QualIds from b with a query per run
+  /// of nearby QualIds and adds them to comps.
+  static void LoadCompositions(QueryableBackend* b, const std::set<int>& qualids,
+                               std::map<int, Composition::Ptr>* comps);
+
   // std::map<AgentId, Agent*>
   std::map<int, Agent*> agents_;
 
+  // std::map<QualId, Composition::Ptr> of compositions loaded so far
+  std::map<int, Composition::Ptr> comps_;
+
   Context* ctx_;
   Recorder* rec_;
   Timer ti_;
@@ -106,6 +181,9 @@ class SimInit {
   SimInfo si_;
   QueryableBackend* b_;
   int t_;
+
+  /// time of the last full snapshot at or before t_
+  int tbase_;
 };
 
 }  // namespace cyclus
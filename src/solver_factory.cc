@@ -120,6 +120,11 @@ void ReportProg(OsiSolverInterface* si) {
 }
 
 void SolveProg(OsiSolverInterface* si, double greedy_obj, bool verbose) {
+  SolveProg(si, greedy_obj, verbose, false);
+}
+
+void SolveProg(OsiSolverInterface* si, double greedy_obj, bool verbose,
+               bool warm) {
   if (verbose)
     ReportProg(si);
 
@@ -129,6 +134,15 @@ void SolveProg(OsiSolverInterface* si, double greedy_obj, bool verbose) {
     CbcModel model(*si);
     ObjValueHandler handler(greedy_obj);
     CbcMain0(model);
+    if (warm) {
+      const double* x = si->getColSolution();
+      const double* c = si->getObjCoefficients();
+      double obj = 0;
+      for (int i = 0; i != si->getNumCols(); i++) {
+        obj += c[i] * x[i];
+      }
+      model.setBestSolution(x, si->getNumCols(), obj, true);
+    }
     model.passInEventHandler(&handler);
     CbcMain1(argc, argv, model, CbcCallBack);
     si->setColSolution(model.getColSolution());
@@ -137,6 +151,9 @@ void SolveProg(OsiSolverInterface* si, double greedy_obj, bool verbose) {
                 << " and obj " << handler.obj()
                 << " and found " << std::boolalpha << handler.found() << "\n";
     }
+  } else if (warm) {
+    // no ints, resolve from the current basis
+    si->resolve();
   } else {
     // no ints, just solve 'initial lp relaxation' 
     si->initialSolve();
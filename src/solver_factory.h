@@ -62,6 +62,13 @@ void SolveProg(OsiSolverInterface* si);
 void SolveProg(OsiSolverInterface* si, bool verbose);
 void SolveProg(OsiSolverInterface* si, double greedy_obj);
 void SolveProg(OsiSolverInterface* si, double greedy_obj, bool verbose);
+/// @param warm if true, the interface's current basis and column solution
+/// (e.g., from a previous, similar problem) are used as a starting point:
+/// linear programs are resolved from the current basis, and the column
+/// solution is offered to the branch and cut solver as an incumbent if it is
+/// feasible
+void SolveProg(OsiSolverInterface* si, double greedy_obj, bool verbose,
+               bool warm);
 bool HasInt(OsiSolverInterface* si);
 
 }  // namespace cyclus
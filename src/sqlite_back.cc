@@ -1,5 +1,9 @@
 #include "sqlite_back.h"
 
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
 #include <iomanip>
 #include <sstream>
 
@@ -18,6 +22,7 @@
 #include <boost/serialization/assume_abstract.hpp>
 
 
+#include "binary_encoding.h"
 #include "blob.h"
 #include "datum.h"
 #include "error.h"
@@ -44,7 +49,10 @@ SqliteBack::~SqliteBack() {
   }
 }
 
-SqliteBack::SqliteBack(std::string path) : db_(path) {
+SqliteBack::SqliteBack(std::string path, Encoding enc)
+    : db_(path),
+      encoding_(enc),
+      has_encoding_col_(true) {
   path_ = path;
   db_.open();
 
@@ -62,8 +70,18 @@ SqliteBack::SqliteBack(std::string path) : db_(path) {
 
   if (tbl_names_.count("FieldTypes") == 0) {
     std::string cmd = "CREATE TABLE IF NOT EXISTS FieldTypes";
-    cmd += "(TableName TEXT,Field TEXT,Type INTEGER);";
+    cmd += "(TableName TEXT,Field TEXT,Type INTEGER,Encoding INTEGER);";
     db_.Execute(cmd);
+  } else {
+    // databases written before container encodings were selectable have no
+    // Encoding column and hold only XML values
+    has_encoding_col_ = false;
+    stmt = db_.Prepare("PRAGMA table_info(FieldTypes);");
+    while (stmt->Step()) {
+      if (std::string(stmt->GetText(1, NULL)) == "Encoding") {
+        has_encoding_col_ = true;
+      }
+    }
   }
 }
 
@@ -90,40 +108,153 @@ void SqliteBack::Notify(DatumList data) {
 
 void SqliteBack::Flush() { }
 
-QueryResult SqliteBack::Query(std::string table, std::vector<Cond>* conds) {
-  QueryResult q = GetTableInfo(table);
+/// Steps a prepared SELECT statement, decoding each row as it is reached.
+class SqliteBack::StmtCursor : public QueryCursor {
+ public:
+  StmtCursor(SqliteBack* b, std::string table, std::vector<Cond>* conds,
+             std::vector<std::string>* cols)
+      : b_(b),
+        done_(false) {
+    std::vector<Encoding> encs;
+    QueryResult info = b_->GetTableInfo(table, &encs);
+    std::vector<int> idx = Project(info.fields, info.types, cols);
+    for (int i = 0; i < idx.size(); ++i) {
+      encs_.push_back(encs[idx[i]]);
+    }
 
-  std::stringstream sql;
-  sql << "SELECT * FROM " << table;
-  if (conds != NULL) {
-    sql << " WHERE ";
-    for (int i = 0; i < conds->size(); ++i) {
-      if (i > 0) {
-        sql << " AND ";
+    std::stringstream sql;
+    for (int i = 0; i < fields_.size(); ++i) {
+      sql << (i > 0 ? "," : "") << fields_[i];
+    }
+    stmt_ = b_->PrepareSelect(sql.str(), table, conds, info, encs, "");
+  }
+
+  virtual bool Next(std::vector<QueryRow>* rows, int n = kBatchSize) {
+    rows->clear();
+    while (!done_ && rows->size() < n) {
+      if (!stmt_->Step()) {
+        done_ = true;
+        stmt_.reset();
+        break;
       }
-      Cond c = (*conds)[i];
-      sql << c.field << " " << c.op << " ?";
+      QueryRow r;
+      for (int j = 0; j < fields_.size(); ++j) {
+        r.push_back(b_->ColAsVal(stmt_, j, types_[j], encs_[j]));
+      }
+      rows->push_back(r);
     }
+    return !rows->empty();
   }
-  sql << ";";
 
-  SqlStatement::Ptr stmt = db_.Prepare(sql.str());
+ private:
+  SqliteBack* b_;
+  SqlStatement::Ptr stmt_;
+  std::vector<Encoding> encs_;
+  bool done_;
+};
 
-  if (conds != NULL) {
-    for (int i = 0; i < conds->size(); ++i) {
-      boost::spirit::hold_any v = (*conds)[i].val;
-      Bind(v, Type(v), stmt, i+1);
+QueryResult SqliteBack::Query(std::string table, std::vector<Cond>* conds) {
+  return Cursor(table, conds)->ReadAll();
+}
+
+QueryCursor::Ptr SqliteBack::Cursor(std::string table,
+                                    std::vector<Cond>* conds,
+                                    std::vector<std::string>* cols) {
+  return QueryCursor::Ptr(new StmtCursor(this, table, conds, cols));
+}
+
+QueryResult SqliteBack::Aggregate(std::string table, std::vector<Cond>* conds,
+                                  std::vector<std::string>* group_by,
+                                  std::vector<Agg>* aggs, int bucket) {
+  std::vector<Encoding> encs;
+  QueryResult info = GetTableInfo(table, &encs);
+  std::vector<std::string> keys;
+  if (group_by != NULL) {
+    keys = *group_by;
+  }
+  std::vector<Agg> a;
+  if (aggs != NULL) {
+    a = *aggs;
+  }
+
+  std::vector<DbTypes> key_types;
+  std::vector<Encoding> key_encs;
+  std::vector<DbTypes> agg_types;
+  for (int i = 0; i < keys.size() + a.size(); ++i) {
+    bool is_key = i < keys.size();
+    if (!is_key && a[i - keys.size()].opcode == AGG_COUNT) {
+      agg_types.push_back(INT);
+      continue;
+    }
+    std::string f = is_key ? keys[i] : a[i - keys.size()].field;
+    int j = std::find(info.fields.begin(), info.fields.end(), f) -
+            info.fields.begin();
+    if (j == info.fields.size()) {
+      throw KeyError("table " + table + " has no such field " + f);
+    }
+    if (is_key) {
+      key_types.push_back(info.types[j]);
+      key_encs.push_back(encs[j]);
+    } else {
+      agg_types.push_back(info.types[j]);
+    }
+  }
+  QueryResult qr = AggTable::Describe(keys, key_types, a, agg_types, bucket);
+
+  // the first key is rounded down to a multiple of bucket, also for negative
+  // times
+  std::stringstream groups;
+  for (int i = 0; i < keys.size(); ++i) {
+    groups << (i > 0 ? "," : "");
+    if (i == 0 && bucket > 0) {
+      groups << "(" << keys[i] << " - ((" << keys[i] << " % " << bucket
+             << ") + " << bucket << ") % " << bucket << ")";
+    } else {
+      groups << keys[i];
+    }
+  }
+  std::stringstream what;
+  what << groups.str();
+  for (int i = 0; i < a.size(); ++i) {
+    what << (i > 0 || !keys.empty() ? "," : "");
+    switch (a[i].opcode) {
+      case AGG_COUNT: what << "count(*)"; break;
+      case AGG_SUM: what << "total(" << a[i].field << ")"; break;
+      case AGG_MIN: what << "min(" << a[i].field << ")"; break;
+      case AGG_MAX: what << "max(" << a[i].field << ")"; break;
+      case AGG_MEAN: what << "avg(" << a[i].field << ")"; break;
     }
   }
+  // a trailing count lets empty groups (only possible without group_by) be
+  // skipped
+  what << (keys.empty() && a.empty() ? "" : ",") << "count(*)";
+  std::string rest;
+  if (!keys.empty()) {
+    rest = " GROUP BY " + groups.str() + " ORDER BY " + groups.str();
+  }
 
-  for (int i = 0; stmt->Step(); ++i) {
+  SqlStatement::Ptr stmt = PrepareSelect(what.str(), table, conds, info, encs,
+                                         rest);
+  int ncols = keys.size() + a.size();
+  while (stmt->Step()) {
+    if (stmt->GetInt(ncols) == 0) {
+      continue;
+    }
     QueryRow r;
-    for (int j = 0; j < q.fields.size(); ++j) {
-      r.push_back(ColAsVal(stmt, j, q.types[j]));
+    for (int i = 0; i < keys.size(); ++i) {
+      r.push_back(ColAsVal(stmt, i, key_types[i], key_encs[i]));
+    }
+    for (int i = 0; i < a.size(); ++i) {
+      int col = keys.size() + i;
+      if (qr.types[col] == DOUBLE) {
+        r.push_back(stmt->GetDouble(col));
+      } else {
+        r.push_back(ColAsVal(stmt, col, qr.types[col], encoding_));
+      }
     }
-    q.rows.push_back(r);
+    qr.rows.push_back(r);
   }
-  return q;
+  return qr;
 }
 
 std::map<std::string, DbTypes> SqliteBack::ColumnTypes(std::string table) {
@@ -147,21 +278,68 @@ std::set<std::string> SqliteBack::Tables() {
   return rtn;
 }
 
+SqlStatement::Ptr SqliteBack::PrepareSelect(std::string what,
+                                             std::string table,
+                                             std::vector<Cond>* conds,
+                                             const QueryResult& info,
+                                             const std::vector<Encoding>& encs,
+                                             std::string rest) {
+  std::stringstream sql;
+  sql << "SELECT " << what << " FROM " << table;
+  if (conds != NULL) {
+    sql << " WHERE ";
+    for (int i = 0; i < conds->size(); ++i) {
+      if (i > 0) {
+        sql << " AND ";
+      }
+      Cond c = (*conds)[i];
+      sql << c.field << " " << c.op << " ?";
+    }
+  }
+  sql << rest << ";";
+
+  SqlStatement::Ptr stmt = db_.Prepare(sql.str());
+
+  if (conds != NULL) {
+    for (int i = 0; i < conds->size(); ++i) {
+      // conditions on container fields must match the field's encoding
+      Encoding enc = encoding_;
+      for (int j = 0; j < info.fields.size(); ++j) {
+        if (info.fields[j] == (*conds)[i].field) {
+          enc = encs[j];
+        }
+      }
+      boost::spirit::hold_any v = (*conds)[i].val;
+      Bind(v, Type(v), enc, stmt, i+1);
+    }
+  }
+  return stmt;
+}
+
 SqliteDb& SqliteBack::db() {
   return db_;
 }
 
-QueryResult SqliteBack::GetTableInfo(std::string table) {
-  std::string sql = "SELECT Field,Type FROM FieldTypes WHERE TableName = '" +
+QueryResult SqliteBack::GetTableInfo(std::string table,
+                                     std::vector<Encoding>* encs) {
+  std::string cols = has_encoding_col_ ? "Field,Type,Encoding" : "Field,Type";
+  std::string sql = "SELECT " + cols + " FROM FieldTypes WHERE TableName = '" +
                     table + "';";
   SqlStatement::Ptr stmt;
   stmt = db_.Prepare(sql);
 
   int i = 0;
   QueryResult info;
+  if (encs != NULL) {
+    encs->clear();
+  }
   for (i = 0; stmt->Step(); ++i) {
     info.fields.push_back(stmt->GetText(0, NULL));
     info.types.push_back((DbTypes)stmt->GetInt(1));
+    if (encs != NULL) {
+      encs->push_back(has_encoding_col_ ? (Encoding)stmt->GetInt(2)
+                                        : XML_ENCODING);
+    }
   }
   if (i == 0) {
     throw ValueError("Invalid table name " + table);
@@ -175,7 +353,7 @@ std::string SqliteBack::Name() {
 
 void SqliteBack::BuildStmt(Datum* d) {
   std::string name = d->title();
-  Datum::Vals vals = d->vals();
+  const Datum::Vals& vals = d->vals();
   std::vector<DbTypes> schema;
 
   schema.push_back(Type(vals[0].second));
@@ -188,19 +366,28 @@ void SqliteBack::BuildStmt(Datum* d) {
 
   schemas_[name] = schema;
   stmts_[name] = db_.Prepare(insert);
+
+  // tables that already existed keep whatever encoding they were written with
+  GetTableInfo(name, &encodings_[name]);
 }
 
 void SqliteBack::CreateTable(Datum* d) {
   std::string name = d->title();
   tbl_names_.insert(name);
 
-  Datum::Vals vals = d->vals();
-  Datum::Vals::iterator it = vals.begin();
+  if (!has_encoding_col_) {
+    db_.Execute("ALTER TABLE FieldTypes ADD COLUMN Encoding INTEGER "
+                "DEFAULT 0;");
+    has_encoding_col_ = true;
+  }
+
+  const Datum::Vals& vals = d->vals();
+  Datum::Vals::const_iterator it = vals.begin();
 
   std::stringstream types;
   types << "INSERT INTO FieldTypes VALUES ('"
         << name << "','" << it->first << "','"
-        << Type(it->second) << "');";
+        << Type(it->second) << "'," << encoding_ << ");";
   db_.Execute(types.str());
 
   std::string cmd = "CREATE TABLE " + name + " (";
@@ -212,7 +399,7 @@ void SqliteBack::CreateTable(Datum* d) {
     std::stringstream types;
     types << "INSERT INTO FieldTypes VALUES ('"
           << name << "','" << it->first << "','"
-          << Type(it->second) << "');";
+          << Type(it->second) << "'," << encoding_ << ");";
     db_.Execute(types.str());
     ++it;
   }
@@ -222,31 +409,76 @@ void SqliteBack::CreateTable(Datum* d) {
 }
 
 void SqliteBack::WriteDatum(Datum* d) {
-  Datum::Vals vals = d->vals();
   SqlStatement::Ptr stmt = stmts_[d->title()];
-  std::vector<DbTypes> schema = schemas_[d->title()];
-
-  for (int i = 0; i < vals.size(); ++i) {
-    boost::spirit::hold_any v = vals[i].second;
-    Bind(v, schema[i], stmt, i+1);
+  const std::vector<DbTypes>& schema = schemas_[d->title()];
+  const std::vector<Encoding>& encs = encodings_[d->title()];
+
+  for (int i = 0; i < d->nfields(); ++i) {
+    if (d->field(i).type == Datum::ANY_FIELD) {
+      Bind(d->box(i), schema[i], encs[i], stmt, i+1);
+    } else {
+      BindField(d, i, stmt, i+1);
+    }
   }
 
   stmt->Exec();
 }
 
-void SqliteBack::Bind(boost::spirit::hold_any v, DbTypes type, SqlStatement::Ptr stmt,
-                      int index) {
+void SqliteBack::BindField(Datum* d, int i, SqlStatement::Ptr stmt,
+                           int index) {
+  const Datum::Field& f = d->field(i);
+  switch (f.type) {
+  case Datum::BOOL_FIELD: {
+    stmt->BindInt(index, d->AsBool(i));
+    break;
+  }
+  case Datum::INT_FIELD: {
+    stmt->BindInt(index, d->AsInt(i));
+    break;
+  }
+  case Datum::FLOAT_FIELD: {
+    stmt->BindDouble(index, d->AsFloat(i));
+    break;
+  }
+  case Datum::DOUBLE_FIELD: {
+    stmt->BindDouble(index, d->AsDouble(i));
+    break;
+  }
+  case Datum::STRING_FIELD: {
+    stmt->BindText(index, d->data(i));
+    break;
+  }
+  case Datum::BLOB_FIELD:
+  case Datum::UUID_FIELD: {
+    stmt->BindBlob(index, d->data(i), f.size);
+    break;
+  }
+  default: {
+    throw ValueError("attempted to bind a boxed datum field as a typed one");
+  }
+  }
+}
+
+void SqliteBack::Bind(const boost::spirit::hold_any& v, DbTypes type,
+                      Encoding enc, SqlStatement::Ptr stmt, int index) {
 
 // serializes the value v of type T and DBType D and binds it to stmt (inside
 // a case statement
 #define CYCLUS_COMMA ,
 #define CYCLUS_BINDVAL(D, T) \
     case D: { \
-    T vect = v.cast<T>(); \
-    std::stringstream ss; \
-    boost::archive::xml_oarchive ar(ss); \
-    ar & BOOST_SERIALIZATION_NVP(vect); \
-    std::string s = ss.str(); \
+    const T& vect = v.cast<T>(); \
+    std::string s; \
+    if (enc == BINARY_ENCODING) { \
+      BinEncode(vect, &s); \
+    } else { \
+      std::stringstream ss; \
+      { \
+        boost::archive::xml_oarchive ar(ss); \
+        ar & BOOST_SERIALIZATION_NVP(vect); \
+      } \
+      s = ss.str(); \
+    } \
     stmt->BindBlob(index, s.c_str(), s.size()); \
     break; \
     }
@@ -325,7 +557,8 @@ void SqliteBack::Bind(boost::spirit::hold_any v, DbTypes type, SqlStatement::Ptr
 
 boost::spirit::hold_any SqliteBack::ColAsVal(SqlStatement::Ptr stmt,
                                              int col,
-                                             DbTypes type) {
+                                             DbTypes type,
+                                             Encoding enc) {
 
   boost::spirit::hold_any v;
 
@@ -334,12 +567,18 @@ boost::spirit::hold_any SqliteBack::ColAsVal(SqlStatement::Ptr stmt,
 #define CYCLUS_COMMA ,
 #define CYCLUS_LOADVAL(D, T) \
       case D: { \
-      char* data =  stmt->GetText(col, NULL); \
-      std::stringstream ss; \
-      ss << data; \
-      boost::archive::xml_iarchive ar(ss); \
+      int n; \
+      char* data =  stmt->GetText(col, &n); \
       T vect; \
-      ar & BOOST_SERIALIZATION_NVP(vect); \
+      if (enc == BINARY_ENCODING) { \
+        const char* p = data; \
+        BinDecode(&p, data + n, &vect); \
+      } else { \
+        std::stringstream ss; \
+        ss << data; \
+        boost::archive::xml_iarchive ar(ss); \
+        ar & BOOST_SERIALIZATION_NVP(vect); \
+      } \
       v = vect; \
       break; \
       }
@@ -431,58 +670,8 @@ std::string SqliteBack::SqlType(boost::spirit::hold_any v) {
   }
 }
 
-struct compare {
-  bool operator()(const std::type_info* a, const std::type_info* b) const {
-    return a->before(*b);
-  }
-};
-
-static std::map<const std::type_info*, DbTypes, compare> type_map;
-
 DbTypes SqliteBack::Type(boost::spirit::hold_any v) {
-  if (type_map.size() == 0) {
-    type_map[&typeid(int)] = INT;
-    type_map[&typeid(double)] = DOUBLE;
-    type_map[&typeid(float)] = FLOAT;
-    type_map[&typeid(bool)] = BOOL;
-    type_map[&typeid(Blob)] = BLOB;
-    type_map[&typeid(boost::uuids::uuid)] = UUID;
-    type_map[&typeid(std::string)] = STRING;
-    type_map[&typeid(std::set<int>)] = SET_INT;
-    type_map[&typeid(std::set<std::string>)] = SET_STRING;
-    type_map[&typeid(std::vector<int>)] = VECTOR_INT;
-    type_map[&typeid(std::vector<double>)] = VECTOR_DOUBLE;
-    type_map[&typeid(std::vector<std::string>)] = VECTOR_STRING;
-    type_map[&typeid(std::list<int>)] = LIST_INT;
-    type_map[&typeid(std::list<std::string>)] = LIST_STRING;
-    type_map[&typeid(std::map<int, int>)] = MAP_INT_INT;
-    type_map[&typeid(std::map<int, double>)] = MAP_INT_DOUBLE;
-    type_map[&typeid(std::map<int, std::string>)] = MAP_INT_STRING;
-    type_map[&typeid(std::map<std::string, int>)] = MAP_STRING_INT;
-    type_map[&typeid(std::map<std::string, double>)] = MAP_STRING_DOUBLE;
-    type_map[&typeid(std::map<std::string, std::string>)] = MAP_STRING_STRING;
-    type_map[&typeid(std::map<std::string, std::vector<double> >)] =
-        MAP_STRING_VECTOR_DOUBLE;
-    type_map[&typeid(std::map<std::string, std::map<int, double> >)] =
-        MAP_STRING_MAP_INT_DOUBLE;
-    type_map[&typeid(std::map<std::string,
-                              std::pair<double, std::map<int, double> > >)] =
-        MAP_STRING_PAIR_DOUBLE_MAP_INT_DOUBLE;
-    type_map[&typeid(std::map<int, std::map<std::string, double> >)] =
-        MAP_INT_MAP_STRING_DOUBLE;
-    type_map[&typeid(
-        std::map<std::string,
-                 std::vector<std::pair<int, std::pair<std::string,
-                                                      std::string> > > >)] =
-        MAP_STRING_VECTOR_PAIR_INT_PAIR_STRING_STRING;
-    type_map[&typeid(std::list<std::pair<int, int> >)] = LIST_PAIR_INT_INT;
-  }
-
-  const std::type_info* ti = &v.type();
-  if (type_map.count(ti) == 0) {
-    throw ValueError(std::string("unsupported backend type ") + ti->name());
-  }
-  return type_map[ti];
+  return BinType(v);
 }
 
 }  // namespace cyclus
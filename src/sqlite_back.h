@@ -14,12 +14,34 @@ namespace cyclus {
 /// named Datum objects have their data placed as rows in a single table.  Handles the
 /// following datum value types: int, float, double, std::string, cyclus::Blob.
 /// Unsupported value types are stored as an empty string.
+///
+/// Container values (vectors, sets, lists, maps and pairs) are stored as
+/// BLOBs in one of the encodings below. The encoding used for each field is
+/// recorded in the Encoding column of the FieldTypes table, so that databases
+/// written with either encoding (including those written before the column
+/// existed, which are XML) can be read back.
 class SqliteBack: public FullBackend {
  public:
+  /// Encodings for container values. The values are stored in the database
+  /// and must never change.
+  enum Encoding {
+    /// boost::serialization XML archives, as written by older versions
+    XML_ENCODING = 0,
+    /// version 1 of the compact binary encoding: native-endian 32-bit ints
+    /// and 64-bit doubles, strings and containers prefixed by their 32-bit
+    /// length, and pairs as their two members in order
+    BINARY_ENCODING = 1,
+  };
+
   /// Creates a new sqlite backend that will write to the database file
   /// specified by path. If the file doesn't exist, a new one is created.
   /// @param path the filepath (including name) to write the sqlite file.
-  SqliteBack(std::string path);
+  /// @param enc the encoding used for container values in tables created by
+  /// this backend. Tables that already exist keep their original encoding.
+  /// The default, XML_ENCODING, keeps the output readable by older versions
+  /// of cyclus and by tools that parse the XML archives; BINARY_ENCODING is
+  /// more compact and faster to write and read.
+  SqliteBack(std::string path, Encoding enc = XML_ENCODING);
 
   virtual ~SqliteBack();
 
@@ -35,6 +57,16 @@ class SqliteBack: public FullBackend {
 
   virtual QueryResult Query(std::string table, std::vector<Cond>* conds);
 
+  /// Returns a cursor that steps the query's statement as rows are requested.
+  /// Only the fields in cols (if not NULL) are selected.
+  virtual QueryCursor::Ptr Cursor(std::string table, std::vector<Cond>* conds,
+                                  std::vector<std::string>* cols = NULL);
+
+  /// Computes the aggregates in a single SQL query (with GROUP BY).
+  virtual QueryResult Aggregate(std::string table, std::vector<Cond>* conds,
+                                std::vector<std::string>* group_by,
+                                std::vector<Agg>* aggs, int bucket = 0);
+
   virtual std::map<std::string, DbTypes> ColumnTypes(std::string table);
 
   virtual std::set<std::string> Tables();
@@ -43,10 +75,31 @@ class SqliteBack: public FullBackend {
   /// what you are doing.
   SqliteDb& db();
 
+  /// Returns the encoding used for container values in new tables.
+  inline Encoding encoding() const { return encoding_; }
+
  private:
-  void Bind(boost::spirit::hold_any v, DbTypes type, SqlStatement::Ptr stmt, int index);
+  class StmtCursor;
+
+  void Bind(const boost::spirit::hold_any& v, DbTypes type, Encoding enc,
+            SqlStatement::Ptr stmt, int index);
 
-  QueryResult GetTableInfo(std::string table);
+  /// binds the typed (i.e. unboxed) i-th field of d to stmt at index.
+  void BindField(Datum* d, int i, SqlStatement::Ptr stmt, int index);
+
+  /// prepares the statement "SELECT [what] FROM [table] WHERE [conds][rest];"
+  /// and binds the conditions' values to it. info and encs are the fields
+  /// and encodings of table.
+  SqlStatement::Ptr PrepareSelect(std::string what, std::string table,
+                                  std::vector<Cond>* conds,
+                                  const QueryResult& info,
+                                  const std::vector<Encoding>& encs,
+                                  std::string rest);
+
+  /// returns the fields and types of table. If encs is not NULL, it is
+  /// filled with the encoding of each field.
+  QueryResult GetTableInfo(std::string table,
+                           std::vector<Encoding>* encs = NULL);
 
   /// returns a valid sql data type name for v (e.g.  INTEGER, REAL, TEXT, etc).
   std::string SqlType(boost::spirit::hold_any v);
@@ -56,7 +109,8 @@ class SqliteBack: public FullBackend {
 
   /// converts the string value in s to a c++ value corresponding the the
   /// supported sqlite datatype type in a hold_any object.
-  boost::spirit::hold_any ColAsVal(SqlStatement::Ptr stmt, int col, DbTypes type);
+  boost::spirit::hold_any ColAsVal(SqlStatement::Ptr stmt, int col,
+                                   DbTypes type, Encoding enc);
 
   /// Queue up a table-create command for d.
   void CreateTable(Datum* d);
@@ -77,6 +131,13 @@ class SqliteBack: public FullBackend {
 
   std::map<std::string, SqlStatement::Ptr> stmts_;
   std::map<std::string, std::vector<DbTypes> > schemas_;
+  std::map<std::string, std::vector<Encoding> > encodings_;
+
+  /// the encoding of container values in tables created by this backend
+  Encoding encoding_;
+
+  /// false for databases whose FieldTypes table predates the Encoding column
+  bool has_encoding_col_;
 };
 
 }  // namespace cyclus
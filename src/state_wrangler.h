@@ -53,6 +53,21 @@ class StateWrangler {
   /// @warning This method MUST NOT modify the agent's state.
   virtual void Snapshot(DbInit di) = 0;
 
+  /// Returns whether the state written by Snapshot may have changed since
+  /// ClearSnapshotDirty was last called. Incremental snapshots (see
+  /// SimInfo::delta_snapshots) don't call Snapshot for agents that return
+  /// false, and otherwise only record the state if its values differ from the
+  /// previous snapshot's. Objects that track changes to their state, e.g. in
+  /// code generated for their state variables, may override this together
+  /// with ClearSnapshotDirty. The default always returns true.
+  virtual bool SnapshotDirty() { return true; }
+
+  /// Called after every snapshot of the object's state, so that objects that
+  /// track changes to their state (see SnapshotDirty) can reset their
+  /// tracking. Unlike Snapshot, this may modify the object. The default does
+  /// nothing.
+  virtual void ClearSnapshotDirty() {}
+
   /// Returns an object's xml rng schema for initializing from input files.
   virtual std::string schema() = 0;
 };
@@ -0,0 +1,180 @@
+#include "thread_pool.h"
+
+namespace cyclus {
+
+/// true on any thread that is currently executing a ThreadPool task
+static thread_local bool in_pool_task = false;
+
+ThreadPool::ThreadPool(int nthreads)
+    : stop_(false),
+      generation_(0),
+      job_(NULL),
+      nranges_(0),
+      active_(0),
+      err_idx_(-1) {
+  Start(nthreads);
+}
+
+ThreadPool::ThreadPool(int nthreads, const std::function<void()>& init)
+    : init_(init),
+      stop_(false),
+      generation_(0),
+      job_(NULL),
+      nranges_(0),
+      active_(0),
+      err_idx_(-1) {
+  Start(nthreads);
+}
+
+void ThreadPool::Start(int nthreads) {
+  nranges_ = nthreads < 1 ? 1 : nthreads;
+  ranges_.reset(new Range[nranges_]);
+  for (int i = 0; i < nranges_; ++i) {
+    ranges_[i].lo = 0;
+    ranges_[i].hi = 0;
+  }
+  for (int i = 1; i < nranges_; ++i) {
+    workers_.push_back(std::thread(&ThreadPool::WorkerLoop, this, i));
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lk(mu_);
+    stop_ = true;
+  }
+  work_cv_.notify_all();
+  for (int i = 0; i < workers_.size(); ++i) {
+    workers_[i].join();
+  }
+}
+
+void ThreadPool::ParallelFor(int n, const std::function<void(int)>& f) {
+  if (n <= 0) {
+    return;
+  } else if (workers_.empty() || n == 1 || in_pool_task) {
+    for (int i = 0; i < n; ++i) {
+      f(i);
+    }
+    return;
+  }
+
+  std::lock_guard<std::mutex> run_lk(run_mu_);
+  {
+    std::lock_guard<std::mutex> lk(mu_);
+    job_ = &f;
+    for (int t = 0; t < nranges_; ++t) {
+      ranges_[t].lo = static_cast<long long>(n) * t / nranges_;
+      ranges_[t].hi = static_cast<long long>(n) * (t + 1) / nranges_;
+    }
+    err_idx_ = -1;
+    err_ = std::exception_ptr();
+    ++generation_;
+  }
+  work_cv_.notify_all();
+
+  Work(0);
+
+  // every task is either finished or claimed by a thread still in Work
+  std::exception_ptr err;
+  {
+    std::unique_lock<std::mutex> lk(mu_);
+    while (active_ > 0) {
+      done_cv_.wait(lk);
+    }
+    job_ = NULL;
+    err = err_;
+    err_ = std::exception_ptr();
+  }
+  if (err) {
+    std::rethrow_exception(err);
+  }
+}
+
+int ThreadPool::Claim(int slot) {
+  Range& own = ranges_[slot];
+  {
+    std::lock_guard<std::mutex> lk(own.mu);
+    if (own.lo < own.hi) {
+      return own.lo++;
+    }
+  }
+
+  for (int k = 1; k < nranges_; ++k) {
+    Range& victim = ranges_[(slot + k) % nranges_];
+    int lo;
+    int hi;
+    {
+      std::lock_guard<std::mutex> lk(victim.mu);
+      int left = victim.hi - victim.lo;
+      if (left <= 0) {
+        continue;
+      }
+      hi = victim.hi;
+      lo = hi - (left + 1) / 2;
+      victim.hi = lo;
+    }
+    // no thread steals from an exhausted range, so only this one writes it
+    std::lock_guard<std::mutex> lk(own.mu);
+    own.lo = lo + 1;
+    own.hi = hi;
+    return lo;
+  }
+  return -1;
+}
+
+void ThreadPool::Work(int slot) {
+  bool prev = in_pool_task;
+  in_pool_task = true;
+
+  std::unique_lock<std::mutex> lk(mu_);
+  if (job_ == NULL) {
+    in_pool_task = prev;
+    return;
+  }
+  const std::function<void(int)>& f = *job_;
+  ++active_;
+  lk.unlock();
+
+  int i;
+  while ((i = Claim(slot)) >= 0) {
+    try {
+      f(i);
+    } catch (...) {
+      std::lock_guard<std::mutex> err_lk(mu_);
+      if (err_idx_ < 0 || i < err_idx_) {
+        err_idx_ = i;
+        err_ = std::current_exception();
+      }
+    }
+  }
+
+  lk.lock();
+  --active_;
+  done_cv_.notify_all();
+  lk.unlock();
+
+  in_pool_task = prev;
+}
+
+void ThreadPool::WorkerLoop(int slot) {
+  if (init_) {
+    init_();
+  }
+  unsigned long seen = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lk(mu_);
+      while (!stop_ && generation_ == seen) {
+        work_cv_.wait(lk);
+      }
+      if (stop_) {
+        return;
+      }
+      seen = generation_;
+    }
+    Work(slot);
+  }
+}
+
+}  // namespace cyclus
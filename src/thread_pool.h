@@ -0,0 +1,108 @@
+#ifndef CYCLUS_SRC_THREAD_POOL_H_
+#define CYCLUS_SRC_THREAD_POOL_H_
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace cyclus {
+
+/// @class ThreadPool
+///
+/// @brief A ThreadPool is a fixed-size set of worker threads used to run
+/// independent, index-addressed tasks concurrently. The thread calling
+/// ParallelFor participates in the work and blocks until every task has
+/// finished, so a pool of size n uses n - 1 worker threads.
+///
+/// Each ParallelFor splits its index range evenly across the threads. A
+/// thread runs its own share from the front and, once it is exhausted,
+/// steals the back half of the remaining share of another thread,
+/// so uneven tasks stay balanced without every claim going through one
+/// shared counter. The order in which tasks execute is not deterministic. Callers that need deterministic
+/// results should write each task's output to its own slot (e.g., indexed by
+/// the task index) and merge the slots in order after ParallelFor returns.
+///
+/// @code
+/// ThreadPool pool(4);
+/// std::vector<double> out(n);
+/// pool.ParallelFor(n, [&](int i) { out[i] = Work(i); });
+/// @endcode
+class ThreadPool {
+ public:
+  /// @param nthreads the total number of threads, including the caller, that
+  /// execute tasks. Values less than 1 are treated as 1.
+  explicit ThreadPool(int nthreads);
+
+  /// @param nthreads as above
+  /// @param init called by every worker thread when it starts, e.g. to set
+  /// up thread-local state the tasks depend on
+  ThreadPool(int nthreads, const std::function<void()>& init);
+
+  /// joins all worker threads
+  ~ThreadPool();
+
+  /// @return the total number of threads, including the caller, that execute
+  /// tasks
+  inline int size() const { return workers_.size() + 1; }
+
+  /// Runs f(i) for every i in [0, n) and returns once all calls have
+  /// completed. If any calls throw, the exception thrown by the call with the
+  /// lowest index is rethrown once all running calls have finished.
+  ///
+  /// Calls made from within a running task (i.e., nested parallelism) are
+  /// executed serially on the calling thread.
+  void ParallelFor(int n, const std::function<void(int)>& f);
+
+ private:
+  /// the not yet claimed tasks [lo, hi) of one thread
+  struct Range {
+    std::mutex mu;
+    int lo;
+    int hi;
+  };
+
+  /// runs tasks of the current job from the given thread's range, stealing
+  /// from other threads' ranges, until none remain unclaimed
+  void Work(int slot);
+
+  /// claims the next task of the slot's own range, or steals one and the
+  /// rest of a victim's back half into the slot's range. Returns -1 if no
+  /// task remains unclaimed.
+  int Claim(int slot);
+
+  /// worker thread main loop; slot is the worker's range index
+  void WorkerLoop(int slot);
+
+  /// starts the worker threads
+  void Start(int nthreads);
+
+  std::vector<std::thread> workers_;
+  std::function<void()> init_;
+
+  /// serializes ParallelFor calls from different external threads
+  std::mutex run_mu_;
+
+  /// guards all job state below
+  std::mutex mu_;
+  std::condition_variable work_cv_;
+  std::condition_variable done_cv_;
+  bool stop_;
+  unsigned long generation_;
+
+  const std::function<void(int)>* job_;
+  /// the task ranges of the caller (slot 0) and of each worker
+  std::unique_ptr<Range[]> ranges_;
+  int nranges_;
+  /// the number of threads inside Work
+  int active_;
+  int err_idx_;
+  std::exception_ptr err_;
+};
+
+}  // namespace cyclus
+
+#endif  // CYCLUS_SRC_THREAD_POOL_H_
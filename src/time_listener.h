@@ -33,6 +33,30 @@ class TimeListener: virtual public Ider {
   ///
   /// @param time is the current simulation timestep
   virtual void Tock() = 0;
+
+  /// Returns the next timestep at which this agent needs its Tick and Tock
+  /// methods called. This is only consulted when the simulation skips idle
+  /// timesteps (see SimInfo::skip_idle), after the Tock of every timestep that
+  /// is run. Agents are still ticked at every timestep that does run, which
+  /// may be earlier. The default, -1, requests the next timestep. Agents that
+  /// do not need to be woken again return kNeverWake.
+  virtual int NextWakeup() { return -1; }
+
+  /// Returns whether this agent's Tick and Tock may run concurrently with
+  /// those of other agents when the simulation is run with more than one
+  /// thread. Agents that override this to return true must only read shared
+  /// simulation state and modify their own state in Tick and Tock. They may
+  /// record data, but must not schedule builds or decommissionings, nor
+  /// assign ids: creating resources, compositions or product qualities, and
+  /// modifying tracked resources (e.g. decaying or transmuting materials), is
+  /// forbidden because ids taken by concurrent threads would differ from run
+  /// to run. Such operations throw a StateError, with or without threads.
+  /// Compositions may be read, and decayed where the decayed composition is
+  /// already known (see Composition::Decay), because their shared decay
+  /// chains and caches are locked. Agents are ticked and tocked in id order;
+  /// only thread-safe agents between two that are not thread safe (the
+  /// default) run concurrently with each other.
+  virtual bool ThreadSafeTick() { return false; }
 };
 
 }  // namespace cyclus
@@ -1,17 +1,58 @@
 // Implements the Timer class
 #include "timer.h"
 
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
 #include <iostream>
+#include <mutex>
 #include <string>
 
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <boost/uuid/uuid_generators.hpp>
+
 #include "agent.h"
 #include "error.h"
 #include "logger.h"
 #include "sim_init.h"
+#include "trader.h"
 
 namespace cyclus {
 
 void Timer::RunSim() {
+  IdCounters::Scope scope(ctx_->ids());
+  int status = 0;
+  try {
+    RunSteps();
+  } catch (std::exception& e) {
+    if (!forked_) {
+      WaitForks();
+      throw;
+    }
+    CLOG(LEV_ERROR) << "Simulation branch failed: " << e.what();
+    status = 1;
+  }
+
+  if (forked_) {
+    // a branch never returns to the caller, whose state (e.g. the backends it
+    // deletes) belongs to the parent process
+    try {
+      ctx_->rec_->Close();
+      delete fork_back_;
+    } catch (std::exception& e) {
+      CLOG(LEV_ERROR) << "Simulation branch failed: " << e.what();
+      status = 1;
+    }
+    std::cout.flush();
+    std::cerr.flush();
+    _exit(status);
+  }
+  WaitForks();
+}
+
+void Timer::RunSteps() {
   CLOG(LEV_INFO1) << "Simulation set to run from start="
                   << 0 << " to end=" << si_.duration;
   CLOG(LEV_INFO1) << "Beginning simulation";
@@ -21,12 +62,24 @@ void Timer::RunSim() {
   while (time_ < si_.duration) {
     CLOG(LEV_INFO1) << "Current time: " << time_;
 
+    if (si_.snapshot_interval > 0 && time_ > 0 &&
+        time_ % si_.snapshot_interval == 0) {
+      want_snapshot_ = true;
+    }
     if (want_snapshot_) {
+      PhaseTimer pt(ctx_->timings(), "Snapshot");
       want_snapshot_ = false;
       SimInit::Snapshot(ctx_);
     }
+    if (fork_queue_.count(time_) > 0) {
+      DoFork();
+    }
 
     // run through phases
+    {
+      PhaseTimer pt(ctx_->timings(), "Decay");
+      ctx_->BatchDecay();
+    }
     DoBuild();
     CLOG(LEV_INFO2) << "Beginning Tick for time: " << time_;
     DoTick();
@@ -35,23 +88,37 @@ void Timer::RunSim() {
     CLOG(LEV_INFO2) << "Beginning Tock for time: " << time_;
     DoTock();
     DoDecom();
+    ctx_->timings()->Record(ctx_, time_);
 
-    time_++;
+    int next = NextTime();
+    if (next > time_ + 1) {
+      CLOG(LEV_INFO2) << "Skipping idle time steps " << time_ + 1 << " to "
+                      << next - 1;
+    }
+    time_ = next;
 
     if (want_kill_) {
       break;
     }
   }
 
+  int dups;
+  {
+    IdCounters* ids = ctx_->ids();
+    std::lock_guard<std::mutex> lk(ids->intern_mu);
+    dups = ids->intern_dups;
+  }
   ctx_->NewDatum("Finish")
       ->AddVal("EarlyTerm", want_kill_)
       ->AddVal("EndTime", time_-1)
+      ->AddVal("InternedDups", dups)
       ->Record();
 
   SimInit::Snapshot(ctx_);  // always do a snapshot at the end of every simulation
 }
 
 void Timer::DoBuild() {
+  PhaseTimer pt(ctx_->timings(), "Build");
   // build queued agents
   std::vector<std::pair<std::string, Agent*> > build_list = build_queue_[time_];
   for (int i = 0; i < build_list.size(); ++i) {
@@ -69,11 +136,8 @@ void Timer::DoBuild() {
 }
 
 void Timer::DoTick() {
-  for (std::map<int, TimeListener*>::iterator agent = tickers_.begin();
-       agent != tickers_.end();
-       agent++) {
-    agent->second->Tick();
-  }
+  PhaseTimer pt(ctx_->timings(), "Tick");
+  RunListeners(&TimeListener::Tick, "Tick");
 }
 
 void Timer::DoResEx(ExchangeManager<Material>* matmgr,
@@ -83,14 +147,54 @@ void Timer::DoResEx(ExchangeManager<Material>* matmgr,
 }
 
 void Timer::DoTock() {
-  for (std::map<int, TimeListener*>::iterator agent = tickers_.begin();
-       agent != tickers_.end();
-       agent++) {
-    agent->second->Tock();
+  PhaseTimer pt(ctx_->timings(), "Tock");
+  RunListeners(&TimeListener::Tock, "Tock");
+}
+
+void Timer::RunListeners(void (TimeListener::*phase)(), const char* name) {
+  Timings* timings = ctx_->timings();
+  std::map<int, TimeListener*>::iterator agent;
+  // thread-safe listeners may not assign ids, with or without threads, so
+  // that a simulation's ids do not depend on its number of threads
+  if (ctx_->thread_pool() == NULL) {
+    for (agent = tickers_.begin(); agent != tickers_.end(); agent++) {
+      AgentTimer at(timings, agent->first, name);
+      if (agent->second->ThreadSafeTick()) {
+        IdCounters::Freeze freeze(ctx_->ids());
+        (agent->second->*phase)();
+      } else {
+        (agent->second->*phase)();
+      }
+    }
+    return;
+  }
+
+  // runs of consecutive thread-safe listeners run in parallel; the others
+  // run alone, so listeners still run in id order across runs
+  agent = tickers_.begin();
+  while (agent != tickers_.end()) {
+    if (!agent->second->ThreadSafeTick()) {
+      AgentTimer at(timings, agent->first, name);
+      (agent->second->*phase)();
+      ++agent;
+      continue;
+    }
+
+    std::vector<TimeListener*> safe;
+    while (agent != tickers_.end() && agent->second->ThreadSafeTick()) {
+      safe.push_back(agent->second);
+      ++agent;
+    }
+    IdCounters::Freeze freeze(ctx_->ids());
+    ctx_->ParallelPhase(safe.size(), [&](int i) {
+      AgentTimer at(timings, safe[i]->id(), name);
+      (safe[i]->*phase)();
+    });
   }
 }
 
 void Timer::DoDecom() {
+  PhaseTimer pt(ctx_->timings(), "Decom");
   // decommission queued agents
   std::vector<Agent*> decom_list = decom_queue_[time_];
   for (int i = 0; i < decom_list.size(); ++i) {
@@ -102,6 +206,156 @@ void Timer::DoDecom() {
   }
 }
 
+void Timer::DoFork() {
+  std::vector<ForkBranch> branches = fork_queue_[time_];
+  fork_queue_.erase(time_);
+
+  // only the forking thread exists in a child process, so all output is
+  // flushed and the recorder's writer and the context's workers are stopped
+  // first; the thread pool is recreated when next needed
+  Recorder* rec = ctx_->rec_;
+  rec->Flush();
+  unsigned int nbuffers = rec->nbuffers();
+  rec->set_nbuffers(1);
+  delete ctx_->pool_;
+  ctx_->pool_ = NULL;
+  std::cout.flush();
+  std::cerr.flush();
+
+  // the solver configuration is only kept in the output, so it is read before
+  // the branches take over the parent's backends
+  SimInit::SolverTables solver = SimInit::QuerySolverInfo(rec);
+
+  boost::uuids::uuid parent = ctx_->sim_id();
+  for (int i = 0; i < branches.size(); ++i) {
+    boost::uuids::uuid id = boost::uuids::random_generator()();
+    pid_t pid = fork();
+    if (pid < 0) {
+      throw StateError("cannot fork simulation branch: " +
+                       std::string(strerror(errno)));
+    } else if (pid == 0) {
+      forked_ = true;
+      fork_queue_.clear();
+      fork_pids_.clear();
+      fork_ids_.clear();
+      fork_times_.clear();
+
+      rec->Detach(id);
+      fork_back_ = branches[i].backend();
+      rec->RegisterBackend(fork_back_);
+      SimInfo si = ctx_->sim_info();
+      si.duration = si_.duration;  // the timer may be initialized directly
+      si.parent_sim = parent;
+      si.parent_type = "fork";
+      si.branch_time = time_;
+      ctx_->InitSim(si);  // also restarts the recorder's writer, if any
+      SimInit::SnapContext(ctx_, solver);
+      RecordSchedules();
+      if (branches[i].modify) {
+        branches[i].modify(ctx_);
+      }
+      ctx_->n_delta_snaps_ = -1;  // the branch's output has no prior snapshot
+      SimInit::Snapshot(ctx_);
+      return;
+    }
+    fork_pids_.push_back(pid);
+    fork_ids_.push_back(id);
+    fork_times_.push_back(time_);
+  }
+  rec->set_nbuffers(nbuffers);
+}
+
+void Timer::RecordSchedules() {
+  std::map<int, std::vector<std::pair<std::string, Agent*> > >::iterator b;
+  for (b = build_queue_.lower_bound(time_); b != build_queue_.end(); ++b) {
+    for (int i = 0; i < b->second.size(); ++i) {
+      Agent* parent = b->second[i].second;
+      ctx_->NewDatum("BuildSchedule")
+          ->AddVal("ParentId", parent != NULL ? parent->id() : -1)
+          ->AddVal("Prototype", b->second[i].first)
+          ->AddVal("SchedTime", time_)
+          ->AddVal("BuildTime", b->first)
+          ->Record();
+    }
+  }
+
+  std::map<int, std::vector<Agent*> >::iterator d;
+  for (d = decom_queue_.lower_bound(time_); d != decom_queue_.end(); ++d) {
+    for (int i = 0; i < d->second.size(); ++i) {
+      ctx_->NewDatum("DecomSchedule")
+          ->AddVal("AgentId", d->second[i]->id())
+          ->AddVal("SchedTime", time_)
+          ->AddVal("DecomTime", d->first)
+          ->Record();
+    }
+  }
+}
+
+void Timer::WaitForks() {
+  for (int i = 0; i < fork_pids_.size(); ++i) {
+    int status = 0;
+    int code = -1;  // the branch did not exit normally
+    if (waitpid(fork_pids_[i], &status, 0) == fork_pids_[i] &&
+        WIFEXITED(status)) {
+      code = WEXITSTATUS(status);
+    }
+    ctx_->NewDatum("ForkBranches")
+        ->AddVal("BranchSimId", fork_ids_[i])
+        ->AddVal("BranchTime", fork_times_[i])
+        ->AddVal("ExitStatus", code)
+        ->Record();
+  }
+  fork_pids_.clear();
+  fork_ids_.clear();
+  fork_times_.clear();
+}
+
+int Timer::NextTime() {
+  int next = time_ + 1;
+  if (!si_.skip_idle || want_snapshot_ || want_kill_) {
+    return next;
+  }
+
+  int wake = si_.duration;
+  std::map<int, std::vector<std::pair<std::string, Agent*> > >::iterator bit;
+  for (bit = build_queue_.upper_bound(time_); bit != build_queue_.end();
+       ++bit) {
+    if (!bit->second.empty()) {
+      wake = std::min(wake, bit->first);
+      break;
+    }
+  }
+  std::map<int, std::vector<Agent*> >::iterator dit;
+  for (dit = decom_queue_.upper_bound(time_); dit != decom_queue_.end();
+       ++dit) {
+    if (!dit->second.empty()) {
+      wake = std::min(wake, dit->first);
+      break;
+    }
+  }
+  std::map<int, std::vector<ForkBranch> >::iterator fit =
+      fork_queue_.upper_bound(time_);
+  if (fit != fork_queue_.end()) {
+    wake = std::min(wake, fit->first);
+  }
+
+  if (si_.snapshot_interval > 0) {
+    int n = si_.snapshot_interval;
+    wake = std::min(wake, (time_ / n + 1) * n);
+  }
+
+  std::map<int, TimeListener*>::iterator tit;
+  for (tit = tickers_.begin(); tit != tickers_.end() && wake > next; ++tit) {
+    wake = std::min(wake, std::max(tit->second->NextWakeup(), next));
+  }
+  const std::set<Trader*>& traders = ctx_->traders();
+  std::set<Trader*>::const_iterator rit;
+  for (rit = traders.begin(); rit != traders.end() && wake > next; ++rit) {
+    wake = std::min(wake, std::max((*rit)->NextTrade(), next));
+  }
+  return std::max(wake, next);
+}
+
 void Timer::RegisterTimeListener(TimeListener* agent) {
   tickers_[agent->id()] = agent;
 }
@@ -152,10 +406,19 @@ int Timer::time() {
   return time_;
 }
 
+void Timer::Fork(int t, const std::vector<ForkBranch>& branches) {
+  if (t < time_) {
+    throw ValueError("cannot fork a simulation in the past");
+  }
+  std::vector<ForkBranch>& q = fork_queue_[t];
+  q.insert(q.end(), branches.begin(), branches.end());
+}
+
 void Timer::Reset() {
   tickers_.clear();
   build_queue_.clear();
   decom_queue_.clear();
+  fork_queue_.clear();
   si_ = SimInfo(0);
 }
 
@@ -178,6 +441,12 @@ int Timer::dur() {
   return si_.duration;
 }
 
-Timer::Timer() : time_(0), si_(0), want_snapshot_(false), want_kill_(false) {}
+Timer::Timer()
+    : time_(0),
+      si_(0),
+      want_snapshot_(false),
+      want_kill_(false),
+      forked_(false),
+      fork_back_(NULL) {}
 
 }  // namespace cyclus
@@ -1,9 +1,12 @@
 #ifndef CYCLUS_SRC_TIMER_H_
 #define CYCLUS_SRC_TIMER_H_
 
+#include <functional>
 #include <utility>
 #include <vector>
 
+#include <boost/uuid/uuid.hpp>
+
 #include "context.h"
 #include "exchange_manager.h"
 #include "product.h"
@@ -16,6 +19,19 @@ class SimInitTest;
 namespace cyclus {
 
 class Agent;
+class RecBackend;
+
+/// A variant of a running simulation that is branched off in its own process
+/// (see Timer::Fork).
+struct ForkBranch {
+  /// Creates the backend the branch records its output to. Called in the
+  /// branch's process, so e.g. database files must be opened here.
+  std::function<RecBackend*()> backend;
+
+  /// Modifies the branched simulation, e.g. changes the parameters of some of
+  /// its agents, before it continues. May be empty.
+  std::function<void(Context*)> modify;
+};
 
 /// Controls simulation timestepping and inter-timestep phases.
 class Timer {
@@ -31,9 +47,22 @@ class Timer {
   /// resets all data (registered listeners, etc.) to empty or initial state
   void Reset();
 
-  /// Runs the simulation.
+  /// Runs the simulation. If idle timesteps are skipped (see
+  /// SimInfo::skip_idle), time jumps from each timestep that is run to the
+  /// next one with a scheduled build or decommissioning, a time listener
+  /// wake-up (see TimeListener::NextWakeup) or a trader wishing to trade (see
+  /// Trader::NextTrade), or an automatic snapshot (see
+  /// SimInfo::snapshot_interval). A requested snapshot or kill always runs the
+  /// next timestep.
   void RunSim();
 
+  /// Enables or disables skipping idle timesteps.
+  void skip_idle(bool on) { si_.skip_idle = on; }
+
+  /// Sets the number of timesteps between automatic snapshots, 0 disables
+  /// them.
+  void snapshot_interval(int n) { si_.snapshot_interval = n; }
+
   /// Registers an agent to receive tick/tock notifications every timestep.
   /// Agents should register from their Deploy method.
   void RegisterTimeListener(TimeListener* agent);
@@ -58,6 +87,31 @@ class Timer {
   /// Schedules the simulation to be terminated at the end of this timestep.
   void KillSim() { want_kill_ = true; }
 
+  /// Schedules the simulation to be branched at the start of timestep t,
+  /// before any of its phases run. Each branch is a forked child process
+  /// that shares the simulation's memory copy-on-write, so no state is
+  /// reloaded from the database. A branch gets a new simulation id and
+  /// records to its own backend the Info table, with this simulation as its
+  /// parent, "fork" as the parent type and t as the branch time, and
+  /// everything else a restart at t needs (see SimInit::SnapContext): the
+  /// solver configuration as read from the first of the parent's backends
+  /// that can be queried, the prototypes, recipes, agents and pending builds
+  /// and decommissionings, and the resources in the agents' inventories. This
+  /// is followed by a full snapshot of its (modified) state at t, so the
+  /// branch's output is self-contained and can be restarted from with
+  /// SimInit::Restart. The branch then runs to the end of the simulation and
+  /// its process exits, while the parent continues unmodified. Branches do
+  /// not inherit forks scheduled by the parent.
+  ///
+  /// At the end of RunSim the parent waits for all of its branches and
+  /// records each one's simulation id, branch time and exit status in the
+  /// ForkBranches table.
+  ///
+  /// @warning forking is only supported on POSIX systems and from a process
+  /// running a single simulation (i.e. not from an Ensemble). The simulation's
+  /// own worker threads are stopped before forking and restarted afterwards.
+  void Fork(int t, const std::vector<ForkBranch>& branches);
+
   /// Returns the current time, in months since the simulation started.
   ///
   /// @return the current time
@@ -87,6 +141,28 @@ class Timer {
   /// decommissions all agents queued for the current timestep.
   void DoDecom();
 
+  /// Returns the timestep to run after the current one.
+  int NextTime();
+
+  /// Runs the simulation's timesteps, see RunSim.
+  void RunSteps();
+
+  /// Forks the branches scheduled for the current timestep. Returns in the
+  /// parent and, set up as the new simulation, in every branch.
+  void DoFork();
+
+  /// Records the builds and decommissionings scheduled for the current time
+  /// and later, with the current time as the time they were scheduled.
+  void RecordSchedules();
+
+  /// Waits for all forked branches and records their exit status.
+  void WaitForks();
+
+  /// Calls phase (i.e. Tick or Tock), named name, on all time listeners.
+  /// Listeners run in id order, except that each run of consecutive
+  /// thread-safe listeners runs in parallel if the context has a thread pool.
+  void RunListeners(void (TimeListener::*phase)(), const char* name);
+
   Context* ctx_;
 
   /// The current time, measured in months from when the simulation
@@ -106,6 +182,19 @@ class Timer {
 
   // std::map<time,std::vector<config> >
   std::map<int, std::vector<Agent*> > decom_queue_;
+
+  std::map<int, std::vector<ForkBranch> > fork_queue_;
+
+  /// true in a forked branch's process
+  bool forked_;
+
+  /// the backend of a forked branch, deleted when the branch exits
+  RecBackend* fork_back_;
+
+  /// process ids, simulation ids and branch times of forked branches
+  std::vector<int> fork_pids_;
+  std::vector<boost::uuids::uuid> fork_ids_;
+  std::vector<int> fork_times_;
 };
 
 }  // namespace cyclus
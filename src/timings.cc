@@ -0,0 +1,68 @@
+#include "timings.h"
+
+#include <string.h>
+
+#include "agent.h"
+#include "context.h"
+
+namespace cyclus {
+
+void Timings::AddPhase(const char* phase, const char* resource, double secs) {
+  for (int i = 0; i < phases_.size(); ++i) {
+    PhaseEntry& e = phases_[i];
+    if (strcmp(e.phase, phase) == 0 && strcmp(e.resource, resource) == 0) {
+      e.secs += secs;
+      return;
+    }
+  }
+  PhaseEntry e = {phase, resource, secs};
+  phases_.push_back(e);
+}
+
+void Timings::AddAgent(int agent_id, const char* call, double secs) {
+  std::lock_guard<std::mutex> lk(mu_);
+  agents_[std::make_pair(agent_id, std::string(call))] += secs;
+}
+
+void Timings::Record(Context* ctx, int t) {
+  if (!phases()) {
+    return;
+  }
+
+  double rec_secs = ctx->rec_->write_secs();
+  AddPhase("Record", "", rec_secs - rec_secs_);
+  rec_secs_ = rec_secs;
+
+  for (int i = 0; i < phases_.size(); ++i) {
+    ctx->NewDatum("PhaseTimings")
+        ->AddVal("Time", t)
+        ->AddVal("Phase", phases_[i].phase)
+        ->AddVal("Resource", phases_[i].resource)
+        ->AddVal("Seconds", phases_[i].secs)
+        ->Record();
+  }
+  phases_.clear();
+
+  std::lock_guard<std::mutex> lk(mu_);
+  std::map<std::pair<int, std::string>, double>::iterator it;
+  for (it = agents_.begin(); it != agents_.end(); ++it) {
+    ctx->NewDatum("AgentTimings")
+        ->AddVal("Time", t)
+        ->AddVal("AgentId", it->first.first)
+        ->AddVal("Call", it->first.second)
+        ->AddVal("Seconds", it->second)
+        ->Record();
+  }
+  agents_.clear();
+}
+
+AgentTimer::AgentTimer(Agent* a, const char* call)
+    : t_(NULL), id_(-1), call_(call) {
+  if (a != NULL && a->context()->timings()->agents()) {
+    t_ = a->context()->timings();
+    id_ = a->id();
+    start_ = Timings::Clock::now();
+  }
+}
+
+}  // namespace cyclus
@@ -0,0 +1,143 @@
+#ifndef CYCLUS_SRC_TIMINGS_H_
+#define CYCLUS_SRC_TIMINGS_H_
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace cyclus {
+
+class Agent;
+class Context;
+
+/// Timings collects the wall-clock time spent in the phases of each time step
+/// and, optionally, in the Tick, Tock, request and bid calls of individual
+/// agents. The totals of a time step are written by Record to the
+/// PhaseTimings and AgentTimings tables.
+///
+/// Timings are collected with the PhaseTimer and AgentTimer guards below,
+/// which do nothing but test the timing level when timing is disabled.
+///
+/// @code
+/// {
+///   PhaseTimer pt(ctx->timings(), "Tick");
+///   DoTick();
+/// }
+/// ctx->timings()->Record(ctx, ctx->time());
+/// @endcode
+class Timings {
+ public:
+  /// Timing levels, each including the ones before it.
+  enum Level {
+    NONE = 0,  ///< nothing is timed
+    PHASES = 1,  ///< time step phases are timed
+    AGENTS = 2,  ///< individual agents' calls are timed as well
+  };
+
+  typedef std::chrono::steady_clock Clock;
+
+  Timings() : level_(NONE), rec_secs_(0) {}
+
+  /// Sets the timing level (see Level).
+  inline void level(int l) { level_ = l; }
+
+  inline int level() const { return level_; }
+
+  /// Returns whether time step phases are timed.
+  inline bool phases() const { return level_ >= PHASES; }
+
+  /// Returns whether individual agents' calls are timed.
+  inline bool agents() const { return level_ >= AGENTS; }
+
+  /// Adds secs to the time spent in phase for the given resource type (empty
+  /// for phases that are not part of a resource exchange).
+  void AddPhase(const char* phase, const char* resource, double secs);
+
+  /// Adds secs to the time spent by the agent with the given id in call.
+  /// This may be called concurrently from several threads.
+  void AddAgent(int agent_id, const char* call, double secs);
+
+  /// Records all timings collected since the previous call as time step t,
+  /// together with the time the context's recorder spent writing output, and
+  /// resets them.
+  void Record(Context* ctx, int t);
+
+ private:
+  struct PhaseEntry {
+    const char* phase;
+    const char* resource;
+    double secs;
+  };
+
+  int level_;
+
+  /// phase totals in the order phases were first timed
+  std::vector<PhaseEntry> phases_;
+
+  /// agent totals keyed by agent id and call, guarded by mu_
+  std::map<std::pair<int, std::string>, double> agents_;
+  std::mutex mu_;
+
+  /// recorder write time at the previous Record call
+  double rec_secs_;
+};
+
+/// Adds the time from its construction to its destruction to a phase of a
+/// Timings object, if phases are timed.
+class PhaseTimer {
+ public:
+  PhaseTimer(Timings* t, const char* phase, const char* resource = "")
+      : t_(t->phases() ? t : NULL), phase_(phase), resource_(resource) {
+    if (t_ != NULL) {
+      start_ = Timings::Clock::now();
+    }
+  }
+
+  ~PhaseTimer() {
+    if (t_ != NULL) {
+      std::chrono::duration<double> d = Timings::Clock::now() - start_;
+      t_->AddPhase(phase_, resource_, d.count());
+    }
+  }
+
+ private:
+  Timings* t_;
+  const char* phase_;
+  const char* resource_;
+  Timings::Clock::time_point start_;
+};
+
+/// Adds the time from its construction to its destruction to an agent's call
+/// in a Timings object, if agents are timed.
+class AgentTimer {
+ public:
+  AgentTimer(Timings* t, int agent_id, const char* call)
+      : t_(t->agents() ? t : NULL), id_(agent_id), call_(call) {
+    if (t_ != NULL) {
+      start_ = Timings::Clock::now();
+    }
+  }
+
+  /// Times a call of agent a, which may be NULL, in a's context.
+  AgentTimer(Agent* a, const char* call);
+
+  ~AgentTimer() {
+    if (t_ != NULL) {
+      std::chrono::duration<double> d = Timings::Clock::now() - start_;
+      t_->AddAgent(id_, call_, d.count());
+    }
+  }
+
+ private:
+  Timings* t_;
+  int id_;
+  const char* call_;
+  Timings::Clock::time_point start_;
+};
+
+}  // namespace cyclus
+
+#endif  // CYCLUS_SRC_TIMINGS_H_
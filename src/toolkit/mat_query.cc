@@ -1,4 +1,5 @@
 #include "mat_query.h"
+#include "nuc_registry.h"
 #include "pyne.h"
 
 #include <cmath>
@@ -17,7 +18,7 @@ double MatQuery::mass(Nuc nuc) {
 }
 
 double MatQuery::moles(Nuc nuc) {
-  return mass(nuc) / (pyne::atomic_mass(nuc) * units::g);
+  return mass(nuc) / (NucRegistry::Instance().AtomicMass(nuc) * units::g);
 }
 
 double MatQuery::mass_frac(Nuc nuc) {
@@ -58,8 +59,8 @@ double MatQuery::atom_frac(std::string nuc) {
 }
 
 bool MatQuery::AlmostEq(Material::Ptr other, double threshold) {
-  CompMap n1 = m_->comp()->mass();
-  CompMap n2 = other->comp()->mass();
+  CompVec n1 = m_->comp()->mass_vec();
+  CompVec n2 = other->comp()->mass_vec();
   compmath::Normalize(&n1);
   compmath::Normalize(&n2);
   return compmath::AlmostEq(n1, n2, threshold);
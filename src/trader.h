@@ -29,6 +29,22 @@ class Trader {
     return manager_;
   }
 
+  /// @brief whether this trader's request and bid queries (GetMatlRequests,
+  /// GetProductRequests, GetMatlBids, and GetProductBids) may run concurrently
+  /// with those of other traders when the simulation is run with more than
+  /// one thread. Archetypes that override this to return true must only
+  /// read shared simulation state and modify their own state in these
+  /// queries. In particular, they must not record data, create tracked
+  /// resources, or schedule builds or decommissionings. Traders that are not
+  /// thread safe (the default) are always queried serially.
+  virtual bool ThreadSafeExchange() { return false; }
+
+  /// @brief the next timestep at which this trader may have requests or bids.
+  /// This is only consulted when the simulation skips idle timesteps (see
+  /// SimInfo::skip_idle). The default, -1, requests the next timestep.
+  /// Traders that will not trade again return kNeverWake.
+  virtual int NextTrade() { return -1; }
+
   /// @brief default implementation for material requests
   virtual std::set<RequestPortfolio<Material>::Ptr>
       GetMatlRequests() {
@@ -5,6 +5,7 @@
 #include "exchange_context.h"
 #include "product.h"
 #include "material.h"
+#include "timings.h"
 #include "trader.h"
 
 namespace cyclus {
@@ -19,12 +20,14 @@ inline static std::set<typename RequestPortfolio<T>::Ptr>
 template<>
 inline std::set<RequestPortfolio<Material>::Ptr>
     QueryRequests<Material>(Trader* t) {
+  AgentTimer at(t->manager(), "GetMatlRequests");
   return t->GetMatlRequests();
 }
 
 template<>
 inline std::set<RequestPortfolio<Product>::Ptr>
     QueryRequests<Product>(Trader* t) {
+  AgentTimer at(t->manager(), "GetProductRequests");
   return t->GetProductRequests();
 }
 
@@ -37,12 +40,14 @@ inline static std::set<typename BidPortfolio<T>::Ptr>
 template<>
 inline std::set<BidPortfolio<Material>::Ptr>
     QueryBids<Material>(Trader* t, CommodMap<Material>::type& map) {
+  AgentTimer at(t->manager(), "GetMatlBids");
   return t->GetMatlBids(map);
 }
 
 template<>
 inline std::set<BidPortfolio<Product>::Ptr>
     QueryBids<Product>(Trader* t, CommodMap<Product>::type& map) {
+  AgentTimer at(t->manager(), "GetProductBids");
   return t->GetProductBids(map);
 }
 
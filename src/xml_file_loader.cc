@@ -3,6 +3,7 @@
 
 #include <algorithm>
 #include <fstream>
+#include <mutex>
 #include <set>
 #include <streambuf>
 
@@ -73,6 +74,25 @@ std::vector<AgentSpec> ParseSpecs(std::string infile) {
 }
 
 std::string BuildMasterSchema(std::string schema_path, std::string infile) {
+  // master schemas only depend on the schema template and the agent specs,
+  // so they are built once per process and shared by all simulations loading
+  // with the same set of archetypes (e.g. the cases of an ensemble)
+  static std::mutex mu;
+  static std::map<std::string, std::string> cache;
+
+  std::vector<AgentSpec> specs = ParseSpecs(infile);
+  std::string key = schema_path;
+  for (int i = 0; i < specs.size(); ++i) {
+    key += "\n" + specs[i].str() + " " + specs[i].alias();
+  }
+  {
+    std::lock_guard<std::mutex> lk(mu);
+    std::map<std::string, std::string>::iterator cached = cache.find(key);
+    if (cached != cache.end()) {
+      return cached->second;
+    }
+  }
+
   Timer ti;
   Recorder rec;
   Context ctx(&ti, &rec);
@@ -81,8 +101,6 @@ std::string BuildMasterSchema(std::string schema_path, std::string infile) {
   LoadStringstreamFromFile(schema, schema_path);
   std::string master = schema.str();
 
-  std::vector<AgentSpec> specs = ParseSpecs(infile);
-
   std::map<std::string, std::string> subschemas;
 
   // force element types to exist so we always replace the config string
@@ -108,6 +126,8 @@ std::string BuildMasterSchema(std::string schema_path, std::string infile) {
     }
   }
 
+  std::lock_guard<std::mutex> lk(mu);
+  cache[key] = master;
   return master;
 }
 
@@ -171,6 +191,7 @@ std::string XMLFileLoader::master_schema() {
 }
 
 void XMLFileLoader::LoadSim() {
+  IdCounters::Scope scope(ctx_->ids());
   std::stringstream ss(master_schema());
   parser_->Validate(ss);
   LoadControlParams();  // must be first
@@ -259,10 +280,13 @@ void XMLFileLoader::LoadSolver() {
     bool verbose = cyclus::OptionalQuery<bool>(&xqe, query, false);
     query = string("/*/control/solver/config/coin-or/mps");
     bool mps = cyclus::OptionalQuery<bool>(&xqe, query, false);
+    query = string("/*/control/solver/config/coin-or/persistent");
+    bool persistent = cyclus::OptionalQuery<bool>(&xqe, query, false);
     ctx_->NewDatum("CoinSolverInfo")
       ->AddVal("Timeout", timeout)
       ->AddVal("Verbose", verbose)
       ->AddVal("Mps", mps)
+      ->AddVal("Persistent", persistent)
       ->Record();
   } else {
     throw ValueError("unknown solver name: " + solver_name);
@@ -420,6 +444,30 @@ void XMLFileLoader::LoadControlParams() {
   // get time step duration
   si.dt = OptionalQuery<int>(qe, "dt", kDefaultTimeStepDur);
 
+  // get number of threads for parallel simulation phases
+  si.nthreads = OptionalQuery<int>(qe, "threads", 1);
+
+  // get number of output buffers, more than one writes asynchronously
+  si.record_buffers = OptionalQuery<int>(qe, "record_buffers",
+                                         kDefaultNumBuffers);
+
+  // get composition interning tolerance, zero disables interning
+  si.intern_tol = OptionalQuery<double>(qe, "intern_tol", 0);
+
+  // get whether to decay all materials together at each time step
+  si.batch_decay = OptionalQuery<bool>(qe, "batch_decay", false);
+
+  // get whether to skip time steps at which nothing is scheduled
+  si.skip_idle = OptionalQuery<bool>(qe, "skip_idle", false);
+
+  // get the level of timing instrumentation, zero disables it
+  si.timings = OptionalQuery<int>(qe, "timings", 0);
+
+  // get the snapshot cadence and the number of incremental snapshots taken
+  // after each full one, zero disables either
+  si.snapshot_interval = OptionalQuery<int>(qe, "snapshot_interval", 0);
+  si.delta_snapshots = OptionalQuery<int>(qe, "delta_snapshots", 0);
+
   ctx_->InitSim(si);
 }
 
@@ -0,0 +1,343 @@
+#include <boost/filesystem.hpp>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <gtest/gtest.h>
+
+#include "blob.h"
+#include "column_back.h"
+#include "hdf5_back.h"
+#include "sqlite_back.h"
+
+static std::string const path = "column_back_tests.col";
+
+class ColumnBackTests : public ::testing::Test {
+ public:
+  virtual void SetUp() {
+    boost::filesystem::remove_all(path);
+    b = new cyclus::ColumnBack(path);
+    r.RegisterBackend(b);
+  }
+
+  virtual void TearDown() {
+    r.Close();
+    delete b;
+    boost::filesystem::remove_all(path);
+  }
+  cyclus::ColumnBack* b;
+  cyclus::Recorder r;
+};
+
+TEST_F(ColumnBackTests, AllTogether) {
+  std::vector<int> vect;
+  vect.push_back(4);
+  vect.push_back(2);
+  std::map<std::string, double> m;
+  m["one"] = 1.1;
+
+  r.NewDatum("DumbTitle")
+      ->AddVal("animal", std::string("monkey"))
+      ->AddVal("weight", 10)
+      ->AddVal("height", 5.5)
+      ->AddVal("ratio", 0.5f)
+      ->AddVal("alive", true)
+      ->AddVal("answer", vect)
+      ->AddVal("count", m)
+      ->AddVal("data", cyclus::Blob("banana"))
+      ->Record();
+
+  vect[1] = 3;
+  m["two"] = 2.2;
+
+  r.NewDatum("DumbTitle")
+      ->AddVal("animal", std::string("elephant"))
+      ->AddVal("weight", 1000)
+      ->AddVal("height", 4.2)
+      ->AddVal("ratio", 0.25f)
+      ->AddVal("alive", false)
+      ->AddVal("answer", vect)
+      ->AddVal("count", m)
+      ->AddVal("data", cyclus::Blob("a very large mammal"))
+      ->Record();
+
+  r.Close();
+
+  cyclus::QueryResult qr = b->Query("DumbTitle", NULL);
+  ASSERT_EQ(2, qr.rows.size());
+  EXPECT_EQ(r.sim_id(), qr.GetVal<boost::uuids::uuid>("SimId", 0));
+
+  EXPECT_EQ("monkey", qr.GetVal<std::string>("animal", 0));
+  EXPECT_EQ(10, qr.GetVal<int>("weight", 0));
+  EXPECT_EQ(5.5, qr.GetVal<double>("height", 0));
+  EXPECT_EQ(0.5f, qr.GetVal<float>("ratio", 0));
+  EXPECT_TRUE(qr.GetVal<bool>("alive", 0));
+  EXPECT_EQ("banana", qr.GetVal<cyclus::Blob>("data", 0).str());
+  std::vector<int> vget = qr.GetVal<std::vector<int> >("answer", 0);
+  ASSERT_EQ(2, vget.size());
+  EXPECT_EQ(2, vget[1]);
+  EXPECT_EQ(1, (qr.GetVal<std::map<std::string, double> >("count", 0).size()));
+
+  EXPECT_EQ("elephant", qr.GetVal<std::string>("animal", 1));
+  EXPECT_EQ(1000, qr.GetVal<int>("weight", 1));
+  EXPECT_DOUBLE_EQ(4.2, qr.GetVal<double>("height", 1));
+  EXPECT_EQ(0.25f, qr.GetVal<float>("ratio", 1));
+  EXPECT_FALSE(qr.GetVal<bool>("alive", 1));
+  EXPECT_EQ("a very large mammal", qr.GetVal<cyclus::Blob>("data", 1).str());
+  vget = qr.GetVal<std::vector<int> >("answer", 1);
+  ASSERT_EQ(2, vget.size());
+  EXPECT_EQ(3, vget[1]);
+  EXPECT_EQ(m, (qr.GetVal<std::map<std::string, double> >("count", 1)));
+}
+
+TEST_F(ColumnBackTests, Conds) {
+  std::string names[] = {"a", "b", "c", "b"};
+  for (int i = 0; i < 4; ++i) {
+    std::vector<int> v(i, 1);
+    r.NewDatum("Rows")
+        ->AddVal("Name", names[i])
+        ->AddVal("Time", i)
+        ->AddVal("Quantity", 1.5 * i)
+        ->AddVal("Vals", v)
+        ->Record();
+  }
+  r.Close();
+
+  std::vector<cyclus::Cond> conds;
+  conds.push_back(cyclus::Cond("Time", ">=", 1));
+  conds.push_back(cyclus::Cond("Quantity", "<", 4.0));
+  cyclus::QueryResult qr = b->Query("Rows", &conds);
+  ASSERT_EQ(2, qr.rows.size());
+  EXPECT_EQ(1, qr.GetVal<int>("Time", 0));
+  EXPECT_EQ(2, qr.GetVal<int>("Time", 1));
+
+  conds.clear();
+  conds.push_back(cyclus::Cond("Name", "==", std::string("b")));
+  qr = b->Query("Rows", &conds);
+  ASSERT_EQ(2, qr.rows.size());
+  EXPECT_EQ(1, qr.GetVal<int>("Time", 0));
+  EXPECT_EQ(3, qr.GetVal<int>("Time", 1));
+
+  conds.clear();
+  conds.push_back(cyclus::Cond("Name", ">", std::string("a")));
+  conds.push_back(cyclus::Cond("SimId", "==", r.sim_id()));
+  EXPECT_EQ(3, b->Query("Rows", &conds).rows.size());
+
+  conds.clear();
+  conds.push_back(cyclus::Cond("Vals", "==", std::vector<int>(2, 1)));
+  qr = b->Query("Rows", &conds);
+  ASSERT_EQ(1, qr.rows.size());
+  EXPECT_EQ(2, qr.GetVal<int>("Time", 0));
+
+  conds.clear();
+  conds.push_back(cyclus::Cond("Vals", "<", std::vector<int>(2, 1)));
+  EXPECT_THROW(b->Query("Rows", &conds), cyclus::ValueError);
+  conds.clear();
+  conds.push_back(cyclus::Cond("Nope", "==", 1));
+  EXPECT_THROW(b->Query("Rows", &conds), cyclus::ValueError);
+}
+
+TEST_F(ColumnBackTests, Reopen) {
+  r.NewDatum("Rows")->AddVal("Name", std::string("a"))->Record();
+  r.NewDatum("Rows")->AddVal("Name", std::string("b"))->Record();
+  r.Close();
+  b->Close();
+
+  // appending to an existing database continues its string dictionaries
+  cyclus::ColumnBack b2(path);
+  cyclus::Recorder r2;
+  r2.RegisterBackend(&b2);
+  r2.NewDatum("Rows")->AddVal("Name", std::string("b"))->Record();
+  r2.NewDatum("Rows")->AddVal("Name", std::string("c"))->Record();
+  r2.Close();
+
+  cyclus::QueryResult qr = b2.Query("Rows", NULL);
+  ASSERT_EQ(4, qr.rows.size());
+  EXPECT_EQ("a", qr.GetVal<std::string>("Name", 0));
+  EXPECT_EQ("b", qr.GetVal<std::string>("Name", 1));
+  EXPECT_EQ("b", qr.GetVal<std::string>("Name", 2));
+  EXPECT_EQ("c", qr.GetVal<std::string>("Name", 3));
+  EXPECT_EQ(r2.sim_id(), qr.GetVal<boost::uuids::uuid>("SimId", 3));
+}
+
+TEST_F(ColumnBackTests, UncleanShutdown) {
+  r.NewDatum("Rows")->AddVal("Time", 1)->AddVal("Name", std::string("a"))
+      ->Record();
+  r.NewDatum("Rows")->AddVal("Time", 2)->AddVal("Name", std::string("b"))
+      ->Record();
+  r.Close();
+  b->Close();
+
+  // a crash leaves the zero padding of the last mapped segments behind
+  std::string files[] = {"SimId.col", "Time.col", "Name.col", "Name.dict"};
+  for (int i = 0; i < 4; ++i) {
+    boost::filesystem::resize_file(path + "/Rows/" + files[i], 1 << 20);
+  }
+
+  cyclus::ColumnBack b2(path);
+  cyclus::QueryResult qr = b2.Query("Rows", NULL);
+  ASSERT_EQ(2, qr.rows.size());
+  EXPECT_EQ(2, qr.GetVal<int>("Time", 1));
+  EXPECT_EQ("b", qr.GetVal<std::string>("Name", 1));
+
+  cyclus::Recorder r2;
+  r2.RegisterBackend(&b2);
+  r2.NewDatum("Rows")->AddVal("Time", 3)->AddVal("Name", std::string("c"))
+      ->Record();
+  r2.Close();
+  qr = b2.Query("Rows", NULL);
+  ASSERT_EQ(3, qr.rows.size());
+  EXPECT_EQ(3, qr.GetVal<int>("Time", 2));
+  EXPECT_EQ("c", qr.GetVal<std::string>("Name", 2));
+}
+
+TEST_F(ColumnBackTests, TypeChange) {
+  r.NewDatum("Rows")->AddVal("Time", 1)->AddVal("Name", std::string("a"))
+      ->Record();
+  r.Flush();
+  // the first field matches but the second doesn't, so neither is appended
+  r.NewDatum("Rows")->AddVal("Time", 2)->AddVal("Name", 2.0)->Record();
+  EXPECT_THROW(r.Flush(), cyclus::ValueError);
+  r.NewDatum("Rows")->AddVal("Time", 3)->AddVal("Name", std::string("c"))
+      ->Record();
+  r.Close();
+
+  cyclus::QueryResult qr = b->Query("Rows", NULL);
+  ASSERT_EQ(2, qr.rows.size());
+  EXPECT_EQ(1, qr.GetVal<int>("Time", 0));
+  EXPECT_EQ("a", qr.GetVal<std::string>("Name", 0));
+  EXPECT_EQ(3, qr.GetVal<int>("Time", 1));
+  EXPECT_EQ("c", qr.GetVal<std::string>("Name", 1));
+}
+
+TEST_F(ColumnBackTests, EmptyTable) {
+  boost::filesystem::create_directories(path + "/Empty");
+  std::ofstream f((path + "/Empty/schema").c_str());
+  f << "cyclus-columns 1\nTime " << cyclus::INT << "\n";
+  f.close();
+
+  std::vector<cyclus::Cond> conds;
+  conds.push_back(cyclus::Cond("Time", ">=", 0));
+  cyclus::QueryResult qr = b->Query("Empty", &conds);
+  EXPECT_EQ(0, qr.rows.size());
+  ASSERT_EQ(1, qr.fields.size());
+  EXPECT_EQ("Time", qr.fields[0]);
+}
+
+TEST_F(ColumnBackTests, LargeTable) {
+  // spans several memory mapped segments
+  int n = 300000;
+  for (int i = 0; i < n; ++i) {
+    r.NewDatum("Big")->AddVal("Time", i)->Record();
+  }
+  r.Close();
+
+  std::vector<cyclus::Cond> conds;
+  conds.push_back(cyclus::Cond("Time", ">=", n - 2));
+  cyclus::QueryResult qr = b->Query("Big", &conds);
+  ASSERT_EQ(2, qr.rows.size());
+  EXPECT_EQ(n - 2, qr.GetVal<int>("Time", 0));
+  EXPECT_EQ(n - 1, qr.GetVal<int>("Time", 1));
+}
+
+TEST_F(ColumnBackTests, ColumnTypesAndTables) {
+  r.NewDatum("IntTable")->AddVal("intcol", 42)->Record();
+  r.Close();
+
+  std::map<std::string, cyclus::DbTypes> coltypes = b->ColumnTypes("IntTable");
+  EXPECT_EQ(2, coltypes.size());  // injects simid
+  EXPECT_EQ(cyclus::INT, coltypes["intcol"]);
+  EXPECT_EQ(cyclus::UUID, coltypes["SimId"]);
+
+  std::set<std::string> tabs = b->Tables();
+  EXPECT_EQ(1, tabs.size());
+  EXPECT_EQ(1, tabs.count("IntTable"));
+  EXPECT_THROW(b->Query("Nope", NULL), cyclus::ValueError);
+}
+
+TEST_F(ColumnBackTests, Aggregate) {
+  // aggregated by the default row scan
+  for (int i = 0; i < 10; ++i) {
+    r.NewDatum("Rows")
+        ->AddVal("Agent", i % 3)
+        ->AddVal("Quantity", 1.0 * i)
+        ->Record();
+  }
+  r.Close();
+
+  std::vector<std::string> group_by(1, "Agent");
+  std::vector<cyclus::Agg> aggs;
+  aggs.push_back(cyclus::Agg("sum", "Quantity"));
+  aggs.push_back(cyclus::Agg("max", "Quantity"));
+  cyclus::QueryResult qr = b->Aggregate("Rows", NULL, &group_by, &aggs);
+  ASSERT_EQ(3, qr.rows.size());
+  EXPECT_EQ(0, qr.GetVal<int>("Agent", 0));
+  EXPECT_DOUBLE_EQ(18, qr.GetVal<double>("sum(Quantity)", 0));
+  EXPECT_DOUBLE_EQ(8, qr.GetVal<double>("max(Quantity)", 2));
+}
+
+// records n Resources-like rows to b and prints the time taken to write them,
+// to query them by time and by time and type, and to read them all
+void BenchBackend(cyclus::FullBackend* b, int n) {
+  cyclus::Recorder r;
+  r.RegisterBackend(b);
+  std::string types[] = {"Material", "Product"};
+  std::clock_t start = std::clock();
+  for (int i = 0; i < n; ++i) {
+    r.NewDatum("Resources")
+        ->AddVal("ResourceId", i)
+        ->AddVal("ObjId", i / 2)
+        ->AddVal("Type", types[i % 2])
+        ->AddVal("TimeCreated", i / 1000)
+        ->AddVal("Quantity", 1.5 * i)
+        ->AddVal("Units", std::string("kg"))
+        ->AddVal("QualId", i % 100)
+        ->AddVal("Parent1", i - 1)
+        ->Record();
+  }
+  r.Close();
+  double twrite = double(std::clock() - start) / CLOCKS_PER_SEC;
+
+  std::vector<cyclus::Cond> conds;
+  conds.push_back(cyclus::Cond("TimeCreated", "==", n / 2000));
+  start = std::clock();
+  int nrows = b->Query("Resources", &conds).rows.size();
+  double ttime = double(std::clock() - start) / CLOCKS_PER_SEC;
+
+  conds.push_back(cyclus::Cond("Type", "==", std::string("Product")));
+  start = std::clock();
+  nrows += b->Query("Resources", &conds).rows.size();
+  double ttype = double(std::clock() - start) / CLOCKS_PER_SEC;
+
+  start = std::clock();
+  nrows += b->Query("Resources", NULL).rows.size();
+  double tscan = double(std::clock() - start) / CLOCKS_PER_SEC;
+
+  std::cout << b->Name() << ": write " << twrite << " s, time filter " << ttime
+            << " s, time+string " << ttype << " s, scan " << tscan
+            << " s, rows " << nrows << "\n";
+}
+
+/// Benchmark of writing and querying 1M Resources-like rows with ColumnBack
+/// versus SqliteBack and Hdf5Back. Run with --gtest_also_run_disabled_tests.
+TEST(ColumnBackBench, DISABLED_Backends) {
+  int n = 1000000;
+  std::string paths[] = {"bench.col", "bench.sqlite", "bench.h5"};
+  for (int i = 0; i < 3; ++i) {
+    boost::filesystem::remove_all(paths[i]);
+  }
+  {
+    cyclus::ColumnBack b(paths[0]);
+    BenchBackend(&b, n);
+  }
+  {
+    cyclus::SqliteBack b(paths[1]);
+    BenchBackend(&b, n);
+  }
+  {
+    cyclus::Hdf5Back b(paths[2]);
+    BenchBackend(&b, n);
+  }
+  for (int i = 0; i < 3; ++i) {
+    boost::filesystem::remove_all(paths[i]);
+  }
+}
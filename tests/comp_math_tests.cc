@@ -1,5 +1,8 @@
 #include "gtest/gtest.h"
 
+#include <ctime>
+#include <iostream>
+
 #include "comp_math.h"
 #include "composition.h"
 #include "cyc_limits.h"
@@ -8,6 +11,7 @@
 namespace cm = cyclus::compmath;
 using cyclus::Composition;
 using cyclus::CompMap;
+using cyclus::CompVec;
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 TEST(CompMathTests, SubSame) {
@@ -252,3 +256,108 @@ TEST(CompMathTests, Add) {
     EXPECT_DOUBLE_EQ(it->second, expect[it->first]);
   }
 }
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+/// returns a composition of n nuclides with ids offset, offset + step, ...
+CompMap MakeComp(int n, int offset, int step) {
+  CompMap v;
+  for (int i = 0; i < n; ++i) {
+    v[offset + i * step] = 1.0 / (i + 1);
+  }
+  return v;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST(CompMathTests, CompVecConvert) {
+  CompMap m = MakeComp(10, 5, 3);
+  CompVec v(m);
+  ASSERT_EQ(10, v.size());
+  EXPECT_EQ(m, v.ToMap());
+  EXPECT_EQ(2, v.Find(11));
+  EXPECT_EQ(-1, v.Find(12));
+
+  EXPECT_THROW(v.Append(5, 1.0), cyclus::ValueError);
+  v.Append(1000, 1.0);
+  EXPECT_EQ(11, v.size());
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST(CompMathTests, CompVecMatchesMap) {
+  // partially overlapping nuclide sets
+  CompMap m1 = MakeComp(20, 1, 2);
+  CompMap m2 = MakeComp(20, 1, 3);
+  CompVec v1(m1);
+  CompVec v2(m2);
+
+  EXPECT_EQ(cm::Add(m1, m2), cm::Add(v1, v2).ToMap());
+  EXPECT_EQ(cm::Sub(m1, m2), cm::Sub(v1, v2).ToMap());
+  EXPECT_EQ(cm::Sub(m2, m1), cm::Sub(v2, v1).ToMap());
+  EXPECT_EQ(cm::Sum(m1), cm::Sum(v1));
+
+  CompMap mn(m1);
+  CompVec vn(v1);
+  cm::Normalize(&mn, 3.5);
+  cm::Normalize(&vn, 3.5);
+  EXPECT_EQ(mn, vn.ToMap());
+
+  CompMap mt = cm::Sub(m1, m2);
+  CompVec vt = cm::Sub(v1, v2);
+  cm::ApplyThreshold(&mt, 0.1);
+  cm::ApplyThreshold(&vt, 0.1);
+  EXPECT_EQ(mt, vt.ToMap());
+  EXPECT_THROW(cm::ApplyThreshold(&vt, -1), cyclus::ValueError);
+
+  EXPECT_TRUE(cm::AllPositive(v1));
+  EXPECT_FALSE(cm::AllPositive(cm::Sub(v1, v2)));
+
+  CompVec vc(v1);
+  vc.vals()[3] *= 1 + 1e-10;
+  EXPECT_TRUE(cm::AlmostEq(v1, vc, 1e-8));
+  EXPECT_FALSE(cm::AlmostEq(v1, vc, 1e-12));
+  EXPECT_FALSE(cm::AlmostEq(v1, v2, 1e-8));
+  EXPECT_TRUE(cm::AlmostEq(CompVec(), CompVec(), 0));
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+/// Microbenchmark of the mix performed by Material::Absorb for CompMap versus
+/// CompVec. Run with --gtest_also_run_disabled_tests.
+TEST(CompMathTests, DISABLED_CompVecBench) {
+  int sizes[] = {10, 100, 1000};
+  for (int k = 0; k < 3; ++k) {
+    int n = sizes[k];
+    int nreps = 1000000 / n;
+    CompMap m1 = MakeComp(n, 1, 2);
+    CompMap m2 = MakeComp(n, 1, 3);
+    CompVec v1(m1);
+    CompVec v2(m2);
+    double sink = 0;
+
+    std::clock_t start = std::clock();
+    for (int i = 0; i < nreps; ++i) {
+      CompMap a(m1);
+      CompMap b(m2);
+      cm::Normalize(&a, 2);
+      cm::Normalize(&b, 3);
+      CompMap c = cm::Sub(cm::Add(a, b), b);
+      cm::ApplyThreshold(&c, 1e-12);
+      sink += c.begin()->second;
+    }
+    double tmap = double(std::clock() - start) / CLOCKS_PER_SEC;
+
+    start = std::clock();
+    for (int i = 0; i < nreps; ++i) {
+      CompVec a(v1);
+      CompVec b(v2);
+      cm::Normalize(&a, 2);
+      cm::Normalize(&b, 3);
+      CompVec c = cm::Sub(cm::Add(a, b), b);
+      cm::ApplyThreshold(&c, 1e-12);
+      sink += c.vals()[0];
+    }
+    double tvec = double(std::clock() - start) / CLOCKS_PER_SEC;
+
+    std::cout << n << " nuclides, " << nreps << " mixes: CompMap " << tmap
+              << " s, CompVec " << tvec << " s (" << tmap / tvec
+              << "x), checksum " << sink << "\n";
+  }
+}
@@ -1,4 +1,6 @@
 #include <map>
+#include <thread>
+#include <vector>
 
 #include <gtest/gtest.h>
 
@@ -16,7 +18,7 @@ class TestComp : public Composition {
  public:
   TestComp() {}
   Composition::Chain DecayLine() {
-    return *decay_line_.get();
+    return decay_line_->chain;
   }  
 };
 
@@ -93,3 +95,138 @@ TEST(CompositionTests, decay) {
   EXPECT_NEAR(v[id("U238")], newv[id("U238")], 1e-4);
 }
 
+
+TEST(CompositionTests, intern) {
+  cyclus::Env::SetNucDataPath();
+  Composition::ClearInterned();
+  Composition::intern_tol(1e-6);
+
+  CompMap v;
+  v[922350000] = 1;
+  v[922380000] = 3;
+  Composition::Ptr c1 = Composition::CreateFromMass(v);
+
+  // equal up to normalization and within tolerance
+  v[922350000] = 2;
+  v[922380000] = 6 + 1e-9;
+  Composition::Ptr c2 = Composition::CreateFromMass(v);
+  EXPECT_EQ(c1, c2);
+  EXPECT_EQ(c1->id(), c2->id());
+
+  // atom and mass based compositions are never merged
+  Composition::Ptr c3 = Composition::CreateFromAtom(v);
+  EXPECT_NE(c1, c3);
+
+  v[922380000] = 7;
+  Composition::Ptr c4 = Composition::CreateFromMass(v);
+  EXPECT_NE(c1, c4);
+  EXPECT_NE(c1->id(), c4->id());
+  EXPECT_EQ(1, Composition::n_interned_dups());
+
+  // decay results are shared through the common decay lineage
+  EXPECT_EQ(c1->Decay(1), c2->Decay(1));
+
+  Composition::intern_tol(0);
+  v[922350000] = 1;
+  v[922380000] = 3;
+  EXPECT_NE(c1, Composition::CreateFromMass(v));
+  EXPECT_EQ(1, Composition::n_interned_dups());
+  Composition::ClearInterned();
+}
+
+TEST(CompositionTests, InternPerCounters) {
+  cyclus::Env::SetNucDataPath();
+  cyclus::IdCounters a;
+  cyclus::IdCounters b;
+  CompMap v;
+  v[922350000] = 1;
+  v[922380000] = 3;
+
+  Composition::Ptr c1;
+  {
+    cyclus::IdCounters::Scope scope(&a);
+    Composition::intern_tol(1e-6);
+    c1 = Composition::CreateFromMass(v);
+    EXPECT_EQ(c1, Composition::CreateFromMass(v));
+    EXPECT_EQ(1, Composition::n_interned_dups());
+  }
+
+  // another simulation's counters neither intern nor see a's compositions
+  {
+    cyclus::IdCounters::Scope scope(&b);
+    EXPECT_EQ(0, Composition::intern_tol());
+    EXPECT_NE(c1, Composition::CreateFromMass(v));
+    Composition::intern_tol(1e-6);
+    EXPECT_NE(c1, Composition::CreateFromMass(v));
+    EXPECT_EQ(0, Composition::n_interned_dups());
+  }
+  EXPECT_EQ(1e-6, a.intern_tol);
+  EXPECT_EQ(1, a.intern_dups);
+}
+
+TEST(CompositionTests, InternWeak) {
+  cyclus::Env::SetNucDataPath();
+  cyclus::IdCounters ids;
+  cyclus::IdCounters::Scope scope(&ids);
+  Composition::intern_tol(1e-6);
+
+  CompMap v;
+  v[922350000] = 1;
+  v[922380000] = 3;
+  int id1 = Composition::CreateFromMass(v)->id();
+
+  // the table did not keep the first composition alive
+  Composition::Ptr c = Composition::CreateFromMass(v);
+  EXPECT_NE(id1, c->id());
+  EXPECT_EQ(c, Composition::CreateFromMass(v));
+  EXPECT_EQ(1, Composition::n_interned_dups());
+
+  // entries of destroyed compositions are swept as the table grows
+  for (int i = 0; i < 4 * cyclus::IdCounters::kInternSweepMin; ++i) {
+    v[922380000] = 4 + i;
+    Composition::CreateFromMass(v);
+  }
+  EXPECT_GT(cyclus::IdCounters::kInternSweepMin, ids.interned.size());
+  v[922380000] = 3;
+  EXPECT_EQ(c, Composition::CreateFromMass(v));
+}
+
+TEST(CompositionTests, InternTolRange) {
+  cyclus::IdCounters ids;
+  cyclus::IdCounters::Scope scope(&ids);
+  EXPECT_THROW(Composition::intern_tol(1e-300), cyclus::ValueError);
+  EXPECT_EQ(0, Composition::intern_tol());
+  Composition::intern_tol(cyclus::IdCounters::kMinInternTol);
+  EXPECT_EQ(cyclus::IdCounters::kMinInternTol, Composition::intern_tol());
+  Composition::intern_tol(-1);
+  EXPECT_EQ(0, Composition::intern_tol());
+}
+
+TEST(CompositionTests, DecayThreads) {
+  cyclus::Env::SetNucDataPath();
+
+  CompMap v;
+  v[id("Cs137")] = 1;
+  v[id("U238")] = 10;
+  Composition::Ptr c = Composition::CreateFromAtom(v);
+
+  // threads decaying along the same lineage must share one result per age
+  std::vector<Composition::Ptr> got(4);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < got.size(); ++i) {
+    threads.push_back(std::thread([&got, c, i]() {
+      for (int dt = 1; dt <= 10; ++dt) {
+        got[i] = c->Decay(dt);
+        got[i]->atom();
+        got[i]->mass_vec();
+      }
+    }));
+  }
+  for (int i = 0; i < threads.size(); ++i) {
+    threads[i].join();
+  }
+  for (int i = 1; i < got.size(); ++i) {
+    EXPECT_EQ(got[0], got[i]);
+  }
+  EXPECT_EQ(got[0], c->Decay(10));
+}
@@ -0,0 +1,114 @@
+#include <gtest/gtest.h>
+
+#include "comp_math.h"
+#include "composition.h"
+#include "context.h"
+#include "decay_batch.h"
+#include "decay_engine.h"
+#include "env.h"
+#include "material.h"
+#include "pyne.h"
+#include "test_context.h"
+#include "thread_pool.h"
+
+using cyclus::CompMap;
+using cyclus::Composition;
+using cyclus::DecayBatch;
+using cyclus::DecayEngine;
+using cyclus::Material;
+using pyne::nucname::id;
+
+// checks that c decayed for delta time steps matches an unbatched decay
+void ExpectEngineDecay(Composition::Ptr c, int delta) {
+  CompMap want = DecayEngine::Instance().DecayVector(
+      c->atom_vec(), kDefaultTimeStepDur * delta).ToMap();
+  CompMap got = c->Decay(delta)->atom();
+  ASSERT_EQ(want.size(), got.size());
+  CompMap::iterator it;
+  for (it = want.begin(); it != want.end(); ++it) {
+    EXPECT_NEAR(it->second, got[it->first], 1e-12 * it->second)
+        << "nuclide " << it->first;
+  }
+}
+
+TEST(DecayBatchTests, MatchesEngine) {
+  cyclus::Env::SetNucDataPath();
+
+  CompMap v;
+  v[id("Cs137")] = 1;
+  v[id("U238")] = 10;
+  Composition::Ptr c1 = Composition::CreateFromAtom(v);
+  v[id("Pu241")] = 2;
+  Composition::Ptr c2 = Composition::CreateFromAtom(v);
+
+  DecayBatch batch;
+  batch.Add(c1, 12, kDefaultTimeStepDur);
+  batch.Add(c1, 12, kDefaultTimeStepDur);  // duplicate
+  batch.Add(c1, 1, kDefaultTimeStepDur);
+  batch.Add(c2, 12, kDefaultTimeStepDur);
+  EXPECT_EQ(3, batch.size());
+
+  cyclus::ThreadPool pool(3);
+  EXPECT_EQ(3, batch.Run(&pool));
+  EXPECT_EQ(0, batch.size());
+
+  // results are cached in the decay lineages
+  Composition::Ptr d = c1->Decay(12);
+  EXPECT_EQ(d, c1->Decay(12));
+  batch.Add(c1, 12, kDefaultTimeStepDur);
+  EXPECT_EQ(0, batch.size());
+
+  ExpectEngineDecay(c1, 12);
+  ExpectEngineDecay(c1, 1);
+  ExpectEngineDecay(c2, 12);
+}
+
+TEST(DecayBatchTests, SharedLineage) {
+  cyclus::Env::SetNucDataPath();
+
+  CompMap v;
+  v[id("Cs137")] = 1;
+  Composition::Ptr c = Composition::CreateFromAtom(v);
+  Composition::Ptr c1 = c->Decay(1);
+
+  // c decayed 3 steps and c1 decayed 2 steps are the same decay
+  DecayBatch batch;
+  batch.Add(c, 3, kDefaultTimeStepDur);
+  batch.Add(c1, 2, kDefaultTimeStepDur);
+  EXPECT_EQ(1, batch.size());
+  batch.Run();
+  EXPECT_EQ(c->Decay(3), c1->Decay(2));
+}
+
+TEST(DecayBatchTests, OnlyUsedDecay) {
+  cyclus::Env::SetNucDataPath();
+  cyclus::TestContext tc;
+  cyclus::FakeContext* ctx = tc.get();
+  ctx->InitSim(cyclus::SimInfo(10, 2015, 1, "", "manual"));
+  ctx->batch_decay(true);
+
+  CompMap v;
+  v[id("Cs137")] = 1;
+  Material::Ptr used = Material::Create(tc.trader(), 1,
+                                        Composition::CreateFromAtom(v));
+  v[id("Sr90")] = 1;
+  Material::Ptr idle = Material::Create(tc.trader(), 1,
+                                        Composition::CreateFromAtom(v));
+
+  // both materials are new, so both are batched once
+  ctx->time(1);
+  EXPECT_EQ(2, ctx->BatchDecay());
+  used->Decay(1);
+
+  // only the material whose decay was used is batched from then on
+  for (int t = 2; t < 5; ++t) {
+    ctx->time(t);
+    EXPECT_EQ(1, ctx->BatchDecay());
+    used->Decay(t);
+  }
+
+  // a material that is decayed again is batched again
+  idle->Decay(4);
+  ctx->time(5);
+  EXPECT_EQ(2, ctx->BatchDecay());
+}
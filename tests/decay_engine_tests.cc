@@ -0,0 +1,157 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <ctime>
+#include <iostream>
+
+#include "comp_math.h"
+#include "context.h"
+#include "decay_engine.h"
+#include "env.h"
+#include "nuc_registry.h"
+#include "pyne.h"
+#include "pyne_decay.h"
+
+using cyclus::CompMap;
+using cyclus::CompVec;
+using cyclus::DecayEngine;
+using cyclus::NucRegistry;
+using pyne::nucname::id;
+
+// checks that v decayed for secs seconds matches pyne's decay up to the
+// accuracy of the rational approximation
+void ExpectPyneDecay(const CompMap& v, double secs) {
+  CompMap want = pyne::decayers::decay(v, secs);
+  CompMap got = DecayEngine::Instance().DecayVector(CompVec(v), secs).ToMap();
+  double tot = cyclus::compmath::Sum(v);
+
+  CompMap all = want;
+  all.insert(got.begin(), got.end());
+  CompMap::iterator it;
+  for (it = all.begin(); it != all.end(); ++it) {
+    double w = want.count(it->first) > 0 ? want[it->first] : 0;
+    double g = got.count(it->first) > 0 ? got[it->first] : 0;
+    EXPECT_NEAR(w, g, 1e-10 * w + 1e-13 * tot) << "nuclide " << it->first;
+  }
+}
+
+TEST(DecayEngineTests, MatchesPyne) {
+  cyclus::Env::SetNucDataPath();
+
+  CompMap v;
+  v[id("Cs137")] = 1;
+  v[id("U238")] = 10;
+  ExpectPyneDecay(v, kDefaultTimeStepDur);
+  ExpectPyneDecay(v, pyne::half_life("Cs137"));
+
+  v[id("Pu241")] = 2;
+  v[id("Am242M")] = 0.5;
+  ExpectPyneDecay(v, 12 * kDefaultTimeStepDur);
+  ExpectPyneDecay(v, 1000 * kDefaultTimeStepDur);
+}
+
+TEST(DecayEngineTests, Memoized) {
+  cyclus::Env::SetNucDataPath();
+  DecayEngine& eng = DecayEngine::Instance();
+  eng.ClearCache();
+  EXPECT_EQ(0, eng.n_cached());
+
+  CompMap v;
+  v[id("Cs137")] = 1;
+  v[id("U238")] = 10;
+  CompVec d1 = eng.DecayVector(CompVec(v), kDefaultTimeStepDur);
+  EXPECT_EQ(2, eng.n_cached());
+
+  // the same parents decayed for the same time reuse the cached columns
+  v[id("Cs137")] = 3;
+  CompVec d2 = eng.DecayVector(CompVec(v), kDefaultTimeStepDur);
+  EXPECT_EQ(2, eng.n_cached());
+  EXPECT_EQ(d1.nucs(), d2.nucs());
+
+  eng.DecayVector(CompVec(v), 2 * kDefaultTimeStepDur);
+  EXPECT_EQ(4, eng.n_cached());
+
+  eng.ClearCache();
+  EXPECT_EQ(0, eng.n_cached());
+}
+
+TEST(DecayEngineTests, BoundedCache) {
+  cyclus::Env::SetNucDataPath();
+  DecayEngine& eng = DecayEngine::Instance();
+  eng.ClearCache();
+
+  // only the most recently used durations are kept
+  int nmax = DecayEngine::kMaxDurations;
+  CompMap v;
+  v[id("Cs137")] = 1;
+  CompVec first = eng.DecayVector(CompVec(v), kDefaultTimeStepDur);
+  for (int i = 2; i <= nmax + 5; ++i) {
+    eng.DecayVector(CompVec(v), i * kDefaultTimeStepDur);
+    EXPECT_EQ(std::min(i, nmax), eng.n_cached());
+  }
+
+  // an evicted duration is recomputed to the same result
+  CompVec again = eng.DecayVector(CompVec(v), kDefaultTimeStepDur);
+  EXPECT_EQ(nmax, eng.n_cached());
+  EXPECT_EQ(first.ToMap(), again.ToMap());
+
+  eng.ClearCache();
+}
+
+TEST(DecayEngineTests, NoDecay) {
+  cyclus::Env::SetNucDataPath();
+  DecayEngine& eng = DecayEngine::Instance();
+
+  // stable nuclides and nuclides unknown to the decay data are unchanged
+  CompMap v;
+  v[id("O16")] = 2;
+  v[922350009] = 3;
+  CompVec d = eng.DecayVector(CompVec(v), 1000 * kDefaultTimeStepDur);
+  EXPECT_EQ(v, d.ToMap());
+
+  v[id("Cs137")] = 1;
+  EXPECT_EQ(v, eng.DecayVector(CompVec(v), 0).ToMap());
+}
+
+TEST(DecayEngineTests, DISABLED_SpentFuelBench) {
+  cyclus::Env::SetNucDataPath();
+  const NucRegistry& reg = NucRegistry::Instance();
+  DecayEngine& eng = DecayEngine::Instance();
+
+  // a spent-fuel-like composition with (up to) 1500 nuclides
+  CompMap m;
+  for (int i = 0; i < reg.size() && m.size() < 1500; ++i) {
+    m[reg.nuc(i)] = 1 + i % 7;
+  }
+  CompVec v(m);
+  // small compositions are decayed more often so that clock() resolves them
+  int nreps = std::max<int>(100, 150000 / m.size());
+  double sink = 0;
+
+  std::clock_t start = std::clock();
+  for (int i = 0; i < nreps; ++i) {
+    CompMap d = pyne::decayers::decay(m, kDefaultTimeStepDur);
+    sink += d.begin()->second;
+  }
+  double tpyne = double(std::clock() - start) / CLOCKS_PER_SEC / nreps;
+
+  eng.ClearCache();
+  start = std::clock();
+  sink += eng.DecayVector(v, kDefaultTimeStepDur).vals()[0];
+  double tcold = double(std::clock() - start) / CLOCKS_PER_SEC;
+
+  start = std::clock();
+  for (int i = 0; i < nreps; ++i) {
+    CompVec d = eng.DecayVector(v, kDefaultTimeStepDur);
+    sink += d.vals()[0];
+  }
+  double twarm = double(std::clock() - start) / CLOCKS_PER_SEC / nreps;
+
+  std::cout << m.size() << " nuclides, per decay: pyne " << tpyne
+            << " s, engine cold " << tcold << " s, engine warm " << twarm
+            << " s (" << tpyne / twarm << "x), checksum " << sink << "\n";
+  if (m.size() < 1500) {
+    std::cout << "the decay data has only " << reg.size() << " nuclides, so"
+              << " these timings do not represent spent fuel\n";
+  }
+}
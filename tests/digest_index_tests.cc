@@ -0,0 +1,65 @@
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "digest_index.h"
+
+using cyclus::Digest;
+using cyclus::DigestIndex;
+
+static Digest Key(int i) {
+  cyclus::Sha1 hasher;
+  hasher.Update(std::to_string(i));
+  return hasher.digest();
+}
+
+TEST(DigestIndexTests, FindInsert) {
+  DigestIndex idx;
+  EXPECT_EQ(DigestIndex::ABSENT, idx.Find(1, Key(1)));
+  idx.Insert(1, Key(1));
+  EXPECT_EQ(DigestIndex::PRESENT, idx.Find(1, Key(1)));
+  EXPECT_EQ(DigestIndex::ABSENT, idx.Find(2, Key(1)));
+  EXPECT_EQ(DigestIndex::ABSENT, idx.Find(1, Key(2)));
+  EXPECT_EQ(1, idx.cached());
+
+  idx.Clear();
+  EXPECT_EQ(DigestIndex::ABSENT, idx.Find(1, Key(1)));
+  EXPECT_EQ(0, idx.cached());
+}
+
+TEST(DigestIndexTests, Eviction) {
+  // a single set of four digests
+  DigestIndex idx(1 << 16, 3);
+  for (int i = 0; i < 4; ++i) {
+    idx.Insert(1, Key(i));
+  }
+  EXPECT_EQ(DigestIndex::PRESENT, idx.Find(1, Key(0)));
+
+  // Key(1) is the least recently used and is left to the filter
+  idx.Insert(1, Key(4));
+  EXPECT_EQ(4, idx.cached());
+  EXPECT_EQ(DigestIndex::MAYBE, idx.Find(1, Key(1)));
+  for (int i = 0; i < 5; ++i) {
+    if (i != 1) {
+      EXPECT_EQ(DigestIndex::PRESENT, idx.Find(1, Key(i)));
+    }
+  }
+}
+
+TEST(DigestIndexTests, NoFalseNegatives) {
+  // a filter far too small for its digests only gets less certain
+  DigestIndex idx(64, 16);
+  for (int i = 0; i < 1000; ++i) {
+    idx.Insert(i % 3, Key(i));
+  }
+  EXPECT_GE(16, idx.cached());
+  for (int i = 0; i < 1000; ++i) {
+    EXPECT_NE(DigestIndex::ABSENT, idx.Find(i % 3, Key(i)));
+  }
+
+  idx.Resize(1 << 16, 0);
+  idx.Insert(0, Key(0));
+  EXPECT_EQ(0, idx.cached());
+  EXPECT_EQ(DigestIndex::MAYBE, idx.Find(0, Key(0)));
+}
@@ -1,4 +1,6 @@
 #include <string>
+#include <thread>
+#include <vector>
 
 #include <gtest/gtest.h>
 
@@ -23,3 +25,25 @@ TEST(ErrorTests, WarnLimit) {
   warn_limit = prev;
 }
 
+
+TEST(ErrorTests, WarnThreads) {
+  // as from the cases of an Ensemble
+  using cyclus::warn_limit;
+  using cyclus::warn_count;
+  unsigned int prev = warn_limit;
+  warn_limit = 0;
+  unsigned int before = warn_count[cyclus::STATE_WARNING];
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.push_back(std::thread([] {
+      for (int j = 0; j < 100; ++j) {
+        cyclus::Warn<cyclus::STATE_WARNING>("spoons everywhere");
+      }
+    }));
+  }
+  for (int i = 0; i < threads.size(); ++i) {
+    threads[i].join();
+  }
+  EXPECT_EQ(before + 400, warn_count[cyclus::STATE_WARNING]);
+  warn_limit = prev;
+}
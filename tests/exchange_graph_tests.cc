@@ -130,3 +130,153 @@ TEST(ExGraphTests, AddMatch) {
   ASSERT_EQ(1, g.matches().size());
   EXPECT_EQ(match, g.matches().at(0));
 }
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST(ExGraphTests, Flatten) {
+  ExchangeNode::Ptr u(new ExchangeNode(5, false, "", 1));
+  ExchangeNode::Ptr v(new ExchangeNode(3, true, "", 2));
+  ExchangeNode::Ptr w(new ExchangeNode(4, false, "", 3));
+
+  Arc a1(u, v);
+  Arc a2(u, w);
+  u->unit_capacities[a1].push_back(1);
+  u->unit_capacities[a2].push_back(1);
+  u->prefs[a1] = 1;
+  u->prefs[a2] = 3;
+  v->unit_capacities[a1].push_back(0.5);
+
+  RequestGroup::Ptr rg(new RequestGroup(5));
+  rg->AddExchangeNode(u);
+  rg->AddCapacity(5);
+  ExchangeNodeGroup::Ptr sg(new ExchangeNodeGroup());
+  sg->AddExchangeNode(v);
+  sg->AddExchangeNode(w);
+  sg->AddCapacity(2);
+
+  ExchangeGraph g;
+  g.AddRequestGroup(rg);
+  g.AddSupplyGroup(sg);
+  g.AddArc(a1);
+  g.AddArc(a2);
+
+  const cyclus::FlatExchangeGraph& f = g.flat();
+  ASSERT_EQ(3, f.n_nodes());
+  ASSERT_EQ(2, f.n_groups());
+  ASSERT_EQ(2, f.n_arcs());
+
+  int iu = f.NodeIndex(u.get());
+  int iv = f.NodeIndex(v.get());
+  int iw = f.NodeIndex(w.get());
+  EXPECT_EQ(0, iu);
+  EXPECT_EQ(0, f.node_grp[iu]);
+  EXPECT_EQ(1, f.node_grp[iv]);
+  EXPECT_EQ(1, f.node_grp[iw]);
+  EXPECT_DOUBLE_EQ(2, f.node_avg_pref[iu]);
+  EXPECT_EQ(0, f.GroupIndex(rg.get()));
+  EXPECT_EQ(1, f.GroupIndex(sg.get()));
+
+  // csr adjacency in arc insertion order
+  ASSERT_EQ(2, f.node_arc_begin[iu + 1] - f.node_arc_begin[iu]);
+  EXPECT_EQ(0, f.node_arcs[f.node_arc_begin[iu]]);
+  EXPECT_EQ(1, f.node_arcs[f.node_arc_begin[iu] + 1]);
+  ASSERT_EQ(1, f.node_arc_begin[iw + 1] - f.node_arc_begin[iw]);
+  EXPECT_EQ(1, f.node_arcs[f.node_arc_begin[iw]]);
+
+  // arc data
+  EXPECT_EQ(iu, f.arc_u[1]);
+  EXPECT_EQ(iw, f.arc_v[1]);
+  EXPECT_DOUBLE_EQ(3, f.arc_pref[1]);
+  EXPECT_TRUE(f.arc_excl[0]);
+  EXPECT_DOUBLE_EQ(3, f.arc_excl_val[0]);
+  EXPECT_FALSE(f.arc_excl[1]);
+
+  // unit capacities
+  EXPECT_TRUE(f.arc_has_vcaps[0]);
+  EXPECT_FALSE(f.arc_has_vcaps[1]);
+  ASSERT_EQ(1, f.arc_vcap_begin[1] - f.arc_vcap_begin[0]);
+  EXPECT_DOUBLE_EQ(0.5, f.arc_vcaps[f.arc_vcap_begin[0]]);
+  EXPECT_EQ(f.arc_vcap_begin[1], f.arc_vcap_begin[2]);
+  EXPECT_DOUBLE_EQ(1, f.arc_ucaps[f.arc_ucap_begin[1]]);
+
+  // adding an arc invalidates the flat form
+  ExchangeNode::Ptr x(new ExchangeNode());
+  g.AddArc(Arc(x, w));
+  EXPECT_EQ(4, g.flat().n_nodes());
+  EXPECT_EQ(-1, g.flat().node_grp[g.flat().NodeIndex(x.get())]);
+}
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST(ExGraphTests, Components) {
+  // two markets, {u1, u2} -> v1 and u3 -> v2, plus a request group without
+  // arcs; u1 and u2 are in separate request groups but share a supplier
+  ExchangeNode::Ptr u1(new ExchangeNode());
+  ExchangeNode::Ptr u2(new ExchangeNode());
+  ExchangeNode::Ptr u3(new ExchangeNode());
+  ExchangeNode::Ptr u4(new ExchangeNode());
+  ExchangeNode::Ptr v1(new ExchangeNode());
+  ExchangeNode::Ptr v2(new ExchangeNode());
+
+  RequestGroup::Ptr r1(new RequestGroup());
+  r1->AddExchangeNode(u1);
+  RequestGroup::Ptr r2(new RequestGroup());
+  r2->AddExchangeNode(u3);
+  RequestGroup::Ptr r3(new RequestGroup());
+  r3->AddExchangeNode(u2);
+  RequestGroup::Ptr r4(new RequestGroup());
+  r4->AddExchangeNode(u4);
+  ExchangeNodeGroup::Ptr s1(new ExchangeNodeGroup());
+  s1->AddExchangeNode(v2);
+  ExchangeNodeGroup::Ptr s2(new ExchangeNodeGroup());
+  s2->AddExchangeNode(v1);
+
+  Arc a1(u1, v1);
+  Arc a2(u3, v2);
+  Arc a3(u2, v1);
+
+  ExchangeGraph g;
+  g.AddRequestGroup(r1);
+  g.AddRequestGroup(r2);
+  g.AddRequestGroup(r3);
+  g.AddRequestGroup(r4);
+  g.AddSupplyGroup(s1);
+  g.AddSupplyGroup(s2);
+  g.AddArc(a1);
+  g.AddArc(a2);
+  g.AddArc(a3);
+
+  std::vector<ExchangeGraph::Ptr> comps = g.Components();
+  ASSERT_EQ(2, comps.size());
+
+  ExchangeGraph::Ptr c = comps[0];
+  ASSERT_EQ(2, c->request_groups().size());
+  EXPECT_EQ(r1, c->request_groups()[0]);
+  EXPECT_EQ(r3, c->request_groups()[1]);
+  ASSERT_EQ(1, c->supply_groups().size());
+  EXPECT_EQ(s2, c->supply_groups()[0]);
+  ASSERT_EQ(2, c->arcs().size());
+  EXPECT_EQ(a1, c->arcs()[0]);
+  EXPECT_EQ(a3, c->arcs()[1]);
+
+  c = comps[1];
+  ASSERT_EQ(1, c->request_groups().size());
+  EXPECT_EQ(r2, c->request_groups()[0]);
+  ASSERT_EQ(1, c->supply_groups().size());
+  EXPECT_EQ(s1, c->supply_groups()[0]);
+  ASSERT_EQ(1, c->arcs().size());
+  EXPECT_EQ(a2, c->arcs()[0]);
+
+  // a request group with nodes in both markets couples them
+  ExchangeNode::Ptr u5(new ExchangeNode());
+  ExchangeNode::Ptr u6(new ExchangeNode());
+  RequestGroup::Ptr r5(new RequestGroup());
+  r5->AddExchangeNode(u5);
+  r5->AddExchangeNode(u6);
+  g.AddRequestGroup(r5);
+  g.AddArc(Arc(u5, v1));
+  g.AddArc(Arc(u6, v2));
+
+  comps = g.Components();
+  ASSERT_EQ(1, comps.size());
+  EXPECT_EQ(4, comps[0]->request_groups().size());
+  EXPECT_EQ(5, comps[0]->arcs().size());
+}
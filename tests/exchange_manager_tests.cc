@@ -1,14 +1,45 @@
 #include <gtest/gtest.h>
 
+#include <mutex>
+#include <vector>
+
 #include "exchange_manager.h"
 #include "greedy_solver.h"
 #include "material.h"
 #include "test_context.h"
+#include "test_trader.h"
 
+using cyclus::ExchangeGraph;
 using cyclus::ExchangeManager;
+using cyclus::ExchangeSolver;
 using cyclus::GreedySolver;
 using cyclus::Material;
 using cyclus::TestContext;
+using cyclus::TestObjFactory;
+using cyclus::TestTrader;
+
+// records the number of request groups of every graph it or its clones solve
+class CountingSolver : public ExchangeSolver {
+ public:
+  CountingSolver(std::vector<int>* sizes, std::mutex* mu)
+      : sizes_(sizes),
+        mu_(mu) {}
+
+  virtual ExchangeSolver* Clone() const {
+    return new CountingSolver(sizes_, mu_);
+  }
+
+ protected:
+  virtual double SolveGraph() {
+    std::lock_guard<std::mutex> lk(*mu_);
+    sizes_->push_back(graph_->request_groups().size());
+    return 0;
+  }
+
+ private:
+  std::vector<int>* sizes_;
+  std::mutex* mu_;
+};
 
 TEST(ExManagerTests, NullTest) {
   TestContext tc;
@@ -18,3 +49,36 @@ TEST(ExManagerTests, NullTest) {
 
   EXPECT_NO_THROW(manager.Execute());
 }
+
+TEST(ExManagerTests, ComponentsIndependentOfThreads) {
+  TestObjFactory fac1;
+  TestObjFactory fac2;
+  fac2.commod = "other";
+
+  for (int nthreads = 1; nthreads <= 2; ++nthreads) {
+    TestContext tc;
+    tc.get()->nthreads(nthreads);
+    std::vector<int> sizes;
+    std::mutex mu;
+    tc.get()->solver(new CountingSolver(&sizes, &mu));
+
+    // two independent markets
+    TestTrader* traders[] = {
+      new TestTrader(tc.get(), &fac1, false),
+      new TestTrader(tc.get(), &fac1, true),
+      new TestTrader(tc.get(), &fac2, false),
+      new TestTrader(tc.get(), &fac2, true),
+    };
+    for (int i = 0; i < 4; ++i) {
+      traders[i]->Build(NULL);
+    }
+
+    ExchangeManager<Material> manager(tc.get());
+    manager.Execute();
+
+    // each component is solved separately, with or without threads
+    ASSERT_EQ(2, sizes.size()) << nthreads << " threads";
+    EXPECT_EQ(1, sizes[0]) << nthreads << " threads";
+    EXPECT_EQ(1, sizes[1]) << nthreads << " threads";
+  }
+}
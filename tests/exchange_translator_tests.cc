@@ -1,3 +1,6 @@
+#include <ctime>
+#include <iostream>
+
 #include <gtest/gtest.h>
 
 #include "bid.h"
@@ -471,3 +474,45 @@ TEST(ExXlateTests, BackXlate) {
   xlator.BackTranslateSolution(matches, obs);
   EXPECT_EQ(exp, obs);
 }
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST(ExXlateTests, DISABLED_TranslateBench) {
+  TestContext tc;
+  TestFacility* trader = tc.trader();
+  int nreqs = 2000;
+  int nbids = 10;  // per request
+
+  ExchangeContext<Material> ctx;
+  std::vector<Request<Material>*> reqs;
+  for (int i = 0; i < nreqs; ++i) {
+    RequestPortfolio<Material>::Ptr rp(new RequestPortfolio<Material>());
+    reqs.push_back(rp->AddRequest(get_mat(u235, qty), trader, "c", 1 + i % 3));
+    ctx.AddRequestPortfolio(rp);
+  }
+  for (int i = 0; i < nreqs; ++i) {
+    BidPortfolio<Material>::Ptr bp(new BidPortfolio<Material>());
+    for (int j = 0; j < nbids; ++j) {
+      bp->AddBid(reqs[(i + 97 * j) % nreqs], get_mat(u235, qty), trader);
+    }
+    ctx.AddBidPortfolio(bp);
+  }
+
+  int nreps = 5;
+  std::clock_t start = std::clock();
+  ExchangeGraph::Ptr graph;
+  for (int i = 0; i < nreps; ++i) {
+    ExchangeTranslator<Material> xlator(&ctx);
+    graph = xlator.Translate();
+  }
+  double txlate = double(std::clock() - start) / CLOCKS_PER_SEC / nreps;
+
+  start = std::clock();
+  for (int i = 0; i < nreps; ++i) {
+    graph->Flatten();
+  }
+  double tflat = double(std::clock() - start) / CLOCKS_PER_SEC / nreps;
+
+  std::cout << graph->arcs().size() << " arcs, per translation: "
+            << txlate << " s, of which Flatten " << tflat << " s ("
+            << 100 * tflat / txlate << "%)\n";
+}
@@ -1,5 +1,7 @@
 #include <gtest/gtest.h>
 
+#include <algorithm>
+
 #include "exchange_graph.h"
 #include "greedy_preconditioner.h"
 #include "greedy_solver.h"
@@ -10,6 +12,7 @@ using cyclus::AvgPrefComp;
 using cyclus::ExchangeGraph;
 using cyclus::ExchangeNode;
 using cyclus::ExchangeNodeGroup;
+using cyclus::ExchangeSolver;
 using cyclus::RequestGroup;
 using cyclus::GreedySolver;
 using cyclus::GreedyPreconditioner;
@@ -74,6 +77,10 @@ TEST(GreedySolverTests, General) {
   bool excl = false;
   GreedySolver s(excl);
 
+  // before Init, the groups' own capacities are used
+  EXPECT_EQ(s.Capacity(a1), 1);
+  EXPECT_EQ(s.Capacity(a2), 1.5);
+
   s.graph(&g);
   s.Init();
   EXPECT_EQ(s.Capacity(a1), 1);
@@ -83,3 +90,57 @@ TEST(GreedySolverTests, General) {
   EXPECT_EQ(g.request_groups()[1], gu1);
   EXPECT_EQ(g.request_groups()[0], gu2);
 }
+
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+ExchangeGraph::Ptr TwoMarketGraph() {
+  ExchangeGraph::Ptr g(new ExchangeGraph());
+  for (int m = 0; m != 2; m++) {
+    ExchangeNode::Ptr v(new ExchangeNode());
+    ExchangeNodeGroup::Ptr gv(new ExchangeNodeGroup());
+    gv->AddExchangeNode(v);
+    gv->AddCapacity(1.5 + m);
+    g->AddSupplyGroup(gv);
+    for (int i = 0; i != 2; i++) {
+      ExchangeNode::Ptr u(new ExchangeNode(1, false, "", i));
+      Arc a(u, v);
+      u->prefs[a] = 1 + i;
+      u->unit_capacities[a].push_back(1);
+      v->unit_capacities[a].push_back(1);
+      RequestGroup::Ptr gu(new RequestGroup(1));
+      gu->AddExchangeNode(u);
+      gu->AddCapacity(1);
+      g->AddRequestGroup(gu);
+      g->AddArc(a);
+    }
+  }
+  return g;
+}
+
+TEST(GreedySolverTests, Components) {
+  ExchangeGraph::Ptr whole = TwoMarketGraph();
+  GreedySolver s(false);
+  s.Solve(whole.get());
+
+  ExchangeGraph::Ptr g = TwoMarketGraph();
+  std::vector<ExchangeGraph::Ptr> comps = g->Components();
+  ASSERT_EQ(2, comps.size());
+  ExchangeSolver* clone = s.Clone();
+  ASSERT_TRUE(clone != NULL);
+  std::vector<double> qtys;
+  for (int i = 0; i != comps.size(); i++) {
+    clone->Solve(comps[i].get());
+    for (int j = 0; j != comps[i]->matches().size(); j++) {
+      qtys.push_back(comps[i]->matches()[j].second);
+    }
+  }
+  delete clone;
+
+  std::vector<double> expected;
+  for (int j = 0; j != whole->matches().size(); j++) {
+    expected.push_back(whole->matches()[j].second);
+  }
+  std::sort(qtys.begin(), qtys.end());
+  std::sort(expected.begin(), expected.end());
+  EXPECT_EQ(expected, qtys);
+  EXPECT_EQ(4, qtys.size());
+}
@@ -1050,4 +1050,370 @@ TEST(Hdf5BackTest, Tables) {
   set<string> tabs = back.Tables();
   EXPECT_LE(1, tabs.size());
   EXPECT_EQ(1, tabs.count("IntTable"));
+  EXPECT_EQ(0, tabs.count("ZoneMaps"));
+}
+
+TEST(Hdf5BackTest, ZoneMaps) {
+  using std::vector;
+  using cyclus::Recorder;
+  using cyclus::Hdf5Back;
+  using cyclus::Cond;
+  using cyclus::QueryResult;
+  FileDeleter fd(path);
+
+  {
+    Recorder m;
+    m.inject_sim_id(false);
+    Hdf5Back back(path);
+    m.RegisterBackend(&back);
+    for (int i = 0; i < 3000; ++i) {
+      m.NewDatum("Zoned")
+          ->AddVal("ResourceId", i)
+          ->AddVal("Mod", i % 7)
+          ->AddVal("Quantity", 0.5 * i)
+          ->Record();
+    }
+    m.Close();
+
+    vector<Cond> conds;
+    conds.push_back(Cond("ResourceId", "==", 2500));
+    QueryResult qr = back.Query("Zoned", &conds);
+    ASSERT_EQ(1, qr.rows.size());
+    EXPECT_DOUBLE_EQ(1250, qr.GetVal<double>("Quantity"));
+
+    conds[0] = Cond("ResourceId", "<", 100);
+    conds.push_back(Cond("Mod", "==", 3));
+    qr = back.Query("Zoned", &conds);
+    EXPECT_EQ(14, qr.rows.size());
+
+    conds.clear();
+    conds.push_back(Cond("ResourceId", ">", 5000));
+    qr = back.Query("Zoned", &conds);
+    EXPECT_EQ(0, qr.rows.size());
+  }
+
+  // one row of bounds per 1024-row chunk, a min and max per INT column
+  hid_t file = H5Fopen(path, H5F_ACC_RDWR, H5P_DEFAULT);
+  hid_t zmset = H5Dopen2(file, "ZoneMaps/Zoned", H5P_DEFAULT);
+  ASSERT_LE(0, zmset);
+  hid_t zmspace = H5Dget_space(zmset);
+  hsize_t dims[2];
+  H5Sget_simple_extent_dims(zmspace, dims, NULL);
+  EXPECT_EQ(3, dims[0]);
+  EXPECT_EQ(4, dims[1]);
+  int bounds[12];
+  H5Dread(zmset, H5T_NATIVE_INT, H5S_ALL, H5S_ALL, H5P_DEFAULT, bounds);
+  EXPECT_EQ(1024, bounds[4]);
+  EXPECT_EQ(2047, bounds[5]);
+  EXPECT_EQ(0, bounds[6]);
+  EXPECT_EQ(6, bounds[7]);
+  H5Sclose(zmspace);
+  H5Dclose(zmset);
+
+  // tables without a zone map are still queried correctly and get one when
+  // they are next written to
+  H5Ldelete(file, "ZoneMaps/Zoned", H5P_DEFAULT);
+  H5Fclose(file);
+  {
+    Recorder m;
+    m.inject_sim_id(false);
+    Hdf5Back back(path);
+    m.RegisterBackend(&back);
+    vector<Cond> conds;
+    conds.push_back(Cond("ResourceId", ">=", 2990));
+    EXPECT_EQ(10, back.Query("Zoned", &conds).rows.size());
+
+    for (int i = 3000; i < 3100; ++i) {
+      m.NewDatum("Zoned")
+          ->AddVal("ResourceId", i)
+          ->AddVal("Mod", i % 7)
+          ->AddVal("Quantity", 0.5 * i)
+          ->Record();
+    }
+    m.Close();
+    EXPECT_EQ(110, back.Query("Zoned", &conds).rows.size());
+  }
+  file = H5Fopen(path, H5F_ACC_RDONLY, H5P_DEFAULT);
+  EXPECT_LT(0, H5Lexists(file, "ZoneMaps/Zoned", H5P_DEFAULT));
+  H5Fclose(file);
+}
+
+TEST(Hdf5BackTest, Cursor) {
+  using std::string;
+  using std::vector;
+  using cyclus::Recorder;
+  using cyclus::Hdf5Back;
+  using cyclus::Cond;
+  using cyclus::QueryCursor;
+  using cyclus::QueryRow;
+  FileDeleter fd(path);
+
+  Recorder m;
+  m.inject_sim_id(false);
+  Hdf5Back back(path);
+  m.RegisterBackend(&back);
+  for (int i = 0; i < 3000; ++i) {
+    m.NewDatum("Rows")
+        ->AddVal("Time", i)
+        ->AddVal("Commodity", string(i % 2 == 0 ? "even" : "odd"))
+        ->AddVal("Quantity", 0.5 * i)
+        ->Record();
+  }
+  m.Close();
+
+  // batches span chunks and only the projected fields are returned
+  vector<Cond> conds;
+  conds.push_back(Cond("Commodity", "==", string("odd")));
+  vector<string> cols;
+  cols.push_back("Quantity");
+  cols.push_back("Time");
+  QueryCursor::Ptr c = back.Cursor("Rows", &conds, &cols);
+  ASSERT_EQ(2, c->fields().size());
+  EXPECT_EQ("Quantity", c->fields()[0]);
+  EXPECT_EQ(cyclus::INT, c->types()[1]);
+  vector<QueryRow> rows;
+  int nrows = 0;
+  int nbatches = 0;
+  while (c->Next(&rows, 1000)) {
+    ASSERT_LE(rows.size(), 1000);
+    for (int i = 0; i < rows.size(); ++i, ++nrows) {
+      ASSERT_EQ(2, rows[i].size());
+      EXPECT_EQ(2 * nrows + 1, rows[i][1].cast<int>());
+      EXPECT_DOUBLE_EQ(nrows + 0.5, rows[i][0].cast<double>());
+    }
+    ++nbatches;
+  }
+  EXPECT_EQ(1500, nrows);
+  EXPECT_EQ(2, nbatches);
+  EXPECT_FALSE(c->Next(&rows));
+
+  conds[0] = Cond("Time", ">=", 2990);
+  cyclus::QueryResult qr = back.Cursor("Rows", &conds)->ReadAll();
+  ASSERT_EQ(10, qr.rows.size());
+  EXPECT_EQ("even", qr.GetVal<string>("Commodity", 0));
+
+  cols.push_back("Nope");
+  EXPECT_THROW(back.Cursor("Rows", NULL, &cols), cyclus::KeyError);
+}
+
+TEST(Hdf5BackTest, Aggregate) {
+  using std::string;
+  using std::vector;
+  using cyclus::Recorder;
+  using cyclus::Hdf5Back;
+  using cyclus::Cond;
+  using cyclus::Agg;
+  using cyclus::QueryResult;
+  FileDeleter fd(path);
+
+  Recorder m;
+  m.inject_sim_id(false);
+  Hdf5Back back(path);
+  back.set_nthreads(3);
+  m.RegisterBackend(&back);
+  vector<int> shape(1, 8);
+  for (int i = 0; i < 5000; ++i) {
+    string commod = i % 2 == 0 ? "even" : "odd";
+    m.NewDatum("Rows")
+        ->AddVal("Time", i)
+        ->AddVal("Commodity", commod, &shape)
+        ->AddVal("VLCommodity", commod)
+        ->AddVal("Quantity", 0.5 * i)
+        ->Record();
+  }
+  m.Close();
+
+  // fixed size columns are aggregated from raw chunks in parallel, variable
+  // length ones through a cursor, with the same results
+  const char* commods[] = {"Commodity", "VLCommodity"};
+  for (int c = 0; c < 2; ++c) {
+    vector<string> group_by(1, commods[c]);
+    vector<Agg> aggs;
+    aggs.push_back(Agg("count"));
+    aggs.push_back(Agg("sum", "Quantity"));
+    aggs.push_back(Agg("min", "Time"));
+    aggs.push_back(Agg("mean", "Quantity"));
+    QueryResult qr = back.Aggregate("Rows", NULL, &group_by, &aggs);
+    ASSERT_EQ(2, qr.rows.size());
+    EXPECT_EQ("even", qr.GetVal<string>(commods[c], 0));
+    EXPECT_EQ(2500, qr.GetVal<int>("count", 0));
+    EXPECT_DOUBLE_EQ(3123750, qr.GetVal<double>("sum(Quantity)", 0));
+    EXPECT_EQ(1, qr.GetVal<int>("min(Time)", 1));
+    EXPECT_DOUBLE_EQ(1250, qr.GetVal<double>("mean(Quantity)", 1));
+
+    vector<Cond> conds;
+    conds.push_back(Cond(commods[c], "==", string("odd")));
+    conds.push_back(Cond("Time", ">=", 4000));
+    group_by[0] = "Time";
+    aggs.resize(2);
+    qr = back.Aggregate("Rows", &conds, &group_by, &aggs, 300);
+    ASSERT_EQ(4, qr.rows.size());
+    EXPECT_EQ(3900, qr.GetVal<int>("Time", 0));
+    EXPECT_EQ(100, qr.GetVal<int>("count", 0));
+    EXPECT_EQ(4800, qr.GetVal<int>("Time", 3));
+    EXPECT_EQ(100, qr.GetVal<int>("count", 3));
+  }
+
+  vector<Agg> aggs(1, Agg("max", "Nope"));
+  EXPECT_THROW(back.Aggregate("Rows", NULL, NULL, &aggs), cyclus::KeyError);
+}
+
+TEST(Hdf5BackTest, ParallelQuery) {
+  using std::map;
+  using std::string;
+  using std::vector;
+  using cyclus::Recorder;
+  using cyclus::Hdf5Back;
+  using cyclus::Cond;
+  using cyclus::QueryResult;
+  FileDeleter fd(path);
+
+  Recorder m;
+  m.inject_sim_id(false);
+  Hdf5Back back(path);
+  m.RegisterBackend(&back);
+  for (int i = 0; i < 10000; ++i) {
+    vector<string> names(i % 4, "n" + std::to_string(i % 13));
+    map<string, double> comp;
+    comp["u235"] = 0.01 * (i % 5);
+    m.NewDatum("Rows")
+        ->AddVal("Time", i)
+        ->AddVal("Names", names)
+        ->AddVal("Comp", comp)
+        ->Record();
+  }
+  m.Close();
+
+  // chunks decoded in parallel are returned in order, as if decoded serially
+  vector<Cond> conds;
+  conds.push_back(Cond("Time", ">=", 100));
+  back.set_nthreads(1);
+  QueryResult serial = back.Query("Rows", &conds);
+  back.set_nthreads(4);
+  int nreads = back.n_vl_reads();
+  QueryResult parallel = back.Query("Rows", &conds);
+  // all the values are found in the batch without locking the file
+  EXPECT_EQ(nreads, back.n_vl_reads());
+  ASSERT_EQ(9900, serial.rows.size());
+  ASSERT_EQ(serial.rows.size(), parallel.rows.size());
+  for (int i = 0; i < serial.rows.size(); ++i) {
+    ASSERT_EQ(100 + i, parallel.GetVal<int>("Time", i));
+    EXPECT_EQ(serial.GetVal<vector<string> >("Names", i),
+              parallel.GetVal<vector<string> >("Names", i));
+    EXPECT_EQ((serial.GetVal<map<string, double> >("Comp", i)),
+              (parallel.GetVal<map<string, double> >("Comp", i)));
+  }
+}
+
+TEST(Hdf5BackTest, BatchedStringKeys) {
+  using std::map;
+  using std::pair;
+  using std::string;
+  using std::vector;
+  using cyclus::Recorder;
+  using cyclus::Hdf5Back;
+  using cyclus::QueryResult;
+  FileDeleter fd(path);
+
+  Recorder m;
+  m.inject_sim_id(false);
+  Hdf5Back back(path);
+  m.RegisterBackend(&back);
+  vector<int> shape(2);
+  shape[0] = 2;
+  shape[1] = -1;
+  for (int i = 0; i < 1000; ++i) {
+    map<string, double> comp;
+    comp["u" + std::to_string(i % 7)] = i;
+    comp["pu" + std::to_string(i % 11)] = 0.5 * i;
+    map<pair<int, string>, double> prefs;
+    prefs[std::make_pair(i, "c" + std::to_string(i % 5))] = i;
+    vector<string> names(2, "n" + std::to_string(i % 3));
+    m.NewDatum("Strs")
+        ->AddVal("Time", i)
+        ->AddVal("Comp", comp)
+        ->AddVal("Prefs", prefs)
+        ->AddVal("FixedComp", comp, &shape)
+        ->AddVal("FixedNames", names, &shape)
+        ->Record();
+  }
+  m.Close();
+
+  // the strings of VL maps and of fixed-size columns of VL strings are read
+  // with the other values of their chunks
+  QueryResult qr = back.Query("Strs", NULL);
+  ASSERT_EQ(1000, qr.rows.size());
+  EXPECT_EQ(0, back.n_vl_reads());
+  for (int i = 0; i < qr.rows.size(); i += 97) {
+    map<string, double> comp = qr.GetVal<map<string, double> >("Comp", i);
+    EXPECT_EQ(i, comp["u" + std::to_string(i % 7)]);
+    EXPECT_EQ(0.5 * i, comp["pu" + std::to_string(i % 11)]);
+    EXPECT_EQ(comp, (qr.GetVal<map<string, double> >("FixedComp", i)));
+    map<pair<int, string>, double> prefs =
+        qr.GetVal<map<pair<int, string>, double> >("Prefs", i);
+    EXPECT_EQ(i, (prefs[std::make_pair(i, "c" + std::to_string(i % 5))]));
+    EXPECT_EQ(vector<string>(2, "n" + std::to_string(i % 3)),
+              qr.GetVal<vector<string> >("FixedNames", i));
+  }
+}
+
+TEST(Hdf5BackTest, VLKeyIndex) {
+  using std::string;
+  using cyclus::Blob;
+  using cyclus::Recorder;
+  using cyclus::Hdf5Back;
+  using cyclus::QueryResult;
+  FileDeleter fd(path);
+
+  // an index far too small to tell the keys apart still writes each value
+  // once, as does one read back in from the database
+  {
+    Recorder m;
+    m.inject_sim_id(false);
+    Hdf5Back back(path);
+    back.set_vlindex_size(64, 4);
+    m.RegisterBackend(&back);
+    for (int i = 0; i < 1000; ++i) {
+      m.NewDatum("Rows")
+          ->AddVal("Time", i)
+          ->AddVal("Name", i % 50 == 0 ? string() : "n" + std::to_string(i % 50))
+          ->AddVal("Data", Blob("b" + std::to_string(i % 7)))
+          ->Record();
+    }
+    m.Close();
+  }
+  {
+    Recorder m;
+    m.inject_sim_id(false);
+    Hdf5Back back(path);
+    m.RegisterBackend(&back);
+    for (int i = 1000; i < 1100; ++i) {
+      m.NewDatum("Rows")
+          ->AddVal("Time", i)
+          ->AddVal("Name", "n" + std::to_string(i % 60))
+          ->AddVal("Data", Blob("b" + std::to_string(i % 7)))
+          ->Record();
+    }
+    m.Close();
+
+    QueryResult qr = back.Query("Rows", NULL);
+    ASSERT_EQ(1100, qr.rows.size());
+    EXPECT_EQ("", qr.GetVal<string>("Name", 0));
+    EXPECT_EQ("n49", qr.GetVal<string>("Name", 999));
+    EXPECT_EQ("n59", qr.GetVal<string>("Name", 1079));
+    EXPECT_EQ("b6", qr.GetVal<Blob>("Data", 1084).str());
+  }
+
+  hid_t file = H5Fopen(path, H5F_ACC_RDONLY, H5P_DEFAULT);
+  hid_t keys = H5Dopen2(file, "StringKeys", H5P_DEFAULT);
+  hid_t space = H5Dget_space(keys);
+  EXPECT_EQ(61, H5Sget_simple_extent_npoints(space));  // "" and n0 to n59
+  H5Sclose(space);
+  H5Dclose(keys);
+  keys = H5Dopen2(file, "BlobKeys", H5P_DEFAULT);
+  space = H5Dget_space(keys);
+  EXPECT_EQ(7, H5Sget_simple_extent_npoints(space));
+  H5Sclose(space);
+  H5Dclose(keys);
+  H5Fclose(file);
 }
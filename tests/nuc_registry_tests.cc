@@ -0,0 +1,70 @@
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+#include "env.h"
+#include "nuc_registry.h"
+#include "pyne.h"
+
+using cyclus::NucRegistry;
+using pyne::nucname::id;
+
+TEST(NucRegistryTests, MatchesPyne) {
+  cyclus::Env::SetNucDataPath();
+  const NucRegistry& reg = NucRegistry::Instance();
+  ASSERT_GT(reg.size(), 0);
+
+  for (int i = 0; i < reg.size(); ++i) {
+    int nuc = reg.nuc(i);
+    EXPECT_EQ(i, reg.Index(nuc));
+    EXPECT_DOUBLE_EQ(pyne::atomic_mass(nuc), reg.atomic_mass(i));
+    EXPECT_DOUBLE_EQ(pyne::decay_const(nuc), reg.decay_const(i));
+    for (int j = 0; j < reg.n_daughters(i); ++j) {
+      int d = reg.daughter(i, j);
+      ASSERT_GE(d, 0);
+      ASSERT_LT(d, reg.size());
+      EXPECT_DOUBLE_EQ(pyne::branch_ratio(nuc, reg.nuc(d)),
+                       reg.branch_ratio(i, j));
+    }
+  }
+}
+
+TEST(NucRegistryTests, Fallback) {
+  cyclus::Env::SetNucDataPath();
+  const NucRegistry& reg = NucRegistry::Instance();
+
+  int nuc = id("U235");
+  EXPECT_DOUBLE_EQ(pyne::atomic_mass(nuc), reg.AtomicMass(nuc));
+  EXPECT_DOUBLE_EQ(pyne::decay_const(nuc), reg.DecayConst(nuc));
+
+  // an isomer that is not part of the decay data
+  nuc = 922350009;
+  EXPECT_EQ(-1, reg.Index(nuc));
+  EXPECT_DOUBLE_EQ(pyne::atomic_mass(nuc), reg.AtomicMass(nuc));
+}
+
+TEST(NucRegistryTests, FallbackThreads) {
+  cyclus::Env::SetNucDataPath();
+  const NucRegistry& reg = NucRegistry::Instance();
+
+  // isomers outside the decay data, looked up concurrently for the first time
+  std::vector<int> nucs;
+  for (int a = 230; a < 240; ++a) {
+    nucs.push_back(920000009 + a * 10000);
+  }
+  std::vector<double> masses(nucs.size());
+  std::vector<std::thread> threads;
+  for (int i = 0; i < nucs.size(); ++i) {
+    threads.push_back(std::thread([&reg, &nucs, &masses, i]() {
+      masses[i] = reg.AtomicMass(nucs[i]);
+    }));
+  }
+  for (int i = 0; i < threads.size(); ++i) {
+    threads[i].join();
+  }
+  for (int i = 0; i < nucs.size(); ++i) {
+    EXPECT_EQ(-1, reg.Index(nucs[i]));
+    EXPECT_DOUBLE_EQ(pyne::atomic_mass(nucs[i]), masses[i]);
+  }
+}
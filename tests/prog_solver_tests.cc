@@ -0,0 +1,180 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "exchange_graph.h"
+#include "prog_solver.h"
+
+namespace cyclus {
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+/// a requester (agent 1 by default) asking for 5 units of fuel from each of
+/// the bidders
+ExchangeGraph::Ptr FuelMarket(const std::vector<int>& bidders,
+                              int requester = 1) {
+  ExchangeGraph::Ptr g(new ExchangeGraph());
+  ExchangeNode::Ptr u(new ExchangeNode(5, false, "fuel", requester));
+  RequestGroup::Ptr rg(new RequestGroup(5));
+  rg->AddExchangeNode(u);
+  rg->AddCapacity(5);
+  g->AddRequestGroup(rg);
+
+  for (int i = 0; i != bidders.size(); i++) {
+    ExchangeNode::Ptr v(new ExchangeNode(10, false, "fuel", bidders[i]));
+    ExchangeNodeGroup::Ptr sg(new ExchangeNodeGroup());
+    sg->AddExchangeNode(v);
+    sg->AddCapacity(10);
+    g->AddSupplyGroup(sg);
+
+    Arc a(u, v);
+    a.pref(bidders[i]);
+    u->prefs[a] = bidders[i];
+    u->unit_capacities[a].push_back(1);
+    v->unit_capacities[a].push_back(1);
+    g->AddArc(a);
+  }
+  return g;
+}
+
+double TotalFlow(ExchangeGraph* g) {
+  double flow = 0;
+  for (int i = 0; i != g->matches().size(); i++) {
+    flow += g->matches()[i].second;
+  }
+  return flow;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST(ProgSolverTests, Persistent) {
+  bool excl = false;
+  bool verbose = false;
+  bool mps = false;
+  bool persistent = true;
+  ProgSolver s("cbc", 60.0, excl, verbose, mps, persistent);
+
+  std::vector<int> bidders;
+  bidders.push_back(2);
+  bidders.push_back(3);
+  ExchangeGraph::Ptr g = FuelMarket(bidders);
+  s.Solve(g.get());
+  EXPECT_EQ(1, s.n_solves());
+  EXPECT_EQ(0, s.n_warm_starts());
+  EXPECT_DOUBLE_EQ(5, TotalFlow(g.get()));
+
+  // an identical market is warm-started
+  g = FuelMarket(bidders);
+  s.Solve(g.get());
+  EXPECT_EQ(2, s.n_solves());
+  EXPECT_EQ(1, s.n_warm_starts());
+  EXPECT_DOUBLE_EQ(5, TotalFlow(g.get()));
+
+  // as is one where a bidder leaves and another arrives
+  bidders[1] = 4;
+  g = FuelMarket(bidders);
+  s.Solve(g.get());
+  EXPECT_EQ(3, s.n_solves());
+  EXPECT_EQ(2, s.n_warm_starts());
+  ASSERT_EQ(1, g->matches().size());
+  EXPECT_EQ(4, g->matches()[0].first.vnode()->agent_id);
+  EXPECT_DOUBLE_EQ(5, g->matches()[0].second);
+
+  // but not one where every bidder is new
+  bidders[0] = 5;
+  bidders[1] = 6;
+  g = FuelMarket(bidders);
+  s.Solve(g.get());
+  EXPECT_EQ(4, s.n_solves());
+  EXPECT_EQ(2, s.n_warm_starts());
+  EXPECT_DOUBLE_EQ(5, TotalFlow(g.get()));
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST(ProgSolverTests, PersistentAcrossExchanges) {
+  bool excl = false;
+  bool verbose = false;
+  bool mps = false;
+  bool persistent = true;
+  ProgSolver s("cbc", 60.0, excl, verbose, mps, persistent);
+
+  std::vector<int> bidders;
+  bidders.push_back(2);
+  bidders.push_back(3);
+  s.res_type("Material");
+  ExchangeGraph::Ptr g = FuelMarket(bidders);
+  s.Solve(g.get());
+  EXPECT_EQ(1, s.n_solves());
+  EXPECT_EQ(0, s.n_warm_starts());
+
+  // an empty graph in between is not solved and keeps the program
+  ExchangeGraph::Ptr empty(new ExchangeGraph());
+  s.Solve(empty.get());
+  EXPECT_EQ(1, s.n_solves());
+  EXPECT_TRUE(empty->matches().empty());
+
+  g = FuelMarket(bidders);
+  s.Solve(g.get());
+  EXPECT_EQ(2, s.n_solves());
+  EXPECT_EQ(1, s.n_warm_starts());
+  EXPECT_DOUBLE_EQ(5, TotalFlow(g.get()));
+
+  // a different market of another resource type gets its own program
+  std::vector<int> others;
+  others.push_back(7);
+  others.push_back(8);
+  s.res_type("Product");
+  g = FuelMarket(others);
+  s.Solve(g.get());
+  EXPECT_EQ(3, s.n_solves());
+  EXPECT_EQ(1, s.n_warm_starts());
+
+  s.res_type("Material");
+  g = FuelMarket(bidders);
+  s.Solve(g.get());
+  EXPECT_EQ(4, s.n_solves());
+  EXPECT_EQ(2, s.n_warm_starts());
+  EXPECT_DOUBLE_EQ(5, TotalFlow(g.get()));
+
+  s.res_type("Product");
+  g = FuelMarket(others);
+  s.Solve(g.get());
+  EXPECT_EQ(5, s.n_solves());
+  EXPECT_EQ(3, s.n_warm_starts());
+  EXPECT_DOUBLE_EQ(5, TotalFlow(g.get()));
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST(ProgSolverTests, PersistentClones) {
+  bool excl = false;
+  bool verbose = false;
+  bool mps = false;
+  bool persistent = true;
+  ProgSolver s("cbc", 60.0, excl, verbose, mps, persistent);
+  EXPECT_TRUE(ProgSolver("cbc", 60.0, excl, verbose, true).Clone() == NULL);
+
+  std::vector<int> bidders;
+  bidders.push_back(2);
+  bidders.push_back(3);
+  std::vector<int> others;
+  others.push_back(7);
+  others.push_back(8);
+
+  // the clones that solve two independent markets share the kept programs,
+  // one for each market
+  for (int i = 0; i < 2; i++) {
+    ExchangeSolver* c1 = s.Clone();
+    ExchangeSolver* c2 = s.Clone();
+    ASSERT_TRUE(c1 != NULL);
+    ExchangeGraph::Ptr g1 = FuelMarket(bidders);
+    ExchangeGraph::Ptr g2 = FuelMarket(others, 6);
+    c1->Solve(g1.get());
+    c2->Solve(g2.get());
+    delete c1;
+    delete c2;
+    EXPECT_DOUBLE_EQ(5, TotalFlow(g1.get()));
+    EXPECT_DOUBLE_EQ(5, TotalFlow(g2.get()));
+  }
+  EXPECT_EQ(4, s.n_solves());
+  EXPECT_EQ(2, s.n_warm_starts());
+}
+
+}  // namespace cyclus
@@ -128,3 +128,35 @@ TEST(QueryBackendTest, CmpConds) {
   EXPECT_PRED2(CmpConds<int>, &x, &conds);
   EXPECT_PRED2(NotCmpConds<int>, &y, &conds);
 }
+
+TEST(QueryBackendTest, ResultCursor) {
+  using std::string;
+  using std::vector;
+  cyclus::QueryResult qr;
+  qr.fields.push_back("x");
+  qr.fields.push_back("y");
+  qr.types.push_back(cyclus::INT);
+  qr.types.push_back(cyclus::STRING);
+  for (int i = 0; i < 5; ++i) {
+    cyclus::QueryRow r;
+    r.push_back(boost::spirit::hold_any(i));
+    r.push_back(boost::spirit::hold_any(string(i, 'a')));
+    qr.rows.push_back(r);
+  }
+
+  vector<string> cols(1, "y");
+  cyclus::ResultCursor c(qr, &cols);
+  ASSERT_EQ(1, c.fields().size());
+  EXPECT_EQ(cyclus::STRING, c.types()[0]);
+  vector<cyclus::QueryRow> rows;
+  ASSERT_TRUE(c.Next(&rows, 3));
+  ASSERT_EQ(3, rows.size());
+  EXPECT_EQ("aa", rows[2][0].cast<string>());
+  cyclus::QueryResult rest = c.ReadAll();
+  ASSERT_EQ(2, rest.rows.size());
+  EXPECT_EQ("aaaa", rest.GetVal<string>("y", 1));
+  EXPECT_FALSE(c.Next(&rows));
+
+  cols[0] = "z";
+  EXPECT_THROW(cyclus::ResultCursor(qr, &cols), cyclus::KeyError);
+}
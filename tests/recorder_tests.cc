@@ -1,7 +1,12 @@
+#include <stdexcept>
+
 #include <gtest/gtest.h>
 
+#include "datum.h"
+#include "error.h"
 #include "rec_backend.h"
 #include "recorder.h"
+#include "thread_pool.h"
 
 class TestBack : public cyclus::RecBackend {
  public:
@@ -85,6 +90,68 @@ TEST(RecorderTest, InjectSimId) {
   EXPECT_EQ(it->second.cast<std::string>(), "funkey");
 }
 
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST(RecorderTest, Datum_TypedFields) {
+  using cyclus::Datum;
+  using cyclus::Recorder;
+  Recorder m;
+  m.inject_sim_id(false);
+  std::vector<int> v(2, 7);
+  Datum* d = m.NewDatum("Typed");
+  d->AddVal("b", true)
+   ->AddVal("i", 42)
+   ->AddVal("f", 1.5f)
+   ->AddVal("d", 2.25)
+   ->AddVal("s", "hello")
+   ->AddVal("blob", cyclus::Blob("bytes"))
+   ->AddVal("u", m.sim_id())
+   ->AddVal("boxed", boost::spirit::hold_any(3))
+   ->AddVal("vec", v);
+
+  ASSERT_EQ(9, d->nfields());
+  EXPECT_EQ(Datum::BOOL_FIELD, d->field(0).type);
+  EXPECT_TRUE(d->AsBool(0));
+  EXPECT_EQ(42, d->AsInt(1));
+  EXPECT_FLOAT_EQ(1.5, d->AsFloat(2));
+  EXPECT_DOUBLE_EQ(2.25, d->AsDouble(3));
+  EXPECT_EQ(Datum::STRING_FIELD, d->field(4).type);
+  EXPECT_EQ(5, d->field(4).size);
+  EXPECT_STREQ("hello", d->data(4));
+  EXPECT_EQ(Datum::BLOB_FIELD, d->field(5).type);
+  EXPECT_EQ("bytes", std::string(d->data(5), d->field(5).size));
+  EXPECT_EQ(m.sim_id(), d->AsUuid(6));
+  // scalars that were boxed by the caller are stored typed
+  EXPECT_EQ(Datum::INT_FIELD, d->field(7).type);
+  EXPECT_EQ(3, d->AsInt(7));
+  EXPECT_EQ(Datum::ANY_FIELD, d->field(8).type);
+  EXPECT_EQ(v, d->box(8).cast<std::vector<int> >());
+  EXPECT_THROW(d->AsDouble(1), cyclus::ValueError);
+  EXPECT_THROW(d->data(8), cyclus::ValueError);
+  EXPECT_THROW(d->box(1), cyclus::ValueError);
+
+  // the boxed view matches the typed one
+  const Datum::Vals& vals = d->vals();
+  ASSERT_EQ(9, vals.size());
+  EXPECT_STREQ("i", vals[1].first);
+  EXPECT_EQ(42, vals[1].second.cast<int>());
+  EXPECT_EQ("hello", vals[4].second.cast<std::string>());
+  EXPECT_EQ(cyclus::Blob("bytes"), vals[5].second.cast<cyclus::Blob>());
+  EXPECT_EQ(m.sim_id(), vals[6].second.cast<boost::uuids::uuid>());
+  EXPECT_EQ(v, vals[8].second.cast<std::vector<int> >());
+  EXPECT_EQ(9, d->shapes().size());
+
+  // a recycled datum starts empty and sees values added after the first
+  // call to vals()
+  d->AddVal("extra", 1);
+  EXPECT_EQ(10, d->vals().size());
+  m.Flush();
+  d = m.NewDatum("Typed");
+  EXPECT_EQ(0, d->nfields());
+  EXPECT_EQ(0, d->vals().size());
+  d->AddVal("s", std::string("again"));
+  EXPECT_STREQ("again", d->data(0));
+}
+
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 TEST(RecorderTest, Manager_Closing) {
   using cyclus::Recorder;
@@ -161,6 +228,131 @@ TEST(RecorderTest, Manager_CloseFlushing) {
   EXPECT_EQ(back1.notify_count, 1);
 }
 
+/// copies the values it receives, since the recorder reuses Datum objects
+class CopyBack : public cyclus::RecBackend {
+ public:
+  CopyBack() : fail(false), fail_std(false) {}
+
+  virtual void Notify(cyclus::DatumList data) {
+    if (fail)
+      throw cyclus::IOError("CopyBack failure");
+    if (fail_std)
+      throw std::runtime_error("CopyBack failure");
+    for (int i = 0; i < data.size(); ++i) {
+      vals.push_back(data[i]->vals().back().second.cast<int>());
+    }
+  }
+
+  virtual std::string Name() {
+    return "CopyBack";
+  }
+
+  virtual void Flush() {}
+
+  bool fail;
+  bool fail_std;
+  std::vector<int> vals;
+};
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST(RecorderTest, Manager_AsyncBuffering) {
+  using cyclus::Recorder;
+  CopyBack back;
+
+  Recorder m;
+  m.set_dump_count(3);
+  m.set_nbuffers(3);
+  EXPECT_EQ(m.nbuffers(), 3);
+  m.RegisterBackend(&back);
+
+  for (int i = 0; i < 100; ++i) {
+    m.NewDatum("Count")
+        ->AddVal("i", i)
+        ->Record();
+  }
+  m.Flush();
+  ASSERT_EQ(back.vals.size(), 100);
+  for (int i = 0; i < 100; ++i) {
+    EXPECT_EQ(back.vals[i], i);
+  }
+
+  // switching back to synchronous mode keeps buffered data
+  m.NewDatum("Count")->AddVal("i", 100)->Record();
+  m.set_nbuffers(1);
+  m.Close();
+  ASSERT_EQ(back.vals.size(), 101);
+  EXPECT_EQ(back.vals.back(), 100);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST(RecorderTest, Manager_AsyncError) {
+  using cyclus::Recorder;
+  CopyBack back;
+  back.fail = true;
+
+  Recorder m;
+  m.set_dump_count(1);
+  m.set_nbuffers(2);
+  m.RegisterBackend(&back);
+
+  // the write fails on the writer thread and is reported by a later call
+  m.NewDatum("Count")->AddVal("i", 0)->Record();
+  EXPECT_THROW(m.Flush(), cyclus::IOError);
+  back.fail = false;
+  EXPECT_NO_THROW(m.Flush());
+  m.NewDatum("Count")->AddVal("i", 1)->Record();
+  EXPECT_NO_THROW(m.Close());
+  ASSERT_EQ(back.vals.size(), 1);
+  EXPECT_EQ(back.vals[0], 1);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST(RecorderTest, Manager_DestructorError) {
+  using cyclus::Recorder;
+  CopyBack back;
+  back.fail_std = true;
+
+  // errors other than cyclus::Error are logged by the destructor too
+  EXPECT_NO_THROW({
+    Recorder m;
+    m.set_nbuffers(2);
+    m.RegisterBackend(&back);
+    m.NewDatum("Count")->AddVal("i", 0)->Record();
+  });
+  EXPECT_EQ(back.vals.size(), 0);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST(RecorderTest, Manager_Stages) {
+  using cyclus::Recorder;
+  CopyBack back;
+
+  Recorder m;
+  m.set_dump_count(4);
+  m.RegisterBackend(&back);
+  m.NewDatum("Count")->AddVal("i", -1)->Record();
+
+  // staged data is merged in stage order regardless of scheduling
+  cyclus::ThreadPool pool(4);
+  m.OpenStages(10);
+  pool.ParallelFor(10, [&](int i) {
+    m.SelectStage(i);
+    for (int k = 0; k < 3; ++k) {
+      m.NewDatum("Count")->AddVal("i", 3 * i + k)->Record();
+    }
+    m.SelectStage(-1);
+  });
+  m.MergeStages();
+  m.NewDatum("Count")->AddVal("i", 30)->Record();
+  m.Close();
+
+  ASSERT_EQ(back.vals.size(), 32);
+  EXPECT_EQ(back.vals[0], -1);
+  for (int i = 0; i <= 30; ++i) {
+    EXPECT_EQ(back.vals[i + 1], i);
+  }
+}
+
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 TEST(RecorderTest, Datum_record) {
   using cyclus::Datum;
@@ -73,6 +73,14 @@ class RegionClassTests : public ::testing::Test {
   }
 };
 
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST_F(RegionClassTests, NextWakeup) {
+  // regions and institutions may act in Tick and Tock, so they are woken at
+  // every timestep unless they say otherwise
+  EXPECT_EQ(-1, reg_->NextWakeup());
+  EXPECT_EQ(-1, child1_->NextWakeup());
+}
+
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 TEST_F(RegionClassTests, TickIter) {
   ASSERT_EQ(5, reg_->children().size());
@@ -1,5 +1,7 @@
 #include <gtest/gtest.h>
 
+#include <cstdio>
+
 #include "comp_math.h"
 #include "composition.h"
 #include "context.h"
@@ -19,7 +21,7 @@ using cy::Agent;
 
 class Inver : public cy::Facility {
  public:
-  Inver(cy::Context* ctx) : cy::Facility(ctx), val1(0) {}
+  Inver(cy::Context* ctx) : cy::Facility(ctx), val1(0), nclears(0) {}
   virtual ~Inver() {}
 
   virtual Agent* Clone() {
@@ -31,20 +33,25 @@ class Inver : public cy::Facility {
   virtual void InitFrom(Inver* a) {
     cy::Facility::InitFrom(a);
     val1 = a->val1;
+    vals = a->vals;
   }
 
   virtual void InitFrom(cy::QueryableBackend* b) {
     cy::Facility::InitFrom(b);
     cy::QueryResult qr = b->Query("Info", NULL);
     val1 = qr.GetVal<int>("val1");
+    vals = qr.GetVal<std::vector<int> >("vals");
   }
 
   virtual void Snapshot(cy::DbInit di) {
     di.NewDatum("Info")
         ->AddVal("val1", val1)
+        ->AddVal("vals", vals)
         ->Record();
   }
 
+  virtual void ClearSnapshotDirty() { ++nclears; }
+
   virtual void Build(Agent* parent) {
     cy::Facility::Build(parent);
 
@@ -79,24 +86,50 @@ class Inver : public cy::Facility {
   cy::toolkit::ResourceBuff buf1;
   cy::toolkit::ResourceBuff buf2;
   int val1;
+  std::vector<int> vals;
+  int nclears;
 };
 
 Agent* ConstructInver(cy::Context* ctx) {
   return new Inver(ctx);
 }
 
+// counts the rows each table query reads from the wrapped backend
+class RowCounter : public cy::QueryableBackend {
+ public:
+  RowCounter(cy::QueryableBackend* b) : b_(b) {}
+
+  virtual cy::QueryResult Query(std::string table,
+                                std::vector<cy::Cond>* conds) {
+    cy::QueryResult qr = b_->Query(table, conds);
+    rows[table] += qr.rows.size();
+    return qr;
+  }
+
+  virtual std::map<std::string, cy::DbTypes> ColumnTypes(std::string table) {
+    return b_->ColumnTypes(table);
+  }
+
+  virtual std::set<std::string> Tables() { return b_->Tables(); }
+
+  std::map<std::string, int> rows;
+
+ private:
+  cy::QueryableBackend* b_;
+};
+
 class SimInitTest : public ::testing::Test {
  public:
   SimInitTest() : rec((unsigned int) 300) {}
 
  protected:
   virtual void SetUp() {
-    resetnextids();
     cy::DynamicModule::man_ctors_[":Inver:Inver"] = ConstructInver;
 
     b = new cy::SqliteBack(dbpath);
     rec.RegisterBackend(b);
     ctx = new cy::Context(&ti, &rec);
+    cy::IdCounters::current(ctx->ids());
     ctx->NewDatum("SolverInfo")
         ->AddVal("Solver", std::string("greedy")) // str constructor for macs
         ->AddVal("ExclusiveOrders", true)
@@ -139,28 +172,29 @@ class SimInitTest : public ::testing::Test {
   }
 
   virtual void TearDown() {
+    cy::IdCounters::current(NULL);
     rec.Close();
     delete ctx;
     delete b;
   }
 
-  void resetnextids() {
-    Agent::next_id_ = 0;
-    cy::Resource::nextstate_id_ = 1;
-    cy::Resource::nextobj_id_ = 1;
-    cy::Composition::next_id_ = 1;
-    cy::Product::next_qualid_ = 1;
-  }
-  int agentid() { return Agent::next_id_; }
-  int stateid() { return cy::Resource::nextstate_id_; }
-  int objid() { return cy::Resource::nextobj_id_; }
-  int compid() { return cy::Composition::next_id_; }
-  int prodid() { return cy::Product::next_qualid_; }
+  int agentid(cy::Context* ctx) { return ctx->ids()->agent; }
+  int stateid(cy::Context* ctx) { return ctx->ids()->res_state; }
+  int objid(cy::Context* ctx) { return ctx->ids()->res_obj; }
+  int compid(cy::Context* ctx) { return ctx->ids()->comp; }
+  int prodid(cy::Context* ctx) { return ctx->ids()->product; }
   int transid(cy::Context* ctx) { return ctx->trans_id_; }
 
   cy::SimInfo siminfo(cy::Context* ctx) { return ctx->si_; }
   std::set<Agent*> agent_list(cy::Context* ctx) { return ctx->agent_list_; }
   std::map<int, cy::TimeListener*> tickers(cy::Timer* ti) { return ti->tickers_; }
+  void time(cy::Timer* ti, int t) { ti->time_ = t; }
+
+  std::map<int, cy::Resource::Ptr> LoadResources(cy::QueryableBackend* b,
+                                                 const std::set<int>& ids) {
+    std::map<int, cy::Composition::Ptr> comps;
+    return cy::SimInit::LoadResources(ctx, b, ids, &comps);
+  }
 
   std::map<int, std::vector<std::pair<std::string, Agent*> > >
   build_queue(cy::Timer* ti) {
@@ -177,30 +211,37 @@ class SimInitTest : public ::testing::Test {
 };
 
 TEST_F(SimInitTest, InitNextIds) {
-  // retrieve next ids from global static vars before overwriting them
-  int agent_id = agentid();
-  int rsrc_state_id = stateid();
-  int rsrc_obj_id = objid();
-  int comp_qual_id = compid();
-  int prod_qual_id = prodid();
-
-  resetnextids();
-  ASSERT_EQ(0, agentid());
-  ASSERT_EQ(1, stateid());
-  ASSERT_EQ(1, objid());
-  ASSERT_EQ(1, compid());
-  ASSERT_EQ(1, prodid());
-
   cy::SimInit si;
   si.Init(&rec, b);
   cy::Context* init_ctx = si.context();
 
   EXPECT_EQ(transid(ctx), transid(init_ctx));
-  EXPECT_EQ(agent_id, agentid());
-  EXPECT_EQ(rsrc_state_id, stateid());
-  EXPECT_EQ(rsrc_obj_id, objid());
-  EXPECT_EQ(comp_qual_id, compid());
-  EXPECT_EQ(prod_qual_id, prodid());
+  EXPECT_EQ(agentid(ctx), agentid(init_ctx));
+  EXPECT_EQ(stateid(ctx), stateid(init_ctx));
+  EXPECT_EQ(objid(ctx), objid(init_ctx));
+  EXPECT_EQ(compid(ctx), compid(init_ctx));
+  EXPECT_EQ(prodid(ctx), prodid(init_ctx));
+}
+
+TEST_F(SimInitTest, IdsPerContext) {
+  // a second simulation assigns ids independently of the first
+  cy::Timer ti2;
+  cy::Recorder rec2;
+  cy::Context ctx2(&ti2, &rec2);
+  int next = agentid(ctx);
+  Inver* a = new Inver(&ctx2);
+  EXPECT_EQ(0, a->id());
+  EXPECT_EQ(next, agentid(ctx));
+  EXPECT_EQ(1, agentid(&ctx2));
+
+  cy::CompMap v;
+  v[922350000] = 1;
+  cy::Material::Ptr m =
+      cy::Material::Create(a, 1, cy::Composition::CreateFromMass(v));
+  // creating a tracked resource bumps its first state id when recording it
+  EXPECT_EQ(2, m->state_id());
+  EXPECT_EQ(1, m->obj_id());
+  ctx2.DelAgent(a);
 }
 
 TEST_F(SimInitTest, InitSimInfo) {
@@ -420,6 +461,70 @@ TEST_F(SimInitTest, InitAgentInventories) {
   }
 }
 
+TEST_F(SimInitTest, InitSharedCompositions) {
+  cy::SimInit si;
+  si.Init(&rec, b);
+  cy::Composition::Ptr recipe1 = si.context()->GetRecipe("recipe1");
+  cy::Composition::Ptr recipe2 = si.context()->GetRecipe("recipe2");
+
+  std::set<Agent*> init_agents = agent_list(si.context());
+  std::set<Agent*>::iterator it;
+  int ndeployed = 0;
+  for (it = init_agents.begin(); it != init_agents.end(); ++it) {
+    Inver* agent = dynamic_cast<Inver*>(*it);
+    if (agent->enter_time() == -1) {
+      continue;
+    }
+    ++ndeployed;
+
+    // every material built from a recipe is reloaded with the very same
+    // composition object as the reloaded recipe.
+    ASSERT_EQ(1, agent->buf1.count());
+    ASSERT_EQ(2, agent->buf2.count());
+    cy::Material::Ptr m1 = agent->buf1.Pop<cy::Material>();
+    cy::Material::Ptr m2 = agent->buf2.Pop<cy::Material>();
+    cy::Material::Ptr m3 = agent->buf2.Pop<cy::Material>();
+    EXPECT_EQ(recipe1, m1->comp());
+    EXPECT_EQ(recipe1, m2->comp());
+    EXPECT_EQ(recipe2, m3->comp());
+  }
+  EXPECT_EQ(2, ndeployed);
+}
+
+TEST_F(SimInitTest, LoadSparseResources) {
+  Inver* a = new Inver(ctx);
+  std::set<int> ids;
+  std::vector<cy::Composition::Ptr> comps;
+  cy::CompMap v;
+  for (int i = 0; i < 1000; ++i) {
+    v[922350000] = 1;
+    v[922380000] = 1 + i;
+    cy::Composition::Ptr c = cy::Composition::CreateFromMass(v);
+    comps.push_back(c);
+    cy::Material::Ptr m = cy::Material::Create(a, i + 1, c);
+    if (i % 250 == 0 || i == 999) {
+      ids.insert(m->state_id());
+    }
+  }
+  rec.Flush();
+
+  RowCounter counter(b);
+  std::map<int, cy::Resource::Ptr> rs = LoadResources(&counter, ids);
+  ASSERT_EQ(ids.size(), rs.size());
+  std::set<int>::iterator it;
+  for (it = ids.begin(); it != ids.end(); ++it) {
+    EXPECT_EQ(*it, rs[*it]->state_id());
+  }
+  EXPECT_DOUBLE_EQ(1, rs[*ids.begin()]->quantity());
+  EXPECT_DOUBLE_EQ(1000, rs[*ids.rbegin()]->quantity());
+
+  // only the rows of the requested resources are read
+  EXPECT_EQ(ids.size(), counter.rows["Resources"]);
+  EXPECT_EQ(ids.size(), counter.rows["MaterialInfo"]);
+  EXPECT_EQ(2 * ids.size(), counter.rows["Compositions"]);
+  ctx->DelAgent(a);
+}
+
 TEST_F(SimInitTest, RestartSimInfo) {
   ti.RunSim();
   rec.Flush();
@@ -437,3 +542,180 @@ TEST_F(SimInitTest, RestartSimInfo) {
   EXPECT_EQ("restart", info.parent_type);
   EXPECT_EQ(2, info.branch_time);
 }
+
+TEST_F(SimInitTest, RestartDeltaSnapshot) {
+  ctx->delta_snapshots(2);
+
+  std::map<int, Inver*> byid;
+  std::set<Agent*> agents = agent_list(ctx);
+  std::set<Agent*>::iterator it;
+  for (it = agents.begin(); it != agents.end(); ++it) {
+    if ((*it)->enter_time() != -1) {
+      byid[(*it)->id()] = dynamic_cast<Inver*>(*it);
+    }
+  }
+  ASSERT_EQ(2, byid.size());
+  Inver* changed = byid.begin()->second;
+  Inver* same = byid.rbegin()->second;
+  same->vals.push_back(3);
+  int nclears = same->nclears;
+
+  time(&ti, 1);
+  cy::SimInit::Snapshot(ctx);  // full
+
+  // change one agent's state and inventories: buf2 loses its first resource
+  // and buf1 gets a new resource in front of its old one
+  changed->val1 = 42;
+  changed->vals.push_back(7);
+  changed->buf2.Pop();
+  cy::Material::Ptr added = cy::Material::Create(
+      changed, 4, ctx->GetRecipe("recipe2"));
+  changed->buf1.Push(added);
+  cy::Resource::Ptr old = changed->buf1.Pop();
+  changed->buf1.Push(old);
+  time(&ti, 2);
+  cy::SimInit::Snapshot(ctx);  // incremental
+  rec.Flush();
+
+  cy::QueryResult qr = b->Query("DeltaSnapshots", NULL);
+  ASSERT_EQ(1, qr.rows.size());
+  EXPECT_EQ(2, qr.GetVal<int>("Time"));
+
+  // only the changed agent's state and inventory differences are recorded
+  std::vector<cy::Cond> conds;
+  conds.push_back(cy::Cond("SimTime", "==", 2));
+  qr = b->Query("AgentStateAgent", &conds);
+  ASSERT_EQ(1, qr.rows.size());
+  EXPECT_EQ(changed->id(), qr.GetVal<int>("AgentId"));
+  qr = b->Query("AgentState_Inver_InverInfo", &conds);  // compares vals too
+  ASSERT_EQ(1, qr.rows.size());
+  EXPECT_EQ(changed->id(), qr.GetVal<int>("AgentId"));
+  EXPECT_EQ(nclears + 2, same->nclears);  // after each snapshot
+  qr = b->Query("AgentStateInventoryDeltas", &conds);
+  ASSERT_EQ(1, qr.rows.size());  // buf2's removal
+  EXPECT_EQ("buf2", qr.GetVal<std::string>("InventoryName"));
+  EXPECT_TRUE(qr.GetVal<bool>("Removed"));
+  qr = b->Query("AgentStateInventories", &conds);
+  EXPECT_EQ(2, qr.rows.size());  // buf1 can't be appended to, so is in full
+
+  cy::SimInit si;
+  si.Restart(b, rec.sim_id(), 2);
+  std::map<int, Inver*> init_byid;
+  agents = agent_list(si.context());
+  for (it = agents.begin(); it != agents.end(); ++it) {
+    init_byid[(*it)->id()] = dynamic_cast<Inver*>(*it);
+  }
+
+  Inver* init_changed = init_byid[changed->id()];
+  ASSERT_TRUE(init_changed != NULL);
+  EXPECT_EQ(42, init_changed->val1);
+  EXPECT_EQ(std::vector<int>(1, 7), init_changed->vals);
+  ASSERT_EQ(2, init_changed->buf1.count());
+  EXPECT_EQ(added->state_id(), init_changed->buf1.Pop()->state_id());
+  EXPECT_EQ(old->state_id(), init_changed->buf1.Pop()->state_id());
+  ASSERT_EQ(1, init_changed->buf2.count());
+  EXPECT_EQ(changed->buf2.Pop()->state_id(),
+            init_changed->buf2.Pop()->state_id());
+
+  Inver* init_same = init_byid[same->id()];
+  ASSERT_TRUE(init_same != NULL);
+  EXPECT_EQ(same->val1, init_same->val1);
+  EXPECT_EQ(same->vals, init_same->vals);
+  EXPECT_EQ(1, init_same->buf1.count());
+  EXPECT_EQ(2, init_same->buf2.count());
+}
+
+TEST_F(SimInitTest, RestartFork) {
+  std::string branchpath = "sim_init_fork_branch.sqlite";
+  std::remove(branchpath.c_str());
+
+  // the state ids of the deployed agents' inventories at the fork
+  std::map<int, std::vector<int> > resids;
+  std::set<Agent*> agents = agent_list(ctx);
+  std::set<Agent*>::iterator it;
+  for (it = agents.begin(); it != agents.end(); ++it) {
+    if ((*it)->enter_time() == -1) {
+      continue;
+    }
+    cy::Inventories invs = (*it)->SnapshotInv();
+    std::vector<int>& ids = resids[(*it)->id()];
+    for (int i = 0; i < invs["buf1"].size(); ++i) {
+      ids.push_back(invs["buf1"][i]->state_id());
+    }
+    for (int i = 0; i < invs["buf2"].size(); ++i) {
+      ids.push_back(invs["buf2"][i]->state_id());
+    }
+  }
+  ASSERT_EQ(2, resids.size());
+
+  cy::ForkBranch br;
+  br.backend = [branchpath]() { return new cy::SqliteBack(branchpath); };
+  ti.Fork(1, std::vector<cy::ForkBranch>(1, br));
+  ti.RunSim();
+  rec.Flush();
+
+  cy::QueryResult qr = b->Query("ForkBranches", NULL);
+  ASSERT_EQ(1, qr.rows.size());
+  ASSERT_EQ(0, qr.GetVal<int>("ExitStatus"));
+  boost::uuids::uuid branchid = qr.GetVal<boost::uuids::uuid>("BranchSimId");
+
+  // the branch's output alone restarts it from the fork
+  cy::SqliteBack bb(branchpath);
+  cy::SimInit si;
+  ASSERT_NO_THROW(si.Restart(&bb, branchid, 1));
+  cy::Context* init_ctx = si.context();
+  EXPECT_EQ(1, init_ctx->time());
+
+  EXPECT_EQ(ctx->GetRecipe("recipe1")->id(),
+            init_ctx->GetRecipe("recipe1")->id());
+  EXPECT_EQ(ctx->GetRecipe("recipe2")->id(),
+            init_ctx->GetRecipe("recipe2")->id());
+
+  Inver* p1;
+  ASSERT_NO_THROW(p1 = init_ctx->CreateAgent<Inver>("proto1"));
+  EXPECT_EQ(23, p1->val1);
+  Inver* p2;
+  ASSERT_NO_THROW(p2 = init_ctx->CreateAgent<Inver>("proto2"));
+  EXPECT_EQ(26, p2->val1);
+
+  std::map<int, Inver*> init_byid;
+  agents = agent_list(init_ctx);
+  for (it = agents.begin(); it != agents.end(); ++it) {
+    if ((*it)->enter_time() != -1) {
+      init_byid[(*it)->id()] = dynamic_cast<Inver*>(*it);
+    }
+  }
+  ASSERT_EQ(2, init_byid.size());
+  std::map<int, std::vector<int> >::iterator rit;
+  for (rit = resids.begin(); rit != resids.end(); ++rit) {
+    Inver* agent = init_byid[rit->first];
+    ASSERT_TRUE(agent != NULL) << "agent id " << rit->first << " not restarted";
+    ASSERT_EQ(1, agent->buf1.count());
+    ASSERT_EQ(2, agent->buf2.count());
+    cy::Material::Ptr m1 = agent->buf1.Pop<cy::Material>();
+    cy::Material::Ptr m2 = agent->buf2.Pop<cy::Material>();
+    cy::Material::Ptr m3 = agent->buf2.Pop<cy::Material>();
+    EXPECT_EQ(rit->second[0], m1->state_id());
+    EXPECT_EQ(rit->second[1], m2->state_id());
+    EXPECT_EQ(rit->second[2], m3->state_id());
+    EXPECT_DOUBLE_EQ(1, m1->quantity());
+    EXPECT_DOUBLE_EQ(2, m2->quantity());
+    EXPECT_DOUBLE_EQ(3, m3->quantity());
+    EXPECT_EQ(init_ctx->GetRecipe("recipe1"), m1->comp());
+    EXPECT_EQ(init_ctx->GetRecipe("recipe2"), m3->comp());
+  }
+
+  std::map<int, std::vector<std::pair<std::string, Agent*> > > builds =
+      build_queue(si.timer());
+  ASSERT_EQ(1, builds[2].size());
+  EXPECT_EQ("proto1", builds[2][0].first);
+  ASSERT_EQ(1, builds[3].size());
+  EXPECT_EQ("proto2", builds[3][0].first);
+  std::map<int, std::vector<Agent*> > decoms = decom_queue(si.timer());
+  ASSERT_EQ(1, decoms[1].size());
+  EXPECT_EQ(2, decoms[1][0]->id());
+  ASSERT_EQ(1, decoms[2].size());
+  EXPECT_EQ(3, decoms[2][0]->id());
+
+  std::remove(branchpath.c_str());
+}
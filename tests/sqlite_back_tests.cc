@@ -1,7 +1,10 @@
 #include "boost/lexical_cast.hpp"
+#include <boost/archive/xml_oarchive.hpp>
+#include <boost/serialization/vector.hpp>
 #include <boost/uuid/uuid_io.hpp>
 #include <gtest/gtest.h>
 
+#include "binary_encoding.h"
 #include "blob.h"
 #include "sqlite_back.h"
 
@@ -525,3 +528,227 @@ TEST_F(SqliteBackTests, ListPairIntInt) {
   EXPECT_EQ(std::make_pair(4, 2), l.front());
   EXPECT_EQ(std::make_pair(5, 3), l.back());
 }
+
+TEST(SqliteBackEncodingTests, Binary) {
+  std::string fname = "sqlite_back_binary.sqlite";
+  FileDeleter fd(fname);
+  std::map<std::string, std::vector<double> > m;
+  m["one"].push_back(1.1);
+  m["two"].push_back(2.2);
+  m["two"].push_back(3.3);
+
+  cyclus::SqliteBack* b = new cyclus::SqliteBack(
+      fname, cyclus::SqliteBack::BINARY_ENCODING);
+  EXPECT_EQ(cyclus::SqliteBack::BINARY_ENCODING, b->encoding());
+  cyclus::Recorder r;
+  r.RegisterBackend(b);
+  r.NewDatum("monty")
+      ->AddVal("count", m)
+      ->Record();
+  r.Close();
+
+  cyclus::SqlStatement::Ptr stmt = b->db().Prepare(
+      "SELECT Encoding FROM FieldTypes WHERE TableName = 'monty';");
+  while (stmt->Step()) {
+    EXPECT_EQ(cyclus::SqliteBack::BINARY_ENCODING, stmt->GetInt(0));
+  }
+  delete b;
+
+  // a backend using a different encoding reads and appends to existing tables
+  // in their original encoding
+  b = new cyclus::SqliteBack(fname, cyclus::SqliteBack::XML_ENCODING);
+  cyclus::Recorder r2;
+  r2.RegisterBackend(b);
+  r2.NewDatum("monty")
+      ->AddVal("count", m)
+      ->Record();
+  r2.Close();
+  cyclus::QueryResult qr = b->Query("monty", NULL);
+  ASSERT_EQ(2, qr.rows.size());
+  for (int i = 0; i < 2; ++i) {
+    EXPECT_EQ(m, (qr.GetVal<std::map<std::string, std::vector<double> > >(
+                      "count", i)));
+  }
+  delete b;
+}
+
+TEST(SqliteBackEncodingTests, Xml) {
+  std::set<std::string> s;
+  s.insert("foo");
+  s.insert("bar");
+
+  // XML is the default
+  cyclus::SqliteBack b(path);
+  EXPECT_EQ(cyclus::SqliteBack::XML_ENCODING, b.encoding());
+  cyclus::Recorder r;
+  r.RegisterBackend(&b);
+  r.NewDatum("monty")
+      ->AddVal("names", s)
+      ->Record();
+  r.Close();
+
+  cyclus::SqlStatement::Ptr stmt = b.db().Prepare(
+      "SELECT names FROM monty;");
+  ASSERT_TRUE(stmt->Step());
+  EXPECT_EQ(0, std::string(stmt->GetText(0, NULL)).find("<?xml"));
+  cyclus::QueryResult qr = b.Query("monty", NULL);
+  EXPECT_EQ(s, qr.GetVal<std::set<std::string> >("names", 0));
+}
+
+TEST(SqliteBackEncodingTests, TruncatedBinary) {
+  // a container length larger than the remaining bytes can hold is rejected
+  // before anything is allocated for it
+  std::string x;
+  cyclus::BinEncode(std::vector<int>(3, 7), &x);
+  uint32_t huge = 0xffffffff;
+  memcpy(&x[0], &huge, sizeof(huge));
+  cyclus::DbTypes types[] = {cyclus::VECTOR_INT, cyclus::LIST_INT,
+                             cyclus::SET_INT, cyclus::MAP_INT_INT};
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_THROW(cyclus::BinDecodeAny(x.data(), x.size(), types[i]),
+                 cyclus::ValueError);
+  }
+
+  // as is a value cut short
+  x.clear();
+  cyclus::BinEncode(std::vector<int>(3, 7), &x);
+  x.resize(x.size() - 1);
+  EXPECT_THROW(cyclus::BinDecodeAny(x.data(), x.size(), cyclus::VECTOR_INT),
+               cyclus::ValueError);
+}
+
+TEST(SqliteBackEncodingTests, LegacyFieldTypes) {
+  // databases written before the Encoding column existed hold XML values
+  std::string fname = "sqlite_back_legacy.sqlite";
+  FileDeleter fd(fname);
+  {
+    cyclus::SqliteDb db(fname);
+    db.open();
+    db.Execute("CREATE TABLE FieldTypes"
+               "(TableName TEXT,Field TEXT,Type INTEGER);");
+    db.Execute("CREATE TABLE Old (vals BLOB);");
+    std::stringstream ins;
+    ins << "INSERT INTO FieldTypes VALUES ('Old','vals'," << cyclus::VECTOR_INT
+        << ");";
+    db.Execute(ins.str());
+    std::vector<int> v(3, 7);
+    std::stringstream ss;
+    {
+      boost::archive::xml_oarchive ar(ss);
+      std::vector<int>& vect = v;
+      ar & BOOST_SERIALIZATION_NVP(vect);
+    }
+    std::string x = ss.str();
+    cyclus::SqlStatement::Ptr stmt = db.Prepare("INSERT INTO Old VALUES (?);");
+    stmt->BindBlob(1, x.c_str(), x.size());
+    stmt->Exec();
+    db.close();
+  }
+
+  cyclus::SqliteBack b(fname);
+  cyclus::QueryResult qr = b.Query("Old", NULL);
+  EXPECT_EQ(std::vector<int>(3, 7), qr.GetVal<std::vector<int> >("vals", 0));
+
+  // new tables in the old database record their encoding
+  cyclus::Recorder r;
+  r.RegisterBackend(&b);
+  r.NewDatum("New")
+      ->AddVal("vals", std::vector<int>(2, 5))
+      ->Record();
+  r.Close();
+  qr = b.Query("New", NULL);
+  EXPECT_EQ(std::vector<int>(2, 5), qr.GetVal<std::vector<int> >("vals", 0));
+  qr = b.Query("Old", NULL);
+  EXPECT_EQ(std::vector<int>(3, 7), qr.GetVal<std::vector<int> >("vals", 0));
+}
+
+TEST_F(SqliteBackTests, Cursor) {
+  for (int i = 0; i < 10; ++i) {
+    r.NewDatum("Rows")
+        ->AddVal("Time", i)
+        ->AddVal("Commodity", std::string(i % 2 == 0 ? "even" : "odd"))
+        ->AddVal("Quantity", 0.5 * i)
+        ->Record();
+  }
+  r.Close();
+
+  std::vector<cyclus::Cond> conds;
+  conds.push_back(cyclus::Cond("Commodity", "==", std::string("odd")));
+  std::vector<std::string> cols;
+  cols.push_back("Quantity");
+  cols.push_back("Time");
+  cyclus::QueryCursor::Ptr c = b->Cursor("Rows", &conds, &cols);
+  ASSERT_EQ(2, c->fields().size());
+  EXPECT_EQ("Quantity", c->fields()[0]);
+  EXPECT_EQ(cyclus::INT, c->types()[1]);
+
+  std::vector<cyclus::QueryRow> rows;
+  ASSERT_TRUE(c->Next(&rows, 3));
+  ASSERT_EQ(3, rows.size());
+  ASSERT_EQ(2, rows[0].size());
+  EXPECT_EQ(1, rows[0][1].cast<int>());
+  EXPECT_DOUBLE_EQ(2.5, rows[2][0].cast<double>());
+  ASSERT_TRUE(c->Next(&rows, 3));
+  ASSERT_EQ(2, rows.size());
+  EXPECT_EQ(9, rows[1][1].cast<int>());
+  EXPECT_FALSE(c->Next(&rows, 3));
+  EXPECT_TRUE(rows.empty());
+
+  cyclus::QueryResult qr = b->Cursor("Rows", NULL)->ReadAll();
+  EXPECT_EQ(10, qr.rows.size());
+  EXPECT_EQ(4, qr.fields.size());  // injects simid
+
+  cols.push_back("Nope");
+  EXPECT_THROW(b->Cursor("Rows", NULL, &cols), cyclus::KeyError);
+}
+
+TEST_F(SqliteBackTests, Aggregate) {
+  for (int i = 0; i < 30; ++i) {
+    r.NewDatum("Rows")
+        ->AddVal("Time", i)
+        ->AddVal("Commodity", std::string(i % 2 == 0 ? "even" : "odd"))
+        ->AddVal("Quantity", 0.5 * i)
+        ->Record();
+  }
+  r.Close();
+
+  std::vector<std::string> group_by(1, "Commodity");
+  std::vector<cyclus::Agg> aggs;
+  aggs.push_back(cyclus::Agg("count"));
+  aggs.push_back(cyclus::Agg("sum", "Quantity"));
+  aggs.push_back(cyclus::Agg("max", "Time"));
+  aggs.push_back(cyclus::Agg("mean", "Quantity"));
+  cyclus::QueryResult qr = b->Aggregate("Rows", NULL, &group_by, &aggs);
+  ASSERT_EQ(5, qr.fields.size());
+  EXPECT_EQ("sum(Quantity)", qr.fields[2]);
+  EXPECT_EQ(cyclus::INT, qr.types[3]);
+  ASSERT_EQ(2, qr.rows.size());
+  EXPECT_EQ("even", qr.GetVal<std::string>("Commodity", 0));
+  EXPECT_EQ(15, qr.GetVal<int>("count", 0));
+  EXPECT_DOUBLE_EQ(105, qr.GetVal<double>("sum(Quantity)", 0));
+  EXPECT_EQ(28, qr.GetVal<int>("max(Time)", 0));
+  EXPECT_DOUBLE_EQ(7.5, qr.GetVal<double>("mean(Quantity)", 1));
+
+  // time buckets of 10 steps
+  std::vector<cyclus::Cond> conds;
+  conds.push_back(cyclus::Cond("Commodity", "==", std::string("odd")));
+  group_by[0] = "Time";
+  aggs.clear();
+  aggs.push_back(cyclus::Agg("min", "Quantity"));
+  qr = b->Aggregate("Rows", &conds, &group_by, &aggs, 10);
+  ASSERT_EQ(3, qr.rows.size());
+  EXPECT_EQ(20, qr.GetVal<int>("Time", 2));
+  EXPECT_DOUBLE_EQ(10.5, qr.GetVal<double>("min(Quantity)", 2));
+
+  // no groups and no matching rows
+  aggs.push_back(cyclus::Agg("count"));
+  conds.push_back(cyclus::Cond("Time", ">", 100));
+  EXPECT_EQ(0, b->Aggregate("Rows", &conds, NULL, &aggs).rows.size());
+  conds.pop_back();
+  qr = b->Aggregate("Rows", &conds, NULL, &aggs);
+  ASSERT_EQ(1, qr.rows.size());
+  EXPECT_EQ(15, qr.GetVal<int>("count"));
+
+  aggs.push_back(cyclus::Agg("sum", "Commodity"));
+  EXPECT_THROW(b->Aggregate("Rows", NULL, NULL, &aggs), cyclus::ValueError);
+}
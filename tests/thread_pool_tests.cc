@@ -0,0 +1,81 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "error.h"
+#include "thread_pool.h"
+
+using cyclus::ThreadPool;
+
+TEST(ThreadPoolTests, Size) {
+  EXPECT_EQ(1, ThreadPool(0).size());
+  EXPECT_EQ(1, ThreadPool(1).size());
+  EXPECT_EQ(4, ThreadPool(4).size());
+}
+
+TEST(ThreadPoolTests, RunsEveryTask) {
+  ThreadPool pool(4);
+  for (int n = 0; n < 50; n += 7) {
+    std::vector<int> out(n, 0);
+    pool.ParallelFor(n, [&](int i) { out[i] += i * i; });
+    for (int i = 0; i < n; ++i) {
+      EXPECT_EQ(i * i, out[i]);
+    }
+  }
+}
+
+TEST(ThreadPoolTests, StealsFromBusyThread) {
+  // the caller's first task blocks until all others have run, so the
+  // worker must steal the rest of the caller's share
+  ThreadPool pool(2);
+  std::atomic<int> done(0);
+  pool.ParallelFor(8, [&](int i) {
+    if (i == 0) {
+      for (int k = 0; k < 10000 && done < 7; ++k) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    } else {
+      ++done;
+    }
+  });
+  EXPECT_EQ(7, done);
+}
+
+TEST(ThreadPoolTests, Nested) {
+  ThreadPool pool(3);
+  std::vector<int> out(10 * 10, 0);
+  pool.ParallelFor(10, [&](int i) {
+    pool.ParallelFor(10, [&](int j) { out[i * 10 + j] = 1; });
+  });
+  for (int i = 0; i < out.size(); ++i) {
+    EXPECT_EQ(1, out[i]);
+  }
+}
+
+TEST(ThreadPoolTests, LowestIndexErrorRethrown) {
+  ThreadPool pool(4);
+  std::vector<int> ran(100, 0);
+  try {
+    pool.ParallelFor(100, [&](int i) {
+      ran[i] = 1;
+      if (i == 17 || i == 63) {
+        throw cyclus::ValueError(i == 17 ? "first" : "second");
+      }
+    });
+    FAIL() << "expected an exception";
+  } catch (cyclus::ValueError& e) {
+    EXPECT_NE(std::string::npos, std::string(e.what()).find("first"));
+  }
+
+  // the pool is still usable after an error
+  int sum = 0;
+  std::vector<int> out(20, 1);
+  pool.ParallelFor(20, [&](int i) { out[i] = 2; });
+  for (int i = 0; i < out.size(); ++i) {
+    sum += out[i];
+  }
+  EXPECT_EQ(40, sum);
+}
@@ -1,9 +1,14 @@
 #include <gtest/gtest.h>
 
+#include <cstdio>
+
+#include "composition.h"
 #include "context.h"
+#include "error.h"
 #include "facility.h"
 #include "greedy_preconditioner.h"
 #include "greedy_solver.h"
+#include "material.h"
 #include "recorder.h"
 #include "timer.h"
 #include "sqlite_back.h"
@@ -63,6 +68,66 @@ class Snapper : public cyclus::Facility {
   bool snap;
 };
 
+class Sleeper : public cyclus::Facility {
+ public:
+  Sleeper(cyclus::Context* ctx) : cyclus::Facility(ctx), snap_at(-1) {}
+  virtual ~Sleeper() {}
+
+  virtual cyclus::Agent* Clone() { return new Sleeper(context()); }
+  virtual void InitInv(cyclus::Inventories& inv) {}
+  virtual cyclus::Inventories SnapshotInv() { return cyclus::Inventories(); }
+
+  void Tick() {
+    ticks.push_back(context()->time());
+    if (context()->time() == snap_at) {
+      context()->Snapshot();
+    }
+  }
+  void Tock() {}
+
+  virtual int NextWakeup() {
+    for (int i = 0; i < wakeups.size(); ++i) {
+      if (wakeups[i] > context()->time()) {
+        return wakeups[i];
+      }
+    }
+    return kNeverWake;
+  }
+  virtual int NextTrade() { return kNeverWake; }
+
+  std::vector<int> wakeups;
+  std::vector<int> ticks;
+  int snap_at;
+};
+
+class TickLogger : public cyclus::Facility {
+ public:
+  TickLogger(cyclus::Context* ctx, bool safe) : cyclus::Facility(ctx), safe(safe) {}
+  virtual ~TickLogger() {}
+
+  virtual cyclus::Agent* Clone() { return new TickLogger(context(), safe); }
+  virtual void InitInv(cyclus::Inventories& inv) {}
+  virtual cyclus::Inventories SnapshotInv() { return cyclus::Inventories(); }
+
+  void Tick() {
+    int matid = -1;
+    if (comp) {
+      matid = cyclus::Material::Create(this, 1, comp)->state_id();
+    }
+    context()->NewDatum("TickLog")
+        ->AddVal("AgentId", id())
+        ->AddVal("Time", context()->time())
+        ->AddVal("MatId", matid)
+        ->Record();
+  }
+  void Tock() {}
+  virtual bool ThreadSafeTick() { return safe; }
+
+  bool safe;
+  // if set, a material of this composition is created in every Tick
+  cyclus::Composition::Ptr comp;
+};
+
 TEST(TimerTests, BareSim) {
   cyclus::Recorder rec;
   cyclus::Timer ti;
@@ -91,6 +156,7 @@ TEST(TimerTests, EarlyTermination) {
   cyclus::QueryResult qr = b.Query("Finish", NULL);
   bool early = qr.GetVal<bool>("EarlyTerm");
   int end = qr.GetVal<int>("EndTime");
+  EXPECT_EQ(0, qr.GetVal<int>("InternedDups"));
 
   EXPECT_TRUE(early);
   EXPECT_EQ(0, end);
@@ -140,6 +206,80 @@ TEST(TimerTests, CustomSnapshot) {
   EXPECT_EQ(10, qr.GetVal<int>("Time", 3));
 }
 
+TEST(TimerTests, SnapshotInterval) {
+  cyclus::Recorder rec;
+  cyclus::Timer ti;
+  cyclus::Context ctx(&ti, &rec);
+  cyclus::SqliteBack b(path);
+  rec.RegisterBackend(&b);
+
+  ti.Initialize(&ctx, cyclus::SimInfo(10));
+  ctx.snapshot_interval(4);
+  ctx.delta_snapshots(1);
+
+  Snapper* turtle = new Snapper(&ctx);
+  turtle->Build(NULL);
+
+  ti.RunSim();
+  rec.Close();
+
+  cyclus::QueryResult qr = b.Query("Snapshots", NULL);
+  ASSERT_EQ(3, qr.rows.size());
+  EXPECT_EQ(4, qr.GetVal<int>("Time", 0));
+  EXPECT_EQ(8, qr.GetVal<int>("Time", 1));
+  EXPECT_EQ(10, qr.GetVal<int>("Time", 2));
+
+  // every full snapshot is followed by one incremental snapshot
+  qr = b.Query("DeltaSnapshots", NULL);
+  ASSERT_EQ(1, qr.rows.size());
+  EXPECT_EQ(8, qr.GetVal<int>("Time", 0));
+}
+
+TEST(TimerTests, Fork) {
+  std::string branchpath = "timer_fork_branch.sqlite";
+  std::remove(branchpath.c_str());
+
+  cyclus::Recorder rec;
+  cyclus::Timer ti;
+  cyclus::Context ctx(&ti, &rec);
+  cyclus::SqliteBack b(path);
+  rec.RegisterBackend(&b);
+
+  ti.Initialize(&ctx, cyclus::SimInfo(6));
+  Snapper* turtle = new Snapper(&ctx);
+  turtle->Build(NULL);
+
+  cyclus::ForkBranch br;
+  br.backend = [branchpath]() { return new cyclus::SqliteBack(branchpath); };
+  ti.Fork(3, std::vector<cyclus::ForkBranch>(1, br));
+  ti.RunSim();
+  rec.Close();
+
+  cyclus::QueryResult qr = b.Query("ForkBranches", NULL);
+  ASSERT_EQ(1, qr.rows.size());
+  EXPECT_EQ(3, qr.GetVal<int>("BranchTime"));
+  EXPECT_EQ(0, qr.GetVal<int>("ExitStatus"));
+  boost::uuids::uuid branchid = qr.GetVal<boost::uuids::uuid>("BranchSimId");
+
+  // the branch records its parent and a snapshot of its state at the fork
+  cyclus::SqliteBack bb(branchpath);
+  qr = bb.Query("Info", NULL);
+  ASSERT_EQ(1, qr.rows.size());
+  EXPECT_EQ(branchid, qr.GetVal<boost::uuids::uuid>("SimId"));
+  EXPECT_EQ(ctx.sim_id(), qr.GetVal<boost::uuids::uuid>("ParentSimId"));
+  EXPECT_EQ("fork", qr.GetVal<std::string>("ParentType"));
+  EXPECT_EQ(3, qr.GetVal<int>("BranchTime"));
+  qr = bb.Query("Snapshots", NULL);
+  ASSERT_EQ(2, qr.rows.size());
+  EXPECT_EQ(3, qr.GetVal<int>("Time", 0));
+  EXPECT_EQ(6, qr.GetVal<int>("Time", 1));
+  qr = bb.Query("Finish", NULL);
+  ASSERT_EQ(1, qr.rows.size());
+  EXPECT_EQ(5, qr.GetVal<int>("EndTime"));
+
+  std::remove(branchpath.c_str());
+}
+
 TEST(TimerTests, NullParentDecomNoSegfault) {
   cyclus::Recorder rec;
   cyclus::Timer ti;
@@ -169,3 +309,231 @@ TEST(TimerTests, DoubleDecom) {
   ti.RunSim();
   EXPECT_EQ(1, Dier::decom_count);
 }
+
+TEST(TimerTests, SkipIdle) {
+  cyclus::Recorder rec;
+  cyclus::Timer ti;
+  cyclus::Context ctx(&ti, &rec);
+  cyclus::SqliteBack b(path);
+  rec.RegisterBackend(&b);
+
+  cyclus::SimInfo si(20);
+  si.skip_idle = true;
+  ti.Initialize(&ctx, si);
+
+  Sleeper* s = new Sleeper(&ctx);
+  s->wakeups.push_back(5);
+  s->wakeups.push_back(12);
+  s->Build(NULL);
+  Sleeper* gone = new Sleeper(&ctx);
+  gone->Build(NULL);
+  ctx.SchedDecom(gone, 8);
+
+  ti.RunSim();
+  rec.Close();
+
+  // only time steps with a wake-up or a decommissioning are run
+  std::vector<int> want;
+  want.push_back(0);
+  want.push_back(5);
+  want.push_back(8);
+  want.push_back(12);
+  EXPECT_EQ(want, s->ticks);
+
+  cyclus::QueryResult qr = b.Query("Finish", NULL);
+  EXPECT_FALSE(qr.GetVal<bool>("EarlyTerm"));
+  EXPECT_EQ(19, qr.GetVal<int>("EndTime"));
+}
+
+TEST(TimerTests, SkipIdleSnapshot) {
+  cyclus::Recorder rec;
+  cyclus::Timer ti;
+  cyclus::Context ctx(&ti, &rec);
+  cyclus::SqliteBack b(path);
+  rec.RegisterBackend(&b);
+
+  cyclus::SimInfo si(10);
+  si.skip_idle = true;
+  ti.Initialize(&ctx, si);
+
+  Sleeper* s = new Sleeper(&ctx);
+  s->wakeups.push_back(3);
+  s->snap_at = 3;
+  s->Build(NULL);
+
+  ti.RunSim();
+  rec.Close();
+
+  // the snapshot requested at time 3 is taken at the start of time 4
+  std::vector<int> want;
+  want.push_back(0);
+  want.push_back(3);
+  want.push_back(4);
+  EXPECT_EQ(want, s->ticks);
+
+  cyclus::QueryResult qr = b.Query("Snapshots", NULL);
+  EXPECT_EQ(2, qr.rows.size());
+  EXPECT_EQ(4, qr.GetVal<int>("Time", 0));
+  EXPECT_EQ(10, qr.GetVal<int>("Time", 1));
+}
+
+TEST(TimerTests, ParallelTick) {
+  cyclus::Recorder rec;
+  cyclus::Timer ti;
+  cyclus::Context ctx(&ti, &rec);
+  cyclus::SqliteBack b(path);
+  rec.RegisterBackend(&b);
+
+  ti.Initialize(&ctx, cyclus::SimInfo(3));
+  ctx.nthreads(4);
+
+  std::vector<int> agents;
+  for (int i = 0; i < 12; ++i) {
+    TickLogger* l = new TickLogger(&ctx, i % 3 != 0);
+    l->Build(NULL);
+    agents.push_back(l->id());
+  }
+
+  ti.RunSim();
+  rec.Close();
+
+  // records keep the id order of a serial run across thread-safe and
+  // other listeners
+  cyclus::QueryResult qr = b.Query("TickLog", NULL);
+  ASSERT_EQ(36, qr.rows.size());
+  int row = 0;
+  for (int t = 0; t < 3; ++t) {
+    for (int i = 0; i < agents.size(); ++i, ++row) {
+      EXPECT_EQ(t, qr.GetVal<int>("Time", row));
+      EXPECT_EQ(agents[i], qr.GetVal<int>("AgentId", row));
+    }
+  }
+}
+
+// runs a simulation of thread-safe listeners and listeners that create
+// materials, returning the ids of the created materials in TickLog order
+std::vector<int> TickIds(int nthreads) {
+  cyclus::Recorder rec;
+  cyclus::Timer ti;
+  cyclus::Context ctx(&ti, &rec);
+  cyclus::SqliteBack b(path);
+  rec.RegisterBackend(&b);
+
+  ti.Initialize(&ctx, cyclus::SimInfo(3));
+  ctx.nthreads(nthreads);
+
+  cyclus::CompMap v;
+  v[922350000] = 1;
+  cyclus::Composition::Ptr c = cyclus::Composition::CreateFromMass(v);
+  for (int i = 0; i < 12; ++i) {
+    TickLogger* l = new TickLogger(&ctx, i % 3 != 0);
+    if (!l->safe) {
+      l->comp = c;
+    }
+    l->Build(NULL);
+  }
+
+  ti.RunSim();
+  rec.Close();
+
+  std::vector<int> ids;
+  cyclus::QueryResult qr = b.Query("TickLog", NULL);
+  for (int i = 0; i < qr.rows.size(); ++i) {
+    ids.push_back(qr.GetVal<int>("MatId", i));
+  }
+  return ids;
+}
+
+TEST(TimerTests, ParallelTickIds) {
+  std::vector<int> first = TickIds(1);
+  ASSERT_EQ(36, first.size());
+  for (int i = 0; i < 5; ++i) {
+    std::vector<int> ids = TickIds(4);
+    ASSERT_EQ(first.size(), ids.size());
+    for (int j = 0; j < ids.size(); ++j) {
+      EXPECT_EQ(first[j], ids[j]) << "run " << i << ", row " << j;
+    }
+  }
+}
+
+TEST(TimerTests, ParallelTickNoIds) {
+  cyclus::Recorder rec;
+  cyclus::Timer ti;
+  cyclus::Context ctx(&ti, &rec);
+  ti.Initialize(&ctx, cyclus::SimInfo(3));
+  ctx.nthreads(4);
+
+  // thread-safe listeners may not create materials, whose ids would depend
+  // on the threads' timing
+  cyclus::CompMap v;
+  v[922350000] = 1;
+  for (int i = 0; i < 4; ++i) {
+    TickLogger* l = new TickLogger(&ctx, true);
+    l->comp = cyclus::Composition::CreateFromMass(v);
+    l->Build(NULL);
+  }
+  EXPECT_THROW(ti.RunSim(), cyclus::StateError);
+
+  // nor without threads
+  cyclus::Recorder rec1;
+  cyclus::Timer ti1;
+  cyclus::Context ctx1(&ti1, &rec1);
+  ti1.Initialize(&ctx1, cyclus::SimInfo(3));
+  TickLogger* l = new TickLogger(&ctx1, true);
+  l->comp = cyclus::Composition::CreateFromMass(v);
+  l->Build(NULL);
+  EXPECT_THROW(ti1.RunSim(), cyclus::StateError);
+}
+
+TEST(TimerTests, Timings) {
+  cyclus::Recorder rec;
+  cyclus::Timer ti;
+  cyclus::Context ctx(&ti, &rec);
+  cyclus::SqliteBack b(path);
+  rec.RegisterBackend(&b);
+
+  ti.Initialize(&ctx, cyclus::SimInfo(3));
+  ctx.timings(cyclus::Timings::AGENTS);
+  TickLogger* l = new TickLogger(&ctx, false);
+  l->Build(NULL);
+
+  ti.RunSim();
+  rec.Close();
+
+  std::vector<cyclus::Cond> conds;
+  conds.push_back(cyclus::Cond("Phase", "==", std::string("Tick")));
+  cyclus::QueryResult qr = b.Query("PhaseTimings", &conds);
+  ASSERT_EQ(3, qr.rows.size());
+  for (int t = 0; t < 3; ++t) {
+    EXPECT_EQ(t, qr.GetVal<int>("Time", t));
+    EXPECT_GE(qr.GetVal<double>("Seconds", t), 0);
+  }
+
+  conds[0] = cyclus::Cond("Phase", "==", std::string("Solve"));
+  qr = b.Query("PhaseTimings", &conds);
+  EXPECT_EQ(0, qr.rows.size());  // no trader ever requests anything
+
+  conds[0] = cyclus::Cond("AgentId", "==", l->id());
+  qr = b.Query("AgentTimings", &conds);
+  // Tick, Tock and the material and product request and bid queries
+  EXPECT_EQ(3 * 6, qr.rows.size());
+}
+
+TEST(TimerTests, TimingsDisabled) {
+  cyclus::Recorder rec;
+  cyclus::Timer ti;
+  cyclus::Context ctx(&ti, &rec);
+  cyclus::SqliteBack b(path);
+  rec.RegisterBackend(&b);
+
+  ti.Initialize(&ctx, cyclus::SimInfo(3));
+  TickLogger* l = new TickLogger(&ctx, false);
+  l->Build(NULL);
+
+  ti.RunSim();
+  rec.Close();
+
+  std::set<std::string> tables = b.Tables();
+  EXPECT_EQ(0, tables.count("PhaseTimings"));
+  EXPECT_EQ(0, tables.count("AgentTimings"));
+}